@@ -31,6 +31,7 @@
 #include <netinet/in.h>
 #include <pthread.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 
 #include <dirent.h>
@@ -226,10 +227,12 @@ static void dbg_logger_finish(void)
 
 void dbg_logger(DBG_LOGGER logger, DBG_LOGGER_FINISH finish, void *user)
 {
+	static int finish_registered = 0;
 	DBG_LOGGER_DATA data;
-	if(num_loggers == 0)
+	if(!finish_registered)
 	{
 		atexit(dbg_logger_finish);
+		finish_registered = 1;
 	}
 	data.logger = logger;
 	data.finish = finish;
@@ -238,6 +241,12 @@ void dbg_logger(DBG_LOGGER logger, DBG_LOGGER_FINISH finish, void *user)
 	num_loggers++;
 }
 
+void dbg_logger_reset(void)
+{
+	dbg_logger_finish();
+	num_loggers = 0;
+}
+
 void dbg_logger_stdout(void)
 {
 #if defined(CONF_FAMILY_WINDOWS)
@@ -279,6 +288,99 @@ void mem_zero(void *block, unsigned size)
 	memset(block, 0, size);
 }
 
+static MEMTAGSTATS memory_tags[NUM_MEMTAGS] = {{0}};
+
+typedef struct
+{
+	int64 size;
+	int64 tag;
+} MEMHEADER;
+
+#if defined(_MSC_VER)
+static int64 atomic_add64(volatile int64 *value, int64 add)
+{
+	return InterlockedExchangeAdd64((volatile LONG64 *)value, add) + add;
+}
+
+static int64 atomic_compswap64(volatile int64 *value, int64 comperand, int64 newvalue)
+{
+	return InterlockedCompareExchange64((volatile LONG64 *)value, newvalue, comperand);
+}
+#else
+static int64 atomic_add64(volatile int64 *value, int64 add)
+{
+	return __atomic_add_fetch(value, add, __ATOMIC_RELAXED);
+}
+
+static int64 atomic_compswap64(volatile int64 *value, int64 comperand, int64 newvalue)
+{
+	__atomic_compare_exchange_n(value, &comperand, newvalue, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	return comperand;
+}
+#endif
+
+static void mem_tag_add(int tag, int64 size, int allocs)
+{
+	MEMTAGSTATS *stats = &memory_tags[tag];
+	int64 live = atomic_add64(&stats->live_bytes, size);
+	int64 peak = stats->peak_bytes;
+	while(live > peak)
+	{
+		int64 prev = atomic_compswap64(&stats->peak_bytes, peak, live);
+		if(prev == peak)
+			break;
+		peak = prev;
+	}
+
+	if(allocs)
+	{
+		atomic_add64(&stats->live_allocs, allocs);
+		if(allocs > 0)
+			atomic_add64(&stats->total_allocs, allocs);
+	}
+}
+
+void *mem_alloc_tagged(int tag, unsigned size)
+{
+	/* the header keeps the block 16 byte aligned */
+	MEMHEADER *header = (MEMHEADER *)malloc(sizeof(MEMHEADER) + size);
+	if(!header)
+		return 0;
+	header->size = size;
+	header->tag = tag;
+	mem_tag_add(tag, size, 1);
+	return header + 1;
+}
+
+void mem_free_tagged(void *block)
+{
+	MEMHEADER *header;
+	if(!block)
+		return;
+	header = (MEMHEADER *)block - 1;
+	mem_tag_add((int)header->tag, -header->size, -1);
+	free(header);
+}
+
+void mem_account(int tag, int64 size)
+{
+	mem_tag_add(tag, size, 0);
+}
+
+void mem_tag_stats(int tag, MEMTAGSTATS *stats)
+{
+	stats->live_bytes = atomic_add64(&memory_tags[tag].live_bytes, 0);
+	stats->peak_bytes = atomic_add64(&memory_tags[tag].peak_bytes, 0);
+	stats->live_allocs = atomic_add64(&memory_tags[tag].live_allocs, 0);
+	stats->total_allocs = atomic_add64(&memory_tags[tag].total_allocs, 0);
+}
+
+const char *mem_tag_name(int tag)
+{
+	static const char *names[NUM_MEMTAGS] = {"snapshots", "snapshot_delta", "map", "datafile", "localization", "sql", "entities"};
+	return names[tag];
+}
+
 IOHANDLE io_open(const char *filename, int flags)
 {
 	if(flags == IOFLAG_READ)
@@ -366,6 +468,70 @@ int io_flush(IOHANDLE io)
 	return fflush((FILE *)io);
 }
 
+void *io_map_file(const char *filename, unsigned *size)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE file, mapping;
+	LARGE_INTEGER file_size;
+	void *data = 0;
+
+	*size = 0;
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return 0;
+	if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0 || file_size.QuadPart > 0x7fffffff)
+	{
+		CloseHandle(file);
+		return 0;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if(mapping)
+	{
+		data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+
+	if(data)
+		*size = (unsigned)file_size.QuadPart;
+	return data;
+#else
+	struct stat file_stat;
+	void *data;
+	int fd;
+
+	*size = 0;
+	fd = open(filename, O_RDONLY);
+	if(fd < 0)
+		return 0;
+	if(fstat(fd, &file_stat) != 0 || file_stat.st_size == 0 || file_stat.st_size > 0x7fffffff)
+	{
+		close(fd);
+		return 0;
+	}
+
+	data = mmap(0, file_stat.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+		return 0;
+
+	*size = (unsigned)file_stat.st_size;
+	return data;
+#endif
+}
+
+void io_unmap_file(void *data, unsigned size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 #define ASYNC_BUFSIZE 8 * 1024
 #define ASYNC_LOCAL_BUFSIZE 64 * 1024
 
@@ -309,6 +309,37 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
+/*
+	Function: io_map_file
+		Maps a whole file into memory for reading.
+
+	Parameters:
+		filename - File to map.
+		size - Pointer to an unsigned that receives the size of the file.
+
+	Returns:
+		Returns a pointer to the file contents, NULL if the file doesn't
+		exist, is empty or couldn't be mapped.
+
+	Remarks:
+		The mapping is copy-on-write, changes to the memory are never
+		written back to the file.
+
+	See Also:
+		<io_unmap_file>
+*/
+void *io_map_file(const char *filename, unsigned *size);
+
+/*
+	Function: io_unmap_file
+		Releases memory returned by <io_map_file>.
+
+	Parameters:
+		data - Pointer returned by <io_map_file>.
+		size - Size returned by <io_map_file>.
+*/
+void io_unmap_file(void *data, unsigned size);
+
 /*
 	Function: io_error
 		Checks whether an error occurred during I/O with the file.
@@ -642,6 +673,79 @@ typedef long long int64;
 typedef unsigned long long uint64;
 #endif
 
+/* Group: Memory accounting */
+enum
+{
+	MEMTAG_SNAPSHOTS=0,
+	MEMTAG_SNAPSHOT_DELTA,
+	MEMTAG_MAP,
+	MEMTAG_DATAFILE,
+	MEMTAG_LOCALIZATION,
+	MEMTAG_SQL,
+	MEMTAG_ENTITIES,
+	NUM_MEMTAGS
+};
+
+typedef struct
+{
+	int64 live_bytes;
+	int64 peak_bytes;
+	int64 live_allocs;
+	int64 total_allocs;
+} MEMTAGSTATS;
+
+/*
+	Function: mem_alloc_tagged
+		Allocates memory and counts it for a subsystem.
+
+	Parameters:
+		tag - MEMTAG_* of the subsystem.
+		size - Size of the block.
+
+	Returns:
+		The block, to be released with <mem_free_tagged>.
+
+	Remarks:
+		- The counters are updated atomically, any thread can allocate.
+*/
+void *mem_alloc_tagged(int tag, unsigned size);
+
+/*
+	Function: mem_free_tagged
+		Frees a block allocated with <mem_alloc_tagged>.
+
+	Parameters:
+		block - The block, or 0.
+*/
+void mem_free_tagged(void *block);
+
+/*
+	Function: mem_account
+		Counts memory of a subsystem that isn't allocated with
+		<mem_alloc_tagged>, like mapped files or large members.
+
+	Parameters:
+		tag - MEMTAG_* of the subsystem.
+		size - Bytes taken, negative when they are released.
+*/
+void mem_account(int tag, int64 size);
+
+/*
+	Function: mem_tag_stats
+		Gets the counters of a subsystem.
+
+	Parameters:
+		tag - MEMTAG_* of the subsystem.
+		stats - Receives the counters.
+*/
+void mem_tag_stats(int tag, MEMTAGSTATS *stats);
+
+/*
+	Function: mem_tag_name
+		Returns the name of a MEMTAG_* for reports.
+*/
+const char *mem_tag_name(int tag);
+
 void set_new_tick(void);
 
 /*
@@ -1808,13 +1912,15 @@ void dbg_logger(DBG_LOGGER logger, DBG_LOGGER_FINISH finish, void *user);
 void dbg_logger_stdout(void);
 void dbg_logger_debugger(void);
 void dbg_logger_file(const char *filename);
+/* flushes and removes all loggers, their threads would not survive a fork() */
+void dbg_logger_reset(void);
 
 typedef struct
 {
-	int sent_packets;
-	int sent_bytes;
-	int recv_packets;
-	int recv_bytes;
+	int64 sent_packets;
+	int64 sent_bytes;
+	int64 recv_packets;
+	int64 recv_bytes;
 } NETSTATS;
 
 void net_stats(NETSTATS *stats);
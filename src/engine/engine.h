@@ -25,6 +25,8 @@ protected:
 public:
 	virtual void Init() = 0;
 	virtual void InitLogfile() = 0;
+	// threads don't survive a fork, a process that forks starts them afterwards
+	virtual void InitJobs() = 0;
 	virtual void HostLookup(CHostLookup *pLookup, const char *pHostname, int Nettype) = 0;
 	virtual void AddJob(CJob *pJob, JOBFUNC pfnFunc, void *pData) = 0;
 };
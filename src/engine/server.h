@@ -274,6 +274,19 @@ public:
 	virtual void SnapFreeID(int ID) = 0;
 	virtual void *SnapNewItem(int Type, int ID, int Size) = 0;
 
+	// When a snapshot is over its item or size budget, the items of the
+	// least important class are dropped first, the farthest ones first within
+	// a class. Applies to the items added after it, until the next call.
+	enum
+	{
+		SNAP_PRIORITY_CRITICAL = 0,
+		SNAP_PRIORITY_CHARACTER,
+		SNAP_PRIORITY_GAMEPLAY,
+		SNAP_PRIORITY_EVENT,
+		SNAP_PRIORITY_COSMETIC,
+	};
+	virtual void SnapSetPriority(int Class, float Distance = 0.0f) = 0;
+
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
 
 	enum
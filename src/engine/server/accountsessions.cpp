@@ -0,0 +1,64 @@
+#include "accountsessions.h"
+
+#include <engine/shared/network.h>
+
+CAccountSessions::CAccountSessions()
+{
+	Clear();
+}
+
+bool CAccountSessions::KeepsSession(int DropType)
+{
+	return DropType != CLIENTDROPTYPE_KICK && DropType != CLIENTDROPTYPE_BAN && DropType != CLIENTDROPTYPE_SHUTDOWN;
+}
+
+void CAccountSessions::Save(const NETADDR *pAddr, int UserID, const char *pUsername, int64 Expires)
+{
+	// same address first, then the one that expires first, free ones included
+	CSession *pSession = &m_aSessions[0];
+	for(int i = 0; i < MAX_SESSIONS; i++)
+	{
+		if(m_aSessions[i].m_Expires && net_addr_comp(&m_aSessions[i].m_Addr, pAddr) == 0)
+		{
+			pSession = &m_aSessions[i];
+			break;
+		}
+		if(m_aSessions[i].m_Expires < pSession->m_Expires)
+			pSession = &m_aSessions[i];
+	}
+
+	pSession->m_Addr = *pAddr;
+	pSession->m_UserID = UserID;
+	str_copy(pSession->m_aUsername, pUsername, sizeof(pSession->m_aUsername));
+	pSession->m_Expires = Expires;
+}
+
+bool CAccountSessions::Take(const NETADDR *pAddr, int64 Now, CSession *pSession)
+{
+	for(int i = 0; i < MAX_SESSIONS; i++)
+	{
+		// the port has to match too, players behind the same address don't share their accounts
+		if(!m_aSessions[i].m_Expires || net_addr_comp(&m_aSessions[i].m_Addr, pAddr) != 0)
+			continue;
+
+		bool Valid = m_aSessions[i].m_Expires > Now;
+		*pSession = m_aSessions[i];
+		m_aSessions[i].m_Expires = 0;
+		return Valid;
+	}
+	return false;
+}
+
+void CAccountSessions::Clear()
+{
+	mem_zero(m_aSessions, sizeof(m_aSessions));
+}
+
+int CAccountSessions::Num(int64 Now) const
+{
+	int Num = 0;
+	for(int i = 0; i < MAX_SESSIONS; i++)
+		if(m_aSessions[i].m_Expires > Now)
+			Num++;
+	return Num;
+}
@@ -0,0 +1,44 @@
+#ifndef ENGINE_SERVER_ACCOUNTSESSIONS_H
+#define ENGINE_SERVER_ACCOUNTSESSIONS_H
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+
+// Accounts of the clients that dropped out, given back without a new login
+// when a client connects again from the same address and port, whatever
+// slot it gets. Kept for a limited time, the oldest one makes room when full.
+// Only the account is kept, never a user level: someone else can end up
+// with the same address and port.
+class CAccountSessions
+{
+public:
+	enum
+	{
+		MAX_SESSIONS = MAX_CLIENTS,
+	};
+
+	struct CSession
+	{
+		NETADDR m_Addr;
+		int m_UserID;
+		char m_aUsername[MAX_NAME_LENGTH];
+		int64 m_Expires;
+	};
+
+	CAccountSessions();
+
+	// timeouts and reconnects keep the account, kicks, bans and shutdowns don't
+	static bool KeepsSession(int DropType);
+
+	void Save(const NETADDR *pAddr, int UserID, const char *pUsername, int64 Expires);
+	// removes the session of the address, false if there is none or it expired
+	bool Take(const NETADDR *pAddr, int64 Now, CSession *pSession);
+	void Clear();
+
+	int Num(int64 Now) const;
+
+private:
+	CSession m_aSessions[MAX_SESSIONS];
+};
+
+#endif
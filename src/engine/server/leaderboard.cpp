@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <functional>
+
+#include <base/math.h>
+
+#include "leaderboard.h"
+
+CLeaderboardCache::CLeaderboardCache(int MaxRounds)
+{
+	m_Lock = lock_create();
+	m_MaxRounds = MaxRounds;
+	m_TimeToLive = 300;
+	mem_zero(&m_Stats, sizeof(m_Stats));
+}
+
+CLeaderboardCache::~CLeaderboardCache()
+{
+	lock_destroy(m_Lock);
+}
+
+CLeaderboardCache::CBoard* CLeaderboardCache::FindBoard(const char* pMapName, int ScoreType)
+{
+	std::map<CBoardKey, CBoard>::iterator Iter = m_Boards.find(CBoardKey(pMapName, ScoreType));
+	if(Iter == m_Boards.end())
+		return 0;
+	return &Iter->second;
+}
+
+// expired boards nobody asked for since, then the least recently used ones
+// if there are still too many, boards being loaded are kept
+void CLeaderboardCache::EvictBoards(int64 Now)
+{
+	std::map<CBoardKey, CBoard>::iterator Oldest = m_Boards.end();
+	int NumBoards = 0;
+	for(std::map<CBoardKey, CBoard>::iterator Iter = m_Boards.begin(); Iter != m_Boards.end();)
+	{
+		if(Iter->second.m_State == BOARD_READY && Now - Iter->second.m_UseTime >= m_TimeToLive)
+		{
+			m_Boards.erase(Iter++);
+			m_Stats.m_Evicted++;
+			continue;
+		}
+		if(Iter->second.m_State == BOARD_READY && (Oldest == m_Boards.end() || Iter->second.m_UseTime < Oldest->second.m_UseTime))
+			Oldest = Iter;
+		NumBoards++;
+		++Iter;
+	}
+
+	if(NumBoards >= MAX_BOARDS && Oldest != m_Boards.end())
+	{
+		m_Boards.erase(Oldest);
+		m_Stats.m_Evicted++;
+	}
+}
+
+void CLeaderboardCache::AddRound(CBoard* pBoard, int MaxRounds, int UserID, const char* pUsername, int Score)
+{
+	CPlayer& Player = pBoard->m_Players[UserID];
+	if(Player.m_lRounds.empty())
+	{
+		str_copy(Player.m_aUsername, pUsername, sizeof(Player.m_aUsername));
+		Player.m_Score = 0;
+	}
+	else
+	{
+		CRankKey OldKey = { Player.m_Score, UserID };
+		std::vector<CRankKey>::iterator Iter = std::lower_bound(pBoard->m_lRanking.begin(), pBoard->m_lRanking.end(), OldKey);
+		if(Iter != pBoard->m_lRanking.end() && Iter->m_UserID == UserID)
+			pBoard->m_lRanking.erase(Iter);
+	}
+
+	std::vector<int>& lRounds = Player.m_lRounds;
+	if((int)lRounds.size() >= MaxRounds && lRounds.back() >= Score)
+	{
+		// not good enough to replace one of the best rounds
+		CRankKey Key = { Player.m_Score, UserID };
+		pBoard->m_lRanking.insert(std::lower_bound(pBoard->m_lRanking.begin(), pBoard->m_lRanking.end(), Key), Key);
+		return;
+	}
+
+	lRounds.insert(std::upper_bound(lRounds.begin(), lRounds.end(), Score, std::greater<int>()), Score);
+	Player.m_Score += Score;
+	if((int)lRounds.size() > MaxRounds)
+	{
+		Player.m_Score -= lRounds.back();
+		lRounds.pop_back();
+	}
+
+	CRankKey Key = { Player.m_Score, UserID };
+	pBoard->m_lRanking.insert(std::lower_bound(pBoard->m_lRanking.begin(), pBoard->m_lRanking.end(), Key), Key);
+}
+
+void CLeaderboardCache::FillEntry(int UserID, const CPlayer* pPlayer, CEntry* pEntry)
+{
+	pEntry->m_UserID = UserID;
+	pEntry->m_Score = pPlayer->m_Score;
+	pEntry->m_NumRounds = pPlayer->m_lRounds.size();
+	pEntry->m_LowestScore = pPlayer->m_lRounds.empty() ? 0 : pPlayer->m_lRounds.back();
+	str_copy(pEntry->m_aUsername, pPlayer->m_aUsername, sizeof(pEntry->m_aUsername));
+}
+
+int CLeaderboardCache::Request(const char* pMapName, int ScoreType, const CRequest& Request, int64 Now)
+{
+	int Result = RESULT_READY;
+
+	lock_wait(m_Lock);
+	CBoard* pBoard = FindBoard(pMapName, ScoreType);
+	if(!pBoard)
+	{
+		EvictBoards(Now);
+		pBoard = &m_Boards[CBoardKey(pMapName, ScoreType)];
+		pBoard->m_State = BOARD_LOADING;
+		pBoard->m_Outdated = false;
+		pBoard->m_Loaded = false;
+		pBoard->m_LoadTime = Now;
+		m_Stats.m_Misses++;
+		Result = RESULT_LOAD;
+	}
+	else if(pBoard->m_State == BOARD_LOADING)
+	{
+		m_Stats.m_Queued++;
+		Result = RESULT_QUEUED;
+	}
+	else if(pBoard->m_Outdated || Now - pBoard->m_LoadTime >= m_TimeToLive)
+	{
+		pBoard->m_State = BOARD_LOADING;
+		pBoard->m_Outdated = false;
+		m_Stats.m_Expired++;
+		Result = RESULT_LOAD;
+	}
+	else
+		m_Stats.m_Hits++;
+
+	pBoard->m_UseTime = Now;
+	if(Result != RESULT_READY)
+		pBoard->m_lPendingRequests.push_back(Request);
+	lock_unlock(m_Lock);
+
+	return Result;
+}
+
+void CLeaderboardCache::FinishLoad(const char* pMapName, int ScoreType, const std::vector<CRoundScore>& lRounds, int64 Now, std::vector<CRequest>* pRequests)
+{
+	lock_wait(m_Lock);
+	CBoard& Board = m_Boards[CBoardKey(pMapName, ScoreType)];
+
+	Board.m_Players.clear();
+	for(unsigned i = 0; i < lRounds.size(); i++)
+	{
+		CPlayer& Player = Board.m_Players[lRounds[i].m_UserID];
+		if(Player.m_lRounds.empty())
+		{
+			str_copy(Player.m_aUsername, lRounds[i].m_aUsername, sizeof(Player.m_aUsername));
+			Player.m_Score = 0;
+		}
+		Player.m_lRounds.push_back(lRounds[i].m_Score);
+	}
+
+	Board.m_lRanking.clear();
+	Board.m_lRanking.reserve(Board.m_Players.size());
+	for(std::map<int, CPlayer>::iterator Iter = Board.m_Players.begin(); Iter != Board.m_Players.end(); ++Iter)
+	{
+		std::vector<int>& lPlayerRounds = Iter->second.m_lRounds;
+		std::sort(lPlayerRounds.begin(), lPlayerRounds.end(), std::greater<int>());
+		if((int)lPlayerRounds.size() > m_MaxRounds)
+			lPlayerRounds.resize(m_MaxRounds);
+
+		for(unsigned i = 0; i < lPlayerRounds.size(); i++)
+			Iter->second.m_Score += lPlayerRounds[i];
+
+		CRankKey Key = { Iter->second.m_Score, Iter->first };
+		Board.m_lRanking.push_back(Key);
+	}
+	std::sort(Board.m_lRanking.begin(), Board.m_lRanking.end());
+
+	// m_Outdated stays set if new scores were written while loading
+	Board.m_State = BOARD_READY;
+	Board.m_Loaded = true;
+	Board.m_LoadTime = Now;
+	if(pRequests)
+		pRequests->insert(pRequests->end(), Board.m_lPendingRequests.begin(), Board.m_lPendingRequests.end());
+	Board.m_lPendingRequests.clear();
+	lock_unlock(m_Lock);
+}
+
+bool CLeaderboardCache::AbortLoad(const char* pMapName, int ScoreType, std::vector<CRequest>* pRequests)
+{
+	bool Loaded = false;
+
+	lock_wait(m_Lock);
+	CBoard* pBoard = FindBoard(pMapName, ScoreType);
+	if(pBoard)
+	{
+		pRequests->insert(pRequests->end(), pBoard->m_lPendingRequests.begin(), pBoard->m_lPendingRequests.end());
+		pBoard->m_lPendingRequests.clear();
+
+		// keep the previous load, the next request tries again
+		Loaded = pBoard->m_Loaded;
+		if(Loaded)
+		{
+			pBoard->m_State = BOARD_READY;
+			pBoard->m_Outdated = true;
+		}
+		else
+			m_Boards.erase(CBoardKey(pMapName, ScoreType));
+	}
+	lock_unlock(m_Lock);
+
+	return Loaded;
+}
+
+void CLeaderboardCache::AddRoundScore(const char* pMapName, int ScoreType, const CRoundScore& Round)
+{
+	lock_wait(m_Lock);
+	CBoard* pBoard = FindBoard(pMapName, ScoreType);
+	if(pBoard)
+	{
+		if(pBoard->m_State == BOARD_READY)
+		{
+			AddRound(pBoard, m_MaxRounds, Round.m_UserID, Round.m_aUsername, Round.m_Score);
+			m_Stats.m_Updates++;
+		}
+		else
+			pBoard->m_Outdated = true;
+	}
+	lock_unlock(m_Lock);
+}
+
+int CLeaderboardCache::GetTop(const char* pMapName, int ScoreType, CEntry* pEntries, int MaxEntries)
+{
+	int NumEntries = 0;
+
+	lock_wait(m_Lock);
+	CBoard* pBoard = FindBoard(pMapName, ScoreType);
+	if(pBoard)
+	{
+		for(unsigned i = 0; i < pBoard->m_lRanking.size() && NumEntries < MaxEntries; i++)
+		{
+			int UserID = pBoard->m_lRanking[i].m_UserID;
+			FillEntry(UserID, &pBoard->m_Players[UserID], &pEntries[NumEntries]);
+			NumEntries++;
+		}
+	}
+	lock_unlock(m_Lock);
+
+	return NumEntries;
+}
+
+bool CLeaderboardCache::GetPlayer(const char* pMapName, int ScoreType, int UserID, int* pRank, CEntry* pEntry)
+{
+	bool Found = false;
+
+	lock_wait(m_Lock);
+	CBoard* pBoard = FindBoard(pMapName, ScoreType);
+	if(pBoard)
+	{
+		std::map<int, CPlayer>::const_iterator Iter = pBoard->m_Players.find(UserID);
+		if(Iter != pBoard->m_Players.end())
+		{
+			CRankKey Key = { Iter->second.m_Score, UserID };
+			*pRank = std::lower_bound(pBoard->m_lRanking.begin(), pBoard->m_lRanking.end(), Key) - pBoard->m_lRanking.begin() + 1;
+			FillEntry(UserID, &Iter->second, pEntry);
+			Found = true;
+		}
+	}
+	lock_unlock(m_Lock);
+
+	return Found;
+}
+
+void CLeaderboardCache::SetDailyBest(int ScoreType, const std::vector<CRoundScore>& lRounds)
+{
+	lock_wait(m_Lock);
+	std::vector<CRoundScore>& lDailyBest = m_DailyBest[ScoreType];
+	lDailyBest.assign(lRounds.begin(), lRounds.begin() + minimum((int)lRounds.size(), (int)MAX_DAILY_BEST));
+	lock_unlock(m_Lock);
+}
+
+void CLeaderboardCache::AddDailyScore(int ScoreType, const CRoundScore& Round)
+{
+	lock_wait(m_Lock);
+	std::map<int, std::vector<CRoundScore> >::iterator Iter = m_DailyBest.find(ScoreType);
+	if(Iter != m_DailyBest.end())
+	{
+		std::vector<CRoundScore>& lDailyBest = Iter->second;
+		unsigned Pos = 0;
+		while(Pos < lDailyBest.size() && lDailyBest[Pos].m_Score >= Round.m_Score)
+			Pos++;
+		if(Pos < MAX_DAILY_BEST)
+		{
+			lDailyBest.insert(lDailyBest.begin() + Pos, Round);
+			if(lDailyBest.size() > MAX_DAILY_BEST)
+				lDailyBest.pop_back();
+		}
+	}
+	lock_unlock(m_Lock);
+}
+
+int CLeaderboardCache::GetDailyBest(int ScoreType, CRoundScore* pRounds, int MaxRounds)
+{
+	int NumRounds = 0;
+
+	lock_wait(m_Lock);
+	std::map<int, std::vector<CRoundScore> >::iterator Iter = m_DailyBest.find(ScoreType);
+	if(Iter != m_DailyBest.end())
+	{
+		for(; NumRounds < (int)Iter->second.size() && NumRounds < MaxRounds; NumRounds++)
+			pRounds[NumRounds] = Iter->second[NumRounds];
+	}
+	lock_unlock(m_Lock);
+
+	return NumRounds;
+}
+
+void CLeaderboardCache::GetStats(CStats* pStats, int64 Now)
+{
+	lock_wait(m_Lock);
+	*pStats = m_Stats;
+	pStats->m_NumBoards = 0;
+	pStats->m_NumPlayers = 0;
+	pStats->m_OldestBoardAge = 0;
+	for(std::map<CBoardKey, CBoard>::iterator Iter = m_Boards.begin(); Iter != m_Boards.end(); ++Iter)
+	{
+		if(Iter->second.m_State != BOARD_READY)
+			continue;
+		pStats->m_NumBoards++;
+		pStats->m_NumPlayers += Iter->second.m_Players.size();
+		pStats->m_OldestBoardAge = maximum(pStats->m_OldestBoardAge, (int)(Now - Iter->second.m_LoadTime));
+	}
+	lock_unlock(m_Lock);
+}
@@ -0,0 +1,159 @@
+#ifndef ENGINE_SERVER_LEADERBOARD_H
+#define ENGINE_SERVER_LEADERBOARD_H
+
+#include <base/system.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Local copy of the per map leaderboards, so chat commands don't hit the
+// database every time. A board holds the best rounds of every player for
+// one map and score type and is kept up to date when round statistics are
+// written. Boards expire after a while because other servers may write to
+// the same database.
+class CLeaderboardCache
+{
+public:
+	enum
+	{
+		MAX_USERNAME_LENGTH = 32,
+		MAX_DAILY_BEST = 5,
+		// the least recently used board makes room past that
+		MAX_BOARDS = 64,
+	};
+
+	enum
+	{
+		REQUEST_TOP10 = 0,
+		REQUEST_RANK,
+		REQUEST_GOAL,
+		REQUEST_CHALLENGE,
+	};
+
+	enum
+	{
+		// the board is up to date, answer the request now
+		RESULT_READY = 0,
+		// the request has been queued behind a load that is already running
+		RESULT_QUEUED,
+		// the request has been queued, the caller must load the board
+		RESULT_LOAD,
+	};
+
+	struct CRequest
+	{
+		int m_Type;
+		int m_ClientID;
+		int m_UserID;
+		int m_DailyScoreType; // for REQUEST_CHALLENGE
+	};
+
+	struct CRoundScore
+	{
+		int m_UserID;
+		int m_Score;
+		char m_aUsername[MAX_USERNAME_LENGTH];
+	};
+
+	struct CEntry
+	{
+		int m_UserID;
+		int m_Score;
+		int m_NumRounds;
+		int m_LowestScore;
+		char m_aUsername[MAX_USERNAME_LENGTH];
+	};
+
+	struct CStats
+	{
+		int m_NumBoards;
+		int m_NumPlayers;
+		int64 m_Hits;
+		int64 m_Misses;
+		int64 m_Queued;
+		int64 m_Expired;
+		int64 m_Updates;
+		int64 m_Evicted;
+		int m_OldestBoardAge;
+	};
+
+private:
+	struct CRankKey
+	{
+		int m_Score;
+		int m_UserID;
+
+		// best score first, same order as the sql queries
+		bool operator<(const CRankKey& Other) const
+		{
+			if(m_Score != Other.m_Score)
+				return m_Score > Other.m_Score;
+			return m_UserID < Other.m_UserID;
+		}
+	};
+
+	struct CPlayer
+	{
+		char m_aUsername[MAX_USERNAME_LENGTH];
+		int m_Score;
+		std::vector<int> m_lRounds; // best first
+	};
+
+	enum
+	{
+		BOARD_LOADING = 0,
+		BOARD_READY,
+	};
+
+	struct CBoard
+	{
+		int m_State;
+		bool m_Outdated;
+		// a board being loaded again still answers from its previous load
+		bool m_Loaded;
+		int64 m_LoadTime;
+		int64 m_UseTime;
+		std::map<int, CPlayer> m_Players;
+		std::vector<CRankKey> m_lRanking;
+		std::vector<CRequest> m_lPendingRequests;
+	};
+
+	typedef std::pair<std::string, int> CBoardKey;
+
+	LOCK m_Lock;
+	int m_MaxRounds;
+	int m_TimeToLive;
+	std::map<CBoardKey, CBoard> m_Boards;
+	CStats m_Stats;
+
+	std::map<int, std::vector<CRoundScore> > m_DailyBest;
+
+	CBoard* FindBoard(const char* pMapName, int ScoreType);
+	void EvictBoards(int64 Now);
+	static void AddRound(CBoard* pBoard, int MaxRounds, int UserID, const char* pUsername, int Score);
+	static void FillEntry(int UserID, const CPlayer* pPlayer, CEntry* pEntry);
+
+public:
+	CLeaderboardCache(int MaxRounds);
+	~CLeaderboardCache();
+
+	void SetTimeToLive(int Seconds) { m_TimeToLive = Seconds; }
+
+	int Request(const char* pMapName, int ScoreType, const CRequest& Request, int64 Now);
+	void FinishLoad(const char* pMapName, int ScoreType, const std::vector<CRoundScore>& lRounds, int64 Now, std::vector<CRequest>* pRequests);
+	// gives back the pending requests, true if they can be answered from a previous load
+	bool AbortLoad(const char* pMapName, int ScoreType, std::vector<CRequest>* pRequests);
+	void AddRoundScore(const char* pMapName, int ScoreType, const CRoundScore& Round);
+
+	int GetTop(const char* pMapName, int ScoreType, CEntry* pEntries, int MaxEntries);
+	bool GetPlayer(const char* pMapName, int ScoreType, int UserID, int* pRank, CEntry* pEntry);
+
+	void SetDailyBest(int ScoreType, const std::vector<CRoundScore>& lRounds);
+	void AddDailyScore(int ScoreType, const CRoundScore& Round);
+	int GetDailyBest(int ScoreType, CRoundScore* pRounds, int MaxRounds);
+
+	void GetStats(CStats* pStats, int64 Now);
+};
+
+#endif
@@ -11,9 +11,14 @@
 #include <game/server/infclass/infcgamecontroller.h>
 #include <game/server/teeinfo.h>
 
+#include <engine/shared/config.h>
+
 #include <pnglite.h>
 
 #include <limits>
+#include <map>
+#include <string>
+#include <vector>
 
 enum class DDNET_TILE
 {
@@ -280,6 +285,11 @@ CMapConverter::~CMapConverter()
 		delete[] m_pTiles;
 }
 
+void CMapConverter::GetClientMapName(char *pBuffer, int BufferSize, const char *pConverterId, const char *pMapName, unsigned ServerMapCrc)
+{
+	str_format(pBuffer, BufferSize, "clientmaps/%s/%s_%08x.map", pConverterId, pMapName, ServerMapCrc);
+}
+
 // Work with 'long long' to properly handle overflows (later)
 static inline long long gcd_long(long long a, long long b)
 {
@@ -801,6 +811,7 @@ void CMapConverter::CopyAnimations()
 void CMapConverter::CopyGameLayer()
 {
 	CMapItemLayerTilemap Item;
+	mem_zero(&Item, sizeof(Item));
 	Item.m_Version = Item.m_Layer.m_Version = 3;
 	Item.m_Layer.m_Flags = 0;
 	Item.m_Layer.m_Type = LAYERTYPE_TILES;
@@ -965,21 +976,76 @@ int CMapConverter::AddExternalImage(const char* pImageName, int Width, int Heigh
 	return m_NumImages-1;
 }
 
-int CMapConverter::AddEmbeddedImage(const char *pImageName, int Width, int Height, bool GrayScale)
+// Embedded images decoded to RGBA, kept for the whole process so that
+// converting another map doesn't decode the class skins again
+struct CDecodedImage
 {
-	CImageInfo img;
-	CImageInfo *pImg = &img;
+	int m_Width;
+	int m_Height;
+	std::vector<unsigned char> m_lData;
+};
 
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf), "data/mapres/%s.png", pImageName);
+static const CDecodedImage *GetDecodedImage(const char *pFilename, bool GrayScale)
+{
+	static LOCK s_Lock = lock_create();
+	static std::map<std::pair<std::string, bool>, CDecodedImage> s_Images;
+
+	const CDecodedImage *pResult = 0;
+	lock_wait(s_Lock);
+	std::pair<std::string, bool> Key(pFilename, GrayScale);
+	std::map<std::pair<std::string, bool>, CDecodedImage>::const_iterator Iter = s_Images.find(Key);
+	if(Iter != s_Images.end())
+		pResult = &Iter->second;
+	else
+	{
+		CImageInfo Img;
+		if(LoadPNG(&Img, pFilename))
+		{
+			if(GrayScale)
+			{
+				MakeGrayScale(&Img);
+			}
 
-	if (!LoadPNG(pImg, aBuf)) {
-		return -1;
+			CDecodedImage &Image = s_Images[Key];
+			Image.m_Width = Img.m_Width;
+			Image.m_Height = Img.m_Height;
+			Image.m_lData.resize((size_t)Img.m_Width * Img.m_Height * 4);
+			if(Img.m_Format == CImageInfo::FORMAT_RGB)
+			{
+				// Convert to RGBA
+				unsigned char *pDataRGBA = &Image.m_lData[0];
+				unsigned char *pDataRGB = (unsigned char *)Img.m_pData;
+				for(int i = 0; i < Img.m_Width * Img.m_Height; i++)
+				{
+					pDataRGBA[i * 4] = pDataRGB[i * 3];
+					pDataRGBA[i * 4 + 1] = pDataRGB[i * 3 + 1];
+					pDataRGBA[i * 4 + 2] = pDataRGB[i * 3 + 2];
+					pDataRGBA[i * 4 + 3] = 255;
+				}
+			}
+			else
+			{
+				mem_copy(&Image.m_lData[0], Img.m_pData, Image.m_lData.size());
+			}
+
+			FreePNG(&Img);
+			pResult = &Image;
+		}
 	}
+	lock_unlock(s_Lock);
+
+	return pResult;
+}
+
+int CMapConverter::AddEmbeddedImage(const char *pImageName, int Width, int Height, bool GrayScale)
+{
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf), "data/mapres/%s.png", pImageName);
 
-	if(GrayScale)
+	const CDecodedImage *pImage = GetDecodedImage(aBuf, GrayScale);
+	if(!pImage)
 	{
-		MakeGrayScale(pImg);
+		return -1;
 	}
 
 	CMapItemImage Item;
@@ -990,32 +1056,11 @@ int CMapConverter::AddEmbeddedImage(const char *pImageName, int Width, int Heigh
 	Item.m_Height = Height;
 	Item.m_ImageName = m_DataFile.AddData(str_length((char*)pImageName)+1, (char*)pImageName);
 
-	Item.m_Width = pImg->m_Width;
-	Item.m_Height = pImg->m_Height;
-
-	if(pImg->m_Format == CImageInfo::FORMAT_RGB)
-	{
-		// Convert to RGBA
-		unsigned char *pDataRGBA = (unsigned char *)malloc((size_t)Item.m_Width * Item.m_Height * 4);
-		unsigned char *pDataRGB = (unsigned char *)pImg->m_pData;
-		for(int i = 0; i < Item.m_Width * Item.m_Height; i++)
-		{
-			pDataRGBA[i * 4] = pDataRGB[i * 3];
-			pDataRGBA[i * 4 + 1] = pDataRGB[i * 3 + 1];
-			pDataRGBA[i * 4 + 2] = pDataRGB[i * 3 + 2];
-			pDataRGBA[i * 4 + 3] = 255;
-		}
-		Item.m_ImageData = m_DataFile.AddData(Item.m_Width * Item.m_Height * 4, pDataRGBA);
-		free(pDataRGBA);
-	}
-	else
-	{
-		Item.m_ImageData = m_DataFile.AddData(Item.m_Width * Item.m_Height * 4, pImg->m_pData);
-	}
+	Item.m_Width = pImage->m_Width;
+	Item.m_Height = pImage->m_Height;
+	Item.m_ImageData = m_DataFile.AddData(pImage->m_lData.size(), (void *)&pImage->m_lData[0]);
 	m_DataFile.AddItem(MAPITEMTYPE_IMAGE, m_NumImages++, sizeof(Item), &Item);
 
-	FreePNG(pImg);
-
 	return m_NumImages-1;
 }
 
@@ -1320,13 +1365,18 @@ bool CMapConverter::CreateMap(const char* pFilename)
 {
 	png_init(0, 0);
 
+	// The map is written next to the old one and renamed over it: servers
+	// have the old file mapped, writing it in place would change their pages.
 	char aBuf[512];
-	if(!m_DataFile.Open(Storage(), pFilename))
+	char aTmpFilename[MAX_PATH_LENGTH];
+	str_format(aTmpFilename, sizeof(aTmpFilename), "%s.%d.tmp", pFilename, pid());
+	if(!m_DataFile.Open(Storage(), aTmpFilename))
 	{
-		str_format(aBuf, sizeof(aBuf), "failed to open file '%s'...", pFilename);
+		str_format(aBuf, sizeof(aBuf), "failed to open file '%s'...", aTmpFilename);
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "infclass", aBuf);
 		return false;
 	}
+	m_DataFile.SetCompressionThreads(g_Config.m_InfConverterThreads);
 	
 	InitState();
 	
@@ -1360,12 +1410,20 @@ bool CMapConverter::CreateMap(const char* pFilename)
 	
 	if (Finalize() < 0)
 	{
+		m_DataFile.Finish();
+		Storage()->RemoveFile(aTmpFilename, IStorage::TYPE_SAVE);
 		return false;
 	}
 	
 	m_DataFile.AddItem(MAPITEMTYPE_ENVPOINTS, 0, m_lEnvPoints.size()*sizeof(CEnvPoint), m_lEnvPoints.base_ptr());
 	m_DataFile.Finish();
 	
+	if(!Storage()->RenameFile(aTmpFilename, pFilename, IStorage::TYPE_SAVE))
+	{
+		Storage()->RemoveFile(aTmpFilename, IStorage::TYPE_SAVE);
+		return false;
+	}
+	
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "infclass", "highres map created");
 	return true;
 }
@@ -46,6 +46,7 @@ public:
 	};
 
 	static const char *GetConverterVersionId();
+	static void GetClientMapName(char *pBuffer, int BufferSize, const char *pConverterId, const char *pMapName, unsigned ServerMapCrc);
 
 protected:
 	IStorage *m_pStorage;
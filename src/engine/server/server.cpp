@@ -19,6 +19,7 @@
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/filecollection.h>
+#include <engine/shared/metrics.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
@@ -51,6 +52,11 @@
 	#define _WIN32_WINNT 0x0501
 	#define WIN32_LEAN_AND_MEAN
 	#include <windows.h>
+#elif defined(CONF_FAMILY_UNIX)
+	#include <errno.h>
+	#include <signal.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
 #endif
 
 extern const char *GIT_SHORTREV_HASH;
@@ -261,9 +267,8 @@ int CServerBan::BanExt(T *pBanPool, const typename T::CDataType *pData, int Seco
 
 		if(NetMatch(&Data, Server()->m_NetServer.ClientAddr(i)))
 		{
-			CNetHash NetHash(&Data);
 			char aBuf[256];
-			MakeBanInfo(pBanPool->Find(&Data, &NetHash), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
+			MakeBanInfo(pBanPool->Find(&Data), aBuf, sizeof(aBuf), MSGTYPE_PLAYER);
 			Server()->m_NetServer.Drop(i, CLIENTDROPTYPE_BAN, aBuf);
 		}
 	}
@@ -317,10 +322,20 @@ bool CServerBan::ConBanExt(IConsole::IResult *pResult, void *pUser)
 void CServer::CClient::Reset(bool ResetScore)
 {
 	// reset input
-	for(int i = 0; i < 200; i++)
+	for(int i = 0; i < INPUT_RING_SIZE; i++)
 		m_aInputs[i].m_GameTick = -1;
-	m_CurrentInput = 0;
 	mem_zero(&m_LatestInput, sizeof(m_LatestInput));
+	m_InputMargin = 0.0f;
+	m_InputJitter = 0.0f;
+	m_InputLateRatio = 0.0f;
+	m_SnapOverflows = 0;
+	m_SnapDroppedItems = 0;
+	m_SnapInterval = 1;
+	m_SnapCountdown = 0;
+	m_SnapCleanSnaps = 0;
+	m_SnapBackoffTick = -1;
+	m_SnapResends = -1;
+	m_SnapBytes = 0.0f;
 
 	m_Snapshots.PurgeAll();
 	m_LastAckedSnapshot = -1;
@@ -360,9 +375,21 @@ void CServer::CClient::Reset(bool ResetScore)
 		m_Accusation.m_Num = 0;
 	}
 }
+
+void CServer::CClient::UpdateInputTiming(int Margin, bool Late)
+{
+	// exponential moving averages, about the last second of inputs
+	const float Weight = 1.0f/32.0f;
+	m_InputMargin += (Margin - m_InputMargin) * Weight;
+	m_InputJitter += (absolute(Margin - m_InputMargin) - m_InputJitter) * Weight;
+	m_InputLateRatio += ((Late ? 1.0f : 0.0f) - m_InputLateRatio) * Weight;
+}
 /* INFECTION MODIFICATION END *****************************************/
 
 CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
+#ifdef CONF_SQL
+	, m_LeaderboardCache(SQL_SCORE_NUMROUND)
+#endif
 {
 	m_TickSpeed = SERVER_TICK_SPEED;
 
@@ -375,6 +402,8 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 
 	m_pCurrentMapData = 0;
 	m_CurrentMapSize = 0;
+	m_CurrentMapMapped = false;
+	m_aPreloadedMap[0] = 0;
 
 	m_MapReload = 0;
 
@@ -385,6 +414,8 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_ServerInfoNumRequests = 0;
 	m_ServerInfoHighLoad = false;
 
+	RegisterMetrics();
+
 #ifdef CONF_SQL
 /* DDNET MODIFICATION START *******************************************/
 	for (int i = 0; i < MAX_SQLSERVERS; i++)
@@ -392,13 +423,16 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 		m_apSqlReadServers[i] = 0;
 		m_apSqlWriteServers[i] = 0;
 	}
+	m_SqlSetupStarted = false;
 
 	CSqlConnector::SetReadServers(m_apSqlReadServers);
 	CSqlConnector::SetWriteServers(m_apSqlWriteServers);
 /* DDNET MODIFICATION END *********************************************/
 	
-	m_GameServerCmdLock = lock_create();
 	m_ChallengeLock = lock_create();
+	m_SqlStatsJournalLock = lock_create();
+	m_SqlStatsJournalFailures = 0;
+	m_SqlStatsJournalNextReplay = 0;
 #endif
 	
 	Init();
@@ -407,15 +441,88 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 CServer::~CServer()
 {
 #ifdef CONF_SQL
-	lock_destroy(m_GameServerCmdLock);
 	lock_destroy(m_ChallengeLock);
+	lock_destroy(m_SqlStatsJournalLock);
 #endif
 }
 
+void CServer::UpdateNameKey(int ClientID)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	if(pClient->m_HasNameKey)
+	{
+		std::unordered_map<std::string, int>::iterator Iter = m_NameCounts.find(pClient->m_aNameKey);
+		if(Iter != m_NameCounts.end() && --Iter->second <= 0)
+			m_NameCounts.erase(Iter);
+		pClient->m_HasNameKey = false;
+	}
+
+	if(pClient->m_State >= CClient::STATE_READY)
+	{
+		str_copy(pClient->m_aNameKey, ClientName(ClientID), sizeof(pClient->m_aNameKey));
+		StrRtrim(pClient->m_aNameKey);
+		m_NameCounts[pClient->m_aNameKey]++;
+		pClient->m_HasNameKey = true;
+	}
+}
+
+void CServer::UpdateNameSet()
+{
+	if(!m_NameSetDirty)
+		return;
+	m_NameSetDirty = 0;
+
+	m_NameCounts.clear();
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		m_aClients[i].m_HasNameKey = false;
+		UpdateNameKey(i);
+	}
+}
+
+bool CServer::IsNameTaken(int ClientID, const char *pName)
+{
+	UpdateNameSet();
+
+	std::unordered_map<std::string, int>::const_iterator Iter = m_NameCounts.find(pName);
+	if(Iter == m_NameCounts.end())
+		return false;
+
+	// the client's own name doesn't count
+	int Count = Iter->second;
+	if(m_aClients[ClientID].m_HasNameKey && str_comp(m_aClients[ClientID].m_aNameKey, pName) == 0)
+		Count--;
+	return Count > 0;
+}
+
+void CServer::CheckNameCollisions()
+{
+	if(!m_NameCheckPending)
+		return;
+	m_NameCheckPending = 0;
+
+	for(int i=MAX_CLIENTS-1; i>=0; i--)
+	{
+		if(m_aClients[i].m_State >= CClient::STATE_READY && m_aClients[i].m_UserID < 0)
+		{
+			if(TrySetClientName(i, m_aClients[i].m_aName))
+			{
+				// auto rename
+				for(int j = 1;; j++)
+				{
+					char aNameTry[MAX_NAME_LENGTH];
+					str_format(aNameTry, sizeof(aNameTry), "(%d)%s", j, m_aClients[i].m_aName);
+					if(TrySetClientName(i, aNameTry) == 0)
+						break;
+				}
+			}
+		}
+	}
+}
+
 int CServer::TrySetClientName(int ClientID, const char *pName)
 {
 	char aTrimmedName[64];
-	char aTrimmedName2[64];
 
 	// trim the name
 	str_copy(aTrimmedName, StrLtrim(pName), sizeof(aTrimmedName));
@@ -432,17 +539,8 @@ int CServer::TrySetClientName(int ClientID, const char *pName)
 	pName = aTrimmedName;
 
 	// make sure that two clients doesn't have the same name
-	for(int i = 0; i < MAX_CLIENTS; i++)
-	{
-		if(i != ClientID && m_aClients[i].m_State >= CClient::STATE_READY)
-		{
-			str_copy(aTrimmedName2, ClientName(i), sizeof(aTrimmedName2));
-			StrRtrim(aTrimmedName2);
-			
-			if(str_comp(pName, aTrimmedName2) == 0)
-				return -1;
-		}
-	}
+	if(IsNameTaken(ClientID, pName))
+		return -1;
 
 	// check if new and old name are the same
 	if(m_aClients[ClientID].m_aName[0] && str_comp(m_aClients[ClientID].m_aName, pName) == 0)
@@ -450,6 +548,7 @@ int CServer::TrySetClientName(int ClientID, const char *pName)
 	
 	// set the client name
 	str_copy(m_aClients[ClientID].m_aName, pName, MAX_NAME_LENGTH);
+	UpdateNameKey(ClientID);
 	return 0;
 }
 
@@ -550,7 +649,11 @@ int CServer::Init()
 		m_aClients[i].m_WasInfected = 0;
 		m_aClients[i].m_Accusation.m_Num = 0;
 		m_aClients[i].m_Latency = 0;
+		m_aClients[i].m_HasNameKey = false;
 	}
+	m_NameCounts.clear();
+	m_NameSetDirty = 0;
+	m_NameCheckPending = 0;
 
 	m_CurrentGameTick = 0;
 	m_MapVotesCounter = 0;
@@ -948,6 +1051,10 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick()%10) != 0)
 			continue;
 
+		// the connection of this client is congested, skip some snapshots
+		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL && --m_aClients[i].m_SnapCountdown > 0)
+			continue;
+
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
@@ -969,6 +1076,15 @@ void CServer::DoSnapshot()
 			SnapshotSize = m_SnapshotBuilder.Finish(pData);
 			Crc = pData->Crc();
 
+			if(m_SnapshotBuilder.NumDroppedItems())
+			{
+				if(!m_aClients[i].m_SnapOverflows)
+					dbg_msg("server", "snapshot over budget for ClientID=%d, dropped %d items", i, m_SnapshotBuilder.NumDroppedItems());
+				m_aClients[i].m_SnapOverflows++;
+				m_aClients[i].m_SnapDroppedItems += m_SnapshotBuilder.NumDroppedItems();
+				m_pSnapshotDroppedItemsMetric->Add(m_SnapshotBuilder.NumDroppedItems());
+			}
+
 			// remove old snapshos
 			// keep 3 seconds worth of snapshots
 			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick-SERVER_TICK_SPEED*3);
@@ -994,6 +1110,7 @@ void CServer::DoSnapshot()
 			// create delta
 			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
 
+			int SentSize = 0;
 			if(DeltaSize)
 			{
 				// compress it
@@ -1002,6 +1119,7 @@ void CServer::DoSnapshot()
 				int NumPackets;
 
 				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
+				SentSize = SnapshotSize;
 				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
 
 				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
@@ -1040,6 +1158,11 @@ void CServer::DoSnapshot()
 				Msg.AddInt(m_CurrentGameTick-DeltaTick);
 				SendMsg(&Msg, MSGFLAG_FLUSH, i);
 			}
+
+			if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
+				UpdateSnapRate(i, SentSize);
+			m_apClientSnapshotBytesMetrics[i]->Set(SentSize);
+			m_pSnapshotBytesMetric->Add(SentSize);
 		}
 	}
 
@@ -1103,6 +1226,9 @@ int CServer::NewClientCallback(int ClientID, void *pUser)
 	memset(&pThis->m_aClients[ClientID].m_Addr, 0, sizeof(NETADDR));
 	pThis->m_aClients[ClientID].m_CustClt = 0;
 	pThis->m_aClients[ClientID].Reset();
+#ifdef CONF_SQL
+	pThis->RestoreAccountSession(ClientID);
+#endif
 	
 	//Getback session about the client
 	IServer::CClientSession* pSession = pThis->m_NetSession.GetData(pThis->m_NetServer.ClientAddr(ClientID));
@@ -1150,6 +1276,7 @@ int CServer::DelClientCallback(int ClientID, int Type, const char *pReason, void
 		pThis->GameServer()->OnClientDrop(ClientID, Type, pReason);
 
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_EMPTY;
+	pThis->RequestNameCheck();
 	pThis->m_aClients[ClientID].m_SupportsMapSha256 = false;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
 	pThis->m_aClients[ClientID].m_aClan[0] = 0;
@@ -1159,6 +1286,10 @@ int CServer::DelClientCallback(int ClientID, int Type, const char *pReason, void
 	pThis->m_aClients[ClientID].m_pRconCmdToSend = 0;
 	pThis->m_aClients[ClientID].m_Snapshots.PurgeAll();
 	pThis->m_aClients[ClientID].m_WaitingTime = 0;
+#ifdef CONF_SQL
+	if(CAccountSessions::KeepsSession(Type))
+		pThis->SaveAccountSession(ClientID);
+#endif
 	pThis->m_aClients[ClientID].m_UserID = -1;
 #ifdef CONF_SQL
 	pThis->m_aClients[ClientID].m_UserLevel = SQL_USERLEVEL_NORMAL;
@@ -1334,17 +1465,18 @@ bool CServer::InitCaptcha()
 
 bool CServer::GenerateClientMap(const char *pMapFilePath, const char *pMapName)
 {
-	if(!m_pMap->Load(pMapFilePath))
+	// the preloaded layers are only used once, a later load of the same map
+	// must not see what the game changed in them
+	bool Preloaded = m_aPreloadedMap[0] && str_comp(m_aPreloadedMap, pMapFilePath) == 0 && m_pMap->IsLoaded();
+	m_aPreloadedMap[0] = 0;
+	if(!Preloaded && !m_pMap->Load(pMapFilePath))
 		return 0;
 
 	//The map format of InfectionClass is different from the vanilla format.
 	//We need to convert the map to something that the client can use
 	//First, try to find if the client map is already generated
 
-	CDataFileReader dfServerMap;
-	dfServerMap.Open(Storage(), pMapFilePath, IStorage::TYPE_ALL);
-	unsigned ServerMapCrc = dfServerMap.Crc();
-	dfServerMap.Close();
+	unsigned ServerMapCrc = m_pMap->Crc();
 
 	EventsDirector::SetPreloadedMapName(pMapName);
 
@@ -1353,7 +1485,7 @@ bool CServer::GenerateClientMap(const char *pMapFilePath, const char *pMapName)
 	const char *pConverterId = g_Config.m_InfConverterId;
 	pConverterId = EventsDirector::GetMapConverterId(pConverterId);
 	str_format(aClientMapDir, sizeof(aClientMapDir), "clientmaps/%s", pConverterId);
-	str_format(aClientMapName, sizeof(aClientMapName), "%s/%s_%08x.map", aClientMapDir, pMapName, ServerMapCrc);
+	CMapConverter::GetClientMapName(aClientMapName, sizeof(aClientMapName), pConverterId, pMapName, ServerMapCrc);
 
 	CMapConverter MapConverter(Storage(), m_pMap, Console());
 	if(!MapConverter.Load())
@@ -1379,8 +1511,10 @@ bool CServer::GenerateClientMap(const char *pMapFilePath, const char *pMapName)
 			dbg_msg("infclass", "Can't create the directory '%s'", aClientMapDir);
 		}
 
+		int64 ConversionStart = time_get();
 		if(!MapConverter.CreateMap(aClientMapName))
 			return false;
+		m_pMapConversionMetric->Observe((time_get() - ConversionStart) * 1000 / time_freq());
 
 		CDataFileReader dfGeneratedMap;
 		dfGeneratedMap.Open(Storage(), aClientMapName, IStorage::TYPE_ALL);
@@ -1397,18 +1531,40 @@ bool CServer::GenerateClientMap(const char *pMapFilePath, const char *pMapName)
 	str_format(aBufMsg, sizeof(aBufMsg), "map crc is %08x, generated map crc is %08x", ServerMapCrc, m_CurrentMapCrc);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
 
-	//Download the generated map in memory to send it to clients
-	IOHANDLE File = Storage()->OpenFile(aClientMapName, IOFLAG_READ, IStorage::TYPE_ALL);
-	m_CurrentMapSize = (int)io_length(File);
-	free(m_pCurrentMapData);
-	m_pCurrentMapData = (unsigned char *)malloc(m_CurrentMapSize);
-	io_read(File, m_pCurrentMapData, m_CurrentMapSize);
+	// Map the generated map to send it to clients. The pages come from the
+	// page cache, so every server on the box serving this map shares them.
+	char aClientMapPath[MAX_PATH_LENGTH];
+	IOHANDLE File = Storage()->OpenFile(aClientMapName, IOFLAG_READ, IStorage::TYPE_ALL, aClientMapPath, sizeof(aClientMapPath));
+	if(!File)
+		return false;
+	FreeCurrentMapData();
+	m_pCurrentMapData = (unsigned char *)io_map_file(aClientMapPath, &m_CurrentMapSize);
+	m_CurrentMapMapped = m_pCurrentMapData != 0;
+	if(!m_CurrentMapMapped)
+	{
+		m_CurrentMapSize = (int)io_length(File);
+		m_pCurrentMapData = (unsigned char *)malloc(m_CurrentMapSize);
+		io_read(File, m_pCurrentMapData, m_CurrentMapSize);
+	}
 	io_close(File);
+	mem_account(MEMTAG_MAP, m_CurrentMapSize);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", "maps/infc_x_current.map loaded in memory");
 
 	return true;
 }
 
+void CServer::FreeCurrentMapData()
+{
+	if(m_CurrentMapMapped)
+		io_unmap_file(m_pCurrentMapData, m_CurrentMapSize);
+	else
+		free(m_pCurrentMapData);
+	mem_account(MEMTAG_MAP, -(int64)m_CurrentMapSize);
+	m_pCurrentMapData = 0;
+	m_CurrentMapSize = 0;
+	m_CurrentMapMapped = false;
+}
+
 void CServer::ProcessClientPacket(CNetChunk *pPacket)
 {
 	int ClientID = pPacket->m_ClientID;
@@ -1525,6 +1681,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				str_format(aBuf, sizeof(aBuf), "player is ready. ClientID=%d addr=%s secure=%s", ClientID, aAddrStr, m_NetServer.HasSecurityToken(ClientID)?"yes":"no");
 				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBuf);
 				m_aClients[ClientID].m_State = CClient::STATE_READY;
+				RequestNameCheck();
 				m_aClients[ClientID].m_WaitingTime = TickSpeed()*g_Config.m_InfConWaitingTime;
 			}
 		}
@@ -1539,6 +1696,14 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 				str_format(aBuf, sizeof(aBuf), "player has entered the game. ClientID=%d addr=%s", ClientID, aAddrStr);
 				Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 				m_aClients[ClientID].m_State = CClient::STATE_INGAME;
+				RequestNameCheck();
+#ifdef CONF_SQL
+				if(m_aClients[ClientID].m_AccountRestored)
+				{
+					m_aClients[ClientID].m_AccountRestored = false;
+					GameServer()->SendChatTarget_Localization(ClientID, CHATCATEGORY_DEFAULT, _("You have been logged back in as {str:Username}, use /logout if this isn't your account"), "Username", m_aClients[ClientID].m_aUsername, NULL);
+				}
+#endif
 				
 				if(m_aClients[ClientID].m_WaitingTime <= 0)
 				{
@@ -1570,6 +1735,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			if(IntendedTick > m_aClients[ClientID].m_LastInputTick)
 			{
 				int TimeLeft = ((TickStartTime(IntendedTick)-time_get())*1000) / time_freq();
+				m_aClients[ClientID].UpdateInputTiming(TimeLeft, IntendedTick <= Tick());
 
 				CMsgPacker Msg(NETMSG_INPUTTIMING, true);
 				Msg.AddInt(IntendedTick);
@@ -1579,11 +1745,11 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			m_aClients[ClientID].m_LastInputTick = IntendedTick;
 
-			pInput = &m_aClients[ClientID].m_aInputs[m_aClients[ClientID].m_CurrentInput];
-
 			if(IntendedTick <= Tick())
 				IntendedTick = Tick()+1;
 
+			// a later input for the same tick replaces the earlier one
+			pInput = m_aClients[ClientID].InputSlot(IntendedTick);
 			pInput->m_GameTick = IntendedTick;
 
 			for(int i = 0; i < Size/4; i++)
@@ -1591,9 +1757,6 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE*sizeof(int));
 
-			m_aClients[ClientID].m_CurrentInput++;
-			m_aClients[ClientID].m_CurrentInput %= 200;
-
 			// call the mod with the fresh input data
 			if(m_aClients[ClientID].m_State == CClient::STATE_INGAME)
 				GameServer()->OnClientDirectInput(ClientID, m_aClients[ClientID].m_LatestInput.m_aData);
@@ -2200,6 +2363,26 @@ int CServer::LoadMap(const char *pMapName)
 	return 1;
 }
 
+// Loads and decodes the map before the instances are forked, so the ones
+// starting on it share its layers copy-on-write instead of decoding their own.
+void CServer::PreloadMap(const char *pMapName)
+{
+	// without a map, each instance picks one from the rotation
+	if(!pMapName[0])
+		return;
+
+	IEngineMap *pMap = Kernel()->RequestInterface<IEngineMap>();
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "maps/%s.map", EventsDirector::GetEventMapName(pMapName));
+	if(!pMap->Load(aBuf))
+	{
+		str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
+		if(!pMap->Load(aBuf))
+			return;
+	}
+	str_copy(m_aPreloadedMap, aBuf, sizeof(m_aPreloadedMap));
+}
+
 int CServer::GetMinPlayersForMap(const char* pMapName)
 {
 	int MinPlayers = 0;
@@ -2261,6 +2444,10 @@ int CServer::Run()
 
 	m_PrintCBIndex = Console()->RegisterPrintCallback(g_Config.m_ConsoleOutputLevel, SendRconLineAuthed, this);
 
+#ifdef CONF_SQL
+	StartSqlSetup();
+#endif
+
 	//Choose a random map from the rotation
 	if(!str_length(g_Config.m_SvMap) && str_length(g_Config.m_SvMaprotation))
 	{
@@ -2360,6 +2547,15 @@ int CServer::Run()
 	m_Econ.Init(Console(), &m_ServerBan);
 
 	char aBuf[256];
+	if(g_Config.m_SvMetricsPort)
+	{
+		if(g_Metrics.Listen(g_Config.m_SvMetricsBindaddr, g_Config.m_SvMetricsPort))
+			str_format(aBuf, sizeof(aBuf), "metrics served on %s:%d", g_Config.m_SvMetricsBindaddr, g_Config.m_SvMetricsPort);
+		else
+			str_format(aBuf, sizeof(aBuf), "couldn't open the metrics socket on port %d", g_Config.m_SvMetricsPort);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+
 	str_format(aBuf, sizeof(aBuf), "server name is '%s'", g_Config.m_SvName);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
 
@@ -2383,6 +2579,7 @@ int CServer::Run()
 	{
 		int64 ReportTime = time_get();
 		int ReportInterval = 3;
+		int64 MetricsTime = time_get();
 
 		m_Lastheartbeat = 0;
 		m_GameStartTime = time_get();
@@ -2423,6 +2620,7 @@ int CServer::Run()
 						m_aClients[c].Reset(false);
 /* INFECTION MODIFICATION END *****************************************/
 						m_aClients[c].m_State = CClient::STATE_CONNECTING;
+						RequestNameCheck();
 						SetClientMemory(c, CLIENTMEMORY_ROUNDSTART_OR_MAPCHANGE, true);
 					}
 
@@ -2443,30 +2641,18 @@ int CServer::Run()
 
 			while(t > TickStartTime(m_CurrentGameTick+1))
 			{
+				int64 TickStart = time_get();
 				m_CurrentGameTick++;
 				NewTicks++;
 
-				//Check for name collision. We add this because the login is in a different thread and can't check it himself.
 				for(int i=MAX_CLIENTS-1; i>=0; i--)
 				{
 					if(m_aClients[i].m_State >= CClient::STATE_READY && m_aClients[i].m_Session.m_MuteTick > 0)
 						m_aClients[i].m_Session.m_MuteTick--;
-					
-					if(m_aClients[i].m_State >= CClient::STATE_READY && m_aClients[i].m_UserID < 0)
-					{
-						if(TrySetClientName(i, m_aClients[i].m_aName))
-						{
-							// auto rename
-							for(int j = 1;; j++)
-							{
-								char aNameTry[MAX_NAME_LENGTH];
-								str_format(aNameTry, sizeof(aNameTry), "(%d)%s", j, m_aClients[i].m_aName);
-								if(TrySetClientName(i, aNameTry) == 0)
-									break;
-							}
-						}
-					}
 				}
+
+				//Check for name collision. We add this because the login is in a different thread and can't check it himself.
+				CheckNameCollisions();
 				
 				for(int i=0; i<MAX_CLIENTS; i++)
 				{
@@ -2493,31 +2679,33 @@ int CServer::Run()
 				{
 					if(m_aClients[c].m_State != CClient::STATE_INGAME)
 						continue;
-					for(int i = 0; i < 200; i++)
-					{
-						if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
-						{
-							GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
-							break;
-						}
-					}
+					CClient::CInput *pInput = m_aClients[c].InputSlot(Tick());
+					if(pInput->m_GameTick == Tick())
+						GameServer()->OnClientPredictedInput(c, pInput->m_aData);
 				}
 
 				GameServer()->OnTick();
 				
 #ifdef CONF_SQL
-				if(m_lGameServerCmds.size())
+				if(!m_GameServerCmds.Empty())
 				{
-					lock_wait(m_GameServerCmdLock);
-					for(int i=0; i<m_lGameServerCmds.size(); i++)
+					int64 Now = time_get();
+					int NumCmds = 0;
+					CGameServerCmd *pCmd = m_GameServerCmds.PopAll();
+					while(pCmd)
 					{
-						m_lGameServerCmds[i]->Execute(GameServer());
-						delete m_lGameServerCmds[i];
+						CGameServerCmd *pNext = pCmd->m_pQueueNext;
+						m_pGameServerCmdLatencyMetric->Observe((Now - pCmd->m_EnqueueTime) * 1000000 / time_freq());
+						pCmd->Execute(GameServer());
+						delete pCmd;
+						pCmd = pNext;
+						NumCmds++;
 					}
-					m_lGameServerCmds.clear();
-					lock_release(m_GameServerCmdLock);
-				} 
+					m_pGameServerCmdsMetric->Add(-NumCmds);
+				}
 #endif
+
+				m_pTickDurationMetric->Observe((time_get() - TickStart) * 1000000 / time_freq());
 			}
 
 			// snap game
@@ -2559,6 +2747,12 @@ int CServer::Run()
 				ReportTime += time_freq()*ReportInterval;
 			}
 
+			if(MetricsTime < time_get())
+			{
+				UpdateMetrics();
+				MetricsTime += time_freq();
+			}
+
 			bool NonActive = true;
 
 			for(int c = 0; c < MAX_CLIENTS; c++)
@@ -2591,11 +2785,12 @@ int CServer::Run()
 
 		m_Econ.Shutdown();
 	}
+	g_Metrics.Close();
 
 	GameServer()->OnShutdown();
 	m_pMap->Unload();
 
-	free(m_pCurrentMapData);
+	FreeCurrentMapData();
 		
 /* DDNET MODIFICATION START *******************************************/
 #ifdef CONF_SQL
@@ -2774,7 +2969,7 @@ bool CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 				int AuthLevel = pThis->m_aClients[i].m_Authed == CServer::AUTHED_ADMIN ? 2 :
 										pThis->m_aClients[i].m_Authed == CServer::AUTHED_MOD ? 1 : 0;
 				
-				str_format(aBuf, sizeof(aBuf), "(#%02i) %s: [antispoof=%d] [login=%d] [level=%d] [ip=%s] [version=%d] [inf=%d]",
+				str_format(aBuf, sizeof(aBuf), "(#%02i) %s: [antispoof=%d] [login=%d] [level=%d] [ip=%s] [version=%d] [inf=%d] [input=%+.0fms jitter=%.0fms late=%.0f%%] [snapdrop=%d items in %d snaps] [snaps=%d/s %.0fB]",
 					i,
 					aBufName,
 					pThis->m_NetServer.HasSecurityToken(i),
@@ -2782,7 +2977,14 @@ bool CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 					AuthLevel,
 					aAddrStr,
 					pThis->m_aClients[i].m_DDNetVersion,
-					pThis->m_aClients[i].m_InfClassVersion
+					pThis->m_aClients[i].m_InfClassVersion,
+					pThis->m_aClients[i].m_InputMargin,
+					pThis->m_aClients[i].m_InputJitter,
+					pThis->m_aClients[i].m_InputLateRatio*100.0f,
+					pThis->m_aClients[i].m_SnapDroppedItems,
+					pThis->m_aClients[i].m_SnapOverflows,
+					SERVER_TICK_SPEED / ((g_Config.m_SvHighBandwidth ? 1 : 2) * pThis->m_aClients[i].m_SnapInterval),
+					pThis->m_aClients[i].m_SnapBytes
 				);
 			}
 			else
@@ -2864,6 +3066,43 @@ bool CServer::ConMapReload(IConsole::IResult *pResult, void *pUser)
 	return true;
 }
 
+bool CServer::ConMemory(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	char aBuf[256];
+	int64 TotalBytes = 0;
+	for(int i = 0; i < NUM_MEMTAGS; i++)
+	{
+		MEMTAGSTATS Stats;
+		mem_tag_stats(i, &Stats);
+		TotalBytes += Stats.live_bytes;
+		str_format(aBuf, sizeof(aBuf), "%-14s %9.1f KiB, peak %9.1f KiB, %lld blocks (%lld allocated in total)", mem_tag_name(i),
+			Stats.live_bytes / 1024.0, Stats.peak_bytes / 1024.0, (long long)Stats.live_allocs, (long long)Stats.total_allocs);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "memory", aBuf);
+	}
+	str_format(aBuf, sizeof(aBuf), "%-14s %9.1f KiB", "total", TotalBytes / 1024.0);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "memory", aBuf);
+
+#if defined(CONF_FAMILY_UNIX)
+	// the rest of the resident size is everything that isn't counted yet
+	IOHANDLE File = io_open("/proc/self/statm", IOFLAG_READ);
+	if(File)
+	{
+		char aStatm[128];
+		int Size = io_read(File, aStatm, sizeof(aStatm) - 1);
+		io_close(File);
+		aStatm[Size] = 0;
+		long long Pages = 0, ResidentPages = 0;
+		if(sscanf(aStatm, "%lld %lld", &Pages, &ResidentPages) == 2)
+		{
+			str_format(aBuf, sizeof(aBuf), "%-14s %9.1f KiB", "resident", ResidentPages * sysconf(_SC_PAGESIZE) / 1024.0);
+			pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "memory", aBuf);
+		}
+	}
+#endif
+	return true;
+}
+
 bool CServer::ConLogout(IConsole::IResult *pResult, void *pUser)
 {
 	CServer *pServer = (CServer *)pUser;
@@ -2979,7 +3218,8 @@ bool CServer::ConAddSqlServer(IConsole::IResult *pResult, void *pUserData)
 		{
 			apSqlServers[i] = new CSqlServer(pResult->GetString(1), pResult->GetString(2), pResult->GetString(3), pResult->GetString(4), pResult->GetString(5), pResult->GetInteger(6), ReadOnly, SetUpDb);
 
-			if(SetUpDb)
+			// servers from the config are set up by StartSqlSetup(), a fork would lose the thread
+			if(SetUpDb && pSelf->m_SqlSetupStarted)
 			{
 				void *TablesThread = thread_init(CreateTablesThread, apSqlServers[i]);
 				thread_detach(TablesThread);
@@ -3024,6 +3264,23 @@ bool CServer::ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData)
 	return true;
 }
 
+void CServer::StartSqlSetup()
+{
+	m_SqlSetupStarted = true;
+	for(int i = 0; i < MAX_SQLSERVERS; i++)
+	{
+		CSqlServer *apServers[] = {m_apSqlReadServers[i], m_apSqlWriteServers[i]};
+		for(unsigned s = 0; s < sizeof(apServers)/sizeof(apServers[0]); s++)
+		{
+			if(apServers[s] && apServers[s]->GetSetUpDb())
+			{
+				void *TablesThread = thread_init(CreateTablesThread, apServers[s]);
+				thread_detach(TablesThread);
+			}
+		}
+	}
+}
+
 void CServer::CreateTablesThread(void *pData)
 {
 	((CSqlServer *)pData)->CreateTables();
@@ -3117,6 +3374,7 @@ void CServer::RegisterCommands()
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
 
 	Console()->Register("reload", "", CFGFLAG_SERVER, ConMapReload, this, "Reload the map");
+	Console()->Register("memory", "", CFGFLAG_SERVER, ConMemory, this, "Show the memory used by each part of the server");
 
 	Console()->Chain("sv_name", ConchainSpecialInfoupdate, this);
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
@@ -3133,6 +3391,7 @@ void CServer::RegisterCommands()
 #ifdef CONF_SQL
 	Console()->Register("inf_add_sqlserver", "ssssssi?i", CFGFLAG_SERVER, ConAddSqlServer, this, "add a sqlserver");
 	Console()->Register("inf_list_sqlservers", "s", CFGFLAG_SERVER, ConDumpSqlServers, this, "list all sqlservers readservers = r, writeservers = w");
+	Console()->Register("inf_leaderboard_cache_stats", "", CFGFLAG_SERVER, ConLeaderboardCacheStats, this, "show leaderboard cache hits, misses and age");
 #endif
 
 	Console()->Register("inf_set_weapon_fire_delay", "i<weapon>i<msec>", CFGFLAG_SERVER, ConSetWeaponFireDelay, this,
@@ -3172,6 +3431,121 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
 }
 
+void CServer::RegisterMetrics()
+{
+	static const int64 s_aTickBounds[] = {250, 500, 1000, 2000, 4000, 8000, 16000, 32000, 64000};
+	static const int64 s_aConversionBounds[] = {100, 250, 500, 1000, 2500, 5000, 10000, 30000};
+	m_pTickDurationMetric = g_Metrics.RegisterHistogram("infclass_tick_duration_seconds", "Time spent in one game tick", s_aTickBounds, sizeof(s_aTickBounds)/sizeof(s_aTickBounds[0]), 1e-6);
+	m_pMapConversionMetric = g_Metrics.RegisterHistogram("infclass_map_conversion_seconds", "Time spent converting a server map into its client map", s_aConversionBounds, sizeof(s_aConversionBounds)/sizeof(s_aConversionBounds[0]), 1e-3);
+	m_pSnapshotBytesMetric = g_Metrics.RegisterCounter("infclass_snapshot_bytes_total", "Snapshot bytes sent to all clients");
+	m_pSnapshotDroppedItemsMetric = g_Metrics.RegisterCounter("infclass_snapshot_dropped_items_total", "Snapshot items dropped to fit the snapshot size");
+	m_pClientsMetric = g_Metrics.RegisterGauge("infclass_clients", "Connected clients");
+	m_pGameServerCmdsMetric = g_Metrics.RegisterGauge("infclass_sql_pending_results", "Results of sql jobs waiting for the next tick");
+	static const int64 s_aLatencyBounds[] = {1000, 5000, 10000, 20000, 50000, 100000, 250000, 1000000};
+	m_pGameServerCmdLatencyMetric = g_Metrics.RegisterHistogram("infclass_sql_result_latency_seconds", "Time a sql result waits before the game thread handles it", s_aLatencyBounds, sizeof(s_aLatencyBounds)/sizeof(s_aLatencyBounds[0]), 1e-6);
+	m_apNetworkMetrics[0] = g_Metrics.RegisterCounter("infclass_network_packets_total", "Packets sent and received", "direction=\"out\"");
+	m_apNetworkMetrics[1] = g_Metrics.RegisterCounter("infclass_network_packets_total", "Packets sent and received", "direction=\"in\"");
+	m_apNetworkMetrics[2] = g_Metrics.RegisterCounter("infclass_network_bytes_total", "Bytes sent and received", "direction=\"out\"");
+	m_apNetworkMetrics[3] = g_Metrics.RegisterCounter("infclass_network_bytes_total", "Bytes sent and received", "direction=\"in\"");
+	for(int i = 0; i < NUM_MEMTAGS; i++)
+	{
+		char aLabels[32];
+		str_format(aLabels, sizeof(aLabels), "tag=\"%s\"", mem_tag_name(i));
+		m_apMemoryMetrics[i] = g_Metrics.RegisterGauge("infclass_memory_bytes", "Memory used by each part of the server", aLabels);
+	}
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		char aLabels[32];
+		str_format(aLabels, sizeof(aLabels), "client_id=\"%d\"", i);
+		m_apClientSnapshotBytesMetrics[i] = g_Metrics.RegisterGauge("infclass_client_snapshot_bytes", "Size of the last snapshot sent to the client", aLabels);
+	}
+}
+
+void CServer::UpdateMetrics()
+{
+	// the network totals are kept on the main thread, so they are copied here
+	NETSTATS Stats;
+	net_stats(&Stats);
+	m_apNetworkMetrics[0]->Store(Stats.sent_packets);
+	m_apNetworkMetrics[1]->Store(Stats.recv_packets);
+	m_apNetworkMetrics[2]->Store(Stats.sent_bytes);
+	m_apNetworkMetrics[3]->Store(Stats.recv_bytes);
+
+	int NumClients = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
+			NumClients++;
+		else
+			m_apClientSnapshotBytesMetrics[i]->Set(0);
+	}
+	m_pClientsMetric->Set(NumClients);
+
+	for(int i = 0; i < NUM_MEMTAGS; i++)
+	{
+		MEMTAGSTATS Stats;
+		mem_tag_stats(i, &Stats);
+		m_apMemoryMetrics[i]->Set(Stats.live_bytes);
+	}
+}
+
+// Additive increase, multiplicative decrease of the snapshot rate: the
+// interval doubles when the connection shows congestion and shrinks by one
+// after a while without any.
+void CServer::UpdateSnapRate(int ClientID, int SnapshotSize)
+{
+	CClient *pClient = &m_aClients[ClientID];
+	pClient->m_SnapBytes += (SnapshotSize - pClient->m_SnapBytes) / 16.0f;
+
+	int Resends = m_NetServer.ClientResends(ClientID);
+	bool NewResends = pClient->m_SnapResends >= 0 && Resends > pClient->m_SnapResends;
+	pClient->m_SnapResends = Resends;
+
+	if(!g_Config.m_SvSnapAdaptive)
+	{
+		pClient->m_SnapInterval = 1;
+		pClient->m_SnapCountdown = 1;
+		return;
+	}
+
+	const int Period = g_Config.m_SvHighBandwidth ? 1 : 2;
+	int MaxInterval = g_Config.m_SvSnapMaxInterval;
+
+	// the latest ack should be about a round trip and a snapshot interval old
+	int ExpectedGap = pClient->m_Latency*SERVER_TICK_SPEED/1000 + pClient->m_SnapInterval*Period + SERVER_TICK_SPEED/5;
+	bool AckLate = pClient->m_LastAckedSnapshot > 0 && Tick() - pClient->m_LastAckedSnapshot > ExpectedGap;
+
+	bool OverRate = false;
+	if(g_Config.m_SvSnapMaxRate)
+	{
+		float BytesPerSecond = pClient->m_SnapBytes * SERVER_TICK_SPEED / (Period*pClient->m_SnapInterval);
+		OverRate = BytesPerSecond > g_Config.m_SvSnapMaxRate*1024.0f;
+	}
+
+	// react once per round trip, the signals lag behind the rate
+	bool CanBackoff = pClient->m_SnapBackoffTick < 0 || Tick() - pClient->m_SnapBackoffTick > ExpectedGap;
+	if((NewResends || AckLate || OverRate) && CanBackoff)
+	{
+		pClient->m_SnapInterval = minimum(pClient->m_SnapInterval*2, MaxInterval);
+		pClient->m_SnapBackoffTick = Tick();
+		pClient->m_SnapCleanSnaps = 0;
+	}
+	else if(!NewResends && !AckLate && !OverRate && ++pClient->m_SnapCleanSnaps >= 10)
+	{
+		pClient->m_SnapInterval = maximum(pClient->m_SnapInterval-1, 1);
+		pClient->m_SnapCleanSnaps = 0;
+	}
+	pClient->m_SnapInterval = clamp(pClient->m_SnapInterval, 1, MaxInterval);
+	pClient->m_SnapCountdown = pClient->m_SnapInterval;
+}
+
+void CServer::SnapSetPriority(int Class, float Distance)
+{
+	// the class decides first, the distance within a class
+	const int DistanceRange = 1<<20;
+	m_SnapshotBuilder.SetPriority(Class*DistanceRange + clamp((int)Distance, 0, DistanceRange-1));
+}
+
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
@@ -3194,6 +3568,98 @@ int CServer::GetClientInfclassVersion(int ClientID) const
 
 static CServer *CreateServer() { return new CServer(); }
 
+#if defined(CONF_FAMILY_UNIX)
+static volatile sig_atomic_t s_InstanceSignal = 0;
+
+static void InstanceSignalHandler(int Signal)
+{
+	s_InstanceSignal = Signal;
+}
+#endif
+
+// Forks one process per instance once the shared assets are loaded, so the
+// instances share them copy-on-write while each one keeps its own config.
+// Only what is loaded before is shared: the localization and the map of the
+// shared arguments. Later maps and the worker threads are per instance.
+// Returns the instance index in the child, -1 in the parent once all
+// instances have exited. Threads are not copied by fork(), so none may be
+// started before: the engine jobs and the sql setup start in each instance.
+static int ForkInstances(int NumInstances, int *pResult)
+{
+	*pResult = 0;
+#if defined(CONF_FAMILY_UNIX)
+	// the stdout logger writes from its own thread, every process starts its own
+	dbg_logger_reset();
+	std::vector<pid_t> lChildren;
+	for(int i = 0; i < NumInstances; i++)
+	{
+		pid_t Child = fork();
+		if(Child == 0)
+		{
+			dbg_logger_stdout();
+			return i;
+		}
+		if(Child < 0)
+		{
+			// don't leave a partial set of instances running
+			dbg_logger_stdout();
+			dbg_msg("server", "failed to start instance %d, stopping the others", i);
+			for(unsigned c = 0; c < lChildren.size(); c++)
+				kill(lChildren[c], SIGTERM);
+			for(unsigned c = 0; c < lChildren.size(); c++)
+				waitpid(lChildren[c], 0, 0);
+			*pResult = -1;
+			return -1;
+		}
+		lChildren.push_back(Child);
+	}
+	dbg_logger_stdout();
+
+	// no SA_RESTART, a signal has to interrupt waitpid
+	struct sigaction Action;
+	mem_zero(&Action, sizeof(Action));
+	Action.sa_handler = InstanceSignalHandler;
+	sigemptyset(&Action.sa_mask);
+	sigaction(SIGINT, &Action, 0);
+	sigaction(SIGTERM, &Action, 0);
+
+	int NumRunning = lChildren.size();
+	while(NumRunning > 0)
+	{
+		int Status;
+		pid_t Child = waitpid(-1, &Status, 0);
+		if(Child < 0)
+		{
+			if(errno != EINTR)
+				break;
+			// pass shutdown requests on to the instances
+			for(unsigned i = 0; i < lChildren.size(); i++)
+			{
+				if(lChildren[i] > 0)
+					kill(lChildren[i], s_InstanceSignal);
+			}
+			continue;
+		}
+
+		for(unsigned i = 0; i < lChildren.size(); i++)
+		{
+			if(lChildren[i] != Child)
+				continue;
+			int ExitCode = WIFEXITED(Status) ? WEXITSTATUS(Status) : -1;
+			dbg_msg("server", "instance %d (pid %d) exited with %d", i, (int)Child, ExitCode);
+			if(ExitCode != 0)
+				*pResult = -1;
+			lChildren[i] = 0;
+			NumRunning--;
+		}
+	}
+#else
+	dbg_msg("server", "--instance is only supported on unix");
+	*pResult = -1;
+#endif
+	return -1;
+}
+
 int main(int argc, const char **argv) // ignore_convention
 {
 #if defined(CONF_FAMILY_WINDOWS)
@@ -3224,6 +3690,18 @@ int main(int argc, const char **argv) // ignore_convention
 	IEngineMasterServer *pEngineMasterServer = CreateEngineMasterServer();
 	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_SERVER, argc, argv); // ignore_convention
 	IConfig *pConfig = CreateConfig();
+
+	// --instance <cfg> hosts one server per config file, the remaining
+	// arguments are console commands shared by all of them
+	std::vector<const char *> lInstanceConfigs;
+	std::vector<const char *> lArguments;
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		if(str_comp(argv[i], "--instance") == 0 && i + 1 < argc) // ignore_convention
+			lInstanceConfigs.push_back(argv[++i]); // ignore_convention
+		else
+			lArguments.push_back(argv[i]); // ignore_convention
+	}
 	
 	pServer->m_pLocalization = new CLocalization(pStorage);
 	pServer->m_pLocalization->InitConfig(0, NULL);
@@ -3265,17 +3743,36 @@ int main(int argc, const char **argv) // ignore_convention
 	pConsole->ExecuteFile("autoexec.cfg");
 
 	// parse the command line arguments
-	if(argc > 1) // ignore_convention
-		pConsole->ParseArguments(argc-1, &argv[1]); // ignore_convention
+	if(!lArguments.empty())
+		pConsole->ParseArguments(lArguments.size(), &lArguments[0]);
+
+	int Ret = 0;
+	int Instance = -1;
+	if(!lInstanceConfigs.empty())
+	{
+		// an instance whose config picks another map loads that one itself
+		pConfig->RestoreStrings();
+		pServer->PreloadMap(g_Config.m_SvMap);
+		Instance = ForkInstances(lInstanceConfigs.size(), &Ret);
+		if(Instance >= 0)
+			pConsole->ExecuteFile(lInstanceConfigs[Instance]);
+	}
 
-	// restore empty config strings to their defaults
-	pConfig->RestoreStrings();
+	if(lInstanceConfigs.empty() || Instance >= 0)
+	{
+		// restore empty config strings to their defaults
+		pConfig->RestoreStrings();
 
-	pEngine->InitLogfile();
+		pEngine->InitLogfile();
+		pEngine->InitJobs();
 
-	// run the server
-	dbg_msg("server", "starting...");
-	int Ret = pServer->Run();
+		// run the server
+		if(Instance >= 0)
+			dbg_msg("server", "starting instance %d (%s)...", Instance, lInstanceConfigs[Instance]);
+		else
+			dbg_msg("server", "starting...");
+		Ret = pServer->Run();
+	}
 
 	delete pServer->m_pLocalization;
 
@@ -3518,11 +4015,32 @@ bool CServer::IsClientLogged(int ClientID)
 }
 
 #ifdef CONF_SQL
+// enough for the results of a burst of logins after a map change, more are allocated
+static CBlockPool<576, 256> *GameServerCmdPool()
+{
+	static CBlockPool<576, 256> s_Pool;
+	return &s_Pool;
+}
+
+void *CServer::CGameServerCmd::operator new(size_t Size)
+{
+	void *pPtr = Size <= (size_t)GameServerCmdPool()->BlockSize() ? GameServerCmdPool()->Alloc() : 0;
+	return pPtr ? pPtr : mem_alloc_tagged(MEMTAG_SQL, Size);
+}
+
+void CServer::CGameServerCmd::operator delete(void *pPtr)
+{
+	if(GameServerCmdPool()->Owns(pPtr))
+		GameServerCmdPool()->Free(pPtr);
+	else
+		mem_free_tagged(pPtr);
+}
+
 void CServer::AddGameServerCmd(CGameServerCmd* pCmd)
 {
-	lock_wait(m_GameServerCmdLock);
-	m_lGameServerCmds.add(pCmd);
-	lock_release(m_GameServerCmdLock);
+	pCmd->m_EnqueueTime = time_get();
+	m_pGameServerCmdsMetric->Add(1);
+	m_GameServerCmds.Push(pCmd);
 }
 
 class CGameServerCmd_SendChatMOTD : public CServer::CGameServerCmd
@@ -3584,26 +4102,62 @@ public:
 	}
 };
 
+// The password is hashed on the thread of the job, the game thread only copies it
+class CAccountPassword
+{
+	char m_aPassword[128];
+	bool m_Hashed;
+	CSqlString<64> m_sHash;
+
+public:
+	CAccountPassword(const char* pPassword)
+	{
+		str_copy(m_aPassword, pPassword, sizeof(m_aPassword));
+		m_Hashed = false;
+	}
+
+	~CAccountPassword()
+	{
+		mem_zero(m_aPassword, sizeof(m_aPassword));
+	}
+
+	// a job can run again on another sql server, the hash is only computed once
+	const CSqlString<64>& Hash()
+	{
+		if(!m_Hashed)
+		{
+			char aHash[64]; //Result
+			mem_zero(aHash, sizeof(aHash));
+			Crypt(m_aPassword, (const unsigned char*) "d9", 1, 16, aHash);
+			m_sHash = CSqlString<64>(aHash);
+			mem_zero(m_aPassword, sizeof(m_aPassword));
+			m_Hashed = true;
+		}
+		return m_sHash;
+	}
+};
+
 class CSqlJob_Server_Login : public CSqlJob
 {
 private:
 	CServer* m_pServer;
 	int m_ClientID;
 	CSqlString<64> m_sName;
-	CSqlString<64> m_sPasswordHash;
+	CAccountPassword m_Password;
 	
 public:
-	CSqlJob_Server_Login(CServer* pServer, int ClientID, const char* pName, const char* pPasswordHash)
+	CSqlJob_Server_Login(CServer* pServer, int ClientID, const char* pName, const char* pPassword) :
+		m_Password(pPassword)
 	{
 		m_pServer = pServer;
 		m_ClientID = ClientID;
 		m_sName = CSqlString<64>(pName);
-		m_sPasswordHash = CSqlString<64>(pPasswordHash);
 	}
 
 	virtual bool Job(CSqlServer* pSqlServer)
 	{
 		char aBuf[512];
+		const CSqlString<64>& sPasswordHash = m_Password.Hash();
 		
 		try
 		{	
@@ -3611,7 +4165,7 @@ public:
 			str_format(aBuf, sizeof(aBuf), 
 				"SELECT UserId, Level FROM %s_Users "
 				"WHERE Username = '%s' AND PasswordHash = '%s';"
-				, pSqlServer->GetPrefix(), m_sName.ClrStr(), m_sPasswordHash.ClrStr());
+				, pSqlServer->GetPrefix(), m_sName.ClrStr(), sPasswordHash.ClrStr());
 			pSqlServer->executeSqlQuery(aBuf);
 
 			if(pSqlServer->GetResults()->next())
@@ -3627,6 +4181,7 @@ public:
 					char aOldName[MAX_NAME_LENGTH];
 					str_copy(aOldName, m_pServer->m_aClients[m_ClientID].m_aName, sizeof(aOldName));
 					str_copy(m_pServer->m_aClients[m_ClientID].m_aUsername, m_sName.Str(), sizeof(m_pServer->m_aClients[m_ClientID].m_aUsername));
+					m_pServer->RequestNameCheck();
 
 					char aBuf[256];
 					str_format(aBuf, sizeof(aBuf), "change_name previous='%s' now='%s'", aOldName, m_pServer->m_aClients[m_ClientID].m_aUsername);
@@ -3681,11 +4236,7 @@ void CServer::Login(int ClientID, const char* pUsername, const char* pPassword)
 	if(m_aClients[ClientID].m_LogInstance >= 0)
 		return;
 	
-	char aHash[64]; //Result
-	mem_zero(aHash, sizeof(aHash));
-	Crypt(pPassword, (const unsigned char*) "d9", 1, 16, aHash);
-	
-	CSqlJob* pJob = new CSqlJob_Server_Login(this, ClientID, pUsername, aHash);
+	CSqlJob* pJob = new CSqlJob_Server_Login(this, ClientID, pUsername, pPassword);
 	m_aClients[ClientID].m_LogInstance = pJob->GetInstance();
 	pJob->Start();
 }
@@ -3693,12 +4244,39 @@ void CServer::Login(int ClientID, const char* pUsername, const char* pPassword)
 void CServer::Logout(int ClientID)
 {
 	m_aClients[ClientID].m_UserID = -1;
+	RequestNameCheck();
 	m_aClients[ClientID].m_UserLevel = SQL_USERLEVEL_NORMAL;
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "change_name previous='%s' now='%s'", m_aClients[ClientID].m_aUsername, m_aClients[ClientID].m_aName);
 	Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "game", aBuf);
 }
 
+void CServer::SaveAccountSession(int ClientID)
+{
+	if(m_aClients[ClientID].m_UserID < 0 || g_Config.m_InfAccountSessionTime <= 0)
+		return;
+	// the address is all that identifies the client coming back, not enough for moderators and admins
+	if(m_aClients[ClientID].m_UserLevel != SQL_USERLEVEL_NORMAL)
+		return;
+	
+	int64 Expires = time_get() + time_freq() * g_Config.m_InfAccountSessionTime;
+	m_AccountSessions.Save(m_NetServer.ClientAddr(ClientID), m_aClients[ClientID].m_UserID, m_aClients[ClientID].m_aUsername, Expires);
+}
+
+void CServer::RestoreAccountSession(int ClientID)
+{
+	CAccountSessions::CSession Session;
+	m_aClients[ClientID].m_AccountRestored = m_AccountSessions.Take(m_NetServer.ClientAddr(ClientID), time_get(), &Session);
+	if(!m_aClients[ClientID].m_AccountRestored)
+		return;
+	
+	m_aClients[ClientID].m_UserID = Session.m_UserID;
+	m_aClients[ClientID].m_UserLevel = SQL_USERLEVEL_NORMAL;
+	str_copy(m_aClients[ClientID].m_aUsername, Session.m_aUsername, sizeof(m_aClients[ClientID].m_aUsername));
+	RequestNameCheck();
+	dbg_msg("infclass", "account session found for the client %d (id: %d)", ClientID, Session.m_UserID);
+}
+
 class CSqlJob_Server_SetEmail : public CSqlJob
 {
 private:
@@ -3762,16 +4340,16 @@ private:
 	CServer* m_pServer;
 	int m_ClientID;
 	CSqlString<64> m_sName;
-	CSqlString<64> m_sPasswordHash;
+	CAccountPassword m_Password;
 	CSqlString<64> m_sEmail;
 	
 public:
-	CSqlJob_Server_Register(CServer* pServer, int ClientID, const char* pName, const char* pPasswordHash, const char* pEmail)
+	CSqlJob_Server_Register(CServer* pServer, int ClientID, const char* pName, const char* pPassword, const char* pEmail) :
+		m_Password(pPassword)
 	{
 		m_pServer = pServer;
 		m_ClientID = ClientID;
 		m_sName = CSqlString<64>(pName);
-		m_sPasswordHash = CSqlString<64>(pPasswordHash);
 		if(pEmail)
 			m_sEmail = CSqlString<64>(pEmail);
 		else
@@ -3788,6 +4366,7 @@ public:
 			return true;
 		
 		net_addr_str(m_pServer->m_NetServer.ClientAddr(m_ClientID), aAddrStr, sizeof(aAddrStr), false);
+		const CSqlString<64>& sPasswordHash = m_Password.Hash();
 		
 		try
 		{
@@ -3850,7 +4429,7 @@ public:
 				"INSERT INTO %s_Users "
 				"(Username, PasswordHash, Email, RegisterDate, RegisterIp) "
 				"VALUES ('%s', '%s', '%s', UTC_TIMESTAMP(), '%s');"
-				, pSqlServer->GetPrefix(), m_sName.ClrStr(), m_sPasswordHash.ClrStr(), m_sEmail.ClrStr(), aAddrStr);
+				, pSqlServer->GetPrefix(), m_sName.ClrStr(), sPasswordHash.ClrStr(), m_sEmail.ClrStr(), aAddrStr);
 			pSqlServer->executeSql(aBuf);
 		}
 		catch (sql::SQLException &e)
@@ -3868,7 +4447,7 @@ public:
 			str_format(aBuf, sizeof(aBuf), 
 				"SELECT UserId FROM %s_Users "
 				"WHERE Username = '%s' AND PasswordHash = '%s';"
-				, pSqlServer->GetPrefix(), m_sName.ClrStr(), m_sPasswordHash.ClrStr());
+				, pSqlServer->GetPrefix(), m_sName.ClrStr(), sPasswordHash.ClrStr());
 			pSqlServer->executeSqlQuery(aBuf);
 
 			if(pSqlServer->GetResults()->next())
@@ -3882,6 +4461,7 @@ public:
 					int UserID = (int)pSqlServer->GetResults()->getInt("UserId");
 					m_pServer->m_aClients[m_ClientID].m_UserID = UserID;
 					str_copy(m_pServer->m_aClients[m_ClientID].m_aUsername, m_sName.Str(), sizeof(m_pServer->m_aClients[m_ClientID].m_aUsername));
+					m_pServer->RequestNameCheck();
 					
 					//If we are really unlucky, the client can deconnect and another one connect during this small code
 					if(m_pServer->m_aClients[m_ClientID].m_LogInstance != GetInstance())
@@ -3923,479 +4503,158 @@ void CServer::Register(int ClientID, const char* pUsername, const char* pPasswor
 	if(m_aClients[ClientID].m_LogInstance >= 0)
 		return;
 	
-	char aHash[64]; //Result
-	mem_zero(aHash, sizeof(aHash));
-	Crypt(pPassword, (const unsigned char*) "d9", 1, 16, aHash);
-	
-	CSqlJob* pJob = new CSqlJob_Server_Register(this, ClientID, pUsername, aHash, pEmail);
+	CSqlJob* pJob = new CSqlJob_Server_Register(this, ClientID, pUsername, pPassword, pEmail);
 	m_aClients[ClientID].m_LogInstance = pJob->GetInstance();
 	pJob->Start();
 }
 
-class CSqlJob_Server_ShowTop10 : public CSqlJob
+static const char* ScoreTypeName(int ScoreType)
+{
+	switch(ScoreType)
+	{
+		case SQL_SCORETYPE_ROUND_SCORE: return "Player";
+		case SQL_SCORETYPE_ENGINEER_SCORE: return "Engineer";
+		case SQL_SCORETYPE_SOLDIER_SCORE: return "Soldier";
+		case SQL_SCORETYPE_SCIENTIST_SCORE: return "Scientist";
+		case SQL_SCORETYPE_BIOLOGIST_SCORE: return "Biologist";
+		case SQL_SCORETYPE_LOOPER_SCORE: return "Looper";
+		case SQL_SCORETYPE_MEDIC_SCORE: return "Medic";
+		case SQL_SCORETYPE_HERO_SCORE: return "Hero";
+		case SQL_SCORETYPE_NINJA_SCORE: return "Ninja";
+		case SQL_SCORETYPE_MERCENARY_SCORE: return "Mercenary";
+		case SQL_SCORETYPE_SNIPER_SCORE: return "Sniper";
+		case SQL_SCORETYPE_SMOKER_SCORE: return "Smoker";
+		case SQL_SCORETYPE_HUNTER_SCORE: return "Hunter";
+		case SQL_SCORETYPE_BOOMER_SCORE: return "Boomer";
+		case SQL_SCORETYPE_GHOST_SCORE: return "Ghost";
+		case SQL_SCORETYPE_SPIDER_SCORE: return "Spider";
+		case SQL_SCORETYPE_GHOUL_SCORE: return "Ghoul";
+		case SQL_SCORETYPE_SLUG_SCORE: return "Slug";
+		case SQL_SCORETYPE_UNDEAD_SCORE: return "Undead";
+		case SQL_SCORETYPE_WITCH_SCORE: return "Witch";
+	}
+	return 0;
+}
+
+void CServer::AnswerLeaderboardRequest(const char* pMapName, int ScoreType, const CLeaderboardCache::CRequest& Request)
 {
-private:
-	CServer* m_pServer;
-	CSqlString<64> m_sMapName;
-	int m_ClientID;
-	int m_ScoreType;
-	
-public:
-	CSqlJob_Server_ShowTop10(CServer* pServer, const char* pMapName, int ClientID, int ScoreType)
-	{
-		m_pServer = pServer;
-		m_sMapName = CSqlString<64>(pMapName);
-		m_ClientID = ClientID;
-		m_ScoreType = ScoreType;
-	}
+	char aBuf[1024];
+	CLeaderboardCache::CEntry aEntries[10];
+	CLeaderboardCache::CEntry Entry;
+	int Rank;
 
-	virtual bool Job(CSqlServer* pSqlServer)
+	switch(Request.m_Type)
 	{
-		char aBuf[1024];
-		
-		try
+		case CLeaderboardCache::REQUEST_TOP10:
 		{
-			//Get the top 10 with this very simple, intuitive and optimized SQL function >_<
-			pSqlServer->executeSql("SET @VarRowNum := 0, @VarType := -1");
-			str_format(aBuf, sizeof(aBuf), 
-				"SELECT "
-					"TableUsers.Username, "
-					"SUM(y.Score) AS AccumulatedScore, "
-					"COUNT(y.Score) AS NbRounds "
-				"FROM ("
-					"SELECT "
-						"x.UserId AS UserId, "
-						"x.Score AS Score, "
-						"@VarRowNum := IF(@VarType = x.UserId, @VarRowNum + 1, 1) as RowNumber, "
-						"@VarType := x.UserId AS dummy "
-					"FROM ("
-						"SELECT "
-							"TableRoundScore.UserId, "
-							"TableRoundScore.Score "
-						"FROM %s_infc_RoundScore AS TableRoundScore "
-						"WHERE ScoreType = '%d' AND MapName = '%s' "
-						"ORDER BY TableRoundScore.UserId ASC, TableRoundScore.Score DESC "
-					") AS x "
-				") AS y "
-				"INNER JOIN %s_Users AS TableUsers ON y.UserId = TableUsers.UserId "
-				"WHERE y.RowNumber <= %d "
-				"GROUP BY y.UserId "
-				"ORDER BY AccumulatedScore DESC, y.UserId ASC "
-				"LIMIT 10"
-				, pSqlServer->GetPrefix()
-				, m_ScoreType
-				, m_sMapName.ClrStr()
-				, pSqlServer->GetPrefix()
-				, SQL_SCORE_NUMROUND
-			);
-			pSqlServer->executeSqlQuery(aBuf);
-			
 			char* pMOTD = aBuf;
-			
-			switch(m_ScoreType)
+			aBuf[0] = 0;
+
+			const char* pTypeName = ScoreTypeName(ScoreType);
+			if(pTypeName)
 			{
-				case SQL_SCORETYPE_ENGINEER_SCORE:
-					str_copy(pMOTD, "== Best Engineer ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_SOLDIER_SCORE:
-					str_copy(pMOTD, "== Best Soldier ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_SCIENTIST_SCORE:
-					str_copy(pMOTD, "== Best Scientist ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_BIOLOGIST_SCORE:
-					str_copy(pMOTD, "== Best Biologist ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_LOOPER_SCORE:
-					str_copy(pMOTD, "== Best Looper ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_MEDIC_SCORE:
-					str_copy(pMOTD, "== Best Medic ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_HERO_SCORE:
-					str_copy(pMOTD, "== Best Hero ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_NINJA_SCORE:
-					str_copy(pMOTD, "== Best Ninja ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_MERCENARY_SCORE:
-					str_copy(pMOTD, "== Best Mercenary ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_SNIPER_SCORE:
-					str_copy(pMOTD, "== Best Sniper ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_SMOKER_SCORE:
-					str_copy(pMOTD, "== Best Smoker ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_HUNTER_SCORE:
-					str_copy(pMOTD, "== Best Hunter ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_BOOMER_SCORE:
-					str_copy(pMOTD, "== Best Boomer ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_GHOST_SCORE:
-					str_copy(pMOTD, "== Best Ghost ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_SPIDER_SCORE:
-					str_copy(pMOTD, "== Best Spider ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_GHOUL_SCORE:
-					str_copy(pMOTD, "== Best Ghoul ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_SLUG_SCORE:
-					str_copy(pMOTD, "== Best Slug ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_UNDEAD_SCORE:
-					str_copy(pMOTD, "== Best Undead ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_WITCH_SCORE:
-					str_copy(pMOTD, "== Best Witch ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
-				case SQL_SCORETYPE_ROUND_SCORE:
-					str_copy(pMOTD, "== Best Player ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
-					pMOTD += str_length(pMOTD);
-					break;
+				str_format(pMOTD, sizeof(aBuf)-(pMOTD-aBuf), "== Best %s ==\n32 best scores on this map\n\n", pTypeName);
+				pMOTD += str_length(pMOTD);
 			}
-			
-			int Rank = 0;
-			while(pSqlServer->GetResults()->next())
+
+			int NumEntries = m_LeaderboardCache.GetTop(pMapName, ScoreType, aEntries, 10);
+			for(int i = 0; i < NumEntries; i++)
 			{
-				Rank++;
-				str_format(pMOTD, sizeof(aBuf)-(pMOTD-aBuf), "%d. %s: %d pts\n",
-					Rank,
-					pSqlServer->GetResults()->getString("Username").c_str(),
-					pSqlServer->GetResults()->getInt("AccumulatedScore")/10
-				);
+				str_format(pMOTD, sizeof(aBuf)-(pMOTD-aBuf), "%d. %s: %d pts\n", i+1, aEntries[i].m_aUsername, aEntries[i].m_Score/10);
 				pMOTD += str_length(pMOTD);
 			}
 			str_copy(pMOTD, "\nCreate an account with /register and try to beat them!", sizeof(aBuf)-(pMOTD-aBuf));
-			
-			CServer::CGameServerCmd* pCmd = new CGameServerCmd_SendChatMOTD(m_ClientID, aBuf);
-			m_pServer->AddGameServerCmd(pCmd);
-		}
-		catch (sql::SQLException &e)
-		{
-			dbg_msg("sql", "Can't get top10 (MySQL Error: %s)", e.what());
-			
-			return false;
-		}
-		
-		return true;
-	}
-};
 
-void CServer::ShowTop10(int ClientID, int ScoreType)
-{
-	CSqlJob* pJob = new CSqlJob_Server_ShowTop10(this, m_aCurrentMap, ClientID, ScoreType);
-	pJob->Start();
-}
-
-class CSqlJob_Server_ShowChallenge : public CSqlJob
-{
-private:
-	CServer* m_pServer;
-	CSqlString<64> m_sMapName;
-	int m_ClientID;
-	int m_ScoreType;
-	
-public:
-	CSqlJob_Server_ShowChallenge(CServer* pServer, const char* pMapName, int ClientID, int ChallengeType)
-	{
-		m_pServer = pServer;
-		m_ScoreType = ChallengeTypeToScoreType(ChallengeType);
-		m_ClientID = ClientID;
-		m_sMapName = CSqlString<64>(pMapName);
-	}
+			AddGameServerCmd(new CGameServerCmd_SendChatMOTD(Request.m_ClientID, aBuf));
+			break;
+		}
 
-	virtual bool Job(CSqlServer* pSqlServer)
-	{
-		char aMotdBuf[1024];
-		char aBuf[1024];
-		
-		try
+		case CLeaderboardCache::REQUEST_CHALLENGE:
 		{
-			char* pMOTD = aMotdBuf;
-			
-			if(m_ScoreType >= 0)
+			char* pMOTD = aBuf;
+			aBuf[0] = 0;
+
+			const char* pTypeName = ScoreTypeName(Request.m_DailyScoreType);
+			if(pTypeName)
 			{
-				str_format(aBuf, sizeof(aBuf), 
-					"SELECT "
-						"TableUsers.Username, "
-						"TableScore.Score "
-					"FROM %s_infc_RoundScore AS TableScore "
-					"INNER JOIN %s_Users AS TableUsers ON TableScore.UserId = TableUsers.UserId "
-					"WHERE DATE(TableScore.ScoreDate) = DATE(UTC_TIMESTAMP()) AND TableScore.ScoreType = %d "
-					"ORDER BY TableScore.Score DESC "
-					"LIMIT 5"
-					, pSqlServer->GetPrefix()
-					, pSqlServer->GetPrefix()
-					, m_ScoreType
-				);
-				pSqlServer->executeSqlQuery(aBuf);
-				
-				switch(m_ScoreType)
-				{
-					case SQL_SCORETYPE_ROUND_SCORE:
-						str_copy(pMOTD, "== Player of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_ENGINEER_SCORE:
-						str_copy(pMOTD, "== Engineer of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_SOLDIER_SCORE:
-						str_copy(pMOTD, "== Soldier of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_SCIENTIST_SCORE:
-						str_copy(pMOTD, "== Scientist of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_BIOLOGIST_SCORE:
-						str_copy(pMOTD, "== Biologist of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_LOOPER_SCORE:
-						str_copy(pMOTD, "== Looper of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_MEDIC_SCORE:
-						str_copy(pMOTD, "== Medic of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_HERO_SCORE:
-						str_copy(pMOTD, "== Hero of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_NINJA_SCORE:
-						str_copy(pMOTD, "== Ninja of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_SNIPER_SCORE:
-						str_copy(pMOTD, "== Sniper of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-					case SQL_SCORETYPE_MERCENARY_SCORE:
-						str_copy(pMOTD, "== Mercenary of the day ==\nBest score in one round\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-						break;
-				}
+				str_format(pMOTD, sizeof(aBuf)-(pMOTD-aBuf), "== %s of the day ==\nBest score in one round\n\n", pTypeName);
 				pMOTD += str_length(pMOTD);
-				
-				int Rank = 0;
-				while(pSqlServer->GetResults()->next())
+
+				CLeaderboardCache::CRoundScore aRounds[CLeaderboardCache::MAX_DAILY_BEST];
+				int NumRounds = m_LeaderboardCache.GetDailyBest(Request.m_DailyScoreType, aRounds, CLeaderboardCache::MAX_DAILY_BEST);
+				for(int i = 0; i < NumRounds; i++)
 				{
-					Rank++;
-					str_format(pMOTD, sizeof(aMotdBuf)-(pMOTD-aMotdBuf), "%d. %s: %d pts\n",
-						Rank,
-						pSqlServer->GetResults()->getString("Username").c_str(),
-						pSqlServer->GetResults()->getInt("Score")/10
-					);
+					str_format(pMOTD, sizeof(aBuf)-(pMOTD-aBuf), "%d. %s: %d pts\n", i+1, aRounds[i].m_aUsername, aRounds[i].m_Score/10);
 					pMOTD += str_length(pMOTD);
 				}
 			}
-			
+
+			str_copy(pMOTD, "\n== Best Players ==\n32 best scores on this map\n\n", sizeof(aBuf)-(pMOTD-aBuf));
+			pMOTD += str_length(pMOTD);
+
+			int NumEntries = m_LeaderboardCache.GetTop(pMapName, ScoreType, aEntries, 5);
+			for(int i = 0; i < NumEntries; i++)
 			{
-				//Get the top 5 with this very simple, intuitive and optimized SQL function >_<
-				pSqlServer->executeSql("SET @VarRowNum := 0, @VarType := -1");
-				str_format(aBuf, sizeof(aBuf), 
-					"SELECT "
-						"TableUsers.Username, "
-						"SUM(y.Score) AS AccumulatedScore, "
-						"COUNT(y.Score) AS NbRounds "
-					"FROM ("
-						"SELECT "
-							"x.UserId AS UserId, "
-							"x.Score AS Score, "
-							"@VarRowNum := IF(@VarType = x.UserId, @VarRowNum + 1, 1) as RowNumber, "
-							"@VarType := x.UserId AS dummy "
-						"FROM ("
-							"SELECT "
-								"TableRoundScore.UserId, "
-								"TableRoundScore.Score "
-							"FROM %s_infc_RoundScore AS TableRoundScore "
-							"WHERE ScoreType = '%d' AND MapName = '%s' "
-							"ORDER BY TableRoundScore.UserId ASC, TableRoundScore.Score DESC "
-						") AS x "
-					") AS y "
-					"INNER JOIN %s_Users AS TableUsers ON y.UserId = TableUsers.UserId "
-					"WHERE y.RowNumber <= %d "
-					"GROUP BY y.UserId "
-					"ORDER BY AccumulatedScore DESC, y.UserId ASC "
-					"LIMIT 5"
-					, pSqlServer->GetPrefix()
-					, SQL_SCORETYPE_ROUND_SCORE
-					, m_sMapName.ClrStr()
-					, pSqlServer->GetPrefix()
-					, SQL_SCORE_NUMROUND
-				);
-				pSqlServer->executeSqlQuery(aBuf);
-				
-				str_copy(pMOTD, "\n== Best Players ==\n32 best scores on this map\n\n", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
+				str_format(pMOTD, sizeof(aBuf)-(pMOTD-aBuf), "%d. %s: %d pts\n", i+1, aEntries[i].m_aUsername, aEntries[i].m_Score/10);
 				pMOTD += str_length(pMOTD);
-				
-				int Rank = 0;
-				while(pSqlServer->GetResults()->next())
-				{
-					Rank++;
-					str_format(pMOTD, sizeof(aMotdBuf)-(pMOTD-aMotdBuf), "%d. %s: %d pts\n",
-						Rank,
-						pSqlServer->GetResults()->getString("Username").c_str(),
-						pSqlServer->GetResults()->getInt("AccumulatedScore")/10
-					);
-					pMOTD += str_length(pMOTD);
-				}
 			}
-			
-			str_copy(pMOTD, "\n\nCreate an account with /register and try to beat them!", sizeof(aMotdBuf)-(pMOTD-aMotdBuf));
-			
-			CServer::CGameServerCmd* pCmd = new CGameServerCmd_SendChatMOTD(m_ClientID, aMotdBuf);
-			m_pServer->AddGameServerCmd(pCmd);
-		}
-		catch (sql::SQLException &e)
-		{
-			dbg_msg("sql", "Can't get challenge (MySQL Error: %s)", e.what());
-			
-			return false;
-		}
-		
-		return true;
-	}
-};
+			str_copy(pMOTD, "\n\nCreate an account with /register and try to beat them!", sizeof(aBuf)-(pMOTD-aBuf));
 
-void CServer::ShowChallenge(int ClientID)
-{
-	if(g_Config.m_InfChallenge)
-	{
-		int ChallengeType;
-		lock_wait(m_ChallengeLock);
-		ChallengeType = m_ChallengeType;
-		lock_release(m_ChallengeLock);
-		
-		CSqlJob* pJob = new CSqlJob_Server_ShowChallenge(this, m_aCurrentMap, ClientID, ChallengeType);
-		pJob->Start();
-	}
-}
-
-class CSqlJob_Server_RefreshChallenge : public CSqlJob
-{
-private:
-	CServer* m_pServer;
-	
-public:
-	CSqlJob_Server_RefreshChallenge(CServer* pServer)
-	{
-		m_pServer = pServer;
-	}
+			AddGameServerCmd(new CGameServerCmd_SendChatMOTD(Request.m_ClientID, aBuf));
+			break;
+		}
 
-	virtual bool Job(CSqlServer* pSqlServer)
-	{
-		char aBuf[1024];
-		char aWinner[32];
-		int ChallengeType = m_pServer->m_ChallengeType;
-		int ScoreType;
-		
-		aWinner[0] = 0;
-		
-		try
-		{
-			//Get the day
-			str_format(aBuf, sizeof(aBuf), "SELECT WEEKDAY(UTC_TIMESTAMP()) AS WeekDay, WEEK(UTC_TIMESTAMP()) AS Week");
-			pSqlServer->executeSqlQuery(aBuf);
-			
-			if(pSqlServer->GetResults()->next())
+		case CLeaderboardCache::REQUEST_RANK:
+			if(m_LeaderboardCache.GetPlayer(pMapName, ScoreType, Request.m_UserID, &Rank, &Entry))
 			{
-				int CurrentDay = pSqlServer->GetResults()->getInt("WeekDay");
-				int CurrentWeek = pSqlServer->GetResults()->getInt("Week");
-				ChallengeType = (CurrentWeek*7 + CurrentDay)%NB_HUMANCLASS;
+				str_format(aBuf, sizeof(aBuf), "You are rank %d in %s (%d pts in %d rounds)", Rank, pMapName, Entry.m_Score/10, Entry.m_NumRounds);
+				AddGameServerCmd(new CGameServerCmd_SendChatTarget(Request.m_ClientID, aBuf));
 			}
-			
-			ScoreType = ChallengeTypeToScoreType(ChallengeType);
-			
-			str_format(aBuf, sizeof(aBuf), 
-				"SELECT "
-					"TableUsers.Username "
-				"FROM %s_infc_RoundScore AS TableScore "
-				"INNER JOIN %s_Users AS TableUsers ON TableScore.UserId = TableUsers.UserId "
-				"WHERE DATE(TableScore.ScoreDate) = DATE(UTC_TIMESTAMP()) AND TableScore.ScoreType = %d "
-				"ORDER BY TableScore.Score DESC "
-				"LIMIT 1"
-				, pSqlServer->GetPrefix()
-				, pSqlServer->GetPrefix()
-				, ScoreType
-			);
-			pSqlServer->executeSqlQuery(aBuf);
-			
-			if(pSqlServer->GetResults()->next())
+			else
+				AddGameServerCmd(new CGameServerCmd_SendChatTarget(Request.m_ClientID, "You must gain at least one point to see your rank"));
+			break;
+
+		case CLeaderboardCache::REQUEST_GOAL:
+			if(m_LeaderboardCache.GetPlayer(pMapName, ScoreType, Request.m_UserID, &Rank, &Entry) && Entry.m_NumRounds == SQL_SCORE_NUMROUND)
 			{
-				str_copy(aWinner, pSqlServer->GetResults()->getString("Username").c_str(), sizeof(aWinner));
+				str_format(aBuf, sizeof(aBuf), "You must gain at least %d points to increase your score", Entry.m_LowestScore/10+1);
+				AddGameServerCmd(new CGameServerCmd_SendChatTarget(Request.m_ClientID, aBuf));
 			}
-			
-			lock_wait(m_pServer->m_ChallengeLock);
-			m_pServer->m_ChallengeType = ChallengeType;
-			str_copy(m_pServer->m_aChallengeWinner, aWinner, sizeof(m_pServer->m_aChallengeWinner));
-			lock_release(m_pServer->m_ChallengeLock);
-		}
-		catch (sql::SQLException &e)
-		{
-			dbg_msg("sql", "Can't refresh challenge (MySQL Error: %s)", e.what());
-			
-			return false;
-		}
-		
-		return true;
-	}
-};
-
-void CServer::RefreshChallenge()
-{
-	if(g_Config.m_InfChallenge)
-	{
-		CSqlJob* pJob = new CSqlJob_Server_RefreshChallenge(this);
-		pJob->Start();
+			else
+				AddGameServerCmd(new CGameServerCmd_SendChatTarget(Request.m_ClientID, "Gain at least one point to increase your score"));
+			break;
 	}
 }
 
-class CSqlJob_Server_ShowRank : public CSqlJob
+class CSqlJob_Server_LoadLeaderboard : public CSqlJob
 {
 private:
 	CServer* m_pServer;
 	CSqlString<64> m_sMapName;
-	int m_ClientID;
-	int m_UserID;
 	int m_ScoreType;
 	
 public:
-	CSqlJob_Server_ShowRank(CServer* pServer, const char* pMapName, int ClientID, int UserID, int ScoreType)
+	CSqlJob_Server_LoadLeaderboard(CServer* pServer, const char* pMapName, int ScoreType)
 	{
 		m_pServer = pServer;
 		m_sMapName = CSqlString<64>(pMapName);
-		m_ClientID = ClientID;
-		m_UserID = UserID;
 		m_ScoreType = ScoreType;
 	}
 
 	virtual bool Job(CSqlServer* pSqlServer)
 	{
 		char aBuf[1024];
+		std::vector<CLeaderboardCache::CRoundScore> lRounds;
 		
 		try
 		{
-			//Get the top 10 with this very simple, intuitive and optimized SQL fuction >_<
+			//Get the best rounds of each player, the sums are computed by the cache
 			pSqlServer->executeSql("SET @VarRowNum := 0, @VarType := -1");
 			str_format(aBuf, sizeof(aBuf), 
 				"SELECT "
 					"y.UserId, "
-					"SUM(y.Score) AS AccumulatedScore, "
-					"COUNT(y.Score) AS NbRounds "
+					"TableUsers.Username, "
+					"y.Score "
 				"FROM ("
 					"SELECT "
 						"x.UserId AS UserId, "
@@ -4411,126 +4670,172 @@ public:
 						"ORDER BY TableRoundScore.UserId ASC, TableRoundScore.Score DESC "
 					") AS x "
 				") AS y "
+				"INNER JOIN %s_Users AS TableUsers ON y.UserId = TableUsers.UserId "
 				"WHERE y.RowNumber <= %d "
-				"GROUP BY y.UserId "
-				"ORDER BY AccumulatedScore DESC, y.UserId ASC "
 				, pSqlServer->GetPrefix()
 				, m_ScoreType
 				, m_sMapName.ClrStr()
+				, pSqlServer->GetPrefix()
 				, SQL_SCORE_NUMROUND
 			);
 			pSqlServer->executeSqlQuery(aBuf);
 			
-			int Rank = 0;
-			bool RankFound = false;
-			while(pSqlServer->GetResults()->next() && !RankFound)
-			{
-				Rank++;
-				if(pSqlServer->GetResults()->getInt("UserId") == m_UserID)
-				{
-					int Score = pSqlServer->GetResults()->getInt("AccumulatedScore")/10;
-					int Rounds = pSqlServer->GetResults()->getInt("NbRounds");
-					str_format(aBuf, sizeof(aBuf), "You are rank %d in %s (%d pts in %d rounds)", Rank, m_sMapName.Str(), Score, Rounds);
-					CServer::CGameServerCmd* pCmd = new CGameServerCmd_SendChatTarget(m_ClientID, aBuf);
-					m_pServer->AddGameServerCmd(pCmd);
-					
-					RankFound = true;
-				}
-			}
-			
-			if(!RankFound)
+			while(pSqlServer->GetResults()->next())
 			{
-				CServer::CGameServerCmd* pCmd = new CGameServerCmd_SendChatTarget(m_ClientID, "You must gain at least one point to see your rank");
-				m_pServer->AddGameServerCmd(pCmd);
+				CLeaderboardCache::CRoundScore Round;
+				Round.m_UserID = pSqlServer->GetResults()->getInt("UserId");
+				Round.m_Score = pSqlServer->GetResults()->getInt("Score");
+				str_copy(Round.m_aUsername, pSqlServer->GetResults()->getString("Username").c_str(), sizeof(Round.m_aUsername));
+				lRounds.push_back(Round);
 			}
 		}
 		catch (sql::SQLException &e)
 		{
-			dbg_msg("sql", "Can't get rank (MySQL Error: %s)", e.what());
+			dbg_msg("sql", "Can't load leaderboard (MySQL Error: %s)", e.what());
 			
 			return false;
 		}
 		
+		std::vector<CLeaderboardCache::CRequest> lRequests;
+		m_pServer->m_LeaderboardCache.FinishLoad(m_sMapName.Str(), m_ScoreType, lRounds, time_get()/time_freq(), &lRequests);
+		for(unsigned i = 0; i < lRequests.size(); i++)
+			m_pServer->AnswerLeaderboardRequest(m_sMapName.Str(), m_ScoreType, lRequests[i]);
+		
 		return true;
 	}
+
+	virtual void OnFailure()
+	{
+		std::vector<CLeaderboardCache::CRequest> lRequests;
+		bool Loaded = m_pServer->m_LeaderboardCache.AbortLoad(m_sMapName.Str(), m_ScoreType, &lRequests);
+		for(unsigned i = 0; i < lRequests.size(); i++)
+		{
+			if(Loaded)
+				m_pServer->AnswerLeaderboardRequest(m_sMapName.Str(), m_ScoreType, lRequests[i]);
+			else
+				m_pServer->AddGameServerCmd(new CGameServerCmd_SendChatTarget(lRequests[i].m_ClientID, "The leaderboard can't be loaded right now, try again later"));
+		}
+	}
 };
 
-void CServer::ShowRank(int ClientID, int ScoreType)
+void CServer::RequestLeaderboard(int ScoreType, int Type, int ClientID, int DailyScoreType)
 {
-	if(m_aClients[ClientID].m_UserID >= 0)
+	CLeaderboardCache::CRequest Request;
+	Request.m_Type = Type;
+	Request.m_ClientID = ClientID;
+	Request.m_UserID = m_aClients[ClientID].m_UserID;
+	Request.m_DailyScoreType = DailyScoreType;
+
+	m_LeaderboardCache.SetTimeToLive(g_Config.m_InfLeaderboardCacheTTL);
+	switch(m_LeaderboardCache.Request(m_aCurrentMap, ScoreType, Request, time_get()/time_freq()))
 	{
-		CSqlJob* pJob = new CSqlJob_Server_ShowRank(this, m_aCurrentMap, ClientID, m_aClients[ClientID].m_UserID, ScoreType);
-		pJob->Start();
+		case CLeaderboardCache::RESULT_READY:
+			AnswerLeaderboardRequest(m_aCurrentMap, ScoreType, Request);
+			break;
+		case CLeaderboardCache::RESULT_LOAD:
+		{
+			CSqlJob* pJob = new CSqlJob_Server_LoadLeaderboard(this, m_aCurrentMap, ScoreType);
+			pJob->Start();
+			break;
+		}
 	}
-	else if(m_pGameServer)
+}
+
+void CServer::ShowTop10(int ClientID, int ScoreType)
+{
+	RequestLeaderboard(ScoreType, CLeaderboardCache::REQUEST_TOP10, ClientID, -1);
+}
+
+void CServer::ShowChallenge(int ClientID)
+{
+	if(g_Config.m_InfChallenge)
 	{
-		m_pGameServer->SendChatTarget_Localization(ClientID, CHATCATEGORY_DEFAULT, _("You must be logged to see your rank"), NULL);
+		int ChallengeType;
+		lock_wait(m_ChallengeLock);
+		ChallengeType = m_ChallengeType;
+		lock_release(m_ChallengeLock);
+		
+		RequestLeaderboard(SQL_SCORETYPE_ROUND_SCORE, CLeaderboardCache::REQUEST_CHALLENGE, ClientID, ChallengeTypeToScoreType(ChallengeType));
 	}
 }
 
-class CSqlJob_Server_ShowGoal : public CSqlJob
+class CSqlJob_Server_RefreshChallenge : public CSqlJob
 {
 private:
 	CServer* m_pServer;
-	CSqlString<64> m_sMapName;
-	int m_ClientID;
-	int m_UserID;
-	int m_ScoreType;
 	
 public:
-	CSqlJob_Server_ShowGoal(CServer* pServer, const char* pMapName, int ClientID, int UserID, int ScoreType)
+	CSqlJob_Server_RefreshChallenge(CServer* pServer)
 	{
 		m_pServer = pServer;
-		m_sMapName = CSqlString<64>(pMapName);
-		m_ClientID = ClientID;
-		m_UserID = UserID;
-		m_ScoreType = ScoreType;
 	}
 
 	virtual bool Job(CSqlServer* pSqlServer)
 	{
 		char aBuf[1024];
+		char aWinner[32];
+		int ChallengeType = m_pServer->m_ChallengeType;
+		int ScoreType;
+		std::vector<CLeaderboardCache::CRoundScore> lDailyBest;
+		
+		aWinner[0] = 0;
 		
 		try
 		{
-			//Get the list of best rounds
-			str_format(aBuf, sizeof(aBuf), 
-				"SELECT Score "
-				"FROM %s_infc_RoundScore "
-				"WHERE UserId = '%d' AND MapName = '%s' AND ScoreType = '%d' "
-				"ORDER BY Score DESC "
-				"LIMIT %d "
+			//Get the day
+			str_format(aBuf, sizeof(aBuf), "SELECT WEEKDAY(UTC_TIMESTAMP()) AS WeekDay, WEEK(UTC_TIMESTAMP()) AS Week");
+			pSqlServer->executeSqlQuery(aBuf);
+			
+			if(pSqlServer->GetResults()->next())
+			{
+				int CurrentDay = pSqlServer->GetResults()->getInt("WeekDay");
+				int CurrentWeek = pSqlServer->GetResults()->getInt("Week");
+				ChallengeType = (CurrentWeek*7 + CurrentDay)%NB_HUMANCLASS;
+			}
+			
+			ScoreType = ChallengeTypeToScoreType(ChallengeType);
+			
+			//The best rounds of the day are kept for /challenge
+			str_format(aBuf, sizeof(aBuf), 
+				"SELECT "
+					"TableUsers.UserId, "
+					"TableUsers.Username, "
+					"TableScore.Score "
+				"FROM %s_infc_RoundScore AS TableScore "
+				"INNER JOIN %s_Users AS TableUsers ON TableScore.UserId = TableUsers.UserId "
+				"WHERE DATE(TableScore.ScoreDate) = DATE(UTC_TIMESTAMP()) AND TableScore.ScoreType = %d "
+				"ORDER BY TableScore.Score DESC "
+				"LIMIT %d"
 				, pSqlServer->GetPrefix()
-				, m_UserID
-				, m_sMapName.ClrStr()
-				, m_ScoreType
-				, SQL_SCORE_NUMROUND
+				, pSqlServer->GetPrefix()
+				, ScoreType
+				, (int)CLeaderboardCache::MAX_DAILY_BEST
 			);
 			pSqlServer->executeSqlQuery(aBuf);
 			
-			int RoundCounter = 0;
-			int Score = 0;
 			while(pSqlServer->GetResults()->next())
 			{
-				Score = pSqlServer->GetResults()->getInt("Score")/10;
-				RoundCounter++;
+				CLeaderboardCache::CRoundScore Round;
+				Round.m_UserID = pSqlServer->GetResults()->getInt("UserId");
+				Round.m_Score = pSqlServer->GetResults()->getInt("Score");
+				str_copy(Round.m_aUsername, pSqlServer->GetResults()->getString("Username").c_str(), sizeof(Round.m_aUsername));
+				lDailyBest.push_back(Round);
 			}
 			
-			if(RoundCounter == SQL_SCORE_NUMROUND)
-			{
-				str_format(aBuf, sizeof(aBuf), "You must gain at least %d points to increase your score", (Score+1)); 
-				CServer::CGameServerCmd* pCmd = new CGameServerCmd_SendChatTarget(m_ClientID, aBuf);
-				m_pServer->AddGameServerCmd(pCmd);
-			}
-			else
+			if(!lDailyBest.empty())
 			{
-				CServer::CGameServerCmd* pCmd = new CGameServerCmd_SendChatTarget(m_ClientID, "Gain at least one point to increase your score");
-				m_pServer->AddGameServerCmd(pCmd);
+				str_copy(aWinner, lDailyBest[0].m_aUsername, sizeof(aWinner));
 			}
+			m_pServer->m_LeaderboardCache.SetDailyBest(ScoreType, lDailyBest);
+			
+			lock_wait(m_pServer->m_ChallengeLock);
+			m_pServer->m_ChallengeType = ChallengeType;
+			str_copy(m_pServer->m_aChallengeWinner, aWinner, sizeof(m_pServer->m_aChallengeWinner));
+			lock_release(m_pServer->m_ChallengeLock);
 		}
 		catch (sql::SQLException &e)
 		{
-			dbg_msg("sql", "Can't get rank (MySQL Error: %s)", e.what());
+			dbg_msg("sql", "Can't refresh challenge (MySQL Error: %s)", e.what());
 			
 			return false;
 		}
@@ -4539,12 +4844,32 @@ public:
 	}
 };
 
+void CServer::RefreshChallenge()
+{
+	if(g_Config.m_InfChallenge)
+	{
+		CSqlJob* pJob = new CSqlJob_Server_RefreshChallenge(this);
+		pJob->Start();
+	}
+}
+
+void CServer::ShowRank(int ClientID, int ScoreType)
+{
+	if(m_aClients[ClientID].m_UserID >= 0)
+	{
+		RequestLeaderboard(ScoreType, CLeaderboardCache::REQUEST_RANK, ClientID, -1);
+	}
+	else if(m_pGameServer)
+	{
+		m_pGameServer->SendChatTarget_Localization(ClientID, CHATCATEGORY_DEFAULT, _("You must be logged to see your rank"), NULL);
+	}
+}
+
 void CServer::ShowGoal(int ClientID, int ScoreType)
 {
 	if(m_aClients[ClientID].m_UserID >= 0)
 	{
-		CSqlJob* pJob = new CSqlJob_Server_ShowGoal(this, m_aCurrentMap, ClientID, m_aClients[ClientID].m_UserID, ScoreType);
-		pJob->Start();
+		RequestLeaderboard(ScoreType, CLeaderboardCache::REQUEST_GOAL, ClientID, -1);
 	}
 	else if(m_pGameServer)
 	{
@@ -4552,6 +4877,24 @@ void CServer::ShowGoal(int ClientID, int ScoreType)
 	}
 }
 
+bool CServer::ConLeaderboardCacheStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+
+	CLeaderboardCache::CStats Stats;
+	pSelf->m_LeaderboardCache.GetStats(&Stats, time_get()/time_freq());
+
+	int64 Requests = Stats.m_Hits + Stats.m_Misses + Stats.m_Queued + Stats.m_Expired;
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf), "boards=%d players=%d oldest=%ds hits=%lld misses=%lld queued=%lld expired=%lld updates=%lld evicted=%lld hitrate=%d%%",
+		Stats.m_NumBoards, Stats.m_NumPlayers, Stats.m_OldestBoardAge,
+		Stats.m_Hits, Stats.m_Misses, Stats.m_Queued, Stats.m_Expired, Stats.m_Updates, Stats.m_Evicted,
+		Requests ? (int)(Stats.m_Hits*100/Requests) : 0);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+	return true;
+}
+
 class CSqlJob_Server_ShowStats : public CSqlJob // under konstruktion (copypasted draft)
 {
 private:
@@ -4668,229 +5011,453 @@ void CServer::Ban(int ClientID, int Seconds, const char* pReason)
 
 #ifdef CONF_SQL
 
-class CSqlJob_Server_SendRoundStatistics : public CSqlJob
+class CSqlJob_Server_SendStatistics : public CSqlJob
 {
 private:
+	enum
+	{
+		MAX_ROWS_PER_INSERT = 256,
+		// a journaled round failing that often is moved to the quarantine file
+		MAX_REPLAY_FAILURES = 5,
+		// seconds, doubled after each failed replay
+		REPLAY_BACKOFF_MIN = 30,
+		REPLAY_BACKOFF_MAX = 3600,
+	};
+
+	// stands for the table prefix in the journal, the server that replays a
+	// round puts its own prefix in
+	static const char* JournalPrefix() { return "{prefix}"; }
+
+	struct CJournalRound
+	{
+		int m_Failures;
+		std::vector<std::string> m_Statements;
+	};
+
+	struct CScoreRow
+	{
+		int m_ClientID;
+		int m_UserID;
+		int m_ScoreType;
+		int m_Score;
+	};
+
+	CServer* m_pServer;
 	CSqlString<64> m_sMapName;
 	int m_NumPlayersMin;
 	int m_NumPlayersMax;
 	int m_RoundDuration;
 	int m_NumWinners;
-	
-	int m_RoundId;
-	
-public:
-	CSqlJob_Server_SendRoundStatistics(CServer* pServer, const CRoundStatistics* pRoundStatistics, const char* pMapName)
+	int m_RoundTime;
+	std::vector<CScoreRow> m_Rows;
+	char m_aaUsernames[MAX_CLIENTS][CLeaderboardCache::MAX_USERNAME_LENGTH];
+	char m_aJournalFile[MAX_PATH_LENGTH];
+
+	void AddScore(int ClientID, int UserID, int ScoreType, int Score)
 	{
-		m_sMapName = CSqlString<64>(pMapName);
-		m_NumPlayersMin = pRoundStatistics->m_NumPlayersMin;
-		m_NumPlayersMax = pRoundStatistics->m_NumPlayersMax;
-		m_NumWinners = pRoundStatistics->NumWinners();
-		m_RoundDuration = pRoundStatistics->m_PlayedTicks/pServer->TickSpeed();
-		m_RoundId = -1;
+		if(Score <= 0)
+			return;
+
+		CScoreRow Row;
+		Row.m_ClientID = ClientID;
+		Row.m_UserID = UserID;
+		Row.m_ScoreType = ScoreType;
+		Row.m_Score = Score;
+		m_Rows.push_back(Row);
 	}
 
-	virtual bool Job(CSqlServer* pSqlServer)
+	// the statements don't depend on the connection, so they can be replayed from the journal
+	void GenerateStatements(const char* pPrefix, std::vector<std::string>* pStatements)
 	{
 		char aBuf[512];
-		
-		try
+		char aDate[128];
+		str_format(aDate, sizeof(aDate), "UTC_TIMESTAMP() - INTERVAL (UNIX_TIMESTAMP() - %d) SECOND", m_RoundTime);
+
+		str_format(aBuf, sizeof(aBuf),
+			"INSERT INTO %s_infc_Rounds "
+			"(MapName, NumPlayersMin, NumPlayersMax, NumWinners, RoundDate, RoundDuration) "
+			"VALUES "
+			"('%s', '%d', '%d', '%d', %s, '%d')"
+			, pPrefix, m_sMapName.ClrStr(), m_NumPlayersMin, m_NumPlayersMax, m_NumWinners, aDate, m_RoundDuration);
+		pStatements->push_back(aBuf);
+		pStatements->push_back("SET @RoundId = LAST_INSERT_ID()");
+
+		for(unsigned First = 0; First < m_Rows.size(); First += MAX_ROWS_PER_INSERT)
 		{
-			str_format(aBuf, sizeof(aBuf), 
-				"INSERT INTO %s_infc_Rounds "
-				"(MapName, NumPlayersMin, NumPlayersMax, NumWinners, RoundDate, RoundDuration) "
+			str_format(aBuf, sizeof(aBuf),
+				"INSERT INTO %s_infc_RoundScore "
+				"(UserId, RoundId, MapName, ScoreType, ScoreDate, Score) "
 				"VALUES "
-				"('%s', '%d', '%d', '%d', UTC_TIMESTAMP(), '%d')"
-				, pSqlServer->GetPrefix(), m_sMapName.ClrStr(), m_NumPlayersMin, m_NumPlayersMax, m_NumWinners, m_RoundDuration);
-			pSqlServer->executeSql(aBuf);
-			
-			//Get old score
-			str_format(aBuf, sizeof(aBuf), 
-				"SELECT RoundId FROM %s_infc_Rounds "
-				"WHERE RoundDuration = '%d' AND NumPlayersMin = '%d' AND NumPlayersMax = '%d'"
-				"ORDER BY RoundId DESC LIMIT 1"
-				, pSqlServer->GetPrefix(), m_RoundDuration, m_NumPlayersMin, m_NumPlayersMax);
-			pSqlServer->executeSqlQuery(aBuf);
-			
-			if(pSqlServer->GetResults()->next())
+				, pPrefix);
+			std::string Statement = aBuf;
+
+			unsigned Last = minimum<unsigned>(First + MAX_ROWS_PER_INSERT, m_Rows.size());
+			for(unsigned i = First; i < Last; i++)
 			{
-				m_RoundId = (int)pSqlServer->GetResults()->getInt("RoundId");
+				str_format(aBuf, sizeof(aBuf), "%s('%d', @RoundId, '%s', '%d', %s, '%d')",
+					i == First ? "" : ", ", m_Rows[i].m_UserID, m_sMapName.ClrStr(), m_Rows[i].m_ScoreType, aDate, m_Rows[i].m_Score);
+				Statement += aBuf;
 			}
+			pStatements->push_back(Statement);
+		}
+	}
+
+	static bool ExecuteTransaction(CSqlServer* pSqlServer, const std::vector<std::string>& Statements)
+	{
+		try
+		{
+			pSqlServer->executeSql("START TRANSACTION");
+			for(unsigned i = 0; i < Statements.size(); i++)
+				pSqlServer->executeSql(Statements[i].c_str());
+			pSqlServer->executeSql("COMMIT");
 		}
 		catch (sql::SQLException &e)
 		{
-			dbg_msg("sql", "Can't send round statistics (MySQL Error: %s)", e.what());
-			
+			dbg_msg("sql", "Can't send statistics (MySQL Error: %s)", e.what());
+			try
+			{
+				pSqlServer->executeSql("ROLLBACK");
+			}
+			catch (sql::SQLException &)
+			{
+			}
 			return false;
 		}
-		
+
 		return true;
 	}
-	
-	virtual void* GenerateChildData()
+
+	// Rounds that couldn't be sent earlier, one statement per line. Each round
+	// starts with a "-- round <failures>" line and is sent in its own transaction.
+	static void ReadJournal(const char* pFilename, std::vector<CJournalRound>* pRounds)
 	{
-		return &m_RoundId;
+		IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+		if(!File)
+			return;
+
+		std::string Content(io_length(File), '\0');
+		Content.resize(io_read(File, &Content[0], Content.size()));
+		io_close(File);
+
+		std::istringstream Stream(Content);
+		std::string Line;
+		while(std::getline(Stream, Line))
+		{
+			if(Line.empty())
+				continue;
+
+			// journals written before the round lines hold a single round
+			int Failures = 0;
+			bool NewRound = sscanf(Line.c_str(), "-- round %d", &Failures) == 1;
+			if(NewRound || pRounds->empty())
+			{
+				CJournalRound Round;
+				Round.m_Failures = Failures;
+				pRounds->push_back(Round);
+			}
+			if(!NewRound)
+				pRounds->back().m_Statements.push_back(Line);
+		}
 	}
-};
 
-class CSqlJob_Server_SendPlayerStatistics : public CSqlJob
-{
-private:
-	CServer* m_pServer;
-	int m_ClientID;
-	int m_UserID;
-	int m_RoundId;
-	CSqlString<64> m_sMapName;
-	CRoundStatistics::CPlayer m_PlayerStatistics;
-	
-public:
-	CSqlJob_Server_SendPlayerStatistics(CServer* pServer, const CRoundStatistics::CPlayer* pPlayerStatistics, const char* pMapName, int UserID, int ClientID)
+	static void WriteJournalRound(IOHANDLE File, const CJournalRound& Round)
 	{
-		m_RoundId = -1;
-		m_pServer = pServer;
-		m_ClientID = ClientID;
-		m_UserID = UserID;
-		m_sMapName = CSqlString<64>(pMapName);
-		m_PlayerStatistics = *pPlayerStatistics;
+		char aBuf[64];
+		str_format(aBuf, sizeof(aBuf), "-- round %d", Round.m_Failures);
+		io_write(File, aBuf, str_length(aBuf));
+		io_write_newline(File);
+		for(unsigned i = 0; i < Round.m_Statements.size(); i++)
+		{
+			io_write(File, Round.m_Statements[i].c_str(), Round.m_Statements[i].size());
+			io_write_newline(File);
+		}
 	}
-	
-	virtual void ProcessParentData(void* pData)
+
+	// the table name comes before any value, so only the first placeholder is the prefix
+	static std::string ApplyPrefix(std::string Statement, const char* pPrefix)
 	{
-		int* pRoundId = (int*) pData;
-		m_RoundId = *pRoundId;
+		const std::string Placeholder = JournalPrefix();
+		size_t Pos = Statement.find(Placeholder);
+		if(Pos != std::string::npos)
+			Statement.replace(Pos, Placeholder.size(), pPrefix);
+		return Statement;
 	}
-	
-	void UpdateScore(CSqlServer* pSqlServer, int ScoreType, int Score, const char* pScoreName)
+
+	void ReplayJournal(CSqlServer* pSqlServer)
 	{
-		char aBuf[512];
-		str_format(aBuf, sizeof(aBuf), 
-			"INSERT INTO %s_infc_RoundScore "
-			"(UserId, RoundId, MapName, ScoreType, ScoreDate, Score) "
-			"VALUES ('%d', '%d', '%s', '%d', UTC_TIMESTAMP(), '%d');"
-			, pSqlServer->GetPrefix(), m_UserID, m_RoundId, m_sMapName.ClrStr(), ScoreType, Score);
-		pSqlServer->executeSql(aBuf);
+		lock_wait(m_pServer->m_SqlStatsJournalLock);
+
+		std::vector<CJournalRound> Rounds;
+		if(time_get() >= m_pServer->m_SqlStatsJournalNextReplay)
+			ReadJournal(m_aJournalFile, &Rounds);
+
+		if(!Rounds.empty())
+		{
+			std::vector<CJournalRound> Remaining;
+			std::vector<CJournalRound> Quarantined;
+			for(unsigned i = 0; i < Rounds.size(); i++)
+			{
+				// after a failure the connection may be gone, the later rounds wait for the next replay
+				if(Remaining.empty() && Quarantined.empty())
+				{
+					std::vector<std::string> Statements;
+					for(unsigned s = 0; s < Rounds[i].m_Statements.size(); s++)
+						Statements.push_back(ApplyPrefix(Rounds[i].m_Statements[s], pSqlServer->GetPrefix()));
+					if(ExecuteTransaction(pSqlServer, Statements))
+						continue;
+					Rounds[i].m_Failures++;
+				}
+
+				if(Rounds[i].m_Failures >= MAX_REPLAY_FAILURES)
+					Quarantined.push_back(Rounds[i]);
+				else
+					Remaining.push_back(Rounds[i]);
+			}
+
+			if(!Quarantined.empty())
+			{
+				char aQuarantineFile[MAX_PATH_LENGTH];
+				str_format(aQuarantineFile, sizeof(aQuarantineFile), "%s.failed", m_aJournalFile);
+				IOHANDLE File = io_open(aQuarantineFile, IOFLAG_APPEND);
+				if(File)
+				{
+					for(unsigned i = 0; i < Quarantined.size(); i++)
+						WriteJournalRound(File, Quarantined[i]);
+					io_close(File);
+				}
+				dbg_msg("sql", "%d journaled rounds failed %d times, moved to '%s'", (int)Quarantined.size(), (int)MAX_REPLAY_FAILURES, aQuarantineFile);
+			}
+
+			if(Remaining.empty())
+				fs_remove(m_aJournalFile);
+			else
+			{
+				IOHANDLE File = io_open(m_aJournalFile, IOFLAG_WRITE);
+				if(File)
+				{
+					for(unsigned i = 0; i < Remaining.size(); i++)
+						WriteJournalRound(File, Remaining[i]);
+					io_close(File);
+				}
+			}
+
+			int Replayed = Rounds.size() - Remaining.size() - Quarantined.size();
+			if(Replayed)
+				dbg_msg("sql", "Replayed %d journaled rounds from '%s'", Replayed, m_aJournalFile);
+
+			if(Remaining.empty() && Quarantined.empty())
+				m_pServer->m_SqlStatsJournalFailures = 0;
+			else
+			{
+				int Backoff = REPLAY_BACKOFF_MIN << minimum(m_pServer->m_SqlStatsJournalFailures, 7);
+				m_pServer->m_SqlStatsJournalNextReplay = time_get() + time_freq() * minimum<int>(Backoff, REPLAY_BACKOFF_MAX);
+				m_pServer->m_SqlStatsJournalFailures++;
+			}
+		}
+
+		lock_unlock(m_pServer->m_SqlStatsJournalLock);
 	}
 
-	virtual bool Job(CSqlServer* pSqlServer)
+	void UpdateLeaderboards()
+	{
+		for(unsigned i = 0; i < m_Rows.size(); i++)
+		{
+			CLeaderboardCache::CRoundScore Round;
+			Round.m_UserID = m_Rows[i].m_UserID;
+			Round.m_Score = m_Rows[i].m_Score;
+			str_copy(Round.m_aUsername, m_aaUsernames[m_Rows[i].m_ClientID], sizeof(Round.m_aUsername));
+			m_pServer->m_LeaderboardCache.AddRoundScore(m_sMapName.Str(), m_Rows[i].m_ScoreType, Round);
+			m_pServer->m_LeaderboardCache.AddDailyScore(m_Rows[i].m_ScoreType, Round);
+		}
+	}
+
+	// sum of the best SQL_SCORE_NUMROUND round scores of each player, before and after this round
+	void SendScoreIncrease(CSqlServer* pSqlServer)
 	{
 		char aBuf[512];
-		
-		if(m_RoundId < 0)
-			return false;
-		
-		try
+		std::string UserIDs;
+		for(unsigned i = 0; i < m_Rows.size(); i++)
 		{
-			//Get old score
-			str_format(aBuf, sizeof(aBuf), 
-				"SELECT Score FROM %s_infc_RoundScore "
-				"WHERE UserId = '%d' AND MapName = '%s' AND ScoreType = '%d'"
-				"ORDER BY Score DESC "
-				"LIMIT %d "
-				, pSqlServer->GetPrefix(), m_UserID, m_sMapName.ClrStr(), 0, SQL_SCORE_NUMROUND);
-			pSqlServer->executeSqlQuery(aBuf);
+			if(m_Rows[i].m_ScoreType != SQL_SCORETYPE_ROUND_SCORE)
+				continue;
+			str_format(aBuf, sizeof(aBuf), "%s'%d'", UserIDs.empty() ? "" : ", ", m_Rows[i].m_UserID);
+			UserIDs += aBuf;
+		}
+		if(UserIDs.empty())
+			return;
 
-			int OldScore = 0;
-			while(pSqlServer->GetResults()->next())
+		std::string Query;
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT UserId, Score FROM %s_infc_RoundScore "
+			"WHERE MapName = '%s' AND ScoreType = '%d' AND RoundId <> @RoundId AND UserId IN ("
+			, pSqlServer->GetPrefix(), m_sMapName.ClrStr(), SQL_SCORETYPE_ROUND_SCORE);
+		Query = aBuf;
+		Query += UserIDs;
+		Query += ") ORDER BY UserId, Score DESC";
+		pSqlServer->executeSqlQuery(Query.c_str());
+
+		int aOldScore[MAX_CLIENTS] = {0};
+		int aNumScores[MAX_CLIENTS] = {0};
+		int aLowestScore[MAX_CLIENTS] = {0};
+		while(pSqlServer->GetResults()->next())
+		{
+			int UserID = (int)pSqlServer->GetResults()->getInt("UserId");
+			int Score = (int)pSqlServer->GetResults()->getInt("Score");
+			for(unsigned i = 0; i < m_Rows.size(); i++)
 			{
-				OldScore += (int)pSqlServer->GetResults()->getInt("Score");
-			}
-			
-			if(m_PlayerStatistics.m_Score > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_ROUND_SCORE, m_PlayerStatistics.m_Score, "");
-				
-			if(m_PlayerStatistics.m_EngineerScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_ENGINEER_SCORE, m_PlayerStatistics.m_EngineerScore, "Engineer");
-			if(m_PlayerStatistics.m_SoldierScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_SOLDIER_SCORE, m_PlayerStatistics.m_SoldierScore, "Soldier");
-			if(m_PlayerStatistics.m_ScientistScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_SCIENTIST_SCORE, m_PlayerStatistics.m_ScientistScore, "Scientist");
-			if(m_PlayerStatistics.m_BiologistScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_BIOLOGIST_SCORE, m_PlayerStatistics.m_BiologistScore, "Biologist");
-			if(m_PlayerStatistics.m_LooperScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_LOOPER_SCORE, m_PlayerStatistics.m_LooperScore, "Looper");
-			if(m_PlayerStatistics.m_MedicScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_MEDIC_SCORE, m_PlayerStatistics.m_MedicScore, "Medic");
-			if(m_PlayerStatistics.m_HeroScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_HERO_SCORE, m_PlayerStatistics.m_HeroScore, "Hero");
-			if(m_PlayerStatistics.m_NinjaScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_NINJA_SCORE, m_PlayerStatistics.m_NinjaScore, "Ninja");
-			if(m_PlayerStatistics.m_MercenaryScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_MERCENARY_SCORE, m_PlayerStatistics.m_MercenaryScore, "Mercenary");
-			if(m_PlayerStatistics.m_SniperScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_SNIPER_SCORE, m_PlayerStatistics.m_SniperScore, "Sniper");
-				
-			if(m_PlayerStatistics.m_SmokerScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_SMOKER_SCORE, m_PlayerStatistics.m_SmokerScore, "Smoker");
-			if(m_PlayerStatistics.m_HunterScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_HUNTER_SCORE, m_PlayerStatistics.m_HunterScore, "Hunter");
-			if(m_PlayerStatistics.m_BoomerScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_BOOMER_SCORE, m_PlayerStatistics.m_BoomerScore, "Boomer");
-			if(m_PlayerStatistics.m_GhostScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_GHOST_SCORE, m_PlayerStatistics.m_GhostScore, "Ghost");
-			if(m_PlayerStatistics.m_SpiderScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_SPIDER_SCORE, m_PlayerStatistics.m_SpiderScore, "Spider");
-			if(m_PlayerStatistics.m_GhoulScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_GHOUL_SCORE, m_PlayerStatistics.m_GhoulScore, "Ghoul");
-			if(m_PlayerStatistics.m_SlugScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_SLUG_SCORE, m_PlayerStatistics.m_SlugScore, "Slug");
-			if(m_PlayerStatistics.m_UndeadScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_UNDEAD_SCORE, m_PlayerStatistics.m_UndeadScore, "Undead");
-			if(m_PlayerStatistics.m_WitchScore > 0)
-				UpdateScore(pSqlServer, SQL_SCORETYPE_WITCH_SCORE, m_PlayerStatistics.m_WitchScore, "Witch");
-		
-			//Get new score
-			str_format(aBuf, sizeof(aBuf), 
-				"SELECT Score FROM %s_infc_RoundScore "
-				"WHERE UserId = '%d' AND MapName = '%s' AND ScoreType = '%d'"
-				"ORDER BY Score DESC "
-				"LIMIT %d "
-				, pSqlServer->GetPrefix(), m_UserID, m_sMapName.ClrStr(), 0, SQL_SCORE_NUMROUND);
-			pSqlServer->executeSqlQuery(aBuf);
+				if(m_Rows[i].m_ScoreType != SQL_SCORETYPE_ROUND_SCORE || m_Rows[i].m_UserID != UserID)
+					continue;
 
-			int NewScore = 0;
-			if(pSqlServer->GetResults()->next())
-			{
-				NewScore += (int)pSqlServer->GetResults()->getInt("Score");
+				// results are sorted, the first ones are the best
+				int ClientID = m_Rows[i].m_ClientID;
+				if(aNumScores[ClientID] < SQL_SCORE_NUMROUND)
+				{
+					aOldScore[ClientID] += Score;
+					aLowestScore[ClientID] = Score;
+					aNumScores[ClientID]++;
+				}
 			}
-			
-			if(OldScore < NewScore)
+		}
+
+		for(unsigned i = 0; i < m_Rows.size(); i++)
+		{
+			if(m_Rows[i].m_ScoreType != SQL_SCORETYPE_ROUND_SCORE)
+				continue;
+
+			int ClientID = m_Rows[i].m_ClientID;
+			int NewScore = aOldScore[ClientID];
+			if(aNumScores[ClientID] < SQL_SCORE_NUMROUND)
+				NewScore += m_Rows[i].m_Score;
+			else if(m_Rows[i].m_Score > aLowestScore[ClientID])
+				NewScore += m_Rows[i].m_Score - aLowestScore[ClientID];
+
+			if(aOldScore[ClientID] < NewScore)
 			{
-				str_format(aBuf, sizeof(aBuf), "You increased your score: +%d", (NewScore-OldScore)/10);
-				CServer::CGameServerCmd* pCmd = new CGameServerCmd_SendChatTarget(m_ClientID, aBuf);
+				str_format(aBuf, sizeof(aBuf), "You increased your score: +%d", (NewScore-aOldScore[ClientID])/10);
+				CServer::CGameServerCmd* pCmd = new CGameServerCmd_SendChatTarget(ClientID, aBuf);
 				m_pServer->AddGameServerCmd(pCmd);
 			}
 		}
+	}
+
+public:
+	CSqlJob_Server_SendStatistics(CServer* pServer, const CRoundStatistics* pRoundStatistics, const char* pMapName, const char* pJournalFile)
+	{
+		m_pServer = pServer;
+		m_sMapName = CSqlString<64>(pMapName);
+		m_NumPlayersMin = pRoundStatistics->m_NumPlayersMin;
+		m_NumPlayersMax = pRoundStatistics->m_NumPlayersMax;
+		m_NumWinners = pRoundStatistics->NumWinners();
+		m_RoundDuration = pRoundStatistics->m_PlayedTicks/pServer->TickSpeed();
+		m_RoundTime = time_timestamp();
+		str_copy(m_aJournalFile, pJournalFile, sizeof(m_aJournalFile));
+	}
+
+	void AddPlayer(const CRoundStatistics::CPlayer* pPlayer, int UserID, int ClientID, const char* pUsername)
+	{
+		str_copy(m_aaUsernames[ClientID], pUsername, sizeof(m_aaUsernames[ClientID]));
+
+		AddScore(ClientID, UserID, SQL_SCORETYPE_ROUND_SCORE, pPlayer->m_Score);
+
+		AddScore(ClientID, UserID, SQL_SCORETYPE_ENGINEER_SCORE, pPlayer->m_EngineerScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_SOLDIER_SCORE, pPlayer->m_SoldierScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_SCIENTIST_SCORE, pPlayer->m_ScientistScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_BIOLOGIST_SCORE, pPlayer->m_BiologistScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_LOOPER_SCORE, pPlayer->m_LooperScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_MEDIC_SCORE, pPlayer->m_MedicScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_HERO_SCORE, pPlayer->m_HeroScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_NINJA_SCORE, pPlayer->m_NinjaScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_MERCENARY_SCORE, pPlayer->m_MercenaryScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_SNIPER_SCORE, pPlayer->m_SniperScore);
+
+		AddScore(ClientID, UserID, SQL_SCORETYPE_SMOKER_SCORE, pPlayer->m_SmokerScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_HUNTER_SCORE, pPlayer->m_HunterScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_BOOMER_SCORE, pPlayer->m_BoomerScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_GHOST_SCORE, pPlayer->m_GhostScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_SPIDER_SCORE, pPlayer->m_SpiderScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_GHOUL_SCORE, pPlayer->m_GhoulScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_SLUG_SCORE, pPlayer->m_SlugScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_UNDEAD_SCORE, pPlayer->m_UndeadScore);
+		AddScore(ClientID, UserID, SQL_SCORETYPE_WITCH_SCORE, pPlayer->m_WitchScore);
+	}
+
+	virtual bool Job(CSqlServer* pSqlServer)
+	{
+		ReplayJournal(pSqlServer);
+
+		std::vector<std::string> Statements;
+		GenerateStatements(pSqlServer->GetPrefix(), &Statements);
+
+		// don't insist on a connection that failed, the next server is tried instead
+		if(!ExecuteTransaction(pSqlServer, Statements))
+			return false;
+
+		UpdateLeaderboards();
+
+		try
+		{
+			SendScoreIncrease(pSqlServer);
+		}
 		catch (sql::SQLException &e)
 		{
-			dbg_msg("sql", "Can't send player statistics (MySQL Error: %s)", e.what());
-			
-			return false;
+			dbg_msg("sql", "Can't get player scores (MySQL Error: %s)", e.what());
 		}
-		
 		return true;
 	}
+
+	virtual void OnFailure()
+	{
+		std::vector<std::string> Statements;
+		GenerateStatements(JournalPrefix(), &Statements);
+
+		CJournalRound Round;
+		Round.m_Failures = 0;
+		Round.m_Statements.swap(Statements);
+
+		lock_wait(m_pServer->m_SqlStatsJournalLock);
+		IOHANDLE File = io_open(m_aJournalFile, IOFLAG_APPEND);
+		if(File && g_Config.m_InfSqlStatsJournalMaxSize && io_length(File) >= (int64)g_Config.m_InfSqlStatsJournalMaxSize * 1024)
+		{
+			io_close(File);
+			dbg_msg("sql", "No sql server reachable and '%s' is full, round statistics lost", m_aJournalFile);
+		}
+		else if(File)
+		{
+			WriteJournalRound(File, Round);
+			io_close(File);
+			dbg_msg("sql", "No sql server reachable, round statistics saved to '%s'", m_aJournalFile);
+		}
+		else
+			dbg_msg("sql", "No sql server reachable, round statistics lost");
+		lock_unlock(m_pServer->m_SqlStatsJournalLock);
+	}
 };
 #endif
 
 void CServer::SendStatistics()
 {
 #ifdef CONF_SQL
-	//Send round statistics
-	CSqlJob* pRoundJob = new CSqlJob_Server_SendRoundStatistics(this, RoundStatistics(), m_aCurrentMap);
-	pRoundJob->Start();
-	
-	//Send player statistics
+	// without a database to write to, the job would only fill the journal
+	bool HasWriteServer = false;
+	for(int i = 0; i < MAX_SQLSERVERS; i++)
+		HasWriteServer = HasWriteServer || m_apSqlWriteServers[i];
+	if(!HasWriteServer)
+		return;
+
+	char aJournalFile[MAX_PATH_LENGTH];
+	Storage()->GetCompletePath(IStorage::TYPE_SAVE, g_Config.m_InfSqlStatsJournal, aJournalFile, sizeof(aJournalFile));
+
+	//Send round and player statistics in one batch
+	CSqlJob_Server_SendStatistics* pJob = new CSqlJob_Server_SendStatistics(this, RoundStatistics(), m_aCurrentMap, aJournalFile);
 	for(int i=0; i<MAX_CLIENTS; i++)
 	{
 		if(m_aClients[i].m_State == CClient::STATE_INGAME)
 		{
 			if(m_aClients[i].m_UserID >= 0 && RoundStatistics()->IsValidePlayer(i))
-			{
-				CSqlJob* pJob = new CSqlJob_Server_SendPlayerStatistics(this, RoundStatistics()->PlayerStatistics(i), m_aCurrentMap, m_aClients[i].m_UserID, i);
-				pRoundJob->AddQueuedJob(pJob);
-			}
+				pJob->AddPlayer(RoundStatistics()->PlayerStatistics(i), m_aClients[i].m_UserID, i, m_aClients[i].m_aUsername);
 		}
 	}
+	pJob->Start();
 #endif
 }
 
@@ -8,17 +8,23 @@
 
 #include <engine/masterserver.h>
 #include <engine/server.h>
+#include <engine/server/accountsessions.h>
+#include <engine/server/leaderboard.h>
 #include <engine/server/netsession.h>
 #include <engine/server/register.h>
 #include <engine/server/roundstatistics.h>
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
+#include <engine/shared/lockfree.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/snapshot.h>
 #include <game/server/classes.h>
 #include <game/voting.h>
 
+#include <string>
+#include <unordered_map>
+
 /* DDNET MODIFICATION START *******************************************/
 #include "sql_connector.h"
 #include "sql_server.h"
@@ -89,6 +95,9 @@ class CServer : public IServer
 #ifdef CONF_SQL
 	CSqlServer* m_apSqlReadServers[MAX_SQLSERVERS];
 	CSqlServer* m_apSqlWriteServers[MAX_SQLSERVERS];
+	// the tables are created once Run() begins, after a fork of the instances
+	bool m_SqlSetupStarted;
+	void StartSqlSetup();
 #endif
 /* DDNET MODIFICATION END *********************************************/
 public:
@@ -116,7 +125,9 @@ public:
 
 			SNAPRATE_INIT=0,
 			SNAPRATE_FULL,
-			SNAPRATE_RECOVER
+			SNAPRATE_RECOVER,
+
+			INPUT_RING_SIZE=200,
 		};
 
 		class CInput
@@ -138,8 +149,26 @@ public:
 		CSnapshotStorage m_Snapshots;
 
 		CInput m_LatestInput;
-		CInput m_aInputs[200]; // TODO: handle input better
-		int m_CurrentInput;
+		CInput m_aInputs[INPUT_RING_SIZE]; // indexed by the game tick of the input
+		CInput *InputSlot(int GameTick) { return &m_aInputs[GameTick%INPUT_RING_SIZE]; }
+
+		// how many ms before their tick the inputs arrive, averaged over the last inputs
+		float m_InputMargin;
+		float m_InputJitter;
+		float m_InputLateRatio; // inputs that missed their tick
+		void UpdateInputTiming(int Margin, bool Late);
+
+		// snapshots that were over budget and the items left out of them
+		int m_SnapOverflows;
+		int m_SnapDroppedItems;
+
+		// adaptive snapshot rate, counted in snapshot periods
+		int m_SnapInterval;
+		int m_SnapCountdown;
+		int m_SnapCleanSnaps; // snapshots sent since the last congestion
+		int m_SnapBackoffTick;
+		int m_SnapResends;
+		float m_SnapBytes; // average compressed snapshot size
 
 		char m_aName[MAX_NAME_LENGTH];
 		char m_aClan[MAX_CLAN_LENGTH];
@@ -170,6 +199,8 @@ public:
 		int m_UserID;
 #ifdef CONF_SQL
 		int m_UserLevel;
+		// logged in again from an account session, the player is told on entering the game
+		bool m_AccountRestored;
 #endif
 		char m_aUsername[MAX_NAME_LENGTH];
 
@@ -184,6 +215,10 @@ public:
 
 		int m_InfClassVersion;
 		bool m_CustClt;
+
+		// the trimmed name this client has in m_NameCounts
+		bool m_HasNameKey;
+		char m_aNameKey[MAX_NAME_LENGTH];
 	};
 
 	CClient m_aClients[MAX_CLIENTS];
@@ -212,10 +247,13 @@ public:
 	char m_aPreviousMap[64];
 	char m_aCurrentMap[64];
 	char m_aShutdownReason[128];
+	// map loaded before the instances are forked, taken by the first LoadMap
+	char m_aPreloadedMap[128];
 	SHA256_DIGEST m_CurrentMapSha256;
 	unsigned m_CurrentMapCrc;
 	unsigned char *m_pCurrentMapData;
 	unsigned int m_CurrentMapSize;
+	bool m_CurrentMapMapped;
 
 	bool m_ServerInfoHighLoad;
 	int64 m_ServerInfoFirstRequest;
@@ -226,9 +264,33 @@ public:
 
 	int m_RconRestrict;
 
+	class CMetricHistogram *m_pTickDurationMetric;
+	class CMetricHistogram *m_pMapConversionMetric;
+	class CMetricCounter *m_pSnapshotBytesMetric;
+	class CMetricCounter *m_pSnapshotDroppedItemsMetric;
+	class CMetricGauge *m_apClientSnapshotBytesMetrics[MAX_CLIENTS];
+	class CMetricGauge *m_pClientsMetric;
+	class CMetricGauge *m_pGameServerCmdsMetric;
+	class CMetricHistogram *m_pGameServerCmdLatencyMetric;
+	class CMetricCounter *m_apNetworkMetrics[4];
+	class CMetricGauge *m_apMemoryMetrics[NUM_MEMTAGS];
+
 	CServer();
 	virtual ~CServer();
 
+	// Names shown for the ready clients, so a name collision is one lookup.
+	// Logins finish on other threads, they only request a rebuild and a
+	// collision check that the next tick does.
+	std::unordered_map<std::string, int> m_NameCounts;
+	volatile int m_NameSetDirty;
+	volatile int m_NameCheckPending;
+
+	void RequestNameCheck() { m_NameSetDirty = 1; m_NameCheckPending = 1; }
+	void UpdateNameKey(int ClientID);
+	void UpdateNameSet();
+	bool IsNameTaken(int ClientID, const char *pName);
+	void CheckNameCollisions();
+
 	int TrySetClientName(int ClientID, const char *pName);
 
 	virtual void SetClientName(int ClientID, const char *pName);
@@ -264,6 +326,9 @@ public:
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
 
 	void DoSnapshot();
+	void UpdateSnapRate(int ClientID, int SnapshotSize);
+	void RegisterMetrics();
+	void UpdateMetrics();
 
 	static int ClientRejoinCallback(int ClientID, void *pUser);
 	static int NewClientCallback(int ClientID, void *pUser);
@@ -292,6 +357,8 @@ public:
 	void ChangeMap(const char *pMap) override;
 	char *GetMapName();
 	int LoadMap(const char *pMapName);
+	void PreloadMap(const char *pMapName);
+	void FreeCurrentMapData();
 
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole);
 	int Run();
@@ -304,6 +371,7 @@ public:
 	static bool ConRecord(IConsole::IResult *pResult, void *pUser);
 	static bool ConStopRecord(IConsole::IResult *pResult, void *pUser);
 	static bool ConMapReload(IConsole::IResult *pResult, void *pUser);
+	static bool ConMemory(IConsole::IResult *pResult, void *pUser);
 	static bool ConLogout(IConsole::IResult *pResult, void *pUser);
 	static bool ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static bool ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -318,6 +386,7 @@ public:
 #ifdef CONF_SQL
 	static bool ConAddSqlServer(IConsole::IResult *pResult, void *pUserData);
 	static bool ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData);
+	static bool ConLeaderboardCacheStats(IConsole::IResult *pResult, void *pUserData);
 
 	static void CreateTablesThread(void *pData);
 #endif
@@ -333,6 +402,7 @@ public:
 	virtual int SnapNewID();
 	virtual void SnapFreeID(int ID);
 	virtual void *SnapNewItem(int Type, int ID, int Size);
+	virtual void SnapSetPriority(int Class, float Distance);
 	void SnapSetStaticsize(int ItemType, int Size);
 	
 /* INFECTION MODIFICATION START ***************************************/
@@ -405,8 +475,15 @@ public:
 	class CGameServerCmd
 	{
 	public:
+		// created by the sql threads for every result, taken from a pool rather than the heap
+		void *operator new(size_t Size);
+		void operator delete(void *pPtr);
+
 		virtual ~CGameServerCmd() {};
 		virtual void Execute(IGameServer* pGameServer) = 0;
+
+		CGameServerCmd *m_pQueueNext;
+		int64 m_EnqueueTime;
 	};
 
 private:
@@ -419,12 +496,24 @@ private:
 	
 #ifdef CONF_SQL
 public:
-	array<CGameServerCmd*> m_lGameServerCmds;
-	LOCK m_GameServerCmdLock;
+	CMpscQueue<CGameServerCmd> m_GameServerCmds;
 	LOCK m_ChallengeLock;
+	LOCK m_SqlStatsJournalLock;
+	// replays that failed in a row and when the next one may run, protected by the journal lock
+	int m_SqlStatsJournalFailures;
+	int64 m_SqlStatsJournalNextReplay;
+	CLeaderboardCache m_LeaderboardCache;
 	char m_aChallengeWinner[16];
 	int64 m_ChallengeRefreshTick;
 	int m_ChallengeType;
+
+	void RequestLeaderboard(int ScoreType, int Type, int ClientID, int DailyScoreType);
+	void AnswerLeaderboardRequest(const char* pMapName, int ScoreType, const CLeaderboardCache::CRequest& Request);
+
+	CAccountSessions m_AccountSessions;
+
+	void SaveAccountSession(int ClientID);
+	void RestoreAccountSession(int ClientID);
 #endif
 	int m_LastRegistrationRequestId = 0;
 
@@ -1,6 +1,14 @@
 #ifdef CONF_SQL
+#include <engine/shared/metrics.h>
+
 #include "sql_job.h"
 
+static CMetricGauge *QueuedJobsMetric()
+{
+	static CMetricGauge *s_pMetric = g_Metrics.RegisterGauge("infclass_sql_jobs", "Sql jobs started and not finished yet");
+	return s_pMetric;
+}
+
 CSqlJob::~CSqlJob()
 {
 	
@@ -14,6 +22,7 @@ void CSqlJob::StartReadOnly()
 void CSqlJob::Start(bool ReadOnly)
 {
 	m_ReadOnly = ReadOnly;
+	QueuedJobsMetric()->Add(1);
 	
 	void *registerThread = thread_init(CSqlJob::Exec, this);
 	thread_detach(registerThread);
@@ -28,6 +37,10 @@ void CSqlJob::Exec(void* pDataSelf)
 {
 	CSqlJob* pSelf = (CSqlJob*) pDataSelf;
 	
+	static const int64 s_aDurationBounds[] = {1, 5, 10, 25, 50, 100, 250, 500, 1000, 5000};
+	static CMetricHistogram *s_pDurationMetric = g_Metrics.RegisterHistogram("infclass_sql_job_duration_seconds", "Time from the start of a sql job to its end, connection included", s_aDurationBounds, sizeof(s_aDurationBounds)/sizeof(s_aDurationBounds[0]), 1e-3);
+	int64 StartTime = time_get();
+	
 	CSqlConnector connector;
 
 	bool Success = false;
@@ -41,9 +54,15 @@ void CSqlJob::Exec(void* pDataSelf)
 		// disconnect from databaseserver
 		connector.SqlServer()->Disconnect();
 	}
+
+	if(!Success)
+		pSelf->OnFailure();
 	
 	pSelf->CleanInstanceRef();
 	
+	s_pDurationMetric->Observe((time_get() - StartTime) * 1000 / time_freq());
+	QueuedJobsMetric()->Add(-1);
+	
 	for(int i=0; i<pSelf->m_QueuedJobs.size(); i++)
 	{
 		pSelf->m_QueuedJobs[i]->ProcessParentData(pSelf->GenerateChildData());
@@ -16,6 +16,10 @@ public:
 	array<CSqlJob*> m_QueuedJobs;
 	
 public:
+	// counted, so jobs that are never deleted show up in the memory report
+	void *operator new(size_t Size) { return mem_alloc_tagged(MEMTAG_SQL, Size); }
+	void operator delete(void *pPtr) { mem_free_tagged(pPtr); }
+	
 	virtual ~CSqlJob();
 
 	void StartReadOnly();
@@ -27,6 +31,8 @@ public:
 	virtual void ProcessParentData(void* pData) {};
 	
 	virtual bool Job(CSqlServer* pSqlServer) = 0;
+	// called when no sql server could complete the job
+	virtual void OnFailure() {}
 	virtual void CleanInstanceRef() {}
 	
 	int GetInstance() { return m_Instance; }
@@ -67,6 +67,7 @@ public:
 	const char* GetPass() { return m_aPass; }
 	const char* GetIP() { return m_aIp; }
 	int GetPort() { return m_Port; }
+	bool GetSetUpDb() { return m_SetUpDB; }
 
 	void Lock() { lock_wait(m_SqlLock); }
 	void UnLock() { lock_unlock(m_SqlLock); }
@@ -17,9 +17,13 @@ MACRO_CONFIG_STR(Bindaddr, bindaddr, 128, "", CFGFLAG_SERVER|CFGFLAG_MASTER, "Ad
 MACRO_CONFIG_INT(SvPort, sv_port, 8303, 0, 0, CFGFLAG_SERVER, "Port to use for the server")
 MACRO_CONFIG_INT(SvExternalPort, sv_external_port, 0, 0, 0, CFGFLAG_SERVER, "External port to report to the master servers")
 MACRO_CONFIG_STR(SvMap, sv_map, 128, "", CFGFLAG_SERVER, "Map to use on the server")
+MACRO_CONFIG_INT(SvMapLoadThreads, sv_map_load_threads, 4, 1, 16, CFGFLAG_SERVER, "Number of threads decompressing the map data when a map is loaded")
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, 64, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
+MACRO_CONFIG_INT(SvSnapAdaptive, sv_snap_adaptive, 1, 0, 1, CFGFLAG_SERVER, "Send fewer snapshots to clients whose connection is congested")
+MACRO_CONFIG_INT(SvSnapMaxInterval, sv_snap_max_interval, 5, 1, 25, CFGFLAG_SERVER, "Largest number of snapshot periods between two snapshots to a congested client")
+MACRO_CONFIG_INT(SvSnapMaxRate, sv_snap_max_rate, 0, 0, 10000, CFGFLAG_SERVER, "Snapshot bandwidth per client in KiB/s, the snapshot rate is lowered above it (0 for no limit)")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SERVER, "Remote console password (full access)")
 MACRO_CONFIG_STR(SvRconModPassword, sv_rcon_mod_password, 32, "", CFGFLAG_SERVER, "Remote console password for moderators (limited access)")
@@ -39,6 +43,9 @@ MACRO_CONFIG_INT(EcBantime, ec_bantime, 0, 0, 1440, CFGFLAG_ECON, "The time a cl
 MACRO_CONFIG_INT(EcAuthTimeout, ec_auth_timeout, 30, 1, 120, CFGFLAG_ECON, "Time in seconds before the the econ authentification times out")
 MACRO_CONFIG_INT(EcOutputLevel, ec_output_level, 1, 0, 2, CFGFLAG_ECON, "Adjusts the amount of information in the external console")
 
+MACRO_CONFIG_STR(SvMetricsBindaddr, sv_metrics_bindaddr, 128, "localhost", CFGFLAG_SERVER, "Address to bind the metrics endpoint to")
+MACRO_CONFIG_INT(SvMetricsPort, sv_metrics_port, 0, 0, 0, CFGFLAG_SERVER, "Port of the Prometheus metrics endpoint (0 to disable)")
+
 MACRO_CONFIG_INT(Debug, debug, 0, 0, 1, CFGFLAG_SERVER, "Debug mode")
 MACRO_CONFIG_INT(DbgStress, dbg_stress, 0, 0, 0, CFGFLAG_SERVER, "Stress systems")
 MACRO_CONFIG_INT(DbgStressNetwork, dbg_stress_network, 0, 0, 0, CFGFLAG_SERVER, "Stress network")
@@ -114,10 +114,6 @@ int CConsole::ParseArgs(CResult *pResult, const char *pFormat)
 					break;
 				}
 
-				while(Command)
-				{
-					Command = NextParam(pFormat);
-				}
 				break;
 			}
 
@@ -174,7 +170,7 @@ int CConsole::ParseArgs(CResult *pResult, const char *pFormat)
 				}
 			}
 		}
-		Command = NextParam(pFormat);
+		Command = *++pFormat;
 	}
 
 	return Error;
@@ -208,6 +204,17 @@ char CConsole::NextParam(const char *&pFormat)
 }
 /* DDNET MODIFICATION END *********************************************/
 
+void CConsole::CompileArgFormat(const char *pParams, char *pFormat, int FormatSize)
+{
+	int Length = 0;
+	for(char Command = *pParams; Command; Command = NextParam(pParams))
+	{
+		dbg_assert(Length < FormatSize-1, "too many command arguments");
+		pFormat[Length++] = Command;
+	}
+	pFormat[Length] = 0;
+}
+
 int CConsole::RegisterPrintCallback(int OutputLevel, FPrintCallback pfnPrintCallback, void *pUserData)
 {
 	if(m_NumPrintCB == MAX_PRINT_CB)
@@ -278,7 +285,7 @@ bool CConsole::LineIsValid(const char *pStr)
 			return false;
 
 		CCommand *pCommand = FindCommand(Result.m_pCommand, m_FlagMask);
-		if(!pCommand || ParseArgs(&Result, pCommand->m_pParams))
+		if(!pCommand || ParseArgs(&Result, pCommand->m_aArgFormat))
 			return false;
 
 		pStr = pNextPart;
@@ -328,6 +335,13 @@ void CConsole::ExecuteLineStroked(int Stroke, const char *pStr, int ClientID, bo
 		if(!*Result.m_pCommand)
 			return;
 
+		// only stroke commands do anything on release
+		if(!Stroke && Result.m_pCommand[0] != '+')
+		{
+			pStr = pNextPart;
+			continue;
+		}
+
 		CCommand *pCommand = FindCommand(Result.m_pCommand, m_FlagMask);
 
 		if(pCommand)
@@ -344,7 +358,7 @@ void CConsole::ExecuteLineStroked(int Stroke, const char *pStr, int ClientID, bo
 
 				if(Stroke || IsStrokeCommand)
 				{
-					if(ParseArgs(&Result, pCommand->m_pParams))
+					if(ParseArgs(&Result, pCommand->m_aArgFormat))
 					{
 						char aBuf[256];
 						
@@ -407,7 +421,7 @@ void CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPoss
 
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandNameHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask)
 		{
@@ -858,6 +872,7 @@ CConsole::CConsole(int FlagMask)
 	m_paStrokeStr[1] = "1";
 	m_ExecutionQueue.Reset();
 	m_pFirstCommand = 0;
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
 	m_pFirstExec = 0;
 	mem_zero(m_aPrintCB, sizeof(m_aPrintCB));
 	m_NumPrintCB = 0;
@@ -933,14 +948,50 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 	}
 }
 
+unsigned CConsole::CommandNameHash(const char *pName)
+{
+	// has to agree with str_comp_nocase, so only fold ascii
+	unsigned Hash = 5381;
+	for(; *pName; pName++)
+	{
+		unsigned char c = *pName;
+		if(c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		Hash = ((Hash << 5) + Hash) + c;
+	}
+	return Hash & COMMAND_HASH_MASK;
+}
+
+void CConsole::AddCommandHashed(CCommand *pCommand)
+{
+	// keep the order of the sorted list, so lookups find the same command
+	CCommand **ppSlot = &m_apCommandHash[CommandNameHash(pCommand->m_pName)];
+	while(*ppSlot && str_comp(pCommand->m_pName, (*ppSlot)->m_pName) > 0)
+		ppSlot = &(*ppSlot)->m_pNextHash;
+	pCommand->m_pNextHash = *ppSlot;
+	*ppSlot = pCommand;
+}
+
+void CConsole::RemoveCommandHashed(CCommand *pCommand)
+{
+	for(CCommand **ppSlot = &m_apCommandHash[CommandNameHash(pCommand->m_pName)]; *ppSlot; ppSlot = &(*ppSlot)->m_pNextHash)
+	{
+		if(*ppSlot == pCommand)
+		{
+			*ppSlot = pCommand->m_pNextHash;
+			break;
+		}
+	}
+	pCommand->m_pNextHash = 0;
+}
+
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
+	AddCommandHashed(pCommand);
+
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
-		if(m_pFirstCommand && m_pFirstCommand->m_pNext)
-			pCommand->m_pNext = m_pFirstCommand;
-		else
-			pCommand->m_pNext = 0;
+		pCommand->m_pNext = m_pFirstCommand;
 		m_pFirstCommand = pCommand;
 	}
 	else
@@ -1058,6 +1109,7 @@ void CConsole::Register(const char *pName, const char *pParams,
 	GenerateUsage(pParams, pCommand->m_pUsage);
 	pCommand->m_pHelp = pHelp;
 	pCommand->m_pParams = pParams;
+	CompileArgFormat(pParams, pCommand->m_aArgFormat, sizeof(pCommand->m_aArgFormat));
 
 	pCommand->m_Flags = Flags;
 	pCommand->m_Temp = false;
@@ -1101,6 +1153,8 @@ void CConsole::RegisterTemp(const char *pName, const char *pParams,	int Flags, c
 		pCommand->m_pParams = pMem;
 	}
 
+	CompileArgFormat(pCommand->m_pParams, pCommand->m_aArgFormat, sizeof(pCommand->m_aArgFormat));
+
 	pCommand->m_pfnCallback = 0;
 	pCommand->m_pUserData = 0;
 	pCommand->m_Flags = Flags;
@@ -1136,6 +1190,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandHashed(pRemoved);
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -1143,6 +1198,18 @@ void CConsole::DeregisterTemp(const char *pName)
 
 void CConsole::DeregisterTempAll()
 {
+	for(int i = 0; i < COMMAND_HASH_SIZE; i++)
+	{
+		CCommand **ppSlot = &m_apCommandHash[i];
+		while(*ppSlot)
+		{
+			if((*ppSlot)->m_Temp)
+				*ppSlot = (*ppSlot)->m_pNextHash;
+			else
+				ppSlot = &(*ppSlot)->m_pNextHash;
+		}
+	}
+
 	// set non temp as first one
 	for(; m_pFirstCommand && m_pFirstCommand->m_Temp; m_pFirstCommand = m_pFirstCommand->m_pNext);
 
@@ -1208,7 +1275,7 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandNameHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp)
 		{
@@ -11,11 +11,19 @@ class CConsole : public IConsole
 	class CCommand : public CCommandInfo
 	{
 	public:
+		enum
+		{
+			MAX_ARG_FORMAT_LENGTH = 32,
+		};
+
 		CCommand *m_pNext;
+		CCommand *m_pNextHash;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
 		void *m_pUserData;
+		// m_pParams reduced to one type character per argument
+		char m_aArgFormat[MAX_ARG_FORMAT_LENGTH];
 
 		virtual const CCommandInfo *NextCommandInfo(int AccessLevel, int FlagMask) const;
 
@@ -32,10 +40,18 @@ class CConsole : public IConsole
 		void *m_pUserData;
 	};
 
+	enum
+	{
+		COMMAND_HASH_SIZE = 1024,
+		COMMAND_HASH_MASK = COMMAND_HASH_SIZE - 1,
+	};
+
 	int m_FlagMask;
 	bool m_StoreCommands;
 	const char *m_paStrokeStr[2];
 	CCommand *m_pFirstCommand;
+	// case insensitive index over m_pFirstCommand, same order within a bucket
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
 
 	class CExecFile
 	{
@@ -133,6 +149,7 @@ class CConsole : public IConsole
 	int ParseArgs(CResult *pResult, const char *pFormat);
 
 	char NextParam(const char *&pFormat);
+	void CompileArgFormat(const char *pParams, char *pFormat, int FormatSize);
 	
 	void GenerateUsage(const char* pParam, char* pUsage);
 	
@@ -167,7 +184,10 @@ class CConsole : public IConsole
 		}
 	} m_ExecutionQueue;
 
+	static unsigned CommandNameHash(const char *pName);
 	void AddCommandSorted(CCommand *pCommand);
+	void AddCommandHashed(CCommand *pCommand);
+	void RemoveCommandHashed(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
 public:
@@ -3,6 +3,9 @@
 
 #include "datafile.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <base/hash_ctxt.h>
 #include <base/math.h>
 #include <base/system.h>
@@ -111,22 +114,83 @@ struct CDatafile
 	int m_DataStartOffset;
 	char **m_ppDataPtrs;
 	char *m_pData;
+
+	// the whole file when it is mapped, data pointers into it must not be freed
+	char *m_pMapped;
+	unsigned m_MappedSize;
 };
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+static bool IsMappedData(const CDatafile *pDataFile, const char *pData)
+{
+	return pDataFile->m_pMapped && pData >= pDataFile->m_pMapped && pData < pDataFile->m_pMapped + pDataFile->m_MappedSize;
+}
+
+// every offset and size read from the file has to stay inside of it, the data
+// blocks are used straight from the mapping
+static bool CheckLayout(const CDatafile *pDataFile, int64 FileSize)
+{
+	const CDatafileHeader *pHeader = &pDataFile->m_Header;
+	const CDatafileInfo *pInfo = &pDataFile->m_Info;
+	if((int64)pDataFile->m_DataStartOffset + pHeader->m_DataSize > FileSize)
+		return false;
+
+	for(int i = 0; i < pHeader->m_NumItemTypes; i++)
+	{
+		const CDatafileItemType *pType = &pInfo->m_pItemTypes[i];
+		if(pType->m_Start < 0 || pType->m_Num < 0 || (int64)pType->m_Start + pType->m_Num > pHeader->m_NumItems)
+			return false;
+	}
+
+	for(int i = 0; i < pHeader->m_NumItems; i++)
+	{
+		int End = i == pHeader->m_NumItems - 1 ? pHeader->m_ItemSize : pInfo->m_pItemOffsets[i + 1];
+		if(pInfo->m_pItemOffsets[i] < 0 || (int64)pInfo->m_pItemOffsets[i] + (int64)sizeof(CDatafileItem) > End || End > pHeader->m_ItemSize)
+			return false;
+	}
+
+	for(int i = 0; i < pHeader->m_NumRawData; i++)
+	{
+		int End = i == pHeader->m_NumRawData - 1 ? pHeader->m_DataSize : pInfo->m_pDataOffsets[i + 1];
+		if(pInfo->m_pDataOffsets[i] < 0 || pInfo->m_pDataOffsets[i] > End || End > pHeader->m_DataSize)
+			return false;
+		if(pHeader->m_Version == 4 && pInfo->m_pDataSizes[i] < 0)
+			return false;
+	}
+	return true;
+}
+
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, int Flags)
 {
 	dbg_msg("datafile", "loading. filename='%s'", pFilename);
 
-	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	char aPath[MAX_PATH_LENGTH];
+	IOHANDLE File = pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType, aPath, sizeof(aPath));
 	if(!File)
 	{
 		dbg_msg("datafile", "could not open '%s'", pFilename);
 		return false;
 	}
+	if(StorageType == IStorage::TYPE_ABSOLUTE)
+		str_copy(aPath, pFilename, sizeof(aPath));
+
+	char *pMapped = 0;
+	unsigned MappedSize = 0;
+	if(Flags & OPENFLAG_MAP)
+	{
+		pMapped = (char *)io_map_file(aPath, &MappedSize);
+		if(!pMapped)
+			dbg_msg("datafile", "could not map '%s', reading it instead", aPath);
+	}
 
 	// take the CRC of the file and store it
 	unsigned Crc = 0;
 	SHA256_DIGEST Sha256;
+	if(pMapped)
+	{
+		Crc = crc32(Crc, (const Bytef *)pMapped, MappedSize); // ignore_convention
+		Sha256 = sha256(pMapped, MappedSize);
+	}
+	else
 	{
 		enum
 		{
@@ -149,12 +213,16 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 		io_seek(File, 0, IOSEEK_START);
 	}
+	int64 FileSize = pMapped ? MappedSize : io_length(File);
 
 	// TODO: change this header
 	CDatafileHeader Header;
 	if(sizeof(Header) != io_read(File, &Header, sizeof(Header)))
 	{
 		dbg_msg("datafile", "couldn't load header");
+		io_close(File);
+		if(pMapped)
+			io_unmap_file(pMapped, MappedSize);
 		return 0;
 	}
 	if(Header.m_aID[0] != 'A' || Header.m_aID[1] != 'T' || Header.m_aID[2] != 'A' || Header.m_aID[3] != 'D')
@@ -162,6 +230,9 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		if(Header.m_aID[0] != 'D' || Header.m_aID[1] != 'A' || Header.m_aID[2] != 'T' || Header.m_aID[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aID[0], Header.m_aID[1], Header.m_aID[2], Header.m_aID[3]);
+			io_close(File);
+			if(pMapped)
+				io_unmap_file(pMapped, MappedSize);
 			return 0;
 		}
 	}
@@ -172,16 +243,31 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		io_close(File);
+		if(pMapped)
+			io_unmap_file(pMapped, MappedSize);
 		return 0;
 	}
 
 	// read in the rest except the data
-	unsigned Size = 0;
-	Size += Header.m_NumItemTypes * sizeof(CDatafileItemType);
-	Size += (Header.m_NumItems + Header.m_NumRawData) * sizeof(int);
-	if(Header.m_Version == 4)
-		Size += Header.m_NumRawData * sizeof(int); // v4 has uncompressed data sizes as well
-	Size += Header.m_ItemSize;
+	int64 HeaderSize = -1;
+	if(Header.m_NumItemTypes >= 0 && Header.m_NumItems >= 0 && Header.m_NumRawData >= 0 && Header.m_ItemSize >= 0 && Header.m_DataSize >= 0)
+	{
+		HeaderSize = (int64)Header.m_NumItemTypes * sizeof(CDatafileItemType);
+		HeaderSize += ((int64)Header.m_NumItems + Header.m_NumRawData) * sizeof(int);
+		if(Header.m_Version == 4)
+			HeaderSize += (int64)Header.m_NumRawData * sizeof(int); // v4 has uncompressed data sizes as well
+		HeaderSize += Header.m_ItemSize;
+	}
+	if(HeaderSize < 0 || (int64)sizeof(Header) + HeaderSize > FileSize)
+	{
+		dbg_msg("datafile", "header doesn't fit into the file");
+		io_close(File);
+		if(pMapped)
+			io_unmap_file(pMapped, MappedSize);
+		return false;
+	}
+	unsigned Size = HeaderSize;
 
 	unsigned AllocSize = Size;
 	AllocSize += sizeof(CDatafile); // add space for info structure
@@ -195,6 +281,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_Sha256 = Sha256;
 	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_pMapped = pMapped;
+	pTmpDataFile->m_MappedSize = MappedSize;
 
 	// clear the data pointers
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData * sizeof(void *));
@@ -204,6 +292,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(ReadSize != Size)
 	{
 		io_close(pTmpDataFile->m_File);
+		if(pMapped)
+			io_unmap_file(pMapped, MappedSize);
 		free(pTmpDataFile);
 		pTmpDataFile = 0;
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
@@ -236,6 +326,13 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		m_pDataFile->m_Info.m_pItemStart = (char *)&m_pDataFile->m_Info.m_pDataOffsets[m_pDataFile->m_Header.m_NumRawData];
 	m_pDataFile->m_Info.m_pDataStart = m_pDataFile->m_Info.m_pItemStart + m_pDataFile->m_Header.m_ItemSize;
 
+	if(!CheckLayout(m_pDataFile, FileSize))
+	{
+		dbg_msg("datafile", "offsets or sizes point outside of the file, it is truncated or corrupt");
+		Close();
+		return false;
+	}
+
 	dbg_msg("datafile", "loading done. datafile='%s'", pFilename);
 
 	if(DEBUG)
@@ -313,6 +410,23 @@ int CDataFileReader::GetDataSize(int Index)
 		return GetFileDataSize(Index);
 }
 
+static char *UncompressData(const CDatafile *pDataFile, int Index, const char *pCompressed, int CompressedSize, unsigned long *pSize)
+{
+	unsigned long UncompressedSize = pDataFile->m_Info.m_pDataSizes[Index];
+	char *pData = (char *)mem_alloc_tagged(MEMTAG_DATAFILE, UncompressedSize);
+
+	*pSize = UncompressedSize;
+	int Result = uncompress((Bytef *)pData, pSize, (const Bytef *)pCompressed, CompressedSize); // ignore_convention
+	if(Result != Z_OK || *pSize != UncompressedSize)
+	{
+		dbg_msg("datafile", "couldn't uncompress data index=%d error=%d size=%lu expected=%lu", Index, Result, *pSize, UncompressedSize);
+		mem_free_tagged(pData);
+		*pSize = 0;
+		return 0;
+	}
+	return pData;
+}
+
 void *CDataFileReader::GetDataImpl(int Index, int Swap)
 {
 	if(!m_pDataFile)
@@ -328,6 +442,9 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 	{
 		// fetch the data size
 		int DataSize = GetFileDataSize(Index);
+		const char *pFileData = 0;
+		if(m_pDataFile->m_pMapped)
+			pFileData = m_pDataFile->m_pMapped + m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index];
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		int SwapSize = DataSize;
 #endif
@@ -335,38 +452,56 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 		if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
-			void *pTemp = malloc(DataSize);
-			unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
 			unsigned long s;
+			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, m_pDataFile->m_Info.m_pDataSizes[Index]);
 
-			dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%lu", Index, DataSize, UncompressedSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
-
-			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
-
-			// decompress the data, TODO: check for errors
-			s = UncompressedSize;
-			uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &s, (Bytef *)pTemp, DataSize); // ignore_convention
+			if(pFileData)
+				m_pDataFile->m_ppDataPtrs[Index] = UncompressData(m_pDataFile, Index, pFileData, DataSize, &s);
+			else
+			{
+				// read the compressed data
+				void *pTemp = malloc(DataSize);
+				io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
+				if(io_read(m_pDataFile->m_File, pTemp, DataSize) == (unsigned)DataSize)
+					m_pDataFile->m_ppDataPtrs[Index] = UncompressData(m_pDataFile, Index, (const char *)pTemp, DataSize, &s);
+				else
+					s = 0;
+
+				// clean up the temporary buffers
+				free(pTemp);
+			}
 #if defined(CONF_ARCH_ENDIAN_BIG)
 			SwapSize = s;
 #endif
-
-			// clean up the temporary buffers
-			free(pTemp);
 		}
+#if !defined(CONF_ARCH_ENDIAN_BIG)
+		else if(pFileData)
+		{
+			// uncompressed data can be used straight from the mapping, it is copy-on-write so callers may still modify it
+			m_pDataFile->m_ppDataPtrs[Index] = (char *)pFileData;
+		}
+#endif
 		else
 		{
 			// load the data
 			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(DataSize);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc_tagged(MEMTAG_DATAFILE, DataSize);
+			if(pFileData)
+				mem_copy(m_pDataFile->m_ppDataPtrs[Index], pFileData, DataSize);
+			else
+			{
+				io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
+				if(io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize) != (unsigned)DataSize)
+				{
+					dbg_msg("datafile", "couldn't read data index=%d", Index);
+					mem_free_tagged(m_pDataFile->m_ppDataPtrs[Index]);
+					m_pDataFile->m_ppDataPtrs[Index] = 0;
+				}
+			}
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
-		if(Swap && SwapSize)
+		if(Swap && SwapSize && m_pDataFile->m_ppDataPtrs[Index])
 			swap_endian(m_pDataFile->m_ppDataPtrs[Index], sizeof(int), SwapSize / sizeof(int));
 #endif
 	}
@@ -374,6 +509,106 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 	return m_pDataFile->m_ppDataPtrs[Index];
 }
 
+struct CDataLoadJob
+{
+	CDatafile *m_pDataFile;
+	std::vector<int> m_lIndices;
+	unsigned m_Next;
+	LOCK m_Lock;
+};
+
+static void DataLoadThread(void *pUser)
+{
+	CDataLoadJob *pJob = (CDataLoadJob *)pUser;
+	CDatafile *pDataFile = pJob->m_pDataFile;
+	while(1)
+	{
+		lock_wait(pJob->m_Lock);
+		unsigned Next = pJob->m_Next++;
+		lock_unlock(pJob->m_Lock);
+		if(Next >= pJob->m_lIndices.size())
+			break;
+
+		// every block is handled by exactly one thread, so the data pointers can be written without locking
+		int Index = pJob->m_lIndices[Next];
+		int Size;
+		if(Index == pDataFile->m_Header.m_NumRawData - 1)
+			Size = pDataFile->m_Header.m_DataSize - pDataFile->m_Info.m_pDataOffsets[Index];
+		else
+			Size = pDataFile->m_Info.m_pDataOffsets[Index + 1] - pDataFile->m_Info.m_pDataOffsets[Index];
+		unsigned long s;
+		pDataFile->m_ppDataPtrs[Index] = UncompressData(pDataFile, Index, pDataFile->m_pMapped + pDataFile->m_DataStartOffset + pDataFile->m_Info.m_pDataOffsets[Index], Size, &s);
+	}
+}
+
+bool CDataFileReader::LoadData(const int *pIndices, int NumIndices, int NumThreads)
+{
+	if(!m_pDataFile)
+		return false;
+	if(!pIndices)
+		NumIndices = m_pDataFile->m_Header.m_NumRawData;
+
+	// blocks that are read from the file or need swapping are loaded the usual way
+#if !defined(CONF_ARCH_ENDIAN_BIG)
+	if(m_pDataFile->m_pMapped && m_pDataFile->m_Header.m_Version == 4)
+	{
+		int64 StartTime = time_get();
+
+		CDataLoadJob Job;
+		Job.m_pDataFile = m_pDataFile;
+		Job.m_Next = 0;
+		int64 TotalSize = 0;
+		for(int i = 0; i < NumIndices; i++)
+		{
+			int Index = pIndices ? pIndices[i] : i;
+			if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData || m_pDataFile->m_ppDataPtrs[Index])
+				continue;
+			if(std::find(Job.m_lIndices.begin(), Job.m_lIndices.end(), Index) != Job.m_lIndices.end())
+				continue;
+			Job.m_lIndices.push_back(Index);
+			TotalSize += m_pDataFile->m_Info.m_pDataSizes[Index];
+		}
+		if(Job.m_lIndices.empty())
+			return true;
+
+		// largest blocks first so the threads finish at about the same time
+		const int *pSizes = m_pDataFile->m_Info.m_pDataSizes;
+		std::sort(Job.m_lIndices.begin(), Job.m_lIndices.end(), [pSizes](int a, int b) { return pSizes[a] > pSizes[b]; });
+
+		NumThreads = clamp(NumThreads, 1, (int)Job.m_lIndices.size());
+		Job.m_Lock = lock_create();
+		std::vector<void *> lThreads;
+		for(int i = 1; i < NumThreads; i++)
+		{
+			void *pThread = thread_init(DataLoadThread, &Job, "datafile load");
+			if(pThread)
+				lThreads.push_back(pThread);
+		}
+		DataLoadThread(&Job);
+		for(unsigned i = 0; i < lThreads.size(); i++)
+			thread_wait(lThreads[i]);
+		lock_destroy(Job.m_Lock);
+
+		dbg_msg("datafile", "loaded %d data blocks (%lld bytes) in %.2fms using %d threads", (int)Job.m_lIndices.size(), TotalSize, (time_get() - StartTime) * 1000.0 / time_freq(), (int)lThreads.size() + 1);
+		for(unsigned i = 0; i < Job.m_lIndices.size(); i++)
+		{
+			if(!m_pDataFile->m_ppDataPtrs[Job.m_lIndices[i]])
+				return false;
+		}
+		return true;
+	}
+#endif
+
+	bool Success = true;
+	for(int i = 0; i < NumIndices; i++)
+	{
+		int Index = pIndices ? pIndices[i] : i;
+		if(Index >= 0 && Index < m_pDataFile->m_Header.m_NumRawData && !GetDataImpl(Index, 0))
+			Success = false;
+	}
+	return Success;
+}
+
 void *CDataFileReader::GetData(int Index)
 {
 	return GetDataImpl(Index, 0);
@@ -390,7 +625,8 @@ void CDataFileReader::UnloadData(int Index)
 		return;
 
 	//
-	free(m_pDataFile->m_ppDataPtrs[Index]);
+	if(!IsMappedData(m_pDataFile, m_pDataFile->m_ppDataPtrs[Index]))
+		mem_free_tagged(m_pDataFile->m_ppDataPtrs[Index]);
 	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
 }
 
@@ -533,8 +769,13 @@ bool CDataFileReader::Close()
 	// free the data that is loaded
 	int i;
 	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
-		free(m_pDataFile->m_ppDataPtrs[i]);
+	{
+		if(!IsMappedData(m_pDataFile, m_pDataFile->m_ppDataPtrs[i]))
+			mem_free_tagged(m_pDataFile->m_ppDataPtrs[i]);
+	}
 
+	if(m_pDataFile->m_pMapped)
+		io_unmap_file(m_pDataFile->m_pMapped, m_pDataFile->m_MappedSize);
 	io_close(m_pDataFile->m_File);
 	free(m_pDataFile);
 	m_pDataFile = 0;
@@ -579,6 +820,7 @@ IOHANDLE CDataFileReader::File()
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_NumCompressionThreads = 1;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(calloc(MAX_ITEM_TYPES, sizeof(CItemTypeInfo)));
 	m_pItems = static_cast<CItemInfo *>(calloc(MAX_ITEMS, sizeof(CItemInfo)));
 	m_pDatas = static_cast<CDataInfo *>(calloc(MAX_DATAS, sizeof(CDataInfo)));
@@ -592,8 +834,12 @@ CDataFileWriter::~CDataFileWriter()
 		if(m_pItems[i].m_pData)
 			free(m_pItems[i].m_pData);
 	for(int i = 0; i < m_NumDatas; ++i)
+	{
 		if(m_pDatas[i].m_pCompressedData)
 			free(m_pDatas[i].m_pCompressedData);
+		if(m_pDatas[i].m_pUncompressedData)
+			free(m_pDatas[i].m_pUncompressedData);
+	}
 	free(m_pItems);
 	m_pItems = 0;
 	free(m_pDatas);
@@ -689,26 +935,43 @@ int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 	return m_NumItems - 1;
 }
 
-int CDataFileWriter::AddData(int Size, void *pData, int CompressionLevel)
+void CDataFileWriter::CompressData(CDataInfo *pInfo, const void *pData)
 {
-	dbg_assert(m_NumDatas < 1024, "too much data");
-
-	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
+	unsigned long s = compressBound(pInfo->m_UncompressedSize);
 	void *pCompData = malloc(s); // temporary buffer that we use during compression
 
-	int Result = compress2((Bytef *)pCompData, &s, (Bytef *)pData, Size, CompressionLevel); // ignore_convention
+	int Result = compress2((Bytef *)pCompData, &s, (const Bytef *)pData, pInfo->m_UncompressedSize, pInfo->m_CompressionLevel); // ignore_convention
 	if(Result != Z_OK)
 	{
 		dbg_msg("datafile", "compression error %d", Result);
 		dbg_assert(0, "zlib error");
 	}
 
-	pInfo->m_UncompressedSize = Size;
 	pInfo->m_CompressedSize = (int)s;
 	pInfo->m_pCompressedData = malloc(pInfo->m_CompressedSize);
 	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
 	free(pCompData);
+}
+
+int CDataFileWriter::AddData(int Size, void *pData, int CompressionLevel)
+{
+	dbg_assert(m_NumDatas < 1024, "too much data");
+
+	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
+	pInfo->m_UncompressedSize = Size;
+	pInfo->m_CompressionLevel = CompressionLevel;
+	pInfo->m_CompressedSize = 0;
+	pInfo->m_pCompressedData = 0;
+	pInfo->m_pUncompressedData = 0;
+
+	if(m_NumCompressionThreads > 1)
+	{
+		// compressed in Finish together with the other blocks
+		pInfo->m_pUncompressedData = malloc(Size);
+		mem_copy(pInfo->m_pUncompressedData, pData, Size);
+	}
+	else
+		CompressData(pInfo, pData);
 
 	m_NumDatas++;
 	return m_NumDatas - 1;
@@ -730,11 +993,70 @@ int CDataFileWriter::AddDataSwapped(int Size, void *pData)
 #endif
 }
 
+struct CDataFileWriter::CCompressionJob
+{
+	CDataInfo *m_pDatas;
+	std::vector<int> m_lIndices;
+	unsigned m_Next;
+	LOCK m_Lock;
+};
+
+void CDataFileWriter::CompressionThread(void *pUser)
+{
+	CCompressionJob *pJob = (CCompressionJob *)pUser;
+	while(1)
+	{
+		lock_wait(pJob->m_Lock);
+		unsigned Next = pJob->m_Next++;
+		lock_unlock(pJob->m_Lock);
+		if(Next >= pJob->m_lIndices.size())
+			break;
+
+		CDataInfo *pInfo = &pJob->m_pDatas[pJob->m_lIndices[Next]];
+		CompressData(pInfo, pInfo->m_pUncompressedData);
+		free(pInfo->m_pUncompressedData);
+		pInfo->m_pUncompressedData = 0;
+	}
+}
+
 int CDataFileWriter::Finish()
 {
 	if(!m_File)
 		return 1;
 
+	// compress the deferred blocks, each one on its own so the result doesn't depend on the threads
+	{
+		CCompressionJob Job;
+		Job.m_pDatas = m_pDatas;
+		Job.m_Next = 0;
+		for(int i = 0; i < m_NumDatas; i++)
+		{
+			if(m_pDatas[i].m_pUncompressedData)
+				Job.m_lIndices.push_back(i);
+		}
+
+		if(!Job.m_lIndices.empty())
+		{
+			// largest blocks first so the threads finish at about the same time
+			const CDataInfo *pDatas = m_pDatas;
+			std::sort(Job.m_lIndices.begin(), Job.m_lIndices.end(), [pDatas](int a, int b) { return pDatas[a].m_UncompressedSize > pDatas[b].m_UncompressedSize; });
+
+			int NumThreads = clamp(m_NumCompressionThreads, 1, (int)Job.m_lIndices.size());
+			Job.m_Lock = lock_create();
+			std::vector<void *> lThreads;
+			for(int i = 1; i < NumThreads; i++)
+			{
+				void *pThread = thread_init(CompressionThread, &Job, "datafile compression");
+				if(pThread)
+					lThreads.push_back(pThread);
+			}
+			CompressionThread(&Job);
+			for(unsigned i = 0; i < lThreads.size(); i++)
+				thread_wait(lThreads[i]);
+			lock_destroy(Job.m_Lock);
+		}
+	}
+
 	int ItemSize = 0;
 	int TypesSize, HeaderSize, OffsetSize, FileSize, SwapSize;
 	int DataSize = 0;
@@ -26,15 +26,26 @@ class CDataFileReader
 	int GetInternalItemType(int ExternalType);
 
 public:
+	enum
+	{
+		// map the whole file into memory instead of reading blocks on demand
+		OPENFLAG_MAP = 1,
+	};
+
 	CDataFileReader() :
 		m_pDataFile(0) {}
 	~CDataFileReader() { Close(); }
 
 	bool IsOpen() const { return m_pDataFile != 0; }
 
-	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, int Flags = 0);
 	bool Close();
 
+	// loads the given data blocks (all of them if pIndices is 0) up front,
+	// decompressing them on several threads when the file is mapped, false
+	// if one of them couldn't be loaded
+	bool LoadData(const int *pIndices, int NumIndices, int NumThreads);
+
 	void *GetData(int Index);
 	void *GetDataSwapped(int Index); // makes sure that the data is 32bit LE ints when saved
 	int GetDataSize(int Index);
@@ -62,8 +73,14 @@ class CDataFileWriter
 		int m_UncompressedSize;
 		int m_CompressedSize;
 		void *m_pCompressedData;
+
+		// kept until Finish when compressing on several threads
+		void *m_pUncompressedData;
+		int m_CompressionLevel;
 	};
 
+	struct CCompressionJob;
+
 	struct CItemInfo
 	{
 		int m_Type;
@@ -98,15 +115,21 @@ class CDataFileWriter
 	CItemInfo *m_pItems;
 	CDataInfo *m_pDatas;
 	int m_aExtendedItemTypes[MAX_EXTENDED_ITEM_TYPES];
+	int m_NumCompressionThreads;
 
 	int GetExtendedItemTypeIndex(int Type);
 
+	static void CompressData(CDataInfo *pInfo, const void *pData);
+	static void CompressionThread(void *pUser);
+
 public:
 	CDataFileWriter();
 	~CDataFileWriter();
 	void Init();
 	bool OpenFile(class IStorage *pStorage, const char *pFilename, int StorageType = IStorage::TYPE_SAVE);
 	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType = IStorage::TYPE_SAVE);
+	// compress the data blocks on several threads in Finish, the file stays the same
+	void SetCompressionThreads(int NumThreads) { m_NumCompressionThreads = NumThreads < 1 ? 1 : NumThreads; }
 	int AddData(int Size, void *pData, int CompressionLevel = Z_DEFAULT_COMPRESSION);
 	int AddDataSwapped(int Size, void *pData);
 	int AddItem(int Type, int ID, int Size, void *pData);
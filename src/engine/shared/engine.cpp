@@ -66,8 +66,6 @@ public:
 		net_init();
 		CNetBase::Init();
 
-		m_JobPool.Init(1);
-
 		m_Logging = false;
 	}
 
@@ -89,6 +87,11 @@ public:
 			dbg_logger_file(g_Config.m_Logfile);
 	}
 
+	void InitJobs()
+	{
+		m_JobPool.Init(1);
+	}
+
 	void HostLookup(CHostLookup *pLookup, const char *pHostname, int Nettype)
 	{
 		str_copy(pLookup->m_aHostname, pHostname, sizeof(pLookup->m_aHostname));
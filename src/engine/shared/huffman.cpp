@@ -94,108 +94,113 @@ void CHuffman::ConstructTree(const unsigned *pFrequencies)
 	Setbits_r(m_pStartNode, 0, 0);
 }
 
-void CHuffman::Init(const unsigned *pFrequencies)
+void CHuffman::ConstructDecodeLut()
 {
-	int i;
-
-	// make sure to cleanout every thing
-	mem_zero(this, sizeof(*this));
-
-	// construct the tree
-	ConstructTree(pFrequencies);
+	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
 
-	// build decode LUT
-	for(i = 0; i < HUFFMAN_LUTSIZE; i++)
+	for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
 	{
+		CDecodeEntry *pEntry = &m_aDecodeLut[i];
+		const CNode *pNode = m_pStartNode;
 		unsigned Bits = i;
-		int k;
-		CNode *pNode = m_pStartNode;
-		for(k = 0; k < HUFFMAN_LUTBITS; k++)
+
+		for(int k = 0; k < HUFFMAN_LUTBITS; k++)
 		{
 			pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
 			Bits >>= 1;
 
-			if(!pNode)
-				break;
+			if(!pNode->m_NumBits)
+				continue;
 
-			if(pNode->m_NumBits)
+			// a complete symbol, take it and start over at the root
+			pEntry->m_NumBits = k+1;
+			if(pNode == pEof)
 			{
-				m_apDecodeLut[i] = pNode;
+				pEntry->m_Eof = 1;
 				break;
 			}
+			pEntry->m_aSymbols[pEntry->m_NumSymbols++] = pNode->m_Symbol;
+			pNode = m_pStartNode;
 		}
 
-		if(k == HUFFMAN_LUTBITS)
-			m_apDecodeLut[i] = pNode;
+		// the first symbol is longer than the lut, remember where to continue
+		if(!pEntry->m_NumSymbols && !pEntry->m_Eof)
+		{
+			pEntry->m_Node = pNode - m_aNodes;
+			pEntry->m_NumBits = HUFFMAN_LUTBITS;
+		}
 	}
+}
 
+void CHuffman::Init(const unsigned *pFrequencies)
+{
+	// make sure to cleanout every thing
+	mem_zero(this, sizeof(*this));
+
+	// construct the tree
+	ConstructTree(pFrequencies);
+
+	// build decode LUT
+	ConstructDecodeLut();
 }
 
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-	Bitcount += m_aNodes[Sym].m_NumBits;
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	while(Bitcount >= 8) \
-	{ \
-		*pDst++ = (unsigned char)(Bits&0xff); \
-		if(pDst == pDstEnd) \
-			return -1; \
-		Bits >>= 8; \
-		Bitcount -= 8; \
-	}
-
 	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
-	// symbol variables
-	unsigned Bits = 0;
+	// the trailing byte below is always written
+	if(OutputSize <= 0)
+		return -1;
+
+	// symbol variables, collect up to 32 bits before writing them out at once
+	uint64 Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	while(pSrc != pSrcEnd)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
+		const CNode *pNode = &m_aNodes[*pSrc++];
+		Bits |= (uint64)pNode->m_Bits << Bitcount;
+		Bitcount += pNode->m_NumBits;
 
-		while(pSrc != pSrcEnd)
+		if(Bitcount >= 32)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE()
+			// the last byte of the output is reserved for the trailing bits
+			if(pDstEnd - pDst <= 4)
+				return -1;
+			pDst[0] = (unsigned char)Bits;
+			pDst[1] = (unsigned char)(Bits>>8);
+			pDst[2] = (unsigned char)(Bits>>16);
+			pDst[3] = (unsigned char)(Bits>>24);
+			pDst += 4;
+			Bits >>= 32;
+			Bitcount -= 32;
 		}
-
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-		HUFFMAN_MACRO_WRITE()
 	}
 
 	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL)
-	HUFFMAN_MACRO_WRITE()
+	Bits |= (uint64)m_aNodes[HUFFMAN_EOF_SYMBOL].m_Bits << Bitcount;
+	Bitcount += m_aNodes[HUFFMAN_EOF_SYMBOL].m_NumBits;
+
+	// write out the remaining full bytes
+	if(pDstEnd - pDst <= (int)(Bitcount/8))
+		return -1;
+	while(Bitcount >= 8)
+	{
+		*pDst++ = (unsigned char)Bits;
+		Bits >>= 8;
+		Bitcount -= 8;
+	}
 
 	// write out the last bits
-	*pDst++ = Bits;
+	*pDst++ = (unsigned char)Bits;
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
-
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
 }
 
 //***************************************************************
@@ -203,72 +208,77 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
-
-	unsigned Bits = 0;
-	unsigned Bitcount = 0;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
-	CNode *pNode = 0;
+	// once the input is used up, the bits are padded with zeros and the
+	// bitcount goes negative
+	uint64 Bits = 0;
+	int Bitcount = 0;
 
 	while(1)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		pNode = 0;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits&HUFFMAN_LUTMASK];
-
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
+		// {A} fill with new bits
+		while(Bitcount <= 56 && pSrc != pSrcEnd)
 		{
-			Bits |= (*pSrc++) << Bitcount;
+			Bits |= (uint64)(*pSrc++) << Bitcount;
 			Bitcount += 8;
 		}
 
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits&HUFFMAN_LUTMASK];
+		// {B} look up all symbols the lut resolves at once
+		const CDecodeEntry *pEntry = &m_aDecodeLut[Bits&HUFFMAN_LUTMASK];
+		Bits >>= pEntry->m_NumBits;
+		Bitcount -= pEntry->m_NumBits;
 
-		if(!pNode)
-			return -1;
-
-		// {D} check if we hit a symbol already
-		if(pNode->m_NumBits)
+		if(pEntry->m_NumSymbols || pEntry->m_Eof)
 		{
-			// remove the bits for that symbol
-			Bits >>= pNode->m_NumBits;
-			Bitcount -= pNode->m_NumBits;
+			// output characters, copy the whole entry if there is enough room
+			if(pDstEnd - pDst >= HUFFMAN_LUT_MAXSYMBOLS)
+				mem_copy(pDst, pEntry->m_aSymbols, HUFFMAN_LUT_MAXSYMBOLS);
+			else if(pDstEnd - pDst >= pEntry->m_NumSymbols)
+				mem_copy(pDst, pEntry->m_aSymbols, pEntry->m_NumSymbols);
+			else
+				return -1;
+			pDst += pEntry->m_NumSymbols;
+
+			// check for eof
+			if(pEntry->m_Eof)
+				break;
+			continue;
 		}
-		else
-		{
-			// remove the bits that the lut checked up for us
-			Bits >>= HUFFMAN_LUTBITS;
-			Bitcount -= HUFFMAN_LUTBITS;
 
-			// walk the tree bit by bit
-			while(1)
+		// {C} walk the tree bit by bit for symbols longer than the lut
+		const CNode *pNode = &m_aNodes[pEntry->m_Node];
+		while(1)
+		{
+			if(Bitcount == 0 && pSrc != pSrcEnd)
 			{
-				// traverse tree
-				pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
+				while(Bitcount <= 56 && pSrc != pSrcEnd)
+				{
+					Bits |= (uint64)(*pSrc++) << Bitcount;
+					Bitcount += 8;
+				}
+			}
 
-				// remove bit
-				Bitcount--;
-				Bits >>= 1;
+			// traverse tree
+			pNode = &m_aNodes[pNode->m_aLeafs[Bits&1]];
 
-				// check if we hit a symbol
-				if(pNode->m_NumBits)
-					break;
+			// remove bit
+			Bitcount--;
+			Bits >>= 1;
 
-				// no more bits, decoding error
-				if(Bitcount == 0)
-					return -1;
-			}
+			// check if we hit a symbol
+			if(pNode->m_NumBits)
+				break;
+
+			// no more bits, decoding error
+			if(Bitcount == 0 && pSrc == pSrcEnd)
+				return -1;
 		}
 
 		// check for eof
-		if(pNode == pEof)
+		if(pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
 			break;
 
 		// output character
@@ -16,7 +16,10 @@ class CHuffman
 
 		HUFFMAN_LUTBITS = 10,
 		HUFFMAN_LUTSIZE = (1<<HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1),
+
+		// every symbol takes at least one bit, so a lut entry can't resolve more than that
+		HUFFMAN_LUT_MAXSYMBOLS = HUFFMAN_LUTBITS,
 	};
 
 	struct CNode
@@ -32,13 +35,27 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
+	// all the symbols that are fully contained in the lut bits of an index
+	struct CDecodeEntry
+	{
+		// node to continue walking the tree from, if not even one symbol fits into the lut bits
+		unsigned short m_Node;
+		// number of bits taken by the decoded symbols
+		unsigned char m_NumBits;
+		unsigned char m_NumSymbols;
+		// set if the eof symbol follows the decoded symbols
+		unsigned char m_Eof;
+		unsigned char m_aSymbols[HUFFMAN_LUT_MAXSYMBOLS];
+	};
+
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
-	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CDecodeEntry m_aDecodeLut[HUFFMAN_LUTSIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
 
 	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
 	void ConstructTree(const unsigned *pFrequencies);
+	void ConstructDecodeLut();
 
 public:
 	/*
@@ -68,6 +85,10 @@ public:
 
 		Returns:
 			Returns the size of the compressed data. Negative value on failure.
+
+		Remarks:
+			- Fails as soon as the compressed data doesn't fit into output_size,
+			  pass input_size-1 to only get a result when compression saves space.
 	*/
 	int Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize);
 
@@ -0,0 +1,110 @@
+#ifndef ENGINE_SHARED_LOCKFREE_H
+#define ENGINE_SHARED_LOCKFREE_H
+
+#include <base/system.h>
+
+#include <atomic>
+
+// Queue of items pushed by any thread and taken by a single one. The items
+// are linked through their m_pQueueNext member, so pushing never allocates.
+template<typename T>
+class CMpscQueue
+{
+	// newest first, PopAll() puts them back in order
+	std::atomic<T *> m_pHead;
+
+public:
+	CMpscQueue() : m_pHead(nullptr) {}
+
+	void Push(T *pItem)
+	{
+		T *pHead = m_pHead.load(std::memory_order_relaxed);
+		do
+		{
+			pItem->m_pQueueNext = pHead;
+		} while(!m_pHead.compare_exchange_weak(pHead, pItem, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	// for the consumer, takes all the items pushed so far, oldest first
+	T *PopAll()
+	{
+		T *pItem = m_pHead.exchange(nullptr, std::memory_order_acquire);
+		T *pFirst = nullptr;
+		while(pItem)
+		{
+			T *pNext = pItem->m_pQueueNext;
+			pItem->m_pQueueNext = pFirst;
+			pFirst = pItem;
+			pItem = pNext;
+		}
+		return pFirst;
+	}
+
+	bool Empty() const { return m_pHead.load(std::memory_order_relaxed) == nullptr; }
+};
+
+// Fixed blocks that any thread can take and give back without a lock. The
+// head of the free list carries a counter next to the block index, so a
+// block taken and given back during a concurrent Alloc() can't corrupt it.
+template<int BLOCK_SIZE, int NUM_BLOCKS>
+class CBlockPool
+{
+	enum
+	{
+		INDEX_NONE=-1,
+	};
+
+	struct CBlock
+	{
+		alignas(16) unsigned char m_aData[BLOCK_SIZE];
+	};
+
+	CBlock m_aBlocks[NUM_BLOCKS];
+	std::atomic<int> m_aNext[NUM_BLOCKS];
+	// counter in the high half, index of the first free block in the low half
+	std::atomic<uint64> m_Head;
+
+	static uint64 MakeHead(uint64 Head, int Index) { return (((Head >> 32) + 1) << 32) | (unsigned)Index; }
+
+public:
+	CBlockPool()
+	{
+		for(int i = 0; i < NUM_BLOCKS; i++)
+			m_aNext[i].store(i + 1 < NUM_BLOCKS ? i + 1 : (int)INDEX_NONE, std::memory_order_relaxed);
+		m_Head.store(0, std::memory_order_release);
+	}
+
+	int BlockSize() const { return BLOCK_SIZE; }
+
+	// 0 once all the blocks are in use
+	void *Alloc()
+	{
+		uint64 Head = m_Head.load(std::memory_order_acquire);
+		while(true)
+		{
+			int Index = (int)(unsigned)(Head & 0xffffffffu);
+			if(Index == INDEX_NONE)
+				return 0;
+			int Next = m_aNext[Index].load(std::memory_order_relaxed);
+			if(m_Head.compare_exchange_weak(Head, MakeHead(Head, Next), std::memory_order_acquire, std::memory_order_acquire))
+				return m_aBlocks[Index].m_aData;
+		}
+	}
+
+	bool Owns(const void *pPtr) const
+	{
+		return pPtr >= (const void *)&m_aBlocks[0] && pPtr < (const void *)&m_aBlocks[NUM_BLOCKS];
+	}
+
+	void Free(void *pPtr)
+	{
+		int Index = (CBlock *)pPtr - m_aBlocks;
+		uint64 Head = m_Head.load(std::memory_order_relaxed);
+		do
+		{
+			m_aNext[Index].store((int)(unsigned)(Head & 0xffffffffu), std::memory_order_relaxed);
+		} while(!m_Head.compare_exchange_weak(Head, MakeHead(Head, Index), std::memory_order_release, std::memory_order_relaxed));
+	}
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <base/system.h>
 #include <engine/map.h>
 #include <engine/storage.h>
+#include "config.h"
 #include "datafile.h"
 
 class CMap : public IEngineMap
@@ -30,7 +31,16 @@ public:
 		IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
 		if(!pStorage)
 			return false;
-		return m_DataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL);
+		if(!m_DataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL, CDataFileReader::OPENFLAG_MAP))
+			return false;
+
+		// collision, zones and the map converter go through nearly every block right after loading
+		if(!m_DataFile.LoadData(0, 0, g_Config.m_SvMapLoadThreads))
+		{
+			m_DataFile.Close();
+			return false;
+		}
+		return true;
 	}
 
 	virtual bool IsLoaded()
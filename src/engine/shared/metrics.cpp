@@ -0,0 +1,262 @@
+#include <algorithm>
+
+#include <base/math.h>
+
+#include "metrics.h"
+
+#if defined(CONF_FAMILY_UNIX)
+#include <signal.h>
+#endif
+
+CMetrics g_Metrics;
+
+static void AppendSample(std::string &Out, const char *pName, const char *pSuffix, const char *pLabels, const char *pExtraLabel, const char *pValue)
+{
+	char aBuf[256];
+	if(pLabels[0] && pExtraLabel)
+		str_format(aBuf, sizeof(aBuf), "%s%s{%s,%s} %s\n", pName, pSuffix, pLabels, pExtraLabel, pValue);
+	else if(pLabels[0] || pExtraLabel)
+		str_format(aBuf, sizeof(aBuf), "%s%s{%s} %s\n", pName, pSuffix, pLabels[0] ? pLabels : pExtraLabel, pValue);
+	else
+		str_format(aBuf, sizeof(aBuf), "%s%s %s\n", pName, pSuffix, pValue);
+	Out += aBuf;
+}
+
+CMetricSeries::CMetricSeries(int Type, const char *pName, const char *pHelp, const char *pLabels)
+{
+	m_Type = Type;
+	str_copy(m_aName, pName, sizeof(m_aName));
+	str_copy(m_aHelp, pHelp, sizeof(m_aHelp));
+	str_copy(m_aLabels, pLabels ? pLabels : "", sizeof(m_aLabels));
+}
+
+void CMetricCounter::Write(std::string &Out) const
+{
+	char aValue[32];
+	str_format(aValue, sizeof(aValue), "%lld", (long long)Value());
+	AppendSample(Out, m_aName, "", m_aLabels, 0, aValue);
+}
+
+void CMetricGauge::Write(std::string &Out) const
+{
+	char aValue[32];
+	str_format(aValue, sizeof(aValue), "%lld", (long long)Value());
+	AppendSample(Out, m_aName, "", m_aLabels, 0, aValue);
+}
+
+CMetricHistogram::CMetricHistogram(const char *pName, const char *pHelp, const char *pLabels, const int64 *pBounds, int NumBounds, double Unit) :
+	CMetricSeries(TYPE_HISTOGRAM, pName, pHelp, pLabels), m_Count(0), m_Sum(0)
+{
+	m_NumBounds = minimum(NumBounds, (int)MAX_BOUNDS);
+	for(int i = 0; i < m_NumBounds; i++)
+		m_aBounds[i] = pBounds[i];
+	for(int i = 0; i <= m_NumBounds; i++)
+		m_aBuckets[i].store(0, std::memory_order_relaxed);
+	m_Unit = Unit;
+}
+
+void CMetricHistogram::Observe(int64 Value)
+{
+	int Bucket = std::lower_bound(m_aBounds, m_aBounds + m_NumBounds, Value) - m_aBounds;
+	m_aBuckets[Bucket].fetch_add(1, std::memory_order_relaxed);
+	m_Sum.fetch_add(Value, std::memory_order_relaxed);
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CMetricHistogram::Write(std::string &Out) const
+{
+	// buckets are cumulative in the output
+	char aLabel[64];
+	char aValue[32];
+	int64 Cumulative = 0;
+	for(int i = 0; i <= m_NumBounds; i++)
+	{
+		Cumulative += m_aBuckets[i].load(std::memory_order_relaxed);
+		if(i < m_NumBounds)
+			str_format(aLabel, sizeof(aLabel), "le=\"%g\"", m_aBounds[i] * m_Unit);
+		else
+			str_copy(aLabel, "le=\"+Inf\"", sizeof(aLabel));
+		str_format(aValue, sizeof(aValue), "%lld", (long long)Cumulative);
+		AppendSample(Out, m_aName, "_bucket", m_aLabels, aLabel, aValue);
+	}
+	str_format(aValue, sizeof(aValue), "%.9g", m_Sum.load(std::memory_order_relaxed) * m_Unit);
+	AppendSample(Out, m_aName, "_sum", m_aLabels, 0, aValue);
+	// the buckets and the count are read at slightly different times, keep them consistent
+	str_format(aValue, sizeof(aValue), "%lld", (long long)Cumulative);
+	AppendSample(Out, m_aName, "_count", m_aLabels, 0, aValue);
+}
+
+CMetrics::CMetrics()
+{
+	m_Lock = lock_create();
+	m_Socket.type = NETTYPE_INVALID;
+	m_Socket.ipv4sock = -1;
+	m_Socket.ipv6sock = -1;
+	m_pThread = 0;
+	m_Stop = false;
+}
+
+CMetrics::~CMetrics()
+{
+	Close();
+	for(unsigned i = 0; i < m_lSeries.size(); i++)
+		delete m_lSeries[i];
+	lock_destroy(m_Lock);
+}
+
+CMetricSeries *CMetrics::Register(CMetricSeries *pSeries)
+{
+	// registering a series again, on a map change for example, gives back the first one
+	lock_wait(m_Lock);
+	for(unsigned i = 0; i < m_lSeries.size(); i++)
+	{
+		if(str_comp(m_lSeries[i]->Name(), pSeries->Name()) == 0 && str_comp(m_lSeries[i]->Labels(), pSeries->Labels()) == 0)
+		{
+			dbg_assert(m_lSeries[i]->Type() == pSeries->Type(), "metric registered with another type");
+			CMetricSeries *pExisting = m_lSeries[i];
+			lock_unlock(m_Lock);
+			delete pSeries;
+			return pExisting;
+		}
+	}
+	m_lSeries.push_back(pSeries);
+	lock_unlock(m_Lock);
+	return pSeries;
+}
+
+CMetricCounter *CMetrics::RegisterCounter(const char *pName, const char *pHelp, const char *pLabels)
+{
+	return (CMetricCounter *)Register(new CMetricCounter(pName, pHelp, pLabels));
+}
+
+CMetricGauge *CMetrics::RegisterGauge(const char *pName, const char *pHelp, const char *pLabels)
+{
+	return (CMetricGauge *)Register(new CMetricGauge(pName, pHelp, pLabels));
+}
+
+CMetricHistogram *CMetrics::RegisterHistogram(const char *pName, const char *pHelp, const int64 *pBounds, int NumBounds, double Unit, const char *pLabels)
+{
+	return (CMetricHistogram *)Register(new CMetricHistogram(pName, pHelp, pLabels, pBounds, NumBounds, Unit));
+}
+
+static bool CompareSeriesName(const CMetricSeries *pA, const CMetricSeries *pB)
+{
+	return str_comp(pA->Name(), pB->Name()) < 0;
+}
+
+void CMetrics::Write(std::string &Out)
+{
+	static const char *s_apTypeNames[] = {"counter", "gauge", "histogram"};
+
+	lock_wait(m_Lock);
+	std::vector<CMetricSeries *> lSeries(m_lSeries);
+	lock_unlock(m_Lock);
+
+	// all series of a metric have to follow its HELP and TYPE lines
+	std::stable_sort(lSeries.begin(), lSeries.end(), CompareSeriesName);
+	char aBuf[256];
+	for(unsigned i = 0; i < lSeries.size(); i++)
+	{
+		if(i == 0 || str_comp(lSeries[i - 1]->Name(), lSeries[i]->Name()) != 0)
+		{
+			str_format(aBuf, sizeof(aBuf), "# HELP %s %s\n# TYPE %s %s\n", lSeries[i]->Name(), lSeries[i]->Help(), lSeries[i]->Name(), s_apTypeNames[lSeries[i]->Type()]);
+			Out += aBuf;
+		}
+		lSeries[i]->Write(Out);
+	}
+}
+
+bool CMetrics::Listen(const char *pBindAddr, int Port)
+{
+	Close();
+
+	NETADDR BindAddr;
+	if(!pBindAddr[0])
+	{
+		mem_zero(&BindAddr, sizeof(BindAddr));
+		BindAddr.type = NETTYPE_ALL;
+	}
+	else if(net_host_lookup(pBindAddr, &BindAddr, NETTYPE_ALL) != 0)
+	{
+		// listening on every address instead would expose the metrics
+		dbg_msg("metrics", "couldn't resolve the bind address '%s'", pBindAddr);
+		return false;
+	}
+	BindAddr.port = Port;
+
+	m_Socket = net_tcp_create(BindAddr);
+	if(!m_Socket.type)
+		return false;
+	if(net_tcp_listen(m_Socket, 8))
+	{
+		net_tcp_close(m_Socket);
+		m_Socket.type = NETTYPE_INVALID;
+		return false;
+	}
+	net_set_non_blocking(m_Socket);
+
+#if defined(CONF_FAMILY_UNIX)
+	// a scraper closing the connection early must not kill the server
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	m_Stop = false;
+	m_pThread = thread_init(ListenThread, this, "metrics");
+	return m_pThread != 0;
+}
+
+void CMetrics::Close()
+{
+	if(m_pThread)
+	{
+		m_Stop = true;
+		thread_wait(m_pThread);
+		m_pThread = 0;
+	}
+	if(m_Socket.type)
+	{
+		net_tcp_close(m_Socket);
+		m_Socket.type = NETTYPE_INVALID;
+	}
+}
+
+void CMetrics::Serve(NETSOCKET Client)
+{
+	// the request itself doesn't matter, but it has to be read before answering
+	char aRequest[1024];
+	if(net_socket_read_wait(Client, 1000000) > 0)
+		net_tcp_recv(Client, aRequest, sizeof(aRequest));
+
+	std::string Body;
+	Write(Body);
+
+	char aHeader[256];
+	str_format(aHeader, sizeof(aHeader), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", (int)Body.size());
+	std::string Response = aHeader + Body;
+
+	int Sent = 0;
+	while(Sent < (int)Response.size())
+	{
+		int Bytes = net_tcp_send(Client, Response.c_str() + Sent, Response.size() - Sent);
+		if(Bytes <= 0)
+			break;
+		Sent += Bytes;
+	}
+}
+
+void CMetrics::ListenThread(void *pUser)
+{
+	CMetrics *pThis = (CMetrics *)pUser;
+	while(!pThis->m_Stop)
+	{
+		if(net_socket_read_wait(pThis->m_Socket, 100000) <= 0)
+			continue;
+
+		NETSOCKET Client;
+		NETADDR Addr;
+		if(net_tcp_accept(pThis->m_Socket, &Client, &Addr) < 0)
+			continue;
+		pThis->Serve(Client);
+		net_tcp_close(Client);
+	}
+}
@@ -0,0 +1,129 @@
+#ifndef ENGINE_SHARED_METRICS_H
+#define ENGINE_SHARED_METRICS_H
+
+#include <base/system.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Counters, gauges and histograms served in the Prometheus text format.
+// Series are registered once and then updated with relaxed atomics, so
+// the game thread never waits on the thread serving the scrapes.
+
+class CMetricSeries
+{
+public:
+	enum
+	{
+		TYPE_COUNTER=0,
+		TYPE_GAUGE,
+		TYPE_HISTOGRAM,
+	};
+
+	CMetricSeries(int Type, const char *pName, const char *pHelp, const char *pLabels);
+	virtual ~CMetricSeries() {}
+
+	int Type() const { return m_Type; }
+	const char *Name() const { return m_aName; }
+	const char *Help() const { return m_aHelp; }
+	const char *Labels() const { return m_aLabels; }
+
+	virtual void Write(std::string &Out) const = 0;
+
+protected:
+	int m_Type;
+	char m_aName[64];
+	char m_aHelp[128];
+	char m_aLabels[64];
+};
+
+class CMetricCounter : public CMetricSeries
+{
+	std::atomic<int64> m_Value;
+
+public:
+	CMetricCounter(const char *pName, const char *pHelp, const char *pLabels) :
+		CMetricSeries(TYPE_COUNTER, pName, pHelp, pLabels), m_Value(0) {}
+
+	void Add(int64 Value = 1) { m_Value.fetch_add(Value, std::memory_order_relaxed); }
+	// for totals that are already counted elsewhere
+	void Store(int64 Value) { m_Value.store(Value, std::memory_order_relaxed); }
+	int64 Value() const { return m_Value.load(std::memory_order_relaxed); }
+
+	virtual void Write(std::string &Out) const;
+};
+
+class CMetricGauge : public CMetricSeries
+{
+	std::atomic<int64> m_Value;
+
+public:
+	CMetricGauge(const char *pName, const char *pHelp, const char *pLabels) :
+		CMetricSeries(TYPE_GAUGE, pName, pHelp, pLabels), m_Value(0) {}
+
+	void Set(int64 Value) { m_Value.store(Value, std::memory_order_relaxed); }
+	void Add(int64 Value) { m_Value.fetch_add(Value, std::memory_order_relaxed); }
+	int64 Value() const { return m_Value.load(std::memory_order_relaxed); }
+
+	virtual void Write(std::string &Out) const;
+};
+
+class CMetricHistogram : public CMetricSeries
+{
+public:
+	enum
+	{
+		MAX_BOUNDS=16,
+	};
+
+	// values are observed as integers, Unit scales them for the output (1e-6 for microseconds as seconds)
+	CMetricHistogram(const char *pName, const char *pHelp, const char *pLabels, const int64 *pBounds, int NumBounds, double Unit);
+
+	void Observe(int64 Value);
+	int64 Count() const { return m_Count.load(std::memory_order_relaxed); }
+
+	virtual void Write(std::string &Out) const;
+
+private:
+	int64 m_aBounds[MAX_BOUNDS];
+	int m_NumBounds;
+	double m_Unit;
+	std::atomic<int64> m_aBuckets[MAX_BOUNDS+1];
+	std::atomic<int64> m_Count;
+	std::atomic<int64> m_Sum;
+};
+
+class CMetrics
+{
+public:
+	CMetrics();
+	~CMetrics();
+
+	// pLabels is the inside of the braces, like 'client_id="3"', or 0
+	CMetricCounter *RegisterCounter(const char *pName, const char *pHelp, const char *pLabels = 0);
+	CMetricGauge *RegisterGauge(const char *pName, const char *pHelp, const char *pLabels = 0);
+	CMetricHistogram *RegisterHistogram(const char *pName, const char *pHelp, const int64 *pBounds, int NumBounds, double Unit, const char *pLabels = 0);
+
+	void Write(std::string &Out);
+
+	// serves the metrics on their own thread, for scrapes of any path
+	bool Listen(const char *pBindAddr, int Port);
+	void Close();
+
+private:
+	LOCK m_Lock;
+	std::vector<CMetricSeries *> m_lSeries;
+
+	NETSOCKET m_Socket;
+	void *m_pThread;
+	volatile bool m_Stop;
+
+	CMetricSeries *Register(CMetricSeries *pSeries);
+	void Serve(NETSOCKET Client);
+	static void ListenThread(void *pUser);
+};
+
+extern CMetrics g_Metrics;
+
+#endif
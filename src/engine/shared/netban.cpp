@@ -3,9 +3,34 @@
 #include <engine/console.h>
 #include <engine/storage.h>
 #include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
 
 #include "netban.h"
 
+// banlist snapshot written by bans_save, read back through a file mapping
+static const char s_aBanFileMagic[8] = {'T', 'W', 'B', 'A', 'N', 'S', 0, 0};
+
+struct CBanFileHeader
+{
+	char m_aMagic[8];
+	int m_Version;
+	int m_NumBans;
+};
+
+struct CBanFileEntry
+{
+	int m_Expires;
+	int m_IsRange;
+	NETADDR m_LB;
+	NETADDR m_UB;
+	char m_aReason[64];
+};
+
+enum
+{
+	BANFILE_VERSION=1,
+};
+
 template<class POOL>
 int CNetBan::Ban(POOL *pBanPool, const typename POOL::CDataType *pData, int Seconds, const char *pReason)
 {
@@ -24,8 +49,7 @@ int CNetBan::Ban(POOL *pBanPool, const typename POOL::CDataType *pData, int Seco
 	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
 
 	// check if it already exists
-	CNetHash NetHash(pData);
-	CNode<typename POOL::CDataType, CBanInfo> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename POOL::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		// adjust the ban
@@ -37,24 +61,31 @@ int CNetBan::Ban(POOL *pBanPool, const typename POOL::CDataType *pData, int Seco
 	}
 
 	// add ban and print result
-	pBan = pBanPool->Add(pData, &Info, &NetHash);
+	pBan = pBanPool->Add(pData, &Info);
+	char aBuf[128];
+	MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
+	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	return 0;
+}
+
+template<class POOL>
+bool CNetBan::BanQuiet(POOL *pBanPool, const typename POOL::CDataType *pData, const CBanInfo *pInfo)
+{
+	if(NetMatch(pData, &m_LocalhostIPV4) || NetMatch(pData, &m_LocalhostIPV6))
+		return false;
+
+	CBan<typename POOL::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
-	{
-		char aBuf[128];
-		MakeBanInfo(pBan, aBuf, sizeof(aBuf), MSGTYPE_BANADD);
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		return 0;
-	}
+		pBanPool->Update(pBan, pInfo);
 	else
-		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", "ban failed (full banlist)");
-	return -1;
+		pBanPool->Add(pData, pInfo);
+	return true;
 }
 
 template<class POOL>
 int CNetBan::Unban(POOL *pBanPool, const typename POOL::CDataType *pData)
 {
-	CNetHash NetHash(pData);
-	CNode<typename POOL::CDataType, CBanInfo> *pBan = pBanPool->Find(pData, &NetHash);
+	CBan<typename POOL::CDataType> *pBan = pBanPool->Find(pData);
 	if(pBan)
 	{
 		char aBuf[256];
@@ -85,6 +116,8 @@ void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 	Console()->Register("unban_all", "", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConUnbanAll, this, "Unban all entries");
 	Console()->Register("bans", "", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBans, this, "Show banlist");
 	Console()->Register("bans_save", "s", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBansSave, this, "Save banlist in a file");
+	Console()->Register("bans_load", "s", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBansLoad, this, "Load a banlist saved with bans_save");
+	Console()->Register("bans_load_list", "s?ir", CFGFLAG_SERVER|CFGFLAG_MASTER|CFGFLAG_STORE, ConBansLoadList, this, "Ban all addresses, ranges and cidr blocks listed in a file for x minutes (0 = forever)");
 }
 
 void CNetBan::Update()
@@ -168,31 +201,190 @@ int CNetBan::UnbanByIndex(int Index)
 
 bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const
 {
-	CNetHash aHash[17];
-	int Length = CNetHash::MakeHashArray(pAddr, aHash);
-
 	// check ban adresses
-	CBanAddr *pBan = m_BanAddrPool.Find(pAddr, &aHash[Length]);
+	CBanAddr *pBan = m_BanAddrPool.Match(pAddr);
 	if(pBan)
 	{
 		MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
 		return true;
 	}
 
-	// check ban ranges
-	for(int i = Length-1; i >= 0; --i)
+	// check ban ranges, the most specific one wins
+	CBanRange *pBanRange = m_BanRangePool.Match(pAddr);
+	if(pBanRange)
+	{
+		MakeBanInfo(pBanRange, pBuf, BufferSize, MSGTYPE_PLAYER);
+		return true;
+	}
+	
+	return false;
+}
+
+bool CNetBan::SaveBans(const char *pFilename)
+{
+	IOHANDLE File = Storage()->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
+
+	CBanFileHeader Header;
+	mem_copy(Header.m_aMagic, s_aBanFileMagic, sizeof(Header.m_aMagic));
+	Header.m_Version = BANFILE_VERSION;
+	Header.m_NumBans = m_BanAddrPool.Num() + m_BanRangePool.Num();
+	io_write(File, &Header, sizeof(Header));
+
+	CBanFileEntry Entry;
+	for(CBanAddr *pBan = m_BanAddrPool.First(); pBan; pBan = pBan->m_pNext)
+	{
+		mem_zero(&Entry, sizeof(Entry));
+		Entry.m_Expires = pBan->m_Info.m_Expires;
+		Entry.m_IsRange = 0;
+		Entry.m_LB = Entry.m_UB = pBan->m_Data;
+		str_copy(Entry.m_aReason, pBan->m_Info.m_aReason, sizeof(Entry.m_aReason));
+		io_write(File, &Entry, sizeof(Entry));
+	}
+	for(CBanRange *pBan = m_BanRangePool.First(); pBan; pBan = pBan->m_pNext)
+	{
+		mem_zero(&Entry, sizeof(Entry));
+		Entry.m_Expires = pBan->m_Info.m_Expires;
+		Entry.m_IsRange = 1;
+		Entry.m_LB = pBan->m_Data.m_LB;
+		Entry.m_UB = pBan->m_Data.m_UB;
+		str_copy(Entry.m_aReason, pBan->m_Info.m_aReason, sizeof(Entry.m_aReason));
+		io_write(File, &Entry, sizeof(Entry));
+	}
+
+	io_close(File);
+	return true;
+}
+
+bool CNetBan::LoadBans(const char *pFilename)
+{
+	char aPath[512];
+	Storage()->GetCompletePath(IStorage::TYPE_SAVE, pFilename, aPath, sizeof(aPath));
+
+	unsigned Size;
+	const unsigned char *pData = static_cast<const unsigned char *>(io_map_file(aPath, &Size));
+	if(!pData)
+		return false;
+
+	const CBanFileHeader *pHeader = reinterpret_cast<const CBanFileHeader *>(pData);
+	if(Size < sizeof(CBanFileHeader) || mem_comp(pHeader->m_aMagic, s_aBanFileMagic, sizeof(pHeader->m_aMagic)) != 0 ||
+		pHeader->m_Version != BANFILE_VERSION || pHeader->m_NumBans < 0 ||
+		(Size - sizeof(CBanFileHeader)) / sizeof(CBanFileEntry) < (unsigned)pHeader->m_NumBans)
+	{
+		io_unmap_file((void *)pData, Size);
+		return false;
+	}
+
+	int Now = time_timestamp();
+	const CBanFileEntry *pEntries = reinterpret_cast<const CBanFileEntry *>(pData + sizeof(CBanFileHeader));
+	for(int i = 0; i < pHeader->m_NumBans; i++)
+	{
+		const CBanFileEntry *pEntry = &pEntries[i];
+		if(pEntry->m_Expires != CBanInfo::EXPIRES_NEVER && pEntry->m_Expires < Now)
+			continue;
+
+		CBanInfo Info = {0};
+		Info.m_Expires = pEntry->m_Expires;
+		str_copy(Info.m_aReason, pEntry->m_aReason, sizeof(Info.m_aReason));
+		if(pEntry->m_IsRange)
+		{
+			CNetRange Range;
+			Range.m_LB = pEntry->m_LB;
+			Range.m_UB = pEntry->m_UB;
+			if(Range.IsValid())
+				BanQuiet(&m_BanRangePool, &Range, &Info);
+		}
+		else
+			BanQuiet(&m_BanAddrPool, &pEntry->m_LB, &Info);
+	}
+
+	io_unmap_file((void *)pData, Size);
+	return true;
+}
+
+int CNetBan::LoadBlocklist(const char *pFilename, int Seconds, const char *pReason, int *pNumInvalid)
+{
+	IOHANDLE File = Storage()->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(!File)
+		return -1;
+
+	CBanInfo Info = {0};
+	Info.m_Expires = Seconds > 0 ? time_timestamp()+Seconds : CBanInfo::EXPIRES_NEVER;
+	str_copy(Info.m_aReason, pReason, sizeof(Info.m_aReason));
+
+	int NumBans = 0;
+	*pNumInvalid = 0;
+
+	CLineReader LineReader;
+	LineReader.Init(File);
+	char *pLine;
+	while((pLine = LineReader.Get()))
 	{
-		for(CBanRange *pBan = m_BanRangePool.First(&aHash[i]); pBan; pBan = pBan->m_pHashNext)
+		// one address, range ("a - b") or cidr block ("a/n") per line
+		char *pComment = (char *)str_find(pLine, "#");
+		if(pComment)
+			*pComment = 0;
+		pLine = str_skip_whitespaces(pLine);
+		int Length = str_length(pLine);
+		while(Length > 0 && (pLine[Length-1] == ' ' || pLine[Length-1] == '\t' || pLine[Length-1] == '\r'))
+			pLine[--Length] = 0;
+		if(!pLine[0])
+			continue;
+
+		CNetRange Range;
+		bool Valid = false;
+		char *pSeparator;
+		if((pSeparator = (char *)str_find(pLine, "/")))
 		{
-			if(NetMatch(&pBan->m_Data, pAddr, i, Length))
+			*pSeparator = 0;
+			int Bits = str_toint(pSeparator+1);
+			if(StrAllnum(pSeparator+1) && pSeparator[1] && net_addr_from_str(&Range.m_LB, pLine) == 0 &&
+				Bits >= 0 && Bits <= CNetPrefixTree::AddrBits(Range.m_LB.type))
 			{
-				MakeBanInfo(pBan, pBuf, BufferSize, MSGTYPE_PLAYER);
-				return true;
+				Range.m_UB = Range.m_LB;
+				int AddrBits = CNetPrefixTree::AddrBits(Range.m_LB.type);
+				for(int i = Bits; i < AddrBits; i++)
+				{
+					Range.m_LB.ip[i>>3] &= ~(0x80 >> (i&7));
+					Range.m_UB.ip[i>>3] |= 0x80 >> (i&7);
+				}
+				Valid = true;
 			}
 		}
+		else if((pSeparator = (char *)str_find(pLine, "-")))
+		{
+			*pSeparator = 0;
+			char *pEnd = pLine+str_length(pLine);
+			while(pEnd > pLine && (pEnd[-1] == ' ' || pEnd[-1] == '\t'))
+				*--pEnd = 0;
+			Valid = net_addr_from_str(&Range.m_LB, pLine) == 0 && net_addr_from_str(&Range.m_UB, str_skip_whitespaces(pSeparator+1)) == 0 &&
+				Range.m_LB.type == Range.m_UB.type && NetComp(&Range.m_LB, &Range.m_UB) <= 0;
+		}
+		else
+		{
+			Valid = net_addr_from_str(&Range.m_LB, pLine) == 0;
+			Range.m_UB = Range.m_LB;
+		}
+
+		if(!Valid)
+		{
+			(*pNumInvalid)++;
+			continue;
+		}
+
+		Range.m_LB.port = Range.m_UB.port = 0;
+		bool Banned;
+		if(NetComp(&Range.m_LB, &Range.m_UB) == 0)
+			Banned = BanQuiet(&m_BanAddrPool, &Range.m_LB, &Info);
+		else
+			Banned = BanQuiet(&m_BanRangePool, &Range, &Info);
+		if(Banned)
+			NumBans++;
 	}
-	
-	return false;
+
+	io_close(File);
+	return NumBans;
 }
 
 bool CNetBan::ConBan(IConsole::IResult *pResult, void *pUser)
@@ -304,36 +496,43 @@ bool CNetBan::ConBansSave(IConsole::IResult *pResult, void *pUser)
 	CNetBan *pThis = static_cast<CNetBan *>(pUser);
 
 	char aBuf[256];
-	IOHANDLE File = pThis->Storage()->OpenFile(pResult->GetString(0), IOFLAG_WRITE, IStorage::TYPE_SAVE);
-	if(!File)
-	{
+	if(pThis->SaveBans(pResult->GetString(0)))
+		str_format(aBuf, sizeof(aBuf), "saved banlist to '%s'", pResult->GetString(0));
+	else
 		str_format(aBuf, sizeof(aBuf), "failed to save banlist to '%s'", pResult->GetString(0));
-		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
-		return true;
-	}
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	
+	return true;
+}
 
-	int Now = time_timestamp();
-	char aAddrStr1[NETADDR_MAXSTRSIZE], aAddrStr2[NETADDR_MAXSTRSIZE];
-	for(CBanAddr *pBan = pThis->m_BanAddrPool.First(); pBan; pBan = pBan->m_pNext)
-	{
-		int Min = pBan->m_Info.m_Expires>-1 ? (pBan->m_Info.m_Expires-Now+59)/60 : -1;
-		net_addr_str(&pBan->m_Data, aAddrStr1, sizeof(aAddrStr1), false);
-		str_format(aBuf, sizeof(aBuf), "ban %s %i %s", aAddrStr1, Min, pBan->m_Info.m_aReason);
-		io_write(File, aBuf, str_length(aBuf));
-		io_write_newline(File);
-	}
-	for(CBanRange *pBan = pThis->m_BanRangePool.First(); pBan; pBan = pBan->m_pNext)
-	{
-		int Min = pBan->m_Info.m_Expires>-1 ? (pBan->m_Info.m_Expires-Now+59)/60 : -1;
-		net_addr_str(&pBan->m_Data.m_LB, aAddrStr1, sizeof(aAddrStr1), false);
-		net_addr_str(&pBan->m_Data.m_UB, aAddrStr2, sizeof(aAddrStr2), false);
-		str_format(aBuf, sizeof(aBuf), "ban_range %s %s %i %s", aAddrStr1, aAddrStr2, Min, pBan->m_Info.m_aReason);
-		io_write(File, aBuf, str_length(aBuf));
-		io_write_newline(File);
-	}
+bool CNetBan::ConBansLoad(IConsole::IResult *pResult, void *pUser)
+{
+	CNetBan *pThis = static_cast<CNetBan *>(pUser);
 
-	io_close(File);
-	str_format(aBuf, sizeof(aBuf), "saved banlist to '%s'", pResult->GetString(0));
+	char aBuf[256];
+	if(pThis->LoadBans(pResult->GetString(0)))
+		str_format(aBuf, sizeof(aBuf), "loaded banlist from '%s' (%d bans)", pResult->GetString(0), pThis->m_BanAddrPool.Num()+pThis->m_BanRangePool.Num());
+	else
+		str_format(aBuf, sizeof(aBuf), "failed to load banlist from '%s'", pResult->GetString(0));
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
+	
+	return true;
+}
+
+bool CNetBan::ConBansLoadList(IConsole::IResult *pResult, void *pUser)
+{
+	CNetBan *pThis = static_cast<CNetBan *>(pUser);
+
+	int Minutes = pResult->NumArguments()>1 ? maximum(pResult->GetInteger(1), 0) : 0;
+	const char *pReason = pResult->NumArguments()>2 ? pResult->GetString(2) : "Blocklisted";
+
+	char aBuf[256];
+	int NumInvalid;
+	int NumBans = pThis->LoadBlocklist(pResult->GetString(0), Minutes*60, pReason, &NumInvalid);
+	if(NumBans >= 0)
+		str_format(aBuf, sizeof(aBuf), "banned %d entries from '%s' (%d invalid lines)", NumBans, pResult->GetString(0), NumInvalid);
+	else
+		str_format(aBuf, sizeof(aBuf), "failed to open blocklist '%s'", pResult->GetString(0));
 	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "net_ban", aBuf);
 	
 	return true;
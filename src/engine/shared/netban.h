@@ -3,6 +3,7 @@
 
 #include <base/system.h>
 #include "netdatabase.h"
+#include "netprefixtree.h"
 
 class CNetBan : public CNetDatabase
 {
@@ -18,14 +19,66 @@ protected:
 		char m_aReason[REASON_LENGTH];
 	};
 
-	typedef CPool<NETADDR, CBanInfo, 1> CBanAddrPool;
-	typedef CPool<CNetRange, CBanInfo, 16> CBanRangePool;
-	typedef CNode<NETADDR, CBanInfo> CBanAddr;
-	typedef CNode<CNetRange, CBanInfo> CBanRange;
-	
-	template<class DATATYPE> void MakeBanInfo(const CNode<DATATYPE, CBanInfo> *pBan, char *pBuf, unsigned BuffSize, int Type) const;
+	template<typename DATATYPE>
+	struct CBan
+	{
+		DATATYPE m_Data;
+		CBanInfo m_Info;
+
+		// ordered by expiry
+		CBan *m_pNext;
+		CBan *m_pPrev;
+	};
+
+	// bans without a fixed capacity, looked up through a prefix tree
+	template<typename DATATYPE>
+	class CBanPool
+	{
+	public:
+		typedef DATATYPE CDataType;
+
+		CBanPool() : m_pFirst(0), m_pLast(0), m_Num(0) {}
+		~CBanPool() { Reset(); }
+
+		CBan<DATATYPE> *Add(const DATATYPE *pData, const CBanInfo *pInfo);
+		int Remove(CBan<DATATYPE> *pBan);
+		void Update(CBan<DATATYPE> *pBan, const CBanInfo *pInfo);
+		void Reset();
+
+		int Num() const { return m_Num; }
+		CBan<DATATYPE> *First() const { return m_pFirst; }
+		CBan<DATATYPE> *Find(const DATATYPE *pData) const;
+		CBan<DATATYPE> *Get(int Index) const;
+		CBan<DATATYPE> *Match(const NETADDR *pAddr) const { return static_cast<CBan<DATATYPE> *>(m_Tree.Match(pAddr)); }
+
+	private:
+		void Link(CBan<DATATYPE> *pBan);
+		void Unlink(CBan<DATATYPE> *pBan);
+
+		CNetPrefixTree m_Tree;
+		CBan<DATATYPE> *m_pFirst;
+		CBan<DATATYPE> *m_pLast;
+		int m_Num;
+	};
+
+	typedef CBanPool<NETADDR> CBanAddrPool;
+	typedef CBanPool<CNetRange> CBanRangePool;
+	typedef CBan<NETADDR> CBanAddr;
+	typedef CBan<CNetRange> CBanRange;
+
+	static const NETADDR *LowerBound(const NETADDR *pAddr) { return pAddr; }
+	static const NETADDR *UpperBound(const NETADDR *pAddr) { return pAddr; }
+	static const NETADDR *LowerBound(const CNetRange *pRange) { return &pRange->m_LB; }
+	static const NETADDR *UpperBound(const CNetRange *pRange) { return &pRange->m_UB; }
+
+	template<class DATATYPE> void MakeBanInfo(const CBan<DATATYPE> *pBan, char *pBuf, unsigned BuffSize, int Type) const;
 	template<class POOL> int Ban(POOL *pBanPool, const typename POOL::CDataType *pData, int Seconds, const char *pReason);
 	template<class POOL> int Unban(POOL *pBanPool, const typename POOL::CDataType *pData);
+	template<class POOL> bool BanQuiet(POOL *pBanPool, const typename POOL::CDataType *pData, const CBanInfo *pInfo);
+
+	bool LoadBans(const char *pFilename);
+	bool SaveBans(const char *pFilename);
+	int LoadBlocklist(const char *pFilename, int Seconds, const char *pReason, int *pNumInvalid);
 
 	class IConsole *m_pConsole;
 	class IStorage *m_pStorage;
@@ -64,10 +117,12 @@ public:
 	static bool ConUnbanAll(class IConsole::IResult *pResult, void *pUser);
 	static bool ConBans(class IConsole::IResult *pResult, void *pUser);
 	static bool ConBansSave(class IConsole::IResult *pResult, void *pUser);
+	static bool ConBansLoad(class IConsole::IResult *pResult, void *pUser);
+	static bool ConBansLoadList(class IConsole::IResult *pResult, void *pUser);
 };
 
 template<class DATATYPE>
-void CNetBan::MakeBanInfo(const CNode<DATATYPE, CBanInfo> *pBan, char *pBuf, unsigned BuffSize, int Type) const
+void CNetBan::MakeBanInfo(const CBan<DATATYPE> *pBan, char *pBuf, unsigned BuffSize, int Type) const
 {
 	if(pBan == 0 || pBuf == 0)
 	{
@@ -109,4 +164,127 @@ void CNetBan::MakeBanInfo(const CNode<DATATYPE, CBanInfo> *pBan, char *pBuf, uns
 		str_format(pBuf, BuffSize, "%s for life (%s)", aBuf, pBan->m_Info.m_aReason);
 }
 
+template<typename DATATYPE>
+void CNetBan::CBanPool<DATATYPE>::Link(CBan<DATATYPE> *pBan)
+{
+	// permanent bans go last, others before the first ban expiring later
+	CBan<DATATYPE> *pNext = 0;
+	if(pBan->m_Info.m_Expires != CBanInfo::EXPIRES_NEVER)
+	{
+		for(pNext = m_pFirst; pNext; pNext = pNext->m_pNext)
+		{
+			if(pNext->m_Info.m_Expires == CBanInfo::EXPIRES_NEVER || pBan->m_Info.m_Expires <= pNext->m_Info.m_Expires)
+				break;
+		}
+	}
+
+	pBan->m_pNext = pNext;
+	pBan->m_pPrev = pNext ? pNext->m_pPrev : m_pLast;
+	if(pBan->m_pPrev)
+		pBan->m_pPrev->m_pNext = pBan;
+	else
+		m_pFirst = pBan;
+	if(pNext)
+		pNext->m_pPrev = pBan;
+	else
+		m_pLast = pBan;
+}
+
+template<typename DATATYPE>
+void CNetBan::CBanPool<DATATYPE>::Unlink(CBan<DATATYPE> *pBan)
+{
+	if(pBan->m_pNext)
+		pBan->m_pNext->m_pPrev = pBan->m_pPrev;
+	else
+		m_pLast = pBan->m_pPrev;
+	if(pBan->m_pPrev)
+		pBan->m_pPrev->m_pNext = pBan->m_pNext;
+	else
+		m_pFirst = pBan->m_pNext;
+	pBan->m_pNext = pBan->m_pPrev = 0;
+}
+
+template<typename DATATYPE>
+CNetBan::CBan<DATATYPE> *CNetBan::CBanPool<DATATYPE>::Add(const DATATYPE *pData, const CBanInfo *pInfo)
+{
+	CBan<DATATYPE> *pBan = new CBan<DATATYPE>;
+	pBan->m_Data = *pData;
+	pBan->m_Info = *pInfo;
+	Link(pBan);
+	m_Tree.InsertRange(LowerBound(pData), UpperBound(pData), pBan);
+	++m_Num;
+	return pBan;
+}
+
+template<typename DATATYPE>
+int CNetBan::CBanPool<DATATYPE>::Remove(CBan<DATATYPE> *pBan)
+{
+	if(pBan == 0)
+		return -1;
+
+	m_Tree.RemoveRange(LowerBound(&pBan->m_Data), UpperBound(&pBan->m_Data), pBan);
+	Unlink(pBan);
+	delete pBan;
+	--m_Num;
+	return 0;
+}
+
+template<typename DATATYPE>
+void CNetBan::CBanPool<DATATYPE>::Update(CBan<DATATYPE> *pBan, const CBanInfo *pInfo)
+{
+	pBan->m_Info = *pInfo;
+	Unlink(pBan);
+	Link(pBan);
+}
+
+template<typename DATATYPE>
+void CNetBan::CBanPool<DATATYPE>::Reset()
+{
+	while(m_pFirst)
+	{
+		CBan<DATATYPE> *pNext = m_pFirst->m_pNext;
+		delete m_pFirst;
+		m_pFirst = pNext;
+	}
+	m_pLast = 0;
+	m_Num = 0;
+	m_Tree.Clear();
+}
+
+template<typename DATATYPE>
+CNetBan::CBan<DATATYPE> *CNetBan::CBanPool<DATATYPE>::Find(const DATATYPE *pData) const
+{
+	// an identical ban is stored at the same first prefix
+	CNetPrefixTree::CPrefix Prefix;
+	if(CNetPrefixTree::SplitRange(LowerBound(pData), UpperBound(pData), &Prefix, 1) == 0)
+		return 0;
+
+	const std::vector<void *> *pValues = m_Tree.Values(LowerBound(pData)->type, &Prefix);
+	if(!pValues)
+		return 0;
+
+	for(unsigned i = 0; i < pValues->size(); i++)
+	{
+		CBan<DATATYPE> *pBan = static_cast<CBan<DATATYPE> *>((*pValues)[i]);
+		if(NetComp(&pBan->m_Data, pData) == 0)
+			return pBan;
+	}
+	return 0;
+}
+
+template<typename DATATYPE>
+CNetBan::CBan<DATATYPE> *CNetBan::CBanPool<DATATYPE>::Get(int Index) const
+{
+	if(Index < 0 || Index >= Num())
+		return 0;
+
+	for(CBan<DATATYPE> *pBan = m_pFirst; pBan; pBan = pBan->m_pNext, --Index)
+	{
+		if(Index == 0)
+			return pBan;
+	}
+
+	return 0;
+}
+
 #endif
@@ -0,0 +1,259 @@
+#include <algorithm>
+
+#include <base/math.h>
+
+#include "netprefixtree.h"
+
+CNetPrefixTree::CNetPrefixTree()
+{
+	Clear();
+}
+
+void CNetPrefixTree::Clear()
+{
+	m_lNodes.clear();
+	m_lFreeNodes.clear();
+
+	unsigned char aZero[16] = {0};
+	for(int i = 0; i < NUM_ROOTS; i++)
+		NewNode(aZero, 0);
+}
+
+int CNetPrefixTree::CommonLength(const unsigned char *pKey1, const unsigned char *pKey2, int MaxLength)
+{
+	int Length = 0;
+	while(Length+8 <= MaxLength && pKey1[Length>>3] == pKey2[Length>>3])
+		Length += 8;
+	while(Length < MaxLength && GetBit(pKey1, Length) == GetBit(pKey2, Length))
+		Length++;
+	return Length;
+}
+
+int CNetPrefixTree::NewNode(const unsigned char *pKey, int Length)
+{
+	int Node;
+	if(!m_lFreeNodes.empty())
+	{
+		Node = m_lFreeNodes.back();
+		m_lFreeNodes.pop_back();
+	}
+	else
+	{
+		Node = m_lNodes.size();
+		m_lNodes.push_back(CNode());
+	}
+
+	CNode &Created = m_lNodes[Node];
+	mem_zero(Created.m_aKey, sizeof(Created.m_aKey));
+	mem_copy(Created.m_aKey, pKey, (Length+7)/8);
+	if(Length&7)
+		Created.m_aKey[Length>>3] &= 0xff << (8-(Length&7));
+	Created.m_Length = Length;
+	Created.m_aChildren[0] = Created.m_aChildren[1] = 0;
+	Created.m_lValues.clear();
+	return Node;
+}
+
+void CNetPrefixTree::FreeNode(int Node)
+{
+	std::vector<void *>().swap(m_lNodes[Node].m_lValues);
+	m_lFreeNodes.push_back(Node);
+}
+
+void CNetPrefixTree::Insert(int Type, const CPrefix *pPrefix, void *pValue)
+{
+	int Node = Root(Type);
+	if(Node < 0)
+		return;
+	while(1)
+	{
+		if(m_lNodes[Node].m_Length == pPrefix->m_Length)
+		{
+			m_lNodes[Node].m_lValues.push_back(pValue);
+			return;
+		}
+
+		int Bit = GetBit(pPrefix->m_aKey, m_lNodes[Node].m_Length);
+		int Child = m_lNodes[Node].m_aChildren[Bit];
+		if(!Child)
+		{
+			int Leaf = NewNode(pPrefix->m_aKey, pPrefix->m_Length);
+			m_lNodes[Leaf].m_lValues.push_back(pValue);
+			m_lNodes[Node].m_aChildren[Bit] = Leaf;
+			return;
+		}
+
+		int ChildLength = m_lNodes[Child].m_Length;
+		int Common = CommonLength(m_lNodes[Child].m_aKey, pPrefix->m_aKey, minimum(ChildLength, pPrefix->m_Length));
+		if(Common == ChildLength)
+		{
+			Node = Child;
+			continue;
+		}
+
+		// the prefixes diverge inside the child's edge, split it
+		int Split = NewNode(pPrefix->m_aKey, Common);
+		m_lNodes[Split].m_aChildren[GetBit(m_lNodes[Child].m_aKey, Common)] = Child;
+		m_lNodes[Node].m_aChildren[Bit] = Split;
+		if(Common == pPrefix->m_Length)
+			m_lNodes[Split].m_lValues.push_back(pValue);
+		else
+		{
+			int Leaf = NewNode(pPrefix->m_aKey, pPrefix->m_Length);
+			m_lNodes[Leaf].m_lValues.push_back(pValue);
+			m_lNodes[Split].m_aChildren[GetBit(pPrefix->m_aKey, Common)] = Leaf;
+		}
+		return;
+	}
+}
+
+int CNetPrefixTree::FindNode(int Type, const CPrefix *pPrefix, int *pParent, int *pGrandParent) const
+{
+	int GrandParent = -1;
+	int Parent = -1;
+	int Node = Root(Type);
+	while(Node >= 0)
+	{
+		const CNode &Current = m_lNodes[Node];
+		if(Current.m_Length > pPrefix->m_Length || CommonLength(Current.m_aKey, pPrefix->m_aKey, Current.m_Length) < Current.m_Length)
+			return -1;
+		if(Current.m_Length == pPrefix->m_Length)
+		{
+			if(pParent)
+				*pParent = Parent;
+			if(pGrandParent)
+				*pGrandParent = GrandParent;
+			return Node;
+		}
+
+		GrandParent = Parent;
+		Parent = Node;
+		Node = Current.m_aChildren[GetBit(pPrefix->m_aKey, Current.m_Length)];
+		if(!Node)
+			break;
+	}
+	return -1;
+}
+
+bool CNetPrefixTree::Remove(int Type, const CPrefix *pPrefix, void *pValue)
+{
+	int Parent, GrandParent;
+	int Node = FindNode(Type, pPrefix, &Parent, &GrandParent);
+	if(Node < 0)
+		return false;
+
+	std::vector<void *> &lValues = m_lNodes[Node].m_lValues;
+	std::vector<void *>::iterator Iter = std::find(lValues.begin(), lValues.end(), pValue);
+	if(Iter == lValues.end())
+		return false;
+	lValues.erase(Iter);
+
+	// drop nodes that are no longer needed to keep the tree compressed
+	if(!lValues.empty() || Parent < 0)
+		return true;
+
+	int *pChildren = m_lNodes[Node].m_aChildren;
+	if(pChildren[0] && pChildren[1])
+		return true;
+
+	int *pParentChildren = m_lNodes[Parent].m_aChildren;
+	int Slot = pParentChildren[0] == Node ? 0 : 1;
+	pParentChildren[Slot] = pChildren[0] ? pChildren[0] : pChildren[1];
+	FreeNode(Node);
+
+	if(pParentChildren[Slot] == 0 && GrandParent >= 0 && m_lNodes[Parent].m_lValues.empty())
+	{
+		// the parent only has one child left
+		int Other = pParentChildren[1-Slot];
+		int *pGrandParentChildren = m_lNodes[GrandParent].m_aChildren;
+		pGrandParentChildren[pGrandParentChildren[0] == Parent ? 0 : 1] = Other;
+		FreeNode(Parent);
+	}
+	return true;
+}
+
+const std::vector<void *> *CNetPrefixTree::Values(int Type, const CPrefix *pPrefix) const
+{
+	int Node = FindNode(Type, pPrefix, 0, 0);
+	return Node < 0 ? 0 : &m_lNodes[Node].m_lValues;
+}
+
+void *CNetPrefixTree::Match(const NETADDR *pAddr) const
+{
+	int Bits = AddrBits(pAddr->type);
+	void *pBest = 0;
+	int Node = Root(pAddr->type);
+	while(Node >= 0)
+	{
+		const CNode &Current = m_lNodes[Node];
+		if(CommonLength(Current.m_aKey, pAddr->ip, Current.m_Length) < Current.m_Length)
+			break;
+		if(!Current.m_lValues.empty())
+			pBest = Current.m_lValues.back();
+		if(Current.m_Length >= Bits)
+			break;
+
+		Node = Current.m_aChildren[GetBit(pAddr->ip, Current.m_Length)];
+		if(!Node)
+			break;
+	}
+	return pBest;
+}
+
+int CNetPrefixTree::SplitRange(const NETADDR *pLB, const NETADDR *pUB, CPrefix *pPrefixes, int MaxPrefixes)
+{
+	int Bits = AddrBits(pLB->type);
+	int Bytes = Bits/8;
+	unsigned char aLow[16], aHigh[16];
+	mem_copy(aLow, pLB->ip, Bytes);
+
+	int NumPrefixes = 0;
+	while(NumPrefixes < MaxPrefixes && mem_comp(aLow, pUB->ip, Bytes) <= 0)
+	{
+		// largest aligned block starting at aLow that doesn't go past the upper bound
+		int HostBits = 0;
+		while(HostBits < Bits && GetBit(aLow, Bits-1-HostBits) == 0)
+			HostBits++;
+		while(1)
+		{
+			mem_copy(aHigh, aLow, Bytes);
+			for(int i = 0; i < HostBits; i++)
+				aHigh[(Bits-1-i)>>3] |= 1 << (i&7);
+			if(mem_comp(aHigh, pUB->ip, Bytes) <= 0)
+				break;
+			HostBits--;
+		}
+
+		mem_copy(pPrefixes[NumPrefixes].m_aKey, aLow, Bytes);
+		pPrefixes[NumPrefixes].m_Length = Bits-HostBits;
+		NumPrefixes++;
+
+		// continue after the block, stop on overflow
+		int i = Bytes-1;
+		for(; i >= 0; i--)
+		{
+			if(++aHigh[i] != 0)
+				break;
+		}
+		if(i < 0)
+			break;
+		mem_copy(aLow, aHigh, Bytes);
+	}
+	return NumPrefixes;
+}
+
+void CNetPrefixTree::InsertRange(const NETADDR *pLB, const NETADDR *pUB, void *pValue)
+{
+	CPrefix aPrefixes[MAX_RANGE_PREFIXES];
+	int NumPrefixes = SplitRange(pLB, pUB, aPrefixes, MAX_RANGE_PREFIXES);
+	for(int i = 0; i < NumPrefixes; i++)
+		Insert(pLB->type, &aPrefixes[i], pValue);
+}
+
+void CNetPrefixTree::RemoveRange(const NETADDR *pLB, const NETADDR *pUB, void *pValue)
+{
+	CPrefix aPrefixes[MAX_RANGE_PREFIXES];
+	int NumPrefixes = SplitRange(pLB, pUB, aPrefixes, MAX_RANGE_PREFIXES);
+	for(int i = 0; i < NumPrefixes; i++)
+		Remove(pLB->type, &aPrefixes[i], pValue);
+}
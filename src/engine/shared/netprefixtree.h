@@ -0,0 +1,71 @@
+#ifndef ENGINE_SHARED_NETPREFIXTREE_H
+#define ENGINE_SHARED_NETPREFIXTREE_H
+
+#include <base/system.h>
+
+#include <vector>
+
+// Compressed binary radix tree over ipv4 and ipv6 address prefixes.
+// Address ranges are stored as the smallest set of prefixes covering them,
+// so a lookup only walks the bits of the address.
+class CNetPrefixTree
+{
+public:
+	enum
+	{
+		MAX_RANGE_PREFIXES=2*128,
+	};
+
+	struct CPrefix
+	{
+		unsigned char m_aKey[16];
+		int m_Length;
+	};
+
+	CNetPrefixTree();
+
+	void Clear();
+
+	void Insert(int Type, const CPrefix *pPrefix, void *pValue);
+	bool Remove(int Type, const CPrefix *pPrefix, void *pValue);
+	const std::vector<void *> *Values(int Type, const CPrefix *pPrefix) const;
+
+	void InsertRange(const NETADDR *pLB, const NETADDR *pUB, void *pValue);
+	void RemoveRange(const NETADDR *pLB, const NETADDR *pUB, void *pValue);
+
+	// value of the longest prefix containing the address, the most recently added one if there are several
+	void *Match(const NETADDR *pAddr) const;
+
+	int NumNodes() const { return m_lNodes.size() - m_lFreeNodes.size(); }
+
+	static int AddrBits(int Type) { return Type == NETTYPE_IPV6 ? 128 : 32; }
+	static int SplitRange(const NETADDR *pLB, const NETADDR *pUB, CPrefix *pPrefixes, int MaxPrefixes);
+
+private:
+	struct CNode
+	{
+		unsigned char m_aKey[16];
+		int m_Length;
+		int m_aChildren[2];
+		std::vector<void *> m_lValues;
+	};
+
+	enum
+	{
+		NUM_ROOTS=3,
+	};
+
+	// the first nodes are the roots for each address type, so 0 can mean no child
+	std::vector<CNode> m_lNodes;
+	std::vector<int> m_lFreeNodes;
+
+	static int Root(int Type) { return Type == NETTYPE_IPV4 ? 0 : Type == NETTYPE_IPV6 ? 1 : Type == NETTYPE_WEBSOCKET_IPV4 ? 2 : -1; }
+	static int GetBit(const unsigned char *pKey, int Bit) { return (pKey[Bit>>3] >> (7-(Bit&7)))&1; }
+	static int CommonLength(const unsigned char *pKey1, const unsigned char *pKey2, int MaxLength);
+
+	int NewNode(const unsigned char *pKey, int Length);
+	void FreeNode(int Node);
+	int FindNode(int Type, const CPrefix *pPrefix, int *pParent, int *pGrandParent) const;
+};
+
+#endif
@@ -198,6 +198,7 @@ private:
 	NETADDR m_PeerAddr;
 	NETSOCKET m_Socket;
 	NETSTATS m_Stats;
+	int m_NumResends;
 
 public:
 	bool m_TimeoutProtected;
@@ -242,6 +243,7 @@ public:
 	int SecurityToken() const { return m_SecurityToken; }
 	
 	int AckSequence() const { return m_Ack; }
+	int NumResends() const { return m_NumResends; }
 	
 	// anti spoof
 	void DirectInit(NETADDR &Addr, SECURITY_TOKEN SecurityToken);
@@ -369,6 +371,7 @@ public:
 	// status requests
 	const NETADDR *ClientAddr(int ClientID) const { return m_aSlots[ClientID].m_Connection.PeerAddress(); }
 	bool HasSecurityToken(int ClientID) const { return m_aSlots[ClientID].m_Connection.SecurityToken() != NET_SECURITY_TOKEN_UNSUPPORTED; }
+	int ClientResends(int ClientID) const { return m_aSlots[ClientID].m_Connection.NumResends(); }
 	NETADDR Address() const { return m_Address; }
 	NETSOCKET Socket() const { return m_Socket; }
 	class CNetBan *NetBan() const { return m_pNetBan; }
@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/system.h>
 #include "config.h"
+#include "metrics.h"
 #include "network.h"
 
 SECURITY_TOKEN ToSecurityToken(const unsigned char* pData)
@@ -34,6 +35,7 @@ void CNetConnection::Reset(bool Rejoin)
 	m_LastSendTime = 0;
 	m_LastRecvTime = 0;
 	//m_LastUpdateTime = 0;
+	m_NumResends = 0;
 
 	//mem_zero(&m_PeerAddr, sizeof(m_PeerAddr));
 	m_UnknownSeq = false;
@@ -185,6 +187,10 @@ void CNetConnection::ResendChunk(CNetChunkResend *pResend)
 {
 	QueueChunkEx(pResend->m_Flags|NET_CHUNKFLAG_RESEND, pResend->m_DataSize, pResend->m_pData, pResend->m_Sequence);
 	pResend->m_LastSendTime = time_get();
+	m_NumResends++;
+
+	static CMetricCounter *s_pResendsMetric = g_Metrics.RegisterCounter("infclass_network_resent_chunks_total", "Reliable chunks sent again");
+	s_pResendsMetric->Add();
 }
 
 void CNetConnection::Resend()
@@ -4,6 +4,9 @@
 #include "compression.h"
 #include "uuid_manager.h"
 
+#include <algorithm>
+#include <vector>
+
 // CSnapshot
 
 CSnapshotItem *CSnapshot::GetItem(int Index) const
@@ -173,6 +176,7 @@ CSnapshotDelta::CSnapshotDelta()
 	mem_zero(m_aSnapshotDataUpdates, sizeof(m_aSnapshotDataUpdates));
 	m_SnapshotCurrent = 0;
 	mem_zero(&m_Empty, sizeof(m_Empty));
+	mem_account(MEMTAG_SNAPSHOT_DELTA, sizeof(*this));
 }
 
 CSnapshotDelta::CSnapshotDelta(const CSnapshotDelta &Old)
@@ -182,6 +186,12 @@ CSnapshotDelta::CSnapshotDelta(const CSnapshotDelta &Old)
 	mem_copy(m_aSnapshotDataUpdates, Old.m_aSnapshotDataUpdates, sizeof(m_aSnapshotDataUpdates));
 	mem_copy(&m_SnapshotCurrent, &Old.m_SnapshotCurrent, sizeof(m_SnapshotCurrent));
 	mem_copy(&m_Empty, &Old.m_Empty, sizeof(m_Empty));
+	mem_account(MEMTAG_SNAPSHOT_DELTA, sizeof(*this));
+}
+
+CSnapshotDelta::~CSnapshotDelta()
+{
+	mem_account(MEMTAG_SNAPSHOT_DELTA, -(int64)sizeof(*this));
 }
 
 void CSnapshotDelta::SetStaticsize(int ItemType, int Size)
@@ -436,7 +446,7 @@ void CSnapshotStorage::PurgeAll()
 	while(pHolder)
 	{
 		pNext = pHolder->m_pNext;
-		free(pHolder);
+		mem_free_tagged(pHolder);
 		pHolder = pNext;
 	}
 
@@ -455,7 +465,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 		pNext = pHolder->m_pNext;
 		if(pHolder->m_Tick >= Tick)
 			return; // no more to remove
-		free(pHolder);
+		mem_free_tagged(pHolder);
 
 		// did we come to the end of the list?
 		if(!pNext)
@@ -480,7 +490,7 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 	if(CreateAlt)
 		TotalSize += DataSize;
 
-	CHolder *pHolder = (CHolder *)malloc(TotalSize);
+	CHolder *pHolder = (CHolder *)mem_alloc_tagged(MEMTAG_SNAPSHOTS, TotalSize);
 
 	// set data
 	pHolder->m_Tick = Tick;
@@ -541,6 +551,8 @@ void CSnapshotBuilder::Init(bool Sixup)
 	m_DataSize = 0;
 	m_NumItems = 0;
 	m_Sixup = Sixup;
+	m_Priority = 0;
+	m_NumDropped = 0;
 
 	for(int i = 0; i < m_NumExtendedItemTypes; i++)
 	{
@@ -569,12 +581,59 @@ int CSnapshotBuilder::Finish(void *pSnapData)
 	//dbg_msg("snap", "---------------------------");
 	// flattern and make the snapshot
 	CSnapshot *pSnap = (CSnapshot *)pSnapData;
-	int OffsetSize = sizeof(int) * m_NumItems;
-	pSnap->m_DataSize = m_DataSize;
-	pSnap->m_NumItems = m_NumItems;
-	mem_copy(pSnap->Offsets(), m_aOffsets, OffsetSize);
-	mem_copy(pSnap->DataStart(), m_aData, m_DataSize);
-	return sizeof(CSnapshot) + OffsetSize + m_DataSize;
+	const int MaxSize = CSnapshot::MAX_SIZE - (int)sizeof(CSnapshot);
+	if(m_NumItems < MAX_ITEMS && (int)sizeof(int) * m_NumItems + m_DataSize <= MaxSize)
+	{
+		int OffsetSize = sizeof(int) * m_NumItems;
+		pSnap->m_DataSize = m_DataSize;
+		pSnap->m_NumItems = m_NumItems;
+		mem_copy(pSnap->Offsets(), m_aOffsets, OffsetSize);
+		mem_copy(pSnap->DataStart(), m_aData, m_DataSize);
+		return sizeof(CSnapshot) + OffsetSize + m_DataSize;
+	}
+
+	// over budget, keep the most important items. Items of the same
+	// priority are kept in the order they were added.
+	std::vector<std::pair<int, int> > lOrder(m_NumItems);
+	for(int i = 0; i < m_NumItems; i++)
+		lOrder[i] = std::make_pair(m_aPriorities[i], i);
+	std::sort(lOrder.begin(), lOrder.end());
+
+	std::vector<bool> lKeep(m_NumItems, false);
+	int NumKept = 0;
+	int Size = 0;
+	for(int i = 0; i < m_NumItems && NumKept < MAX_ITEMS - 1; i++)
+	{
+		int Index = lOrder[i].second;
+		int ItemSize = sizeof(int) + StagedItemSize(Index);
+		if(Size + ItemSize > MaxSize)
+			continue;
+		lKeep[Index] = true;
+		NumKept++;
+		Size += ItemSize;
+	}
+
+	// write the kept items in their original order
+	pSnap->m_NumItems = NumKept;
+	int DataSize = 0;
+	for(int i = 0, Kept = 0; i < m_NumItems; i++)
+	{
+		if(!lKeep[i])
+			continue;
+		int ItemSize = StagedItemSize(i);
+		pSnap->Offsets()[Kept++] = DataSize;
+		mem_copy(pSnap->DataStart() + DataSize, GetItem(i), ItemSize);
+		DataSize += ItemSize;
+	}
+	pSnap->m_DataSize = DataSize;
+	m_NumDropped += m_NumItems - NumKept;
+	return sizeof(CSnapshot) + sizeof(int) * NumKept + DataSize;
+}
+
+int CSnapshotBuilder::StagedItemSize(int Index) const
+{
+	int End = Index + 1 < m_NumItems ? m_aOffsets[Index + 1] : m_DataSize;
+	return End - m_aOffsets[Index];
 }
 
 static int GetTypeFromIndex(int Index)
@@ -619,11 +678,12 @@ int CSnapshotBuilder::GetExtendedItemTypeIndex(int TypeID)
 
 void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
 {
-	if(m_DataSize + sizeof(CSnapshotItem) + Size >= CSnapshot::MAX_SIZE ||
-		m_NumItems + 1 >= MAX_ITEMS)
+	if(m_DataSize + sizeof(CSnapshotItem) + Size >= MAX_STAGED_SIZE ||
+		m_NumItems + 1 >= MAX_STAGED_ITEMS)
 	{
-		dbg_assert(m_DataSize < CSnapshot::MAX_SIZE, "too much data");
-		dbg_assert(m_NumItems < MAX_ITEMS, "too many items");
+		dbg_assert(m_DataSize < MAX_STAGED_SIZE, "too much data");
+		dbg_assert(m_NumItems < MAX_STAGED_ITEMS, "too many items");
+		m_NumDropped++;
 		return 0;
 	}
 
@@ -637,6 +697,7 @@ void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
 	mem_zero(pObj, sizeof(CSnapshotItem) + Size);
 	pObj->m_TypeAndID = (Type << 16) | ID;
 	m_aOffsets[m_NumItems] = m_DataSize;
+	m_aPriorities[m_NumItems] = m_Priority;
 	m_DataSize += sizeof(CSnapshotItem) + Size;
 	m_NumItems++;
 
@@ -83,6 +83,7 @@ public:
 	static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size);
 	CSnapshotDelta();
 	CSnapshotDelta(const CSnapshotDelta &Old);
+	~CSnapshotDelta();
 	int GetDataRate(int Index) { return m_aSnapshotDataRate[Index]; }
 	int GetDataUpdates(int Index) { return m_aSnapshotDataUpdates[Index]; }
 	void SetStaticsize(int ItemType, int Size);
@@ -122,25 +123,36 @@ public:
 	int Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
 };
 
+// Items are staged with a priority, lower values are more important. When
+// the staged items don't fit into a snapshot, Finish keeps the most important
+// ones and drops the rest.
 class CSnapshotBuilder
 {
 	enum
 	{
 		MAX_ITEMS = 1024,
 		MAX_EXTENDED_ITEM_TYPES = 64,
+
+		MAX_STAGED_ITEMS = MAX_ITEMS * 2,
+		MAX_STAGED_SIZE = CSnapshot::MAX_SIZE * 2,
 	};
 
-	char m_aData[CSnapshot::MAX_SIZE];
+	char m_aData[MAX_STAGED_SIZE];
 	int m_DataSize;
 
-	int m_aOffsets[MAX_ITEMS];
+	int m_aOffsets[MAX_STAGED_ITEMS];
+	int m_aPriorities[MAX_STAGED_ITEMS];
 	int m_NumItems;
 
+	int m_Priority;
+	int m_NumDropped;
+
 	int m_aExtendedItemTypes[MAX_EXTENDED_ITEM_TYPES];
 	int m_NumExtendedItemTypes;
 
 	void AddExtendedItemType(int Index);
 	int GetExtendedItemTypeIndex(int TypeID);
+	int StagedItemSize(int Index) const; // including the item header
 
 	bool m_Sixup;
 
@@ -149,12 +161,17 @@ public:
 
 	void Init(bool Sixup = false);
 
+	// applies to the items added after it, reset by Init
+	void SetPriority(int Priority) { m_Priority = Priority; }
 	void *NewItem(int Type, int ID, int Size);
 
 	CSnapshotItem *GetItem(int Index);
 	int *GetItemData(int Key);
 
 	int Finish(void *pSnapdata);
+
+	// items left out of the last finished snapshot, or that didn't fit into the staging area
+	int NumDroppedItems() const { return m_NumDropped; }
 };
 
 #endif // ENGINE_SNAPSHOT_H
@@ -437,74 +437,101 @@ int CCollision::GetZoneValueAt(int ZoneHandle, float x, float y)
 
 bool CCollision::AreConnected(vec2 Pos1, vec2 Pos2, float Radius)
 {
-	if(distance(Pos1, Pos2) > Radius)
-		return false;
+	bool Connected;
+	return AreConnected(Pos1, &Pos2, 1, Radius, &Connected) > 0;
+}
+
+int CCollision::AreConnected(vec2 Pos1, const vec2 *pPos2, int NumPos2, float Radius, bool *pConnected)
+{
+	enum
+	{
+		CELL_SOLID=1,
+		CELL_REACHED=2,
+		CELL_TARGET=4,
+	};
 	
 	int TileRadius = std::ceil(Radius/32.0f);
-	int CenterX = TileRadius;
-	int CenterY = TileRadius;
 	int Width = 2*TileRadius+1;
-	int Height = 2*TileRadius+1;
-	char* pMap = new char[Width*Height];
-	for(int j=0; j<Height; j++)
+	int NumCells = Width*Width;
+	if((int)m_lFloodCells.size() < NumCells)
 	{
-		for(int i=0; i<Width; i++)
-		{
-			if(CheckPoint(Pos1.x + 32.0f*(i-CenterX), Pos1.y + 32.0f*(j-CenterY)))
-				pMap[j*Width+i] = 0x0; //This tile can be checked
-			else
-				pMap[j*Width+i] = 0x1;
-		}
+		m_lFloodCells.resize(NumCells);
+		m_lFloodQueue.resize(NumCells);
 	}
+	// solidity is only looked up for the cells the flood gets to
+	mem_zero(&m_lFloodCells[0], NumCells);
 	
-	pMap[CenterY*Width+CenterX] = 0x2; //This tile is checked
+	if((int)m_lFloodTargets.size() < NumPos2)
+		m_lFloodTargets.resize(NumPos2);
 	
-	int Pos2X = clamp(CenterX + (int)round((Pos2.x - Pos1.x)/32.0f), 0, Width-1);
-	int Pos2Y = clamp(CenterY + (int)round((Pos2.y - Pos1.y)/32.0f), 0, Height-1);
+	int NumPending = 0;
+	for(int k=0; k<NumPos2; k++)
+	{
+		pConnected[k] = false;
+		m_lFloodTargets[k] = -1;
+		if(distance(Pos1, pPos2[k]) > Radius)
+			continue;
+		
+		int X = clamp(TileRadius + (int)round((pPos2[k].x - Pos1.x)/32.0f), 0, Width-1);
+		int Y = clamp(TileRadius + (int)round((pPos2[k].y - Pos1.y)/32.0f), 0, Width-1);
+		m_lFloodTargets[k] = Y*Width+X;
+		m_lFloodCells[Y*Width+X] |= CELL_TARGET;
+		NumPending++;
+	}
+	if(!NumPending)
+		return 0;
 	
-	bool Changes = true;
-	while(Changes)
+	// breadth first from the tile of Pos1, which counts as free even inside a wall
+	int NumConnected = 0;
+	int QueueBegin = 0;
+	int QueueEnd = 0;
+	int Center = TileRadius*Width+TileRadius;
+	m_lFloodCells[Center] |= CELL_REACHED;
+	m_lFloodQueue[QueueEnd++] = Center;
+	while(QueueBegin < QueueEnd)
 	{
-		Changes = false;
-		for(int j=0; j<Height; j++)
+		int Cell = m_lFloodQueue[QueueBegin++];
+		int X = Cell%Width;
+		int Y = Cell/Width;
+		
+		if(m_lFloodCells[Cell]&CELL_TARGET)
 		{
-			for(int i=0; i<Width; i++)
+			for(int k=0; k<NumPos2; k++)
 			{
-				if(pMap[j*Width+i]&0x1 && !(pMap[j*Width+i]&0x2))
+				if(m_lFloodTargets[k] == Cell)
 				{
-					if(i>0 && (pMap[j*Width+(i-1)]&0x2))
-					{
-						pMap[j*Width+i] = 0x2;
-						Changes = true;
-					}
-					if(j>0 && (pMap[(j-1)*Width+i]&0x2))
-					{
-						pMap[j*Width+i] = 0x2;
-						Changes = true;
-					}
-					if(i<Width-1 && (pMap[j*Width+(i+1)]&0x2))
-					{
-						pMap[j*Width+i] = 0x2;
-						Changes = true;
-					}
-					if(j<Height-1 && (pMap[(j+1)*Width+i]&0x2))
-					{
-						pMap[j*Width+i] = 0x2;
-						Changes = true;
-					}
+					pConnected[k] = true;
+					NumConnected++;
+					NumPending--;
 				}
 			}
+			if(!NumPending)
+				break;
 		}
 		
-		if(pMap[Pos2Y*Width+Pos2X]&0x2)
+		static const int s_aDirX[4] = {-1, 1, 0, 0};
+		static const int s_aDirY[4] = {0, 0, -1, 1};
+		for(int d=0; d<4; d++)
 		{
-			delete[] pMap;
-			return true;
+			int NextX = X + s_aDirX[d];
+			int NextY = Y + s_aDirY[d];
+			if(NextX < 0 || NextX >= Width || NextY < 0 || NextY >= Width)
+				continue;
+			
+			int Next = NextY*Width+NextX;
+			if(m_lFloodCells[Next]&(CELL_SOLID|CELL_REACHED))
+				continue;
+			if(CheckPoint(Pos1.x + 32.0f*(NextX-TileRadius), Pos1.y + 32.0f*(NextY-TileRadius)))
+			{
+				m_lFloodCells[Next] |= CELL_SOLID;
+				continue;
+			}
+			m_lFloodCells[Next] |= CELL_REACHED;
+			m_lFloodQueue[QueueEnd++] = Next;
 		}
-	}	
+	}
 	
-	delete[] pMap;
-	return false;
+	return NumConnected;
 }
 
 int CCollision::GetPureMapIndex(float x, float y)
@@ -62,6 +62,8 @@ public:
 	bool CheckPhysicsFlag(vec2 Pos, int Flag);
 	
 	bool AreConnected(vec2 Pos1, vec2 Pos2, float Radius);
+	// floods once from Pos1 for all the positions, returns how many of them are connected
+	int AreConnected(vec2 Pos1, const vec2 *pPos2, int NumPos2, float Radius, bool *pConnected);
 /* INFECTION MODIFICATION END *****************************************/
 
 	int GetPureMapIndex(float x, float y);
@@ -75,6 +77,11 @@ public:
 private:
 	class CTeleTile *m_pTele;
 	std::map<int, std::vector<vec2>> m_TeleOuts;
+
+	// scratch space of AreConnected, kept between calls
+	std::vector<unsigned char> m_lFloodCells;
+	std::vector<int> m_lFloodQueue;
+	std::vector<int> m_lFloodTargets;
 };
 
 #endif
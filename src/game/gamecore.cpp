@@ -62,6 +62,29 @@ float VelocityRamp(float Value, float Start, float Range, float Curvature)
 const float CCharacterCore::PhysicalSize = 28.0f;
 const float CCharacterCore::PassengerYOffset = -50;
 
+int CWorldCore::FindCharacters(vec2 Min, vec2 Max, int *pIDs, const CCharacterCore *pExcept, int AlsoID) const
+{
+	int Num = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CCharacterCore *pCharCore = m_apCharacters[i];
+		if(!pCharCore || pCharCore == pExcept)
+			continue;
+		const vec2 Pos = pCharCore->m_Pos;
+		if(i == AlsoID || (Pos.x >= Min.x && Pos.x <= Max.x && Pos.y >= Min.y && Pos.y <= Max.y))
+			pIDs[Num++] = i;
+	}
+	return Num;
+}
+
+// box around a segment, with a bit of slack for rounding in the exact checks
+static void SegmentBox(vec2 From, vec2 To, float Radius, vec2 *pMin, vec2 *pMax)
+{
+	Radius += 1.0f;
+	*pMin = vec2(minimum(From.x, To.x) - Radius, minimum(From.y, To.y) - Radius);
+	*pMax = vec2(maximum(From.x, To.x) + Radius, maximum(From.y, To.y) + Radius);
+}
+
 void CCharacterCore::Init(CWorldCore *pWorld, CCollision *pCollision)
 {
 	m_pWorld = pWorld;
@@ -229,11 +252,17 @@ void CCharacterCore::Tick(bool UseInput, CParams* pParams)
 		}
 
 		// Check against other players first
-		if(m_pWorld)
+		if(m_pWorld && !m_IsPassenger && !m_InLove)
 		{
+			vec2 Min, Max;
+			SegmentBox(m_HookPos, NewPos, PhysicalSize + 2.0f, &Min, &Max);
+			int aIDs[MAX_CLIENTS];
+			int NumIDs = m_pWorld->FindCharacters(Min, Max, aIDs, this);
+
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			for(int c = 0; c < NumIDs; c++)
 			{
+				int i = aIDs[c];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 				if (IsRecursePassenger(pCharCore))
 					continue;
@@ -338,8 +367,15 @@ void CCharacterCore::Tick(bool UseInput, CParams* pParams)
 
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		// only close characters collide, the hooked one is pulled from any distance
+		vec2 Min, Max;
+		SegmentBox(m_Pos, m_Pos, PhysicalSize * 1.25f, &Min, &Max);
+		int aIDs[MAX_CLIENTS];
+		int NumIDs = m_pWorld->FindCharacters(Min, Max, aIDs, this, m_HookedPlayer);
+
+		for(int c = 0; c < NumIDs; c++)
 		{
+			int i = aIDs[c];
 			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 			if(!pCharCore)
 				continue;
@@ -430,16 +466,22 @@ void CCharacterCore::Move(CParams* pParams)
 	if(m_pWorld && !pTuningParams->m_PlayerCollision)
 	{
 		// check player collision
+		vec2 Min, Max;
+		SegmentBox(m_Pos, NewPos, 28.0f, &Min, &Max);
+		int aIDs[MAX_CLIENTS];
+		int NumIDs = m_pWorld->FindCharacters(Min, Max, aIDs, this);
+
+		// nobody close, the path doesn't have to be walked
 		float Distance = distance(m_Pos, NewPos);
-		int End = Distance+1;
+		int End = NumIDs ? Distance+1 : 0;
 		vec2 LastPos = m_Pos;
 		for(int i = 0; i < End; i++)
 		{
 			float a = i/Distance;
 			vec2 Pos = mix(m_Pos, NewPos, a);
-			for(int p = 0; p < MAX_CLIENTS; p++)
+			for(int c = 0; c < NumIDs; c++)
 			{
-				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
+				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[aIDs[c]];
 				if(!pCharCore || pCharCore == this)
 					continue;
 				if (!m_Infected && !pCharCore->m_Infected)
@@ -200,6 +200,14 @@ public:
 
 	CTuningParams m_Tuning;
 	class CCharacterCore *m_apCharacters[MAX_CLIENTS];
+
+	// Broadphase for the player-vs-player checks: fills pIDs with the ids of
+	// the characters inside the box, in ascending order so the exact checks
+	// run in the same order as a loop over all clients. pExcept, the asking
+	// character, is left out and AlsoID is added even if it's outside the box.
+	// Positions are written from many places during a tick, so the box test
+	// always runs on the current positions.
+	int FindCharacters(vec2 Min, vec2 Max, int *pIDs, const class CCharacterCore *pExcept, int AlsoID = -1) const;
 };
 
 class CCharacterCore
@@ -11,13 +11,13 @@
 public: \
 	void *operator new(size_t Size) \
 	{ \
-		void *p = malloc(Size); \
+		void *p = mem_alloc_tagged(MEMTAG_ENTITIES, Size); \
 		mem_zero(p, Size); \
 		return p; \
 	} \
 	void operator delete(void *pPtr) \
 	{ \
-		free(pPtr); \
+		mem_free_tagged(pPtr); \
 	} \
 \
 private:
@@ -3,6 +3,7 @@
 #include "eventhandler.h"
 #include "gamecontext.h"
 
+#include <engine/shared/metrics.h>
 #include <game/server/player.h>
 
 //////////////////////////////////////////////////
@@ -21,10 +22,12 @@ void CEventHandler::SetGameServer(CGameContext *pGameServer)
 
 void *CEventHandler::Create(int Type, int Size, int64 Mask)
 {
-	if(m_NumEvents == MAX_EVENTS)
-		return 0;
-	if(m_CurrentOffset+Size >= MAX_DATASIZE)
+	static CMetricCounter *s_pDroppedMetric = g_Metrics.RegisterCounter("infclass_events_dropped_total", "Events dropped because the event buffer was full");
+	if(m_NumEvents == MAX_EVENTS || m_CurrentOffset+Size >= MAX_DATASIZE)
+	{
+		s_pDroppedMetric->Add();
 		return 0;
+	}
 
 	void *p = &m_aData[m_CurrentOffset];
 	m_aOffsets[m_NumEvents] = m_CurrentOffset;
@@ -49,12 +52,15 @@ void CEventHandler::Snap(int SnappingClient)
 		if(SnappingClient == -1 || CmaskIsSet(m_aClientMasks[i], SnappingClient))
 		{
 			CNetEvent_Common *ev = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
-			if(SnappingClient == -1 || distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, vec2(ev->m_X, ev->m_Y)) < 1500.0f)
+			float Distance = SnappingClient == -1 ? 0.0f : distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, vec2(ev->m_X, ev->m_Y));
+			if(Distance < 1500.0f)
 			{
+				GameServer()->Server()->SnapSetPriority(IServer::SNAP_PRIORITY_EVENT, Distance);
 				void *d = GameServer()->Server()->SnapNewItem(m_aTypes[i], i, m_aSizes[i]);
 				if(d)
 					mem_copy(d, &m_aData[m_aOffsets[i]], m_aSizes[i]);
 			}
 		}
 	}
+	GameServer()->Server()->SnapSetPriority(IServer::SNAP_PRIORITY_CRITICAL);
 }
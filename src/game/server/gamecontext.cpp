@@ -931,9 +931,7 @@ void CGameContext::SendTuningParams(int ClientID)
 	CheckPureTuning();
 
 	CMsgPacker Msg(NETMSGTYPE_SV_TUNEPARAMS);
-	int *pParams = (int *)&m_Tuning;
-	for(unsigned i = 0; i < sizeof(m_Tuning)/sizeof(int); i++)
-		Msg.AddInt(pParams[i]);
+	m_TuningProfiles.Pack(m_TuningProfiles.Intern(&m_Tuning), &Msg);
 	Server()->SendMsg(&Msg, MSGFLAG_VITAL, ClientID);
 }
 
@@ -4300,9 +4298,7 @@ void CGameContext::OnSnap(int ClientID)
 	if(ClientID == -1 && Server()->DemoRecorder_IsRecording() && mem_comp(&StandardTuning, &m_Tuning, sizeof(CTuningParams)) != 0)
 	{
 		CMsgPacker Msg(NETMSGTYPE_SV_TUNEPARAMS);
-		int *pParams = (int *)&m_Tuning;
-		for(unsigned i = 0; i < sizeof(m_Tuning)/sizeof(int); i++)
-			Msg.AddInt(pParams[i]);
+		m_TuningProfiles.Pack(m_TuningProfiles.Intern(&m_Tuning), &Msg);
 		Server()->SendMsg(&Msg, MSGFLAG_RECORD|MSGFLAG_NOSEND, ClientID);
 	}
 
@@ -4312,6 +4308,7 @@ void CGameContext::OnSnap(int ClientID)
 
 /* INFECTION MODIFICATION START ***************************************/
 	//Snap laser dots
+	Server()->SnapSetPriority(IServer::SNAP_PRIORITY_COSMETIC);
 	for(int i=0; i < m_LaserDots.size(); i++)
 	{
 		if(ClientID >= 0)
@@ -4381,6 +4378,7 @@ void CGameContext::OnSnap(int ClientID)
 			pObj->m_Subtype = 0;
 		}
 	}
+	Server()->SnapSetPriority(IServer::SNAP_PRIORITY_CRITICAL);
 /* INFECTION MODIFICATION END *****************************************/
 	
 	for(int i = 0; i < MAX_CLIENTS; i++)
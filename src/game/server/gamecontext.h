@@ -22,6 +22,7 @@
 #include "eventhandler.h"
 #include "gamecontroller.h"
 #include "gameworld.h"
+#include "tuningprofiles.h"
 
 #include <fstream>
 
@@ -85,6 +86,7 @@ class CGameContext : public IGameServer
 	CCollision m_Collision;
 	CNetObjHandler m_NetObjHandler;
 	CTuningParams m_Tuning;
+	CTuningProfiles m_TuningProfiles;
 	int m_HeroGiftCooldown;
 
 	static bool ConTuneParam(IConsole::IResult *pResult, void *pUserData);
@@ -127,6 +129,7 @@ public:
 	CGameWorld *GameWorld() { return &m_World; }
 	CCollision *Collision() { return &m_Collision; }
 	CTuningParams *Tuning() { return &m_Tuning; }
+	CTuningProfiles *TuningProfiles() { return &m_TuningProfiles; }
 	virtual class CLayers *Layers() { return &m_Layers; }
 
 	CGameContext();
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <utility>
 #include <engine/shared/config.h>
+#include <engine/shared/metrics.h>
 #include <game/server/player.h>
 
 //////////////////////////////////////////////////
@@ -22,6 +23,20 @@ CGameWorld::CGameWorld()
 	m_ResetRequested = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		m_apFirstEntityTypes[i] = 0;
+
+	static const char *s_apTypeNames[NUM_ENTTYPES] = {
+		"projectile", "laser", "growing_explosion", "flying_point", "character",
+		"engineer_wall", "soldier_bomb", "scientist_mine", "scientist_laser", "mercenary_bomb",
+		"scatter_grenade", "medic_grenade", "hero_flag", "biologist_mine", "slug_slime",
+		"bouncing_bullet", "looper_wall", "white_hole", "superweapon_indicator", "laser_teleport",
+		"turret", "plasma",
+	};
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		char aLabels[64];
+		str_format(aLabels, sizeof(aLabels), "type=\"%s\"", s_apTypeNames[i]);
+		m_apEntityMetrics[i] = g_Metrics.RegisterGauge("infclass_entities", "Entities in the game world", aLabels);
+	}
 }
 
 CGameWorld::~CGameWorld()
@@ -108,15 +123,35 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 }
 
 //
+static int SnapPriorityClass(int EntType)
+{
+	switch(EntType)
+	{
+	case CGameWorld::ENTTYPE_CHARACTER:
+		return IServer::SNAP_PRIORITY_CHARACTER;
+	case CGameWorld::ENTTYPE_FLYINGPOINT:
+	case CGameWorld::ENTTYPE_SUPERWEAPON_INDICATOR:
+		return IServer::SNAP_PRIORITY_COSMETIC;
+	default:
+		return IServer::SNAP_PRIORITY_GAMEPLAY;
+	}
+}
+
 void CGameWorld::Snap(int SnappingClient)
 {
+	const CPlayer *pViewer = SnappingClient >= 0 ? GameServer()->m_apPlayers[SnappingClient] : 0;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		int Class = SnapPriorityClass(i);
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			Server()->SnapSetPriority(Class, pViewer ? distance(pViewer->m_ViewPos, pEnt->GetPos()) : 0.0f);
 			pEnt->Snap(SnappingClient);
 			pEnt = m_pNextTraverseEntity;
 		}
+	}
+	Server()->SnapSetPriority(IServer::SNAP_PRIORITY_CRITICAL);
 }
 
 void CGameWorld::Reset()
@@ -222,6 +257,17 @@ void CGameWorld::UpdatePlayerMaps()
 	}
 }
 
+void CGameWorld::UpdateMetrics()
+{
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		int NumEntities = 0;
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			NumEntities++;
+		m_apEntityMetrics[i]->Set(NumEntities);
+	}
+}
+
 void CGameWorld::Tick()
 {
 	if(m_ResetRequested)
@@ -263,6 +309,9 @@ void CGameWorld::Tick()
 	RemoveEntities();
 
 	UpdatePlayerMaps();
+
+	if(Server()->Tick() % Server()->TickSpeed() == 0)
+		UpdateMetrics();
 }
 
 CEntity *CGameWorld::IntersectEntity(vec2 Pos0, vec2 Pos1, float Radius, vec2 *NewPos, int EntityType, EntityFilter FilterFunction)
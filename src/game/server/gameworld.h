@@ -57,6 +57,9 @@ private:
 	class IServer *m_pServer;
 
 	void UpdatePlayerMaps();
+	void UpdateMetrics();
+
+	class CMetricGauge *m_apEntityMetrics[NUM_ENTTYPES];
 
 public:
 	class CGameContext *GameServer() { return m_pGameServer; }
@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <game/server/gamecontext.h>
 #include <engine/shared/config.h>
+#include <game/server/infclass/particles.h>
 
 #include "biologist-mine.h"
 #include "biologist-laser.h"
@@ -52,11 +53,11 @@ void CBiologistMine::Snap(int SnappingClient)
 			return;
 	}
 
-	float AngleStep = 2.0f * pi / CBiologistMine::NUM_SIDE;
-	float Radius = 32.0f;
+	vec2 aVertices[CBiologistMine::NUM_SIDE];
+	CirclePoints(m_Pos, 32.0f, 0.0f, CBiologistMine::NUM_SIDE, aVertices);
 	for(int i=0; i<CBiologistMine::NUM_SIDE; i++)
 	{
-		vec2 VertexPos = m_Pos + vec2(Radius * cos(AngleStep*i), Radius * sin(AngleStep*i));
+		vec2 VertexPos = aVertices[i];
 		
 		CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(Server()->SnapNewItem(NETOBJTYPE_LASER, m_IDs[i], sizeof(CNetObj_Laser)));
 		if(!pObj)
@@ -7,6 +7,7 @@
 
 #include <game/server/infclass/damage_type.h>
 #include <game/server/infclass/infcgamecontroller.h>
+#include <game/server/infclass/particles.h>
 
 #include "growingexplosion.h"
 #include "infccharacter.h"
@@ -115,11 +116,12 @@ void CMercenaryBomb::Snap(int SnappingClient)
 	}
 
 	float AngleStart = (2.0f * pi * Server()->Tick()/static_cast<float>(Server()->TickSpeed()))/10.0f;
-	float AngleStep = 2.0f * pi / CMercenaryBomb::NUM_SIDE;
 	float R = 50.0f*static_cast<float>(m_Damage)/Config()->m_InfMercBombs;
+	vec2 aVertices[CMercenaryBomb::NUM_SIDE];
+	CirclePoints(m_Pos, R, AngleStart, CMercenaryBomb::NUM_SIDE, aVertices);
 	for(int i=0; i<CMercenaryBomb::NUM_SIDE; i++)
 	{
-		vec2 PosStart = m_Pos + vec2(R * cos(AngleStart + AngleStep*i), R * sin(AngleStart + AngleStep*i));
+		vec2 PosStart = aVertices[i];
 
 		CNetObj_Pickup *pP = static_cast<CNetObj_Pickup *>(Server()->SnapNewItem(NETOBJTYPE_PICKUP, m_IDs[i], sizeof(CNetObj_Pickup)));
 		if(!pP)
@@ -135,10 +137,10 @@ void CMercenaryBomb::Snap(int SnappingClient)
 	{
 		R = GetMaxRadius();
 		AngleStart = AngleStart*2.0f;
+		CirclePoints(m_Pos, R, AngleStart, CMercenaryBomb::NUM_SIDE, aVertices);
 		for(int i=0; i<CMercenaryBomb::NUM_SIDE; i++)
 		{
-			vec2 PosStart = m_Pos + vec2(R * cos(AngleStart + AngleStep*i), R * sin(AngleStart + AngleStep*i));
-			GameController()->SendHammerDot(PosStart, m_IDs[CMercenaryBomb::NUM_SIDE+i]);
+			GameController()->SendHammerDot(aVertices[i], m_IDs[CMercenaryBomb::NUM_SIDE+i]);
 		}
 	}
 }
@@ -25,13 +25,27 @@ void CSlugSlime::Tick()
 		return;
 	}
 	
-	// Find other players
-	for(CInfClassCharacter *p = (CInfClassCharacter*) GameWorld()->FindFirst(CGameWorld::ENTTYPE_CHARACTER); p; p = (CInfClassCharacter *)p->TypeNext())
+	// Find other players, all of them are checked with a single flood from the slime
+	CInfClassCharacter *apCharacters[MAX_CLIENTS];
+	vec2 aPositions[MAX_CLIENTS];
+	bool aConnected[MAX_CLIENTS];
+	int NumCharacters = 0;
+	for(CInfClassCharacter *p = (CInfClassCharacter*) GameWorld()->FindFirst(CGameWorld::ENTTYPE_CHARACTER); p && NumCharacters < MAX_CLIENTS; p = (CInfClassCharacter *)p->TypeNext())
 	{
-		if(!GameServer()->Collision()->AreConnected(p->m_Pos, m_Pos, 84.0f))
-			continue; // not in reach
-		
-		p->GetClass()->OnSlimeEffect(m_Owner);
+		apCharacters[NumCharacters] = p;
+		aPositions[NumCharacters] = p->m_Pos;
+		NumCharacters++;
+	}
+	
+	if(GameServer()->Collision()->AreConnected(m_Pos, aPositions, NumCharacters, 84.0f, aConnected))
+	{
+		for(int i = 0; i < NumCharacters; i++)
+		{
+			if(!aConnected[i])
+				continue; // not in reach
+			
+			apCharacters[i]->GetClass()->OnSlimeEffect(m_Owner);
+		}
 	}
 	
 	if((m_LifeSpan % 20) == 0)
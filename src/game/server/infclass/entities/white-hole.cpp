@@ -7,6 +7,7 @@
 
 #include <game/server/infclass/damage_type.h>
 #include <game/server/infclass/infcgamecontroller.h>
+#include <game/server/player.h>
 
 #include "growingexplosion.h"
 #include "infccharacter.h"
@@ -23,8 +24,8 @@ CWhiteHole::CWhiteHole(CGameContext *pGameContext, vec2 CenterPos, int Owner)
 
 	m_NumParticles = Config()->m_InfWhiteHoleNumParticles;
 	m_IDs = new int[m_NumParticles];
-	m_ParticlePos = new vec2[m_NumParticles];
-	m_ParticleVec = new vec2[m_NumParticles];
+	m_Particles.Resize(m_NumParticles);
+	m_lParticleIndices.resize(m_NumParticles);
 	for(int i=0; i<m_NumParticles; i++)
 	{
 		m_IDs[i] = Server()->SnapNewID();
@@ -46,8 +47,6 @@ CWhiteHole::~CWhiteHole()
 		Server()->SnapFreeID(m_IDs[i]);
 	}
 	delete[] m_IDs;
-	delete[] m_ParticlePos;
-	delete[] m_ParticleVec;
 }
 
 void CWhiteHole::StartVisualEffect()
@@ -61,8 +60,7 @@ void CWhiteHole::StartVisualEffect()
 		RandomAngle = 2.0f * pi * random_float();
 		VecX = cos(RandomAngle);
 		VecY = sin(RandomAngle);
-		m_ParticlePos[i] = m_Pos + vec2(RandomRadius * VecX, RandomRadius * VecY);
-		m_ParticleVec[i] = vec2(-VecX, -VecY);
+		m_Particles.Set(i, m_Pos + vec2(RandomRadius * VecX, RandomRadius * VecY), vec2(-VecX, -VecY));
 	}
 	// find out how long it takes for a particle to reach the mid
 	RandomRadius = random_float()*(Radius-4.0f);
@@ -116,43 +114,36 @@ void CWhiteHole::Snap(int SnappingClient)
 	}
 
 	// Draw full particle effect - if anti ping is not set to true
-	for(int i=0; i<m_NumParticles; i++)
+	// only the particles inside the radius during the start animation, and only those the client can see
+	float MaxDistance = isDieing ? Config()->m_InfWhiteHoleRadius * 2.0f : m_Radius;
+	vec2 ViewPos = SnappingClient == -1 ? m_Pos : GameServer()->m_apPlayers[SnappingClient]->m_ViewPos;
+	int NumVisible = m_Particles.Visible(m_Pos, MaxDistance, ViewPos, m_lParticleIndices.data());
+	for(int i=0; i<NumVisible; i++)
 	{
-		if(!isDieing && distance(m_ParticlePos[i], m_Pos) > m_Radius)
-			continue; // start animation
-
-		GameController()->SendHammerDot(m_ParticlePos[i], m_IDs[i]);
+		int Index = m_lParticleIndices[i];
+		GameController()->SendHammerDot(m_Particles.Pos(Index), m_IDs[Index]);
 	}
 }
 
 void CWhiteHole::MoveParticles()
 {
 	float Radius = Config()->m_InfWhiteHoleRadius;
-	float RandomAngle, Speed;
+	float RandomAngle;
 	float VecX, VecY;
-	vec2 VecMid;
-	for(int i=0; i<m_NumParticles; i++)
+	int NumArrived = m_Particles.PullTowards(m_Pos, Radius, m_ParticleStartSpeed, m_ParticleAcceleration, m_lParticleIndices.data());
+	for(int i=0; i<NumArrived; i++)
 	{
-		VecMid = m_Pos - m_ParticlePos[i];
-		Speed = m_ParticleStartSpeed * clamp(1.0f-length(VecMid)/Radius+0.5f, 0.0f, 1.0f);
-		m_ParticlePos[i] += vec2(m_ParticleVec[i].x*Speed, m_ParticleVec[i].y*Speed); 
-		if (dot(VecMid, m_ParticleVec[i]) <= 0)
+		int Index = m_lParticleIndices[i];
+		if (m_LifeSpan < m_ParticleStopTickTime)
 		{
-			if (m_LifeSpan < m_ParticleStopTickTime)
-			{
-				// make particles disappear
-				m_ParticlePos[i] = vec2(-99999.0f, -99999.0f);
-				m_ParticleVec[i] = vec2(0.0f, 0.0f);
-				continue;
-			}
-			RandomAngle = 2.0f * pi * random_float();
-			VecX = cos(RandomAngle);
-			VecY = sin(RandomAngle);
-			m_ParticlePos[i] = m_Pos + vec2(Radius * VecX, Radius * VecY);
-			m_ParticleVec[i] = vec2(-VecX, -VecY);
+			// make particles disappear
+			m_Particles.Set(Index, vec2(-99999.0f, -99999.0f), vec2(0.0f, 0.0f));
 			continue;
 		}
-		m_ParticleVec[i] *= m_ParticleAcceleration; 
+		RandomAngle = 2.0f * pi * random_float();
+		VecX = cos(RandomAngle);
+		VecY = sin(RandomAngle);
+		m_Particles.Set(Index, m_Pos + vec2(Radius * VecX, Radius * VecY), vec2(-VecX, -VecY));
 	}
 }
 
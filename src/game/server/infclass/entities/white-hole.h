@@ -5,6 +5,10 @@
 
 #include "infcentity.h"
 
+#include <game/server/infclass/particles.h>
+
+#include <vector>
+
 class CWhiteHole : public CInfCEntity
 {
 private:
@@ -34,8 +38,8 @@ private:
 
 	int m_NumParticles; // will be set with a config var
 	int *m_IDs;
-	vec2 *m_ParticlePos;
-	vec2 *m_ParticleVec;
+	CParticleSet m_Particles;
+	std::vector<int> m_lParticleIndices; // scratch space for the particle kernels
 
 	bool isDieing;
 	
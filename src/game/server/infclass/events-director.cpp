@@ -15,11 +15,12 @@ enum class EventType
 	Winter,
 };
 
-static EventType PreloadedMapEventType = EventType::None;
+// per thread so that several maps can be converted at once
+static thread_local EventType PreloadedMapEventType = EventType::None;
 
 const char *EventsDirector::GetMapConverterId(const char *pConverterId)
 {
-	static char CustomId[32] = { 0 };
+	static thread_local char CustomId[32] = { 0 };
 	if(PreloadedMapEventType == EventType::Winter)
 	{
 		if(CustomId[0] == 0)
@@ -8,6 +8,7 @@ MACRO_CONFIG_STR(AboutContactsMatrix, about_contacts_matrix, 128, "https://infcl
 
 MACRO_CONFIG_STR(InfConverterId, inf_converter_id, 16, "v2", CFGFLAG_SERVER, "Map converter version id")
 MACRO_CONFIG_INT(InfConverterForceRegeneration, inf_converter_force_regeneration, 0, 0, 1, CFGFLAG_SERVER, "Always (re)generate client map (regardless of cache)")
+MACRO_CONFIG_INT(InfConverterThreads, inf_converter_threads, 4, 1, 16, CFGFLAG_SERVER, "Number of threads compressing the generated client map")
 MACRO_CONFIG_INT(SvTimelimitInSeconds, sv_timelimit_in_seconds, 0, 0, 10000, CFGFLAG_SERVER, "Time limit in seconds (0 means 'fallback to sv_timelimit')")
 MACRO_CONFIG_INT(InfInactiveHumansKickTime, inf_inactive_humans_kick_time, 180, 0, 10000, CFGFLAG_SERVER, "How many seconds to wait before taking care of inactive humans")
 MACRO_CONFIG_INT(InfInactiveInfectedKickTime, inf_inactive_infected_kick_time, 30, 0, 10000, CFGFLAG_SERVER, "How many seconds to wait before taking care of inactive infected")
@@ -17,6 +18,10 @@ MACRO_CONFIG_STR(InfEvent, inf_event, 64, "", CFGFLAG_SERVER, "Special event")
 
 MACRO_CONFIG_INT(InfMinPlayers, inf_min_players, 2, 0, 64, CFGFLAG_SERVER, "Minimum number of players to start the round")
 MACRO_CONFIG_INT(InfChallenge, inf_challenge, 0, 0, 1, CFGFLAG_SERVER, "Enable challenges")
+MACRO_CONFIG_STR(InfSqlStatsJournal, inf_sql_stats_journal, 128, "sql_stats_journal.sql", CFGFLAG_SERVER, "File to keep round statistics in while no sql server is reachable")
+MACRO_CONFIG_INT(InfSqlStatsJournalMaxSize, inf_sql_stats_journal_max_size, 4096, 0, 1048576, CFGFLAG_SERVER, "Size (in KiB) the statistics journal can grow to, later rounds are dropped (0 for no limit)")
+MACRO_CONFIG_INT(InfAccountSessionTime, inf_account_session_time, 300, 0, 3600, CFGFLAG_SERVER, "How long (in seconds) a client dropping out stays logged in if it connects again from the same address (0 to disable)")
+MACRO_CONFIG_INT(InfLeaderboardCacheTTL, inf_leaderboard_cache_ttl, 300, 0, 86400, CFGFLAG_SERVER, "How long (in seconds) leaderboards are answered from memory before they are loaded again")
 MACRO_CONFIG_INT(InfAccusationThreshold, inf_accusation_threshold, 4, 1, 8, CFGFLAG_SERVER, "Number of accusations needed to start a banvote")
 MACRO_CONFIG_INT(InfLeaverBanTime, inf_leaver_ban_time, 5, 0, 180, CFGFLAG_SERVER, "How long an infected gets banned (in minutes), when leaving and leaving causes a human to get infected")
 MACRO_CONFIG_INT(InfFastDownload, inf_fast_download, 1, 0, 1, CFGFLAG_SERVER, "Enables fast download of maps")
@@ -29,6 +29,10 @@
 
 const int InfClassModeSpecialSkip = 0x100;
 
+// a tee closer than this to a spawn position blocks it
+const float SpawnDistance = 60.0f;
+const float SpawnOccupancyCellSize = 64.0f;
+
 const char *toString(ROUND_TYPE RoundType)
 {
 	switch(RoundType)
@@ -47,7 +51,7 @@ const char *toString(ROUND_TYPE RoundType)
 }
 
 CInfClassGameController::CInfClassGameController(class CGameContext *pGameServer)
-: IGameController(pGameServer)
+: IGameController(pGameServer), m_SpawnOccupancy(SpawnOccupancyCellSize)
 {
 	m_pGameType = "InfClassR";
 	
@@ -193,6 +197,15 @@ bool CInfClassGameController::OnEntity(const char* pName, vec2 Pivot, vec2 P0, v
 {
 	bool res = IGameController::OnEntity(pName, Pivot, P0, P1, P2, P3, PosEnv);
 
+	if(str_comp(pName, "icInfected") == 0 || str_comp(pName, "icHuman") == 0)
+	{
+		// the tiles don't change during a map, a spawn point in a wall never becomes usable
+		vec2 Pos = (P0 + P1 + P2 + P3)/4.0f;
+		int Type = str_comp(pName, "icInfected") == 0 ? 0 : 1;
+		if(IsClearOfCollisions(Pos, 0))
+			m_ValidSpawnPoints[Type].add(Pos);
+	}
+
 	if(str_comp(pName, "icInfected") == 0)
 	{
 		vec2 Pos = (P0 + P1 + P2 + P3)/4.0f;
@@ -2504,15 +2517,20 @@ bool CInfClassGameController::IsSpawnable(vec2 Pos, int TeleZoneIndex)
 	
 	for(int c = 0; c < Num; ++c)
 	{
-		if(distance(aEnts[c]->m_Pos, Pos) <= 60)
+		if(distance(aEnts[c]->m_Pos, Pos) <= SpawnDistance)
 			return false;
 	}
 	
+	return IsClearOfCollisions(Pos, TeleZoneIndex);
+}
+
+bool CInfClassGameController::IsClearOfCollisions(vec2 Pos, int TeleZoneIndex)
+{
 	//Check the center
-	int TeleIndex = GameServer()->Collision()->GetZoneValueAt(GameServer()->m_ZoneHandle_icTeleport, Pos);
 	if(GameServer()->Collision()->CheckPoint(Pos))
 		return false;
-	if(TeleZoneIndex && TeleIndex == TeleZoneIndex)
+	// the zones can be animated, they are only looked up when they matter
+	if(TeleZoneIndex && GameServer()->Collision()->GetZoneValueAt(GameServer()->m_ZoneHandle_icTeleport, Pos) == TeleZoneIndex)
 		return false;
 	
 	//Check the border of the tee. Kind of extrem, but more precise
@@ -2520,16 +2538,26 @@ bool CInfClassGameController::IsSpawnable(vec2 Pos, int TeleZoneIndex)
 	{
 		float Angle = i * (2.0f * pi / 16.0f);
 		vec2 CheckPos = Pos + vec2(cos(Angle), sin(Angle)) * 30.0f;
-		TeleIndex = GameServer()->Collision()->GetZoneValueAt(GameServer()->m_ZoneHandle_icTeleport, CheckPos);
 		if(GameServer()->Collision()->CheckPoint(CheckPos))
 			return false;
-		if(TeleZoneIndex && TeleIndex == TeleZoneIndex)
+		if(TeleZoneIndex && GameServer()->Collision()->GetZoneValueAt(GameServer()->m_ZoneHandle_icTeleport, CheckPos) == TeleZoneIndex)
 			return false;
 	}
 	
 	return true;
 }
 
+void CInfClassGameController::UpdateSpawnOccupancy()
+{
+	if(m_SpawnOccupancyTick == Server()->Tick())
+		return;
+	
+	m_SpawnOccupancyTick = Server()->Tick();
+	m_SpawnOccupancy.Clear();
+	for(CCharacter *pCharacter = (CCharacter *)GameServer()->m_World.FindFirst(CGameWorld::ENTTYPE_CHARACTER); pCharacter; pCharacter = (CCharacter *)pCharacter->TypeNext())
+		m_SpawnOccupancy.Add(pCharacter->m_Pos);
+}
+
 bool CInfClassGameController::TryRespawn(CInfClassPlayer *pPlayer, SpawnContext *pContext)
 {
 	// spectators can't spawn
@@ -2569,6 +2597,8 @@ bool CInfClassGameController::TryRespawn(CInfClassPlayer *pPlayer, SpawnContext
 			if(pInfected->FindWitchSpawnPosition(pContext->SpawnPos))
 			{
 				pContext->SpawnType = SpawnContext::WitchSpawn;
+				UpdateSpawnOccupancy();
+				m_SpawnOccupancy.Add(pContext->SpawnPos);
 				return true;
 			}
 		}
@@ -2582,15 +2612,21 @@ bool CInfClassGameController::TryRespawn(CInfClassPlayer *pPlayer, SpawnContext
 		return false;
 	}
 
-	// get spawn point
-	int RandomShift = random_int(0, m_SpawnPoints[Type].size()-1);
-	for(int i = 0; i < m_SpawnPoints[Type].size(); i++)
+	if(m_ValidSpawnPoints[Type].size() == 0)
+		return false;
+
+	// get spawn point, the walls were checked at the map loading, only the other tees are left
+	UpdateSpawnOccupancy();
+	int RandomShift = random_int(0, m_ValidSpawnPoints[Type].size()-1);
+	for(int i = 0; i < m_ValidSpawnPoints[Type].size(); i++)
 	{
-		int I = (i + RandomShift)%m_SpawnPoints[Type].size();
-		if(IsSpawnable(m_SpawnPoints[Type][I], 0))
+		int I = (i + RandomShift)%m_ValidSpawnPoints[Type].size();
+		if(!m_SpawnOccupancy.IsOccupied(m_ValidSpawnPoints[Type][I], SpawnDistance))
 		{
-			pContext->SpawnPos = m_SpawnPoints[Type][I];
+			pContext->SpawnPos = m_ValidSpawnPoints[Type][I];
 			pContext->SpawnType = SpawnContext::WitchSpawn;
+			// the character is added to the world right after, the next spawns of this tick have to see it
+			m_SpawnOccupancy.Add(pContext->SpawnPos);
 			return true;
 		}
 	}
@@ -4,6 +4,7 @@
 #define GAME_SERVER_INFCLASS_GAMECONTROLLER_H
 
 #include <game/server/gamecontroller.h>
+#include <game/server/infclass/occupancygrid.h>
 
 #include <base/tl/array_on_stack.h>
 #include <engine/console.h>
@@ -167,12 +168,21 @@ private:
 	int RandomZombieToWitch();
 	ClientsArray m_WitchCallers;
 
+	bool IsClearOfCollisions(vec2 Pos, int TeleZoneIndex);
+	void UpdateSpawnOccupancy();
+
 private:
 	int m_MapWidth;
 	int m_MapHeight;
 	int* m_GrowingMap;
 	bool m_ExplosionStarted;
 
+	// the spawn points that are not in a wall, checked once when the map is loaded
+	array<vec2> m_ValidSpawnPoints[2];
+	// characters and the spawns of this tick, built again on the first respawn of a tick
+	COccupancyGrid m_SpawnOccupancy;
+	int m_SpawnOccupancyTick = -1;
+
 	int m_TargetToKill;
 	int m_TargetToKillCoolDown;
 
@@ -16,6 +16,11 @@ CInfClassPlayer::CInfClassPlayer(CInfClassGameController *pGameController, int C
 	: CPlayer(pGameController->GameServer(), ClientID, Team)
 	, m_pGameController(pGameController)
 {
+	for(CEncodedClan &Clan : m_aEncodedClans)
+		Clan.m_Key = -1;
+	for(CEncodedSkin &Skin : m_aEncodedSkins)
+		Skin.m_pSkinName = nullptr;
+
 	m_class = PLAYERCLASS_INVALID;
 	SetClass(PLAYERCLASS_NONE);
 }
@@ -170,9 +175,8 @@ void CInfClassPlayer::SnapClientInfo(int SnappingClient, int SnappingClientMappe
 	if(!pClientInfo)
 		return;
 
-	StrToInts(&pClientInfo->m_Name0, 4, Server()->ClientName(m_ClientID));
-	StrToInts(&pClientInfo->m_Clan0, 3, GetClan(SnappingClient));
-	pClientInfo->m_Country = Server()->ClientCountry(m_ClientID);
+	mem_copy(pClientInfo, GetEncodedClientInfo(), sizeof(*pClientInfo));
+	mem_copy(&pClientInfo->m_Clan0, GetEncodedClan(SnappingClient), sizeof(int) * 3);
 
 	IServer::CClientInfo ClientInfo = {0};
 	if(SnappingClient != DemoClientID)
@@ -191,7 +195,7 @@ void CInfClassPlayer::SnapClientInfo(int SnappingClient, int SnappingClientMappe
 		SkinInfo.pSkinName = "default";
 	}
 
-	StrToInts(&pClientInfo->m_Skin0, 6, SkinInfo.pSkinName);
+	mem_copy(&pClientInfo->m_Skin0, GetEncodedSkin(SkinInfo.pSkinName), sizeof(int) * 6);
 	pClientInfo->m_UseCustomColor = SkinInfo.UseCustomColor;
 	pClientInfo->m_ColorBody = SkinInfo.ColorBody;
 	pClientInfo->m_ColorFeet = SkinInfo.ColorFeet;
@@ -473,6 +477,56 @@ const char *CInfClassPlayer::GetClan(int SnappingClient) const
 	return aBuf;
 }
 
+const int *CInfClassPlayer::GetEncodedClan(int SnappingClient)
+{
+	if(GetTeam() == TEAM_SPECTATORS)
+	{
+		return &GetEncodedClientInfo()->m_Clan0;
+	}
+
+	int SnapScoreMode = PLAYERSCOREMODE_SCORE;
+	if(GameServer()->GetPlayer(SnappingClient))
+	{
+		SnapScoreMode = GameServer()->m_apPlayers[SnappingClient]->GetScoreMode();
+	}
+
+	// everything GetClan() depends on for this score mode
+	int Key;
+	CEncodedClan *pClan;
+	if(SnapScoreMode == PLAYERSCOREMODE_TIME)
+	{
+		Key = m_HumanTime;
+		pClan = &m_aEncodedClans[1];
+	}
+	else
+	{
+		Key = GetClass() * 2 + (Server()->IsClientLogged(GetCID()) ? 1 : 0);
+		pClan = &m_aEncodedClans[0];
+	}
+
+	if(pClan->m_Key != Key)
+	{
+		pClan->m_Key = Key;
+		StrToInts(pClan->m_aClan, 3, GetClan(SnappingClient));
+	}
+	return pClan->m_aClan;
+}
+
+const int *CInfClassPlayer::GetEncodedSkin(const char *pSkinName)
+{
+	for(const CEncodedSkin &Skin : m_aEncodedSkins)
+	{
+		if(Skin.m_pSkinName == pSkinName)
+			return Skin.m_aSkin;
+	}
+
+	CEncodedSkin *pSkin = &m_aEncodedSkins[m_NextEncodedSkin];
+	m_NextEncodedSkin = (m_NextEncodedSkin + 1) % (int)(sizeof(m_aEncodedSkins) / sizeof(m_aEncodedSkins[0]));
+	pSkin->m_pSkinName = pSkinName;
+	StrToInts(pSkin->m_aSkin, 6, pSkinName);
+	return pSkin->m_aSkin;
+}
+
 bool CInfClassPlayer::IsForcedToSpectate() const
 {
 	return !IsSpectator() && (!m_pCharacter || !m_pCharacter->IsAlive()) && TargetToFollow() >= 0;
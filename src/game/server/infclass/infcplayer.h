@@ -83,12 +83,31 @@ public:
 
 protected:
 	const char *GetClan(int SnappingClient = -1) const override;
+	const int *GetEncodedClan(int SnappingClient);
+	const int *GetEncodedSkin(const char *pSkinName);
 
 	bool IsForcedToSpectate() const;
 
 	CSkinContext m_SkinContext;
 	SkinGetter m_SkinGetter;
 
+	// the clan shown in the class and the time score modes
+	struct CEncodedClan
+	{
+		int m_Key;
+		int m_aClan[3];
+	};
+	CEncodedClan m_aEncodedClans[2];
+
+	// skins sent to clients of different versions, keyed by the static skin name
+	struct CEncodedSkin
+	{
+		const char *m_pSkinName;
+		int m_aSkin[6];
+	};
+	CEncodedSkin m_aEncodedSkins[4];
+	int m_NextEncodedSkin = 0;
+
 	CInfClassGameController *m_pGameController = nullptr;
 	CInfClassPlayerClass *m_pInfcPlayerClass = nullptr;
 
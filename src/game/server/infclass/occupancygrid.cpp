@@ -0,0 +1,51 @@
+#include "occupancygrid.h"
+
+#include <base/math.h>
+
+#include <algorithm>
+
+COccupancyGrid::COccupancyGrid(float CellSize)
+{
+	m_CellSize = CellSize;
+}
+
+void COccupancyGrid::Clear()
+{
+	m_lItems.clear();
+}
+
+int COccupancyGrid::CellCoord(float Value) const
+{
+	return (int)floorf(Value / m_CellSize);
+}
+
+void COccupancyGrid::Add(vec2 Pos)
+{
+	CItem Item;
+	Item.m_Cell = CellKey(CellCoord(Pos.x), CellCoord(Pos.y));
+	Item.m_Pos = Pos;
+	m_lItems.insert(std::upper_bound(m_lItems.begin(), m_lItems.end(), Item), Item);
+}
+
+bool COccupancyGrid::IsOccupied(vec2 Pos, float Radius) const
+{
+	dbg_assert(Radius <= m_CellSize, "occupancy radius larger than a cell");
+
+	int CellX = CellCoord(Pos.x);
+	int CellY = CellCoord(Pos.y);
+	for(int y = CellY - 1; y <= CellY + 1; y++)
+	{
+		for(int x = CellX - 1; x <= CellX + 1; x++)
+		{
+			CItem Key;
+			Key.m_Cell = CellKey(x, y);
+			std::vector<CItem>::const_iterator It = std::lower_bound(m_lItems.begin(), m_lItems.end(), Key);
+			for(; It != m_lItems.end() && It->m_Cell == Key.m_Cell; ++It)
+			{
+				if(distance(It->m_Pos, Pos) <= Radius)
+					return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,40 @@
+#ifndef GAME_SERVER_INFCLASS_OCCUPANCYGRID_H
+#define GAME_SERVER_INFCLASS_OCCUPANCYGRID_H
+
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <vector>
+
+// Positions sorted by the grid cell they are in, so checking for one near a
+// point only looks at the 3x3 cells around it. The grid is sparse, only the
+// cells with something in them take memory.
+class COccupancyGrid
+{
+public:
+	// queries can't use a radius larger than the cell size
+	COccupancyGrid(float CellSize);
+
+	void Clear();
+	void Add(vec2 Pos);
+	bool IsOccupied(vec2 Pos, float Radius) const;
+
+	int Num() const { return m_lItems.size(); }
+
+private:
+	struct CItem
+	{
+		int64 m_Cell;
+		vec2 m_Pos;
+
+		bool operator<(const CItem &Other) const { return m_Cell < Other.m_Cell; }
+	};
+
+	float m_CellSize;
+	std::vector<CItem> m_lItems;
+
+	static int64 CellKey(int x, int y) { return ((int64)y << 32) | (unsigned)x; }
+	int CellCoord(float Value) const;
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include "particles.h"
+
+#include <base/math.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// same view as CEntity::NetworkClipped
+static const float s_ViewWidth = 1000.0f;
+static const float s_ViewHeight = 800.0f;
+static const float s_ViewDistance = 1100.0f;
+
+CParticleSet::CParticleSet()
+{
+	m_NumParticles = 0;
+}
+
+void CParticleSet::Resize(int NumParticles)
+{
+	m_NumParticles = NumParticles;
+	int Size = (NumParticles + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+	m_lPosX.assign(Size, 0.0f);
+	m_lPosY.assign(Size, 0.0f);
+	m_lVelX.assign(Size, 0.0f);
+	m_lVelY.assign(Size, 0.0f);
+}
+
+void CParticleSet::Set(int Index, vec2 Pos, vec2 Vel)
+{
+	m_lPosX[Index] = Pos.x;
+	m_lPosY[Index] = Pos.y;
+	m_lVelX[Index] = Vel.x;
+	m_lVelY[Index] = Vel.y;
+}
+
+// adds the indices of the set bits in Mask, skipping the padding
+static inline int AddIndices(int Mask, int First, int Num, int *pIndices, int Count)
+{
+	for(int i = 0; Mask; i++, Mask >>= 1)
+	{
+		if((Mask & 1) && First + i < Num)
+			pIndices[Count++] = First + i;
+	}
+	return Count;
+}
+
+int CParticleSet::PullTowardsScalar(vec2 Center, float Radius, float StartSpeed, float Acceleration, int *pArrived)
+{
+	int NumArrived = 0;
+	for(int i = 0; i < m_NumParticles; i++)
+	{
+		float MidX = Center.x - m_lPosX[i];
+		float MidY = Center.y - m_lPosY[i];
+		float Length = sqrtf(MidX * MidX + MidY * MidY);
+		float Speed = StartSpeed * clamp(1.0f - Length / Radius + 0.5f, 0.0f, 1.0f);
+		float Dot = MidX * m_lVelX[i] + MidY * m_lVelY[i];
+		m_lPosX[i] += m_lVelX[i] * Speed;
+		m_lPosY[i] += m_lVelY[i] * Speed;
+		if(Dot <= 0.0f)
+		{
+			pArrived[NumArrived++] = i;
+			continue;
+		}
+		m_lVelX[i] *= Acceleration;
+		m_lVelY[i] *= Acceleration;
+	}
+	return NumArrived;
+}
+
+int CParticleSet::VisibleScalar(vec2 Center, float MaxDistance, vec2 ViewPos, int *pIndices) const
+{
+	int NumVisible = 0;
+	for(int i = 0; i < m_NumParticles; i++)
+	{
+		float CenterX = m_lPosX[i] - Center.x;
+		float CenterY = m_lPosY[i] - Center.y;
+		float ViewX = ViewPos.x - m_lPosX[i];
+		float ViewY = ViewPos.y - m_lPosY[i];
+		if(CenterX * CenterX + CenterY * CenterY > MaxDistance * MaxDistance)
+			continue;
+		if(absolute(ViewX) > s_ViewWidth || absolute(ViewY) > s_ViewHeight || ViewX * ViewX + ViewY * ViewY > s_ViewDistance * s_ViewDistance)
+			continue;
+		pIndices[NumVisible++] = i;
+	}
+	return NumVisible;
+}
+
+#if defined(__AVX__)
+
+int CParticleSet::PullTowards(vec2 Center, float Radius, float StartSpeed, float Acceleration, int *pArrived)
+{
+	const __m256 CenterX = _mm256_set1_ps(Center.x);
+	const __m256 CenterY = _mm256_set1_ps(Center.y);
+	const __m256 Rad = _mm256_set1_ps(Radius);
+	const __m256 Start = _mm256_set1_ps(StartSpeed);
+	const __m256 Accel = _mm256_set1_ps(Acceleration);
+	const __m256 Zero = _mm256_setzero_ps();
+	const __m256 One = _mm256_set1_ps(1.0f);
+	const __m256 Half = _mm256_set1_ps(0.5f);
+
+	int NumArrived = 0;
+	for(int i = 0; i < m_NumParticles; i += 8)
+	{
+		__m256 PosX = _mm256_loadu_ps(&m_lPosX[i]);
+		__m256 PosY = _mm256_loadu_ps(&m_lPosY[i]);
+		__m256 VelX = _mm256_loadu_ps(&m_lVelX[i]);
+		__m256 VelY = _mm256_loadu_ps(&m_lVelY[i]);
+
+		__m256 MidX = _mm256_sub_ps(CenterX, PosX);
+		__m256 MidY = _mm256_sub_ps(CenterY, PosY);
+		__m256 Length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(MidX, MidX), _mm256_mul_ps(MidY, MidY)));
+		__m256 Factor = _mm256_add_ps(_mm256_sub_ps(One, _mm256_div_ps(Length, Rad)), Half);
+		__m256 Speed = _mm256_mul_ps(Start, _mm256_min_ps(_mm256_max_ps(Factor, Zero), One));
+		__m256 Dot = _mm256_add_ps(_mm256_mul_ps(MidX, VelX), _mm256_mul_ps(MidY, VelY));
+		__m256 Arrived = _mm256_cmp_ps(Dot, Zero, _CMP_LE_OQ);
+
+		_mm256_storeu_ps(&m_lPosX[i], _mm256_add_ps(PosX, _mm256_mul_ps(VelX, Speed)));
+		_mm256_storeu_ps(&m_lPosY[i], _mm256_add_ps(PosY, _mm256_mul_ps(VelY, Speed)));
+		_mm256_storeu_ps(&m_lVelX[i], _mm256_blendv_ps(_mm256_mul_ps(VelX, Accel), VelX, Arrived));
+		_mm256_storeu_ps(&m_lVelY[i], _mm256_blendv_ps(_mm256_mul_ps(VelY, Accel), VelY, Arrived));
+
+		NumArrived = AddIndices(_mm256_movemask_ps(Arrived), i, m_NumParticles, pArrived, NumArrived);
+	}
+	return NumArrived;
+}
+
+int CParticleSet::Visible(vec2 Center, float MaxDistance, vec2 ViewPos, int *pIndices) const
+{
+	const __m256 CenterX = _mm256_set1_ps(Center.x);
+	const __m256 CenterY = _mm256_set1_ps(Center.y);
+	const __m256 MaxDistance2 = _mm256_set1_ps(MaxDistance * MaxDistance);
+	const __m256 ViewPosX = _mm256_set1_ps(ViewPos.x);
+	const __m256 ViewPosY = _mm256_set1_ps(ViewPos.y);
+	const __m256 Width = _mm256_set1_ps(s_ViewWidth);
+	const __m256 Height = _mm256_set1_ps(s_ViewHeight);
+	const __m256 ViewDistance2 = _mm256_set1_ps(s_ViewDistance * s_ViewDistance);
+	const __m256 SignBit = _mm256_set1_ps(-0.0f);
+
+	int NumVisible = 0;
+	for(int i = 0; i < m_NumParticles; i += 8)
+	{
+		__m256 PosX = _mm256_loadu_ps(&m_lPosX[i]);
+		__m256 PosY = _mm256_loadu_ps(&m_lPosY[i]);
+
+		__m256 CX = _mm256_sub_ps(PosX, CenterX);
+		__m256 CY = _mm256_sub_ps(PosY, CenterY);
+		__m256 VX = _mm256_sub_ps(ViewPosX, PosX);
+		__m256 VY = _mm256_sub_ps(ViewPosY, PosY);
+
+		__m256 Inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(CX, CX), _mm256_mul_ps(CY, CY)), MaxDistance2, _CMP_LE_OQ);
+		Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(_mm256_andnot_ps(SignBit, VX), Width, _CMP_LE_OQ));
+		Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(_mm256_andnot_ps(SignBit, VY), Height, _CMP_LE_OQ));
+		Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(VX, VX), _mm256_mul_ps(VY, VY)), ViewDistance2, _CMP_LE_OQ));
+
+		NumVisible = AddIndices(_mm256_movemask_ps(Inside), i, m_NumParticles, pIndices, NumVisible);
+	}
+	return NumVisible;
+}
+
+#elif defined(__SSE2__)
+
+int CParticleSet::PullTowards(vec2 Center, float Radius, float StartSpeed, float Acceleration, int *pArrived)
+{
+	const __m128 CenterX = _mm_set1_ps(Center.x);
+	const __m128 CenterY = _mm_set1_ps(Center.y);
+	const __m128 Rad = _mm_set1_ps(Radius);
+	const __m128 Start = _mm_set1_ps(StartSpeed);
+	const __m128 Accel = _mm_set1_ps(Acceleration);
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 One = _mm_set1_ps(1.0f);
+	const __m128 Half = _mm_set1_ps(0.5f);
+
+	int NumArrived = 0;
+	for(int i = 0; i < m_NumParticles; i += 4)
+	{
+		__m128 PosX = _mm_loadu_ps(&m_lPosX[i]);
+		__m128 PosY = _mm_loadu_ps(&m_lPosY[i]);
+		__m128 VelX = _mm_loadu_ps(&m_lVelX[i]);
+		__m128 VelY = _mm_loadu_ps(&m_lVelY[i]);
+
+		__m128 MidX = _mm_sub_ps(CenterX, PosX);
+		__m128 MidY = _mm_sub_ps(CenterY, PosY);
+		__m128 Length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(MidX, MidX), _mm_mul_ps(MidY, MidY)));
+		__m128 Factor = _mm_add_ps(_mm_sub_ps(One, _mm_div_ps(Length, Rad)), Half);
+		__m128 Speed = _mm_mul_ps(Start, _mm_min_ps(_mm_max_ps(Factor, Zero), One));
+		__m128 Dot = _mm_add_ps(_mm_mul_ps(MidX, VelX), _mm_mul_ps(MidY, VelY));
+		__m128 Arrived = _mm_cmple_ps(Dot, Zero);
+
+		_mm_storeu_ps(&m_lPosX[i], _mm_add_ps(PosX, _mm_mul_ps(VelX, Speed)));
+		_mm_storeu_ps(&m_lPosY[i], _mm_add_ps(PosY, _mm_mul_ps(VelY, Speed)));
+		// sse2 has no blend, keep the velocity of the arrived particles with masks
+		_mm_storeu_ps(&m_lVelX[i], _mm_or_ps(_mm_and_ps(Arrived, VelX), _mm_andnot_ps(Arrived, _mm_mul_ps(VelX, Accel))));
+		_mm_storeu_ps(&m_lVelY[i], _mm_or_ps(_mm_and_ps(Arrived, VelY), _mm_andnot_ps(Arrived, _mm_mul_ps(VelY, Accel))));
+
+		NumArrived = AddIndices(_mm_movemask_ps(Arrived), i, m_NumParticles, pArrived, NumArrived);
+	}
+	return NumArrived;
+}
+
+int CParticleSet::Visible(vec2 Center, float MaxDistance, vec2 ViewPos, int *pIndices) const
+{
+	const __m128 CenterX = _mm_set1_ps(Center.x);
+	const __m128 CenterY = _mm_set1_ps(Center.y);
+	const __m128 MaxDistance2 = _mm_set1_ps(MaxDistance * MaxDistance);
+	const __m128 ViewPosX = _mm_set1_ps(ViewPos.x);
+	const __m128 ViewPosY = _mm_set1_ps(ViewPos.y);
+	const __m128 Width = _mm_set1_ps(s_ViewWidth);
+	const __m128 Height = _mm_set1_ps(s_ViewHeight);
+	const __m128 ViewDistance2 = _mm_set1_ps(s_ViewDistance * s_ViewDistance);
+	const __m128 SignBit = _mm_set1_ps(-0.0f);
+
+	int NumVisible = 0;
+	for(int i = 0; i < m_NumParticles; i += 4)
+	{
+		__m128 PosX = _mm_loadu_ps(&m_lPosX[i]);
+		__m128 PosY = _mm_loadu_ps(&m_lPosY[i]);
+
+		__m128 CX = _mm_sub_ps(PosX, CenterX);
+		__m128 CY = _mm_sub_ps(PosY, CenterY);
+		__m128 VX = _mm_sub_ps(ViewPosX, PosX);
+		__m128 VY = _mm_sub_ps(ViewPosY, PosY);
+
+		__m128 Inside = _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(CX, CX), _mm_mul_ps(CY, CY)), MaxDistance2);
+		Inside = _mm_and_ps(Inside, _mm_cmple_ps(_mm_andnot_ps(SignBit, VX), Width));
+		Inside = _mm_and_ps(Inside, _mm_cmple_ps(_mm_andnot_ps(SignBit, VY), Height));
+		Inside = _mm_and_ps(Inside, _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(VX, VX), _mm_mul_ps(VY, VY)), ViewDistance2));
+
+		NumVisible = AddIndices(_mm_movemask_ps(Inside), i, m_NumParticles, pIndices, NumVisible);
+	}
+	return NumVisible;
+}
+
+#else
+
+int CParticleSet::PullTowards(vec2 Center, float Radius, float StartSpeed, float Acceleration, int *pArrived)
+{
+	return PullTowardsScalar(Center, Radius, StartSpeed, Acceleration, pArrived);
+}
+
+int CParticleSet::Visible(vec2 Center, float MaxDistance, vec2 ViewPos, int *pIndices) const
+{
+	return VisibleScalar(Center, MaxDistance, ViewPos, pIndices);
+}
+
+#endif
+
+void CirclePoints(vec2 Center, float Radius, float Angle, int NumPoints, vec2 *pPoints)
+{
+	if(NumPoints <= 0)
+		return;
+
+	float AngleStep = 2.0f * pi / NumPoints;
+	float StepCos = cosf(AngleStep);
+	float StepSin = sinf(AngleStep);
+	vec2 Dir = vec2(cosf(Angle), sinf(Angle)) * Radius;
+	for(int i = 0; i < NumPoints; i++)
+	{
+		pPoints[i] = Center + Dir;
+		Dir = vec2(Dir.x * StepCos - Dir.y * StepSin, Dir.x * StepSin + Dir.y * StepCos);
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef GAME_SERVER_INFCLASS_PARTICLES_H
+#define GAME_SERVER_INFCLASS_PARTICLES_H
+
+#include <base/vmath.h>
+
+#include <vector>
+
+// Particles of a visual effect, stored as separate coordinate arrays so the
+// update and the culling run over several particles at once (AVX or SSE2
+// when the build targets them, plain loops otherwise).
+class CParticleSet
+{
+public:
+	enum
+	{
+		// the arrays are padded to a multiple of this, the kernels don't need a tail loop
+		BATCH_SIZE = 8,
+	};
+
+	CParticleSet();
+
+	void Resize(int NumParticles);
+	int Num() const { return m_NumParticles; }
+
+	vec2 Pos(int Index) const { return vec2(m_lPosX[Index], m_lPosY[Index]); }
+	vec2 Vel(int Index) const { return vec2(m_lVelX[Index], m_lVelY[Index]); }
+	void Set(int Index, vec2 Pos, vec2 Vel);
+
+	// Moves every particle along its velocity, faster the closer it is to
+	// Center, and accelerates it. Writes the indices of the particles that
+	// have reached the center to pArrived and returns their number, the
+	// caller places these somewhere else.
+	int PullTowards(vec2 Center, float Radius, float StartSpeed, float Acceleration, int *pArrived);
+
+	// Writes the indices of the particles within MaxDistance of Center that
+	// a client looking at ViewPos can see and returns their number.
+	int Visible(vec2 Center, float MaxDistance, vec2 ViewPos, int *pIndices) const;
+
+	// same as the above without the vector instructions, for testing
+	int PullTowardsScalar(vec2 Center, float Radius, float StartSpeed, float Acceleration, int *pArrived);
+	int VisibleScalar(vec2 Center, float MaxDistance, vec2 ViewPos, int *pIndices) const;
+
+private:
+	int m_NumParticles;
+	std::vector<float> m_lPosX;
+	std::vector<float> m_lPosY;
+	std::vector<float> m_lVelX;
+	std::vector<float> m_lVelY;
+};
+
+// Writes NumPoints points evenly spaced on a circle, starting at Angle.
+// Only the first point and the step need cos and sin, the rest are rotations.
+void CirclePoints(vec2 Center, float Radius, float Angle, int NumPoints, vec2 *pPoints);
+
+#endif
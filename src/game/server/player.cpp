@@ -44,6 +44,15 @@ void CPlayer::Reset()
 
 	m_SendVoteIndex = -1;
 
+	m_ClientInfoCache.m_Tick = -1;
+	m_ClientInfoCache.m_aName[0] = 0;
+	m_ClientInfoCache.m_aClan[0] = 0;
+	m_ClientInfoCache.m_aSkinName[0] = 0;
+	mem_zero(&m_ClientInfoCache.m_Info, sizeof(m_ClientInfoCache.m_Info));
+	StrToInts(&m_ClientInfoCache.m_Info.m_Name0, 4, "");
+	StrToInts(&m_ClientInfoCache.m_Info.m_Clan0, 3, "");
+	StrToInts(&m_ClientInfoCache.m_Info.m_Skin0, 6, "");
+
 	m_OverrideEmote = 0;
 	m_OverrideEmoteReset = -1;
 
@@ -70,8 +79,8 @@ void CPlayer::Reset()
 
 	m_HookProtectionAutomatic = true;
 
-	m_PrevTuningParams = *m_pGameServer->Tuning();
-	m_NextTuningParams = m_PrevTuningParams;
+	m_NextTuningParams = *m_pGameServer->Tuning();
+	m_TuningProfile = m_pGameServer->TuningProfiles()->Intern(&m_NextTuningParams);
 	m_IsInGame = false;
 
 	for(unsigned int i=0; i<sizeof(m_LastHumanClasses)/sizeof(int); i++)
@@ -163,18 +172,17 @@ void CPlayer::PostTick()
 
 void CPlayer::HandleTuningParams()
 {
-	if(!(m_PrevTuningParams == m_NextTuningParams))
+	int TuningProfile = GameServer()->TuningProfiles()->Intern(&m_NextTuningParams);
+	if(TuningProfile != m_TuningProfile)
 	{
 		if(m_IsReady)
 		{
 			CMsgPacker Msg(NETMSGTYPE_SV_TUNEPARAMS);
-			int *pParams = (int *)&m_NextTuningParams;
-			for(unsigned i = 0; i < sizeof(m_NextTuningParams)/sizeof(int); i++)
-				Msg.AddInt(pParams[i]);
+			GameServer()->TuningProfiles()->Pack(TuningProfile, &Msg);
 			Server()->SendMsg(&Msg, MSGFLAG_VITAL, GetCID());
 		}
 		
-		m_PrevTuningParams = m_NextTuningParams;
+		m_TuningProfile = TuningProfile;
 	}
 	
 	m_NextTuningParams = *GameServer()->Tuning();
@@ -270,13 +278,46 @@ void CPlayer::SnapClientInfo(int SnappingClient, int SnappingClientMappedId)
 	if(!pClientInfo)
 		return;
 
-	StrToInts(&pClientInfo->m_Name0, 4, Server()->ClientName(m_ClientID));
-	StrToInts(&pClientInfo->m_Clan0, 3, GetClan(SnappingClient));
-	pClientInfo->m_Country = Server()->ClientCountry(m_ClientID);
-	StrToInts(&pClientInfo->m_Skin0, 6, m_TeeInfos.m_SkinName);
-	pClientInfo->m_UseCustomColor = m_TeeInfos.m_UseCustomColor;
-	pClientInfo->m_ColorBody = m_TeeInfos.m_ColorBody;
-	pClientInfo->m_ColorFeet = m_TeeInfos.m_ColorFeet;
+	mem_copy(pClientInfo, GetEncodedClientInfo(), sizeof(*pClientInfo));
+
+	// the cache holds the server clan, a derived player may show something else
+	const char *pClan = GetClan(SnappingClient);
+	if(pClan != Server()->ClientClan(m_ClientID))
+		StrToInts(&pClientInfo->m_Clan0, 3, pClan);
+}
+
+const CNetObj_ClientInfo *CPlayer::GetEncodedClientInfo()
+{
+	CClientInfoCache *pCache = &m_ClientInfoCache;
+	if(pCache->m_Tick == Server()->Tick())
+		return &pCache->m_Info;
+	pCache->m_Tick = Server()->Tick();
+
+	const char *pName = Server()->ClientName(m_ClientID);
+	if(str_comp(pCache->m_aName, pName) != 0)
+	{
+		str_copy(pCache->m_aName, pName, sizeof(pCache->m_aName));
+		StrToInts(&pCache->m_Info.m_Name0, 4, pName);
+	}
+
+	const char *pClan = Server()->ClientClan(m_ClientID);
+	if(str_comp(pCache->m_aClan, pClan) != 0)
+	{
+		str_copy(pCache->m_aClan, pClan, sizeof(pCache->m_aClan));
+		StrToInts(&pCache->m_Info.m_Clan0, 3, pClan);
+	}
+
+	if(str_comp(pCache->m_aSkinName, m_TeeInfos.m_SkinName) != 0)
+	{
+		str_copy(pCache->m_aSkinName, m_TeeInfos.m_SkinName, sizeof(pCache->m_aSkinName));
+		StrToInts(&pCache->m_Info.m_Skin0, 6, m_TeeInfos.m_SkinName);
+	}
+
+	pCache->m_Info.m_Country = Server()->ClientCountry(m_ClientID);
+	pCache->m_Info.m_UseCustomColor = m_TeeInfos.m_UseCustomColor;
+	pCache->m_Info.m_ColorBody = m_TeeInfos.m_ColorBody;
+	pCache->m_Info.m_ColorFeet = m_TeeInfos.m_ColorFeet;
+	return &pCache->m_Info;
 }
 
 void CPlayer::OnDisconnect()
@@ -126,6 +126,21 @@ protected:
 
 	virtual const char *GetClan(int SnappingClient = -1) const;
 
+	// CNetObj_ClientInfo fields that are the same for every snapping client.
+	// The sources are compared once per tick and only encoded again when
+	// they have changed, snapping copies the encoded ints.
+	struct CClientInfoCache
+	{
+		int m_Tick;
+		char m_aName[64];
+		char m_aClan[64];
+		char m_aSkinName[64];
+		CNetObj_ClientInfo m_Info;
+	};
+	CClientInfoCache m_ClientInfoCache;
+
+	const CNetObj_ClientInfo *GetEncodedClientInfo();
+
 	//
 	bool m_Spawning;
 	int m_ClientID;
@@ -184,7 +199,8 @@ public:
 	bool m_HookProtection;
 	bool m_HookProtectionAutomatic;
 	
-	CTuningParams m_PrevTuningParams;
+	// ID of the last tuning sent, see CTuningProfiles
+	int m_TuningProfile;
 	CTuningParams m_NextTuningParams;
 	
 	void HandleTuningParams();
@@ -11,6 +11,7 @@ public:
 class CWeakSkinInfo
 {
 public:
+	// must point to a string that never changes, its encoding is cached by address
 	const char *pSkinName = nullptr;
 	int UseCustomColor = 0;
 	int ColorBody = 0;
@@ -0,0 +1,74 @@
+#include <engine/shared/packer.h>
+
+#include "tuningprofiles.h"
+
+CTuningProfiles::CTuningProfiles()
+{
+	m_FirstID = 0;
+	m_NumProfiles = 0;
+	Clear();
+}
+
+void CTuningProfiles::Clear()
+{
+	m_FirstID += m_NumProfiles;
+	m_NumProfiles = 0;
+	for(int i = 0; i < HASH_SIZE; i++)
+		m_aHashSlots[i] = -1;
+}
+
+unsigned CTuningProfiles::Hash(const CTuningParams *pParams)
+{
+	// FNV-1a over the raw values
+	const int *pValues = (const int *)pParams;
+	unsigned Hash = 2166136261u;
+	for(int i = 0; i < CTuningParams::Num(); i++)
+	{
+		Hash ^= (unsigned)pValues[i];
+		Hash *= 16777619u;
+	}
+	return Hash;
+}
+
+int CTuningProfiles::Intern(const CTuningParams *pParams)
+{
+	unsigned Hash = CTuningProfiles::Hash(pParams);
+	int Slot = Hash % HASH_SIZE;
+	for(; m_aHashSlots[Slot] != -1; Slot = (Slot + 1) % HASH_SIZE)
+	{
+		const CProfile *pProfile = &m_aProfiles[m_aHashSlots[Slot]];
+		if(pProfile->m_Hash == Hash && mem_comp(&pProfile->m_Params, pParams, sizeof(CTuningParams)) == 0)
+			return m_FirstID + m_aHashSlots[Slot];
+	}
+
+	if(m_NumProfiles == MAX_PROFILES)
+	{
+		// only reached when the tuning changes a lot, the states in use get interned again
+		Clear();
+		Slot = Hash % HASH_SIZE;
+	}
+
+	CProfile *pProfile = &m_aProfiles[m_NumProfiles];
+	pProfile->m_Params = *pParams;
+	pProfile->m_Hash = Hash;
+
+	CPacker Packer;
+	Packer.Reset();
+	const int *pValues = (const int *)pParams;
+	for(int i = 0; i < CTuningParams::Num(); i++)
+		Packer.AddInt(pValues[i]);
+	pProfile->m_MsgSize = Packer.Size();
+	mem_copy(pProfile->m_aMsgData, Packer.Data(), Packer.Size());
+
+	m_aHashSlots[Slot] = m_NumProfiles;
+	return m_FirstID + m_NumProfiles++;
+}
+
+bool CTuningProfiles::Pack(int ID, CMsgPacker *pMsg) const
+{
+	int Index = ID - m_FirstID;
+	if(Index < 0 || Index >= m_NumProfiles)
+		return false;
+	pMsg->AddRaw(m_aProfiles[Index].m_aMsgData, m_aProfiles[Index].m_MsgSize);
+	return true;
+}
@@ -0,0 +1,52 @@
+#ifndef GAME_SERVER_TUNINGPROFILES_H
+#define GAME_SERVER_TUNINGPROFILES_H
+
+#include <engine/message.h>
+#include <game/gamecore.h>
+
+// Tuning states that are in use, each with its tuning message already packed.
+// Most players share a handful of states (the map tuning, frozen, in water,
+// slowed down...), so a player only keeps the ID of its profile and sending
+// a change is an integer compare and a copy of the packed message.
+class CTuningProfiles
+{
+public:
+	enum
+	{
+		MAX_PROFILES=64,
+		HASH_SIZE=128,
+		// an int takes at most 5 bytes once packed
+		MAX_MSG_SIZE=sizeof(CTuningParams)/sizeof(int)*5,
+	};
+
+	CTuningProfiles();
+
+	// IDs are never reused, holders of an ID from before a Clear() get a new one on their next Intern()
+	void Clear();
+	// returns the ID of the profile with these params, adding it when it is new
+	int Intern(const CTuningParams *pParams);
+	// appends the packed params of a profile, returns false for an unknown ID
+	bool Pack(int ID, CMsgPacker *pMsg) const;
+
+	int Num() const { return m_NumProfiles; }
+
+private:
+	struct CProfile
+	{
+		CTuningParams m_Params;
+		unsigned m_Hash;
+		int m_MsgSize;
+		unsigned char m_aMsgData[MAX_MSG_SIZE];
+	};
+
+	CProfile m_aProfiles[MAX_PROFILES];
+	int m_NumProfiles;
+	// profile index of each hash slot, -1 when the slot is free
+	int m_aHashSlots[HASH_SIZE];
+	// ID of m_aProfiles[0], the others follow
+	int m_FirstID;
+
+	static unsigned Hash(const CTuningParams *pParams);
+};
+
+#endif
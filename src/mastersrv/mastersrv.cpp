@@ -1,5 +1,6 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 
 #include <engine/config.h>
@@ -17,9 +18,13 @@
 enum {
 	MTU = 1400,
 	MAX_SERVERS_PER_PACKET=75,
-	MAX_PACKETS=16,
+	MAX_PACKETS=128,
 	MAX_SERVERS=MAX_SERVERS_PER_PACKET*MAX_PACKETS,
-	EXPIRE_TIME = 90
+	EXPIRE_TIME = 90,
+	HASH_SIZE = 8192,
+	// one bucket per second, must be more than EXPIRE_TIME
+	TIMER_WHEEL_SIZE = 128,
+	NUM_SERVERTYPES = 2,
 };
 
 struct CCheckServer
@@ -29,20 +34,41 @@ struct CCheckServer
 	NETADDR m_AltAddress;
 	int m_TryCount;
 	int64 m_TryTime;
+	int m_HashNext;
 };
 
 static CCheckServer m_aCheckServers[MAX_SERVERS];
 static int m_NumCheckServers = 0;
+// check servers by ip, both addresses only differ in the port
+static int m_aCheckServerHash[HASH_SIZE];
 
+// Servers keep their index while they are registered, so the hash chains,
+// the timer wheel and the list packets can refer to them.
 struct CServerEntry
 {
 	enum ServerType m_Type;
 	NETADDR m_Address;
 	int64 m_Expire;
+	int m_Slot; // position in the list packets of its type
+	int m_HashNext;
+	int m_TimerPrev;
+	int m_TimerNext;
 };
 
 static CServerEntry m_aServers[MAX_SERVERS];
 static int m_NumServers = 0;
+static int m_aFreeServers[MAX_SERVERS];
+static int m_NumFreeServers = 0;
+static int m_aServerHash[HASH_SIZE];
+
+// servers by the second they expire in
+static int m_aTimerWheel[TIMER_WHEEL_SIZE];
+static int64 m_LastPurgeSecond = 0;
+
+// servers in the order they appear in the list packets, a page is one packet
+static int m_aaSlots[NUM_SERVERTYPES][MAX_SERVERS];
+static int m_aNumSlots[NUM_SERVERTYPES] = {0};
+static bool m_aaDirtyPackets[NUM_SERVERTYPES][MAX_PACKETS];
 
 struct CPacketData
 {
@@ -88,83 +114,171 @@ static CNetClient m_NetOp; // main
 
 IConsole *m_pConsole;
 
-void BuildPackets()
+static unsigned AddrHash(const NETADDR *pAddr, bool WithPort)
 {
-	CServerEntry *pCurrent = &m_aServers[0];
-	int ServersLeft = m_NumServers;
-	m_NumPackets = 0;
-	m_NumPacketsLegacy = 0;
-	int PacketIndex = 0;
-	int PacketIndexLegacy = 0;
-	while(ServersLeft-- && (m_NumPackets + m_NumPacketsLegacy) < MAX_PACKETS)
+	// fnv-1a
+	unsigned Hash = 2166136261u;
+	Hash = (Hash ^ pAddr->type) * 16777619u;
+	for(int i = 0; i < 16; i++)
+		Hash = (Hash ^ pAddr->ip[i]) * 16777619u;
+	if(WithPort)
 	{
-		if(pCurrent->m_Type == SERVERTYPE_NORMAL)
-		{
-			if(PacketIndex % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndex = 0;
-				m_NumPackets++;
-			}
+		Hash = (Hash ^ (pAddr->port & 0xff)) * 16777619u;
+		Hash = (Hash ^ (pAddr->port >> 8)) * 16777619u;
+	}
+	return Hash & (HASH_SIZE - 1);
+}
 
-			// copy header
-			mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+static int TimerBucket(int64 Time)
+{
+	return (Time / time_freq()) % TIMER_WHEEL_SIZE;
+}
 
-			// copy server addresses
-			if(pCurrent->m_Address.type == NETTYPE_IPV6)
-			{
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, pCurrent->m_Address.ip,
-					sizeof(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp));
-			}
-			else
-			{
-				static char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF };
+void InitRegistry()
+{
+	for(int i = 0; i < HASH_SIZE; i++)
+	{
+		m_aServerHash[i] = -1;
+		m_aCheckServerHash[i] = -1;
+	}
+	for(int i = 0; i < TIMER_WHEEL_SIZE; i++)
+		m_aTimerWheel[i] = -1;
+	m_NumFreeServers = MAX_SERVERS;
+	for(int i = 0; i < MAX_SERVERS; i++)
+		m_aFreeServers[i] = MAX_SERVERS - 1 - i;
+	m_LastPurgeSecond = time_get() / time_freq() - 1;
+}
 
-				mem_copy(m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[12] = pCurrent->m_Address.ip[0];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[13] = pCurrent->m_Address.ip[1];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[14] = pCurrent->m_Address.ip[2];
-				m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aIp[15] = pCurrent->m_Address.ip[3];
-			}
+static void LinkTimer(int Index)
+{
+	int Bucket = TimerBucket(m_aServers[Index].m_Expire);
+	m_aServers[Index].m_TimerPrev = -1;
+	m_aServers[Index].m_TimerNext = m_aTimerWheel[Bucket];
+	if(m_aTimerWheel[Bucket] >= 0)
+		m_aServers[m_aTimerWheel[Bucket]].m_TimerPrev = Index;
+	m_aTimerWheel[Bucket] = Index;
+}
 
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[0] = (pCurrent->m_Address.port>>8)&0xff;
-			m_aPackets[m_NumPackets-1].m_Data.m_aServers[PacketIndex].m_aPort[1] = pCurrent->m_Address.port&0xff;
+static void UnlinkTimer(int Index)
+{
+	CServerEntry *pServer = &m_aServers[Index];
+	if(pServer->m_TimerPrev >= 0)
+		m_aServers[pServer->m_TimerPrev].m_TimerNext = pServer->m_TimerNext;
+	else
+		m_aTimerWheel[TimerBucket(pServer->m_Expire)] = pServer->m_TimerNext;
+	if(pServer->m_TimerNext >= 0)
+		m_aServers[pServer->m_TimerNext].m_TimerPrev = pServer->m_TimerPrev;
+}
 
-			PacketIndex++;
+static int FindServer(const NETADDR *pAddr)
+{
+	for(int i = m_aServerHash[AddrHash(pAddr, true)]; i >= 0; i = m_aServers[i].m_HashNext)
+	{
+		if(net_addr_comp(&m_aServers[i].m_Address, pAddr) == 0)
+			return i;
+	}
+	return -1;
+}
 
-			m_aPackets[m_NumPackets-1].m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*PacketIndex;
+static void SetSlot(int Type, int Slot, int Index)
+{
+	m_aaSlots[Type][Slot] = Index;
+	m_aServers[Index].m_Slot = Slot;
+	m_aaDirtyPackets[Type][Slot / MAX_SERVERS_PER_PACKET] = true;
+}
 
-			pCurrent++;
-		}
-		else if(pCurrent->m_Type == SERVERTYPE_LEGACY)
-		{
-			if(PacketIndexLegacy % MAX_SERVERS_PER_PACKET == 0)
-			{
-				PacketIndexLegacy = 0;
-				m_NumPacketsLegacy++;
-			}
+static void RemoveServer(int Index)
+{
+	CServerEntry *pServer = &m_aServers[Index];
 
-			// copy header
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
+	int *pLink = &m_aServerHash[AddrHash(&pServer->m_Address, true)];
+	while(*pLink != Index)
+		pLink = &m_aServers[*pLink].m_HashNext;
+	*pLink = pServer->m_HashNext;
 
-			// copy server addresses
-			mem_copy(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp, pCurrent->m_Address.ip,
-				sizeof(m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aIp));
-			// 0.5 has the port in little endian on the network
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[0] = pCurrent->m_Address.port&0xff;
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Data.m_aServers[PacketIndexLegacy].m_aPort[1] = (pCurrent->m_Address.port>>8)&0xff;
+	UnlinkTimer(Index);
 
-			PacketIndexLegacy++;
+	// fill the gap with the last server, only two packets change
+	int Type = pServer->m_Type;
+	int Last = --m_aNumSlots[Type];
+	if(pServer->m_Slot != Last)
+		SetSlot(Type, pServer->m_Slot, m_aaSlots[Type][Last]);
+	m_aaDirtyPackets[Type][Last / MAX_SERVERS_PER_PACKET] = true;
 
-			m_aPacketsLegacy[m_NumPacketsLegacy-1].m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*PacketIndexLegacy;
+	m_aFreeServers[m_NumFreeServers++] = Index;
+	m_NumServers--;
+}
 
-			pCurrent++;
-		}
-		else
+static void WriteServerAddr(CMastersrvAddr *pOut, const NETADDR *pAddr)
+{
+	if(pAddr->type == NETTYPE_IPV6)
+	{
+		mem_copy(pOut->m_aIp, pAddr->ip, sizeof(pOut->m_aIp));
+	}
+	else
+	{
+		static const unsigned char IPV4Mapping[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF };
+
+		mem_copy(pOut->m_aIp, IPV4Mapping, sizeof(IPV4Mapping));
+		pOut->m_aIp[12] = pAddr->ip[0];
+		pOut->m_aIp[13] = pAddr->ip[1];
+		pOut->m_aIp[14] = pAddr->ip[2];
+		pOut->m_aIp[15] = pAddr->ip[3];
+	}
+
+	pOut->m_aPort[0] = (pAddr->port>>8)&0xff;
+	pOut->m_aPort[1] = pAddr->port&0xff;
+}
+
+static void WriteServerAddrLegacy(CMastersrvAddrLegacy *pOut, const NETADDR *pAddr)
+{
+	mem_copy(pOut->m_aIp, pAddr->ip, sizeof(pOut->m_aIp));
+	// 0.5 has the port in little endian on the network
+	pOut->m_aPort[0] = pAddr->port&0xff;
+	pOut->m_aPort[1] = (pAddr->port>>8)&0xff;
+}
+
+// only rebuilds the packets whose servers changed since the last call
+void BuildPackets()
+{
+	for(int Type = 0; Type < NUM_SERVERTYPES; Type++)
+	{
+		int NumSlots = m_aNumSlots[Type];
+		int NumPackets = (NumSlots + MAX_SERVERS_PER_PACKET - 1) / MAX_SERVERS_PER_PACKET;
+		for(int Packet = 0; Packet < NumPackets; Packet++)
 		{
-			*pCurrent = m_aServers[m_NumServers-1];
-			m_NumServers--;
-			dbg_msg("mastersrv", "error: server of invalid type, dropping it");
+			if(!m_aaDirtyPackets[Type][Packet])
+				continue;
+			m_aaDirtyPackets[Type][Packet] = false;
+
+			int First = Packet * MAX_SERVERS_PER_PACKET;
+			int Num = minimum((int)MAX_SERVERS_PER_PACKET, NumSlots - First);
+			if(Type == SERVERTYPE_NORMAL)
+			{
+				CPacketData *pPacket = &m_aPackets[Packet];
+				mem_copy(pPacket->m_Data.m_aHeader, SERVERBROWSE_LIST, sizeof(SERVERBROWSE_LIST));
+				for(int i = 0; i < Num; i++)
+					WriteServerAddr(&pPacket->m_Data.m_aServers[i], &m_aServers[m_aaSlots[Type][First + i]].m_Address);
+				pPacket->m_Size = sizeof(SERVERBROWSE_LIST) + sizeof(CMastersrvAddr)*Num;
+			}
+			else
+			{
+				CPacketDataLegacy *pPacket = &m_aPacketsLegacy[Packet];
+				mem_copy(pPacket->m_Data.m_aHeader, SERVERBROWSE_LIST_LEGACY, sizeof(SERVERBROWSE_LIST_LEGACY));
+				for(int i = 0; i < Num; i++)
+					WriteServerAddrLegacy(&pPacket->m_Data.m_aServers[i], &m_aServers[m_aaSlots[Type][First + i]].m_Address);
+				pPacket->m_Size = sizeof(SERVERBROWSE_LIST_LEGACY) + sizeof(CMastersrvAddrLegacy)*Num;
+			}
 		}
+
+		// packets past the end are rebuilt once servers fill them again
+		for(int Packet = NumPackets; Packet < MAX_PACKETS; Packet++)
+			m_aaDirtyPackets[Type][Packet] = false;
+
+		if(Type == SERVERTYPE_NORMAL)
+			m_NumPackets = NumPackets;
+		else
+			m_NumPacketsLegacy = NumPackets;
 	}
 }
 
@@ -204,8 +318,52 @@ void SendCheck(NETADDR *pAddr)
 	m_NetChecker.Send(&p);
 }
 
+static int FindCheckServer(const NETADDR *pAddr)
+{
+	for(int i = m_aCheckServerHash[AddrHash(pAddr, false)]; i >= 0; i = m_aCheckServers[i].m_HashNext)
+	{
+		if(net_addr_comp(&m_aCheckServers[i].m_Address, pAddr) == 0 ||
+			net_addr_comp(&m_aCheckServers[i].m_AltAddress, pAddr) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static void LinkCheckServer(int Index)
+{
+	int Bucket = AddrHash(&m_aCheckServers[Index].m_Address, false);
+	m_aCheckServers[Index].m_HashNext = m_aCheckServerHash[Bucket];
+	m_aCheckServerHash[Bucket] = Index;
+}
+
+static void UnlinkCheckServer(int Index)
+{
+	int *pLink = &m_aCheckServerHash[AddrHash(&m_aCheckServers[Index].m_Address, false)];
+	while(*pLink != Index)
+		pLink = &m_aCheckServers[*pLink].m_HashNext;
+	*pLink = m_aCheckServers[Index].m_HashNext;
+}
+
+static void RemoveCheckServer(int Index)
+{
+	int Last = m_NumCheckServers-1;
+	UnlinkCheckServer(Index);
+	if(Index != Last)
+	{
+		UnlinkCheckServer(Last);
+		m_aCheckServers[Index] = m_aCheckServers[Last];
+		LinkCheckServer(Index);
+	}
+	m_NumCheckServers--;
+}
+
 void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type)
 {
+	// a check for this server is already running
+	int Index = FindCheckServer(pInfo);
+	if(Index >= 0 && net_addr_comp(&m_aCheckServers[Index].m_Address, pInfo) == 0)
+		return;
+
 	// add server
 	if(m_NumCheckServers == MAX_SERVERS)
 	{
@@ -223,26 +381,33 @@ void AddCheckserver(NETADDR *pInfo, NETADDR *pAlt, ServerType Type)
 	m_aCheckServers[m_NumCheckServers].m_TryCount = 0;
 	m_aCheckServers[m_NumCheckServers].m_TryTime = 0;
 	m_aCheckServers[m_NumCheckServers].m_Type = Type;
+	LinkCheckServer(m_NumCheckServers);
 	m_NumCheckServers++;
 }
 
 void AddServer(NETADDR *pInfo, ServerType Type)
 {
+	if(Type != SERVERTYPE_NORMAL && Type != SERVERTYPE_LEGACY)
+	{
+		dbg_msg("mastersrv", "error: server of invalid type, dropping it");
+		return;
+	}
+
 	// see if server already exists in list
-	for(int i = 0; i < m_NumServers; i++)
+	int Index = FindServer(pInfo);
+	if(Index >= 0)
 	{
-		if(net_addr_comp(&m_aServers[i].m_Address, pInfo) == 0)
-		{
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "updated: %s", aAddrStr);
-			m_aServers[i].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-			return;
-		}
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
+		dbg_msg("mastersrv", "updated: %s", aAddrStr);
+		UnlinkTimer(Index);
+		m_aServers[Index].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+		LinkTimer(Index);
+		return;
 	}
 
 	// add server
-	if(m_NumServers == MAX_SERVERS)
+	if(m_NumFreeServers == 0)
 	{
 		dbg_msg("mastersrv", "error: mastersrv is full");
 		return;
@@ -251,9 +416,17 @@ void AddServer(NETADDR *pInfo, ServerType Type)
 	char aAddrStr[NETADDR_MAXSTRSIZE];
 	net_addr_str(pInfo, aAddrStr, sizeof(aAddrStr), true);
 	dbg_msg("mastersrv", "added: %s", aAddrStr);
-	m_aServers[m_NumServers].m_Address = *pInfo;
-	m_aServers[m_NumServers].m_Expire = time_get()+time_freq()*EXPIRE_TIME;
-	m_aServers[m_NumServers].m_Type = Type;
+	Index = m_aFreeServers[--m_NumFreeServers];
+	CServerEntry *pServer = &m_aServers[Index];
+	pServer->m_Address = *pInfo;
+	pServer->m_Expire = time_get()+time_freq()*EXPIRE_TIME;
+	pServer->m_Type = Type;
+
+	int Bucket = AddrHash(pInfo, true);
+	pServer->m_HashNext = m_aServerHash[Bucket];
+	m_aServerHash[Bucket] = Index;
+	LinkTimer(Index);
+	SetSlot(Type, m_aNumSlots[Type]++, Index);
 	m_NumServers++;
 }
 
@@ -275,8 +448,7 @@ void UpdateServers()
 
 				// FAIL!!
 				SendError(&m_aCheckServers[i].m_Address);
-				m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers-1];
-				m_NumCheckServers--;
+				RemoveCheckServer(i);
 				i--;
 			}
 			else
@@ -292,24 +464,30 @@ void UpdateServers()
 	}
 }
 
+// walks the timer wheel buckets of the seconds that have passed
 void PurgeServers()
 {
 	int64 Now = time_get();
-	int i = 0;
-	while(i < m_NumServers)
+	int64 Second = Now / time_freq();
+	int64 First = maximum(m_LastPurgeSecond + 1, Second - TIMER_WHEEL_SIZE);
+	for(int64 s = First; s < Second; s++)
 	{
-		if(m_aServers[i].m_Expire < Now)
+		int i = m_aTimerWheel[s % TIMER_WHEEL_SIZE];
+		while(i >= 0)
 		{
-			// remove server
-			char aAddrStr[NETADDR_MAXSTRSIZE];
-			net_addr_str(&m_aServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
-			dbg_msg("mastersrv", "expired: %s", aAddrStr);
-			m_aServers[i] = m_aServers[m_NumServers-1];
-			m_NumServers--;
+			int Next = m_aServers[i].m_TimerNext;
+			if(m_aServers[i].m_Expire < Now)
+			{
+				// remove server
+				char aAddrStr[NETADDR_MAXSTRSIZE];
+				net_addr_str(&m_aServers[i].m_Address, aAddrStr, sizeof(aAddrStr), true);
+				dbg_msg("mastersrv", "expired: %s", aAddrStr);
+				RemoveServer(i);
+			}
+			i = Next;
 		}
-		else
-			i++;
 	}
+	m_LastPurgeSecond = maximum(m_LastPurgeSecond, Second - 1);
 }
 
 void ReloadBans()
@@ -327,6 +505,8 @@ int main(int argc, const char **argv) // ignore_convention
 	dbg_logger_stdout();
 	net_init();
 
+	InitRegistry();
+
 	mem_copy(m_CountData.m_Header, SERVERBROWSE_COUNT, sizeof(SERVERBROWSE_COUNT));
 	mem_copy(m_CountDataLegacy.m_Header, SERVERBROWSE_COUNT_LEGACY, sizeof(SERVERBROWSE_COUNT_LEGACY));
 
@@ -452,6 +632,7 @@ int main(int argc, const char **argv) // ignore_convention
 			{
 				// someone requested the list
 				dbg_msg("mastersrv", "requested, responding with %d m_aServers", m_NumServers);
+				BuildPackets();
 
 				CNetChunk p;
 				p.m_ClientID = -1;
@@ -470,6 +651,7 @@ int main(int argc, const char **argv) // ignore_convention
 			{
 				// someone requested the list
 				dbg_msg("mastersrv", "requested, responding with %d m_aServers", m_NumServers);
+				BuildPackets();
 
 				CNetChunk p;
 				p.m_ClientID = -1;
@@ -497,16 +679,11 @@ int main(int argc, const char **argv) // ignore_convention
 			{
 				Type = SERVERTYPE_INVALID;
 				// remove it from checking
-				for(int i = 0; i < m_NumCheckServers; i++)
+				int Index = FindCheckServer(&Packet.m_Address);
+				if(Index >= 0)
 				{
-					if(net_addr_comp(&m_aCheckServers[i].m_Address, &Packet.m_Address) == 0 ||
-						net_addr_comp(&m_aCheckServers[i].m_AltAddress, &Packet.m_Address) == 0)
-					{
-						Type = m_aCheckServers[i].m_Type;
-						m_NumCheckServers--;
-						m_aCheckServers[i] = m_aCheckServers[m_NumCheckServers];
-						break;
-					}
+					Type = m_aCheckServers[Index].m_Type;
+					RemoveCheckServer(Index);
 				}
 
 				// drops servers that were not in the CheckServers list
@@ -531,7 +708,6 @@ int main(int argc, const char **argv) // ignore_convention
 
 			PurgeServers();
 			UpdateServers();
-			BuildPackets();
 		}
 
 		// be nice to the CPU
@@ -5,8 +5,11 @@
 #include <engine/storage.h>
 #include <unicode/ushape.h>
 #include <unicode/ubidi.h>
+#include <zlib.h>
 /* END EDIT ***********************************************************/
 
+#include <vector>
+
 /* LANGUAGE ***********************************************************/
 
 CLocalization::CLanguage::CLanguage() :
@@ -20,6 +23,7 @@ CLocalization::CLanguage::CLanguage() :
 	m_aName[0] = 0;
 	m_aFilename[0] = 0;
 	m_aParentFilename[0] = 0;
+	m_aJsonPath[0] = 0;
 }
 
 CLocalization::CLanguage::CLanguage(const char* pName, const char* pFilename, const char* pParentFilename) :
@@ -32,6 +36,7 @@ CLocalization::CLanguage::CLanguage(const char* pName, const char* pFilename, co
 	str_copy(m_aName, pName, sizeof(m_aName));
 	str_copy(m_aFilename, pFilename, sizeof(m_aFilename));
 	str_copy(m_aParentFilename, pParentFilename, sizeof(m_aParentFilename));
+	m_aJsonPath[0] = 0;
 	
 	UErrorCode Status;
 	
@@ -84,15 +89,6 @@ CLocalization::CLanguage::CLanguage(const char* pName, const char* pFilename, co
 
 CLocalization::CLanguage::~CLanguage()
 {
-	hashtable< CEntry, 128 >::iterator Iter = m_Translations.begin();
-	while(Iter != m_Translations.end())
-	{
-		if(Iter.data())
-			Iter.data()->Free();
-		
-		++Iter;
-	}
-	
 	if(m_pNumberFormater)
 		unum_close(m_pNumberFormater);
 	
@@ -106,17 +102,36 @@ CLocalization::CLanguage::~CLanguage()
 		delete m_pTimeUnitFormater;
 }
 
+static void CatalogPath(const char* pJsonPath, char* pBuffer, int BufferSize)
+{
+	int Length = str_length(pJsonPath);
+	if(str_endswith(pJsonPath, ".json"))
+		Length -= 5;
+	str_format(pBuffer, BufferSize, "%.*s.catalog", Length, pJsonPath);
+}
+
 /* BEGIN EDIT *********************************************************/
 bool CLocalization::CLanguage::Load(CLocalization* pLocalization, CStorage* pStorage)
 /* END EDIT ***********************************************************/
 {
 	// read file data into buffer
 	char aBuf[256];
+	char aCatalogPath[512];
 	str_format(aBuf, sizeof(aBuf), "languages/%s.json", m_aFilename);
 	
-	IOHANDLE File = pStorage->OpenFile(aBuf, IOFLAG_READ, CStorage::TYPE_ALL);
+	IOHANDLE File = pStorage->OpenFile(aBuf, IOFLAG_READ, CStorage::TYPE_ALL, m_aJsonPath, sizeof(m_aJsonPath));
 	if(!File)
-		return false;
+	{
+		// a compiled catalog can be shipped without its json file
+		m_aJsonPath[0] = 0;
+		str_format(aBuf, sizeof(aBuf), "languages/%s.catalog", m_aFilename);
+		File = pStorage->OpenFile(aBuf, IOFLAG_READ, CStorage::TYPE_ALL, aCatalogPath, sizeof(aCatalogPath));
+		if(!File)
+			return false;
+		io_close(File);
+		m_Loaded = m_Catalog.Load(aCatalogPath);
+		return m_Loaded;
+	}
 	
 	// load the file as a string
 	int FileSize = (int)io_length(File);
@@ -124,7 +139,27 @@ bool CLocalization::CLanguage::Load(CLocalization* pLocalization, CStorage* pSto
 	io_read(File, pFileData, FileSize);
 	pFileData[FileSize] = 0;
 	io_close(File);
+	unsigned Crc = crc32(0, (const Bytef *)pFileData, FileSize); // ignore_convention
 
+	// use the compiled catalog if it was made from this json file
+	CatalogPath(m_aJsonPath, aCatalogPath, sizeof(aCatalogPath));
+	if(m_Catalog.Load(aCatalogPath) && m_Catalog.SourceCrc() == Crc)
+	{
+		delete[] pFileData;
+		m_Loaded = true;
+		return true;
+	}
+	
+	bool Success = LoadJson(pFileData, Crc);
+	if(!Success)
+		dbg_msg("Localization", "Can't load the localization file %s", aBuf);
+	delete[] pFileData;
+	m_Loaded = Success;
+	return Success;
+}
+
+bool CLocalization::CLanguage::LoadJson(const char* pFileData, unsigned Crc)
+{
 	// parse json data
 	json_settings JsonSettings;
 	mem_zero(&JsonSettings, sizeof(JsonSettings));
@@ -132,111 +167,74 @@ bool CLocalization::CLanguage::Load(CLocalization* pLocalization, CStorage* pSto
 	json_value *pJsonData = json_parse_ex(&JsonSettings, pFileData, aError);
 	if(pJsonData == 0)
 	{
-		dbg_msg("Localization", "Can't load the localization file %s : %s", aBuf, aError);
-		delete[] pFileData;
+		dbg_msg("Localization", "Can't parse the localization file: %s", aError);
 		return false;
 	}
 	
-	dynamic_string Buffer;
-	int Length;
-
-	// extract data
+	static const char *s_apPluralNames[NUM_PLURALTYPES] = {"value", "zero", "one", "two", "few", "many", "other"};
+	
+	// extract data, the strings stay in the json values until the catalog is built
+	std::vector<CLocalizationCatalog::CEntry> lEntries;
 	const json_value &rStart = (*pJsonData)["translation"];
 	if(rStart.type == json_array)
 	{
 		for(unsigned i = 0; i < rStart.u.array.length; ++i)
 		{
 			const char* pKey = rStart[i]["key"];
-			if(pKey && pKey[0])
+			if(!pKey || !pKey[0])
+				continue;
+			
+			CLocalizationCatalog::CEntry Entry;
+			Entry.m_pKey = pKey;
+			for(int v = 0; v < NUM_PLURALTYPES; v++)
+				Entry.m_apVersions[v] = NULL;
+			
+			const char* pSingular = rStart[i]["value"];
+			if(pSingular && pSingular[0])
+				Entry.m_apVersions[PLURALTYPE_NONE] = pSingular;
+			else
 			{
-				CEntry* pEntry = m_Translations.set(pKey);
-				
-				const char* pSingular = rStart[i]["value"];
-				if(pSingular && pSingular[0])
-				{
-					Length = str_length(pSingular)+1;
-					pEntry->m_apVersions[PLURALTYPE_NONE] = new char[Length];
-					str_copy(pEntry->m_apVersions[PLURALTYPE_NONE], pSingular, Length);
-				}
-				else
+				for(int v = PLURALTYPE_ZERO; v < NUM_PLURALTYPES; v++)
 				{
-					const char* pPlural;
-					
-					//Zero
-					pPlural = rStart[i]["zero"];
-					if(pPlural && pPlural[PLURALTYPE_ZERO])
-					{
-						Length = str_length(pPlural)+1;
-						pEntry->m_apVersions[PLURALTYPE_ZERO] = new char[Length];
-						str_copy(pEntry->m_apVersions[PLURALTYPE_ZERO], pPlural, Length);
-					}
-					//One
-					pPlural = rStart[i]["one"];
-					if(pPlural && pPlural[PLURALTYPE_ONE])
-					{
-						Length = str_length(pPlural)+1;
-						pEntry->m_apVersions[PLURALTYPE_ONE] = new char[Length];
-						str_copy(pEntry->m_apVersions[PLURALTYPE_ONE], pPlural, Length);
-					}
-					//Two
-					pPlural = rStart[i]["two"];
-					if(pPlural && pPlural[PLURALTYPE_TWO])
-					{
-						Length = str_length(pPlural)+1;
-						pEntry->m_apVersions[PLURALTYPE_TWO] = new char[Length];
-						str_copy(pEntry->m_apVersions[PLURALTYPE_TWO], pPlural, Length);
-					}
-					//Few
-					pPlural = rStart[i]["few"];
-					if(pPlural && pPlural[PLURALTYPE_FEW])
-					{
-						Length = str_length(pPlural)+1;
-						pEntry->m_apVersions[PLURALTYPE_FEW] = new char[Length];
-						str_copy(pEntry->m_apVersions[PLURALTYPE_FEW], pPlural, Length);
-					}
-					//Many
-					pPlural = rStart[i]["many"];
-					if(pPlural && pPlural[PLURALTYPE_MANY])
-					{
-						Length = str_length(pPlural)+1;
-						pEntry->m_apVersions[PLURALTYPE_MANY] = new char[Length];
-						str_copy(pEntry->m_apVersions[PLURALTYPE_MANY], pPlural, Length);
-					}
-					//Other
-					pPlural = rStart[i]["other"];
-					if(pPlural && pPlural[PLURALTYPE_OTHER])
-					{
-						Length = str_length(pPlural)+1;
-						pEntry->m_apVersions[PLURALTYPE_OTHER] = new char[Length];
-						str_copy(pEntry->m_apVersions[PLURALTYPE_OTHER], pPlural, Length);
-					}
+					const char* pPlural = rStart[i][s_apPluralNames[v]];
+					if(pPlural && pPlural[0])
+						Entry.m_apVersions[v] = pPlural;
 				}
 			}
+			lEntries.push_back(Entry);
 		}
 	}
+	
+	bool Success = m_Catalog.Build(lEntries.empty() ? 0 : &lEntries[0], lEntries.size(), Crc);
 
 	// clean up
 	json_value_free(pJsonData);
-	delete[] pFileData;
-	
-	m_Loaded = true;
+	return Success;
+}
+
+bool CLocalization::CLanguage::IsCompiled() const
+{
+	return m_Catalog.IsMapped();
+}
+
+bool CLocalization::CLanguage::SaveCatalog() const
+{
+	if(!m_aJsonPath[0] || !m_Catalog.IsLoaded())
+		return false;
 	
-	return true;
+	char aCatalogPath[512];
+	CatalogPath(m_aJsonPath, aCatalogPath, sizeof(aCatalogPath));
+	return m_Catalog.Save(aCatalogPath);
 }
 
 const char* CLocalization::CLanguage::Localize(const char* pText) const
 {	
-	const CEntry* pEntry = m_Translations.get(pText);
-	if(!pEntry)
-		return NULL;
-	
-	return pEntry->m_apVersions[PLURALTYPE_NONE];
+	return m_Catalog.Find(pText, PLURALTYPE_NONE);
 }
 
 const char* CLocalization::CLanguage::Localize_P(int Number, const char* pText) const
 {
-	const CEntry* pEntry = m_Translations.get(pText);
-	if(!pEntry)
+	if(!m_Catalog.IsLoaded())
 		return NULL;
 	
 	UChar aPluralKeyWord[6];
@@ -264,7 +262,7 @@ const char* CLocalization::CLanguage::Localize_P(int Number, const char* pText)
 			PluralCode = PLURALTYPE_ONE;
 	}
 	
-	return pEntry->m_apVersions[PluralCode];
+	return m_Catalog.Find(pText, PluralCode);
 }
 
 /* LOCALIZATION *******************************************************/
@@ -348,11 +346,7 @@ bool CLocalization::Init()
 				pLanguage->SetWritingDirection(DIRECTION_RTL);
 				
 			if(m_Cfg_MainLanguage == pLanguage->GetFilename())
-			{
-				pLanguage->Load(this, Storage());
-				
 				m_pMainLanguage = pLanguage;
-			}
 		}
 	}
 
@@ -360,8 +354,69 @@ bool CLocalization::Init()
 	json_value_free(pJsonData);
 	delete[] pFileData;
 	
+	PreloadLanguages();
+	
 	return true;
 }
+
+struct CPreloadJob
+{
+	CLocalization* m_pLocalization;
+	class CStorage* m_pStorage;
+	array<CLocalization::CLanguage*>* m_pLanguages;
+	int m_Next;
+	LOCK m_Lock;
+};
+
+static void PreloadThread(void* pUser)
+{
+	CPreloadJob* pJob = (CPreloadJob*)pUser;
+	while(1)
+	{
+		lock_wait(pJob->m_Lock);
+		int Next = pJob->m_Next++;
+		lock_unlock(pJob->m_Lock);
+		if(Next >= pJob->m_pLanguages->size())
+			break;
+		
+		(*pJob->m_pLanguages)[Next]->Load(pJob->m_pLocalization, pJob->m_pStorage);
+	}
+}
+
+// Loads every language up front, so no json file gets parsed on the main
+// thread in the middle of a round the first time a player needs it.
+void CLocalization::PreloadLanguages()
+{
+	int64 StartTime = time_get();
+	
+	CPreloadJob Job;
+	Job.m_pLocalization = this;
+	Job.m_pStorage = Storage();
+	Job.m_pLanguages = &m_pLanguages;
+	Job.m_Next = 0;
+	Job.m_Lock = lock_create();
+	
+	const int NumThreads = minimum(4, m_pLanguages.size());
+	array<void*> lThreads;
+	for(int i = 1; i < NumThreads; i++)
+	{
+		void* pThread = thread_init(PreloadThread, &Job, "localization preload");
+		if(pThread)
+			lThreads.add(pThread);
+	}
+	PreloadThread(&Job);
+	for(int i = 0; i < lThreads.size(); i++)
+		thread_wait(lThreads[i]);
+	lock_destroy(Job.m_Lock);
+	
+	int NumCompiled = 0;
+	for(int i = 0; i < m_pLanguages.size(); i++)
+	{
+		if(m_pLanguages[i]->IsLoaded() && m_pLanguages[i]->IsCompiled())
+			NumCompiled++;
+	}
+	dbg_msg("Localization", "%d languages loaded (%d compiled) in %.2fms", m_pLanguages.size(), NumCompiled, (time_get() - StartTime) * 1000.0f / time_freq());
+}
 	
 void CLocalization::AddListener(IListener* pListener)
 {
@@ -597,9 +652,8 @@ const char* CLocalization::LocalizeWithDepth(const char* pLanguageCode, const ch
 	if(!pLanguage)
 		return pText;
 	
-	if(!pLanguage->IsLoaded())
-		pLanguage->Load(this, Storage());
-	
+	// every language was loaded by PreloadLanguages, the ones without a file
+	// (such as "en") stay empty instead of being looked for again
 	const char* pResult = pLanguage->Localize(pText);
 	if(pResult)
 		return pResult;
@@ -632,9 +686,6 @@ const char* CLocalization::LocalizeWithDepth_P(const char* pLanguageCode, int Nu
 	if(!pLanguage)
 		return pText;
 	
-	if(!pLanguage->IsLoaded())
-		pLanguage->Load(this, Storage());
-	
 	const char* pResult = pLanguage->Localize_P(Number, pText);
 	if(pResult)
 		return pResult;
@@ -3,6 +3,7 @@
 
 /* BEGIN EDIT *********************************************************/
 #include <teeuniverses/tl/hashtable.h>
+#include <teeuniverses/components/localization_catalog.h>
 #define CStorage IStorage
 /* END EDIT ***********************************************************/
 
@@ -60,34 +61,17 @@ public:
 
 	class CLanguage
 	{
-	protected:
-		class CEntry
-		{
-		public:
-			char* m_apVersions[NUM_PLURALTYPES];
-			
-			CEntry()
-			{
-				for(int i=0; i<NUM_PLURALTYPES; i++)
-					m_apVersions[i] = NULL;
-			}
-			
-			void Free()
-			{
-				for(int i=0; i<NUM_PLURALTYPES; i++)
-					if(m_apVersions[i])
-						delete[] m_apVersions[i];
-			}
-		};
-		
 	protected:
 		char m_aName[64];
 		char m_aFilename[64];
 		char m_aParentFilename[64];
+		char m_aJsonPath[512];
 		bool m_Loaded;
 		int m_Direction;
 		
-		hashtable< CEntry, 128 > m_Translations;
+		CLocalizationCatalog m_Catalog;
+		
+		bool LoadJson(const char* pFileData, unsigned Crc);
 	
 	public:
 		UPluralRules* m_pPluralRules;
@@ -107,6 +91,8 @@ public:
 		inline void SetWritingDirection(int Direction) { m_Direction = Direction; }
 		inline bool IsLoaded() const { return m_Loaded; }
 		bool Load(CLocalization* pLocalization, class CStorage* pStorage);
+		bool SaveCatalog() const;
+		bool IsCompiled() const;
 		const char* Localize(const char* pKey) const;
 		const char* Localize_P(int Number, const char* pText) const;
 	};
@@ -130,6 +116,8 @@ public:
 	fixed_string128 m_Cfg_MainLanguage;
 
 protected:
+	void PreloadLanguages();
+	
 	const char* LocalizeWithDepth(const char* pLanguageCode, const char* pText, int Depth);
 	const char* LocalizeWithDepth_P(const char* pLanguageCode, int Number, const char* pText, int Depth);
 	
@@ -0,0 +1,251 @@
+#include "localization_catalog.h"
+
+#include <base/math.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+static const char s_aCatalogMagic[4] = {'T', 'W', 'L', 'C'};
+
+CLocalizationCatalog::CLocalizationCatalog() :
+	m_pData(0),
+	m_DataSize(0),
+	m_Mapped(false)
+{
+}
+
+CLocalizationCatalog::~CLocalizationCatalog()
+{
+	Unload();
+}
+
+unsigned CLocalizationCatalog::Hash(const char *pKey, unsigned Seed)
+{
+	// fnv-1a with a final mix, so the seeds give independent slot choices
+	unsigned Hash = 2166136261u ^ (Seed * 0x9e3779b9u);
+	for(const unsigned char *p = (const unsigned char *)pKey; *p; p++)
+	{
+		Hash ^= *p;
+		Hash *= 16777619u;
+	}
+	Hash ^= Hash >> 16;
+	Hash *= 0x85ebca6bu;
+	Hash ^= Hash >> 13;
+	Hash *= 0xc2b2ae35u;
+	Hash ^= Hash >> 16;
+	return Hash;
+}
+
+void CLocalizationCatalog::Unload()
+{
+	mem_account(MEMTAG_LOCALIZATION, -(int64)m_DataSize);
+	if(m_Mapped)
+		io_unmap_file((void *)m_pData, m_DataSize);
+	std::vector<unsigned char>().swap(m_lOwnedData);
+	m_pData = 0;
+	m_DataSize = 0;
+	m_Mapped = false;
+}
+
+bool CLocalizationCatalog::Build(const CEntry *pEntries, int NumEntries, unsigned SourceCrc)
+{
+	Unload();
+
+	// a key that appears twice keeps its last translation
+	std::vector<const CEntry *> lEntries;
+	std::unordered_map<std::string, int> KeyIndices;
+	for(int i = 0; i < NumEntries; i++)
+	{
+		std::pair<std::unordered_map<std::string, int>::iterator, bool> Result = KeyIndices.insert(std::make_pair(std::string(pEntries[i].m_pKey), (int)lEntries.size()));
+		if(Result.second)
+			lEntries.push_back(&pEntries[i]);
+		else
+			lEntries[Result.first->second] = &pEntries[i];
+	}
+	NumEntries = lEntries.size();
+
+	std::vector<unsigned> lHashes(NumEntries);
+	for(int i = 0; i < NumEntries; i++)
+		lHashes[i] = Hash(lEntries[i]->m_pKey, 0);
+
+	int NumBuckets = maximum((NumEntries + 3) / 4, 1);
+	std::vector<std::vector<int> > lBuckets(NumBuckets);
+	for(int i = 0; i < NumEntries; i++)
+		lBuckets[lHashes[i] % NumBuckets].push_back(i);
+
+	// the largest buckets are the hardest to place, they go first
+	std::vector<int> lOrder(NumBuckets);
+	for(int i = 0; i < NumBuckets; i++)
+		lOrder[i] = i;
+	std::stable_sort(lOrder.begin(), lOrder.end(), [&lBuckets](int a, int b) { return lBuckets[a].size() > lBuckets[b].size(); });
+
+	int NumSlots = maximum(NumEntries, 1);
+	std::vector<unsigned> lSeeds;
+	std::vector<int> lSlotEntries;
+	while(1)
+	{
+		lSeeds.assign(NumBuckets, 0);
+		lSlotEntries.assign(NumSlots, -1);
+		bool Placed = true;
+		for(int b = 0; b < NumBuckets && Placed; b++)
+		{
+			const std::vector<int> &lBucket = lBuckets[lOrder[b]];
+			if(lBucket.empty())
+				break;
+
+			Placed = false;
+			std::vector<int> lBucketSlots(lBucket.size());
+			for(unsigned Seed = 1; Seed < (1u << 16) && !Placed; Seed++)
+			{
+				Placed = true;
+				for(unsigned k = 0; k < lBucket.size() && Placed; k++)
+				{
+					int Slot = Hash(lEntries[lBucket[k]]->m_pKey, Seed) % NumSlots;
+					if(lSlotEntries[Slot] != -1 || std::find(lBucketSlots.begin(), lBucketSlots.begin() + k, Slot) != lBucketSlots.begin() + k)
+						Placed = false;
+					lBucketSlots[k] = Slot;
+				}
+				if(Placed)
+				{
+					lSeeds[lOrder[b]] = Seed;
+					for(unsigned k = 0; k < lBucket.size(); k++)
+						lSlotEntries[lBucketSlots[k]] = lBucket[k];
+				}
+			}
+		}
+		if(Placed)
+			break;
+		// very unlikely, make some room and try again
+		NumSlots += NumSlots / 8 + 1;
+	}
+
+	// slots, then the strings they point to
+	std::vector<int> lSlots(NumSlots * SLOT_SIZE, -1);
+	std::vector<char> lStrings;
+	for(int s = 0; s < NumSlots; s++)
+	{
+		if(lSlotEntries[s] < 0)
+			continue;
+		const CEntry *pEntry = lEntries[lSlotEntries[s]];
+		for(int v = -1; v < NUM_VERSIONS; v++)
+		{
+			const char *pString = v < 0 ? pEntry->m_pKey : pEntry->m_apVersions[v];
+			if(!pString)
+				continue;
+			lSlots[s * SLOT_SIZE + 1 + v] = lStrings.size();
+			lStrings.insert(lStrings.end(), pString, pString + str_length(pString) + 1);
+		}
+	}
+	if(lStrings.empty())
+		lStrings.push_back(0);
+
+	CHeader Header;
+	mem_copy(Header.m_aMagic, s_aCatalogMagic, sizeof(Header.m_aMagic));
+	Header.m_Version = VERSION;
+	Header.m_NumSlots = NumSlots;
+	Header.m_NumBuckets = NumBuckets;
+	Header.m_NumEntries = NumEntries;
+	Header.m_StringsSize = lStrings.size();
+	Header.m_SourceCrc = SourceCrc;
+
+	unsigned DataSize = sizeof(Header) + lSeeds.size() * sizeof(unsigned) + lSlots.size() * sizeof(int) + lStrings.size();
+	m_lOwnedData.resize(DataSize);
+	unsigned char *pData = &m_lOwnedData[0];
+	mem_copy(pData, &Header, sizeof(Header));
+	pData += sizeof(Header);
+	mem_copy(pData, &lSeeds[0], lSeeds.size() * sizeof(unsigned));
+	pData += lSeeds.size() * sizeof(unsigned);
+	mem_copy(pData, &lSlots[0], lSlots.size() * sizeof(int));
+	pData += lSlots.size() * sizeof(int);
+	mem_copy(pData, &lStrings[0], lStrings.size());
+
+	m_pData = &m_lOwnedData[0];
+	m_DataSize = DataSize;
+	mem_account(MEMTAG_LOCALIZATION, m_DataSize);
+	return true;
+}
+
+bool CLocalizationCatalog::Validate() const
+{
+	if(m_DataSize < sizeof(CHeader))
+		return false;
+	const CHeader *pHeader = Header();
+	if(mem_comp(pHeader->m_aMagic, s_aCatalogMagic, sizeof(pHeader->m_aMagic)) != 0 || pHeader->m_Version != VERSION)
+		return false;
+	if(pHeader->m_NumSlots < 1 || pHeader->m_NumBuckets < 1 || pHeader->m_NumEntries < 0 || pHeader->m_StringsSize < 1)
+		return false;
+	if(pHeader->m_NumSlots > (int)(m_DataSize / (SLOT_SIZE * sizeof(int))) || pHeader->m_NumBuckets > (int)(m_DataSize / sizeof(unsigned)))
+		return false;
+
+	unsigned Size = sizeof(CHeader) + pHeader->m_NumBuckets * sizeof(unsigned) + pHeader->m_NumSlots * SLOT_SIZE * sizeof(int) + pHeader->m_StringsSize;
+	if(Size != m_DataSize || Strings()[pHeader->m_StringsSize - 1] != 0)
+		return false;
+
+	const int *pSlots = Slots();
+	for(int i = 0; i < pHeader->m_NumSlots * SLOT_SIZE; i++)
+	{
+		if(pSlots[i] < -1 || pSlots[i] >= pHeader->m_StringsSize)
+			return false;
+	}
+	return true;
+}
+
+bool CLocalizationCatalog::Load(const char *pFilename)
+{
+	Unload();
+
+	unsigned Size;
+	void *pData = io_map_file(pFilename, &Size);
+	if(!pData)
+		return false;
+
+	m_pData = (const unsigned char *)pData;
+	m_DataSize = Size;
+	m_Mapped = true;
+	mem_account(MEMTAG_LOCALIZATION, m_DataSize);
+	if(!Validate())
+	{
+		dbg_msg("localization", "invalid catalog '%s'", pFilename);
+		Unload();
+		return false;
+	}
+	return true;
+}
+
+bool CLocalizationCatalog::Save(const char *pFilename) const
+{
+	if(!m_pData)
+		return false;
+
+	IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+	if(!File)
+		return false;
+	bool Success = io_write(File, m_pData, m_DataSize) == m_DataSize;
+	io_close(File);
+	return Success;
+}
+
+unsigned CLocalizationCatalog::SourceCrc() const
+{
+	return m_pData ? Header()->m_SourceCrc : 0;
+}
+
+int CLocalizationCatalog::NumEntries() const
+{
+	return m_pData ? Header()->m_NumEntries : 0;
+}
+
+const char *CLocalizationCatalog::Find(const char *pKey, int Version) const
+{
+	if(!m_pData)
+		return 0;
+
+	const CHeader *pHeader = Header();
+	unsigned Bucket = Hash(pKey, 0) % pHeader->m_NumBuckets;
+	unsigned Slot = Hash(pKey, Seeds()[Bucket]) % pHeader->m_NumSlots;
+	const int *pSlot = &Slots()[Slot * SLOT_SIZE];
+	if(pSlot[0] < 0 || str_comp(Strings() + pSlot[0], pKey) != 0)
+		return 0;
+	return pSlot[1 + Version] < 0 ? 0 : Strings() + pSlot[1 + Version];
+}
@@ -0,0 +1,74 @@
+#ifndef TEEUNIVERSES_COMPONENTS_LOCALIZATION_CATALOG_H
+#define TEEUNIVERSES_COMPONENTS_LOCALIZATION_CATALOG_H
+
+#include <base/system.h>
+
+#include <vector>
+
+// Translations of one language in a single flat block, so the same data can
+// be built from the json files or memory-mapped from a compiled catalog.
+// Keys are found with a minimal perfect hash: the hash of the key picks a
+// bucket, and the bucket's seed places its keys into free slots.
+class CLocalizationCatalog
+{
+public:
+	enum
+	{
+		NUM_VERSIONS = 7, // CLocalization::NUM_PLURALTYPES
+		VERSION = 1,
+	};
+
+	struct CEntry
+	{
+		const char *m_pKey;
+		const char *m_apVersions[NUM_VERSIONS];
+	};
+
+	CLocalizationCatalog();
+	~CLocalizationCatalog();
+
+	// SourceCrc identifies the json file the entries come from
+	bool Build(const CEntry *pEntries, int NumEntries, unsigned SourceCrc);
+	bool Load(const char *pFilename);
+	bool Save(const char *pFilename) const;
+	void Unload();
+
+	bool IsLoaded() const { return m_pData != 0; }
+	bool IsMapped() const { return m_Mapped; }
+	unsigned SourceCrc() const;
+	int NumEntries() const;
+	const char *Find(const char *pKey, int Version) const;
+
+	static unsigned Hash(const char *pKey, unsigned Seed);
+
+private:
+	struct CHeader
+	{
+		char m_aMagic[4];
+		int m_Version;
+		int m_NumSlots;
+		int m_NumBuckets;
+		int m_NumEntries;
+		int m_StringsSize;
+		unsigned m_SourceCrc;
+	};
+
+	enum
+	{
+		SLOT_SIZE = 1 + NUM_VERSIONS, // key offset and one offset per version, -1 if empty
+	};
+
+	const unsigned char *m_pData;
+	unsigned m_DataSize;
+	bool m_Mapped;
+	std::vector<unsigned char> m_lOwnedData;
+
+	const CHeader *Header() const { return (const CHeader *)m_pData; }
+	const unsigned *Seeds() const { return (const unsigned *)(Header() + 1); }
+	const int *Slots() const { return (const int *)(Seeds() + Header()->m_NumBuckets); }
+	const char *Strings() const { return (const char *)(Slots() + Header()->m_NumSlots * SLOT_SIZE); }
+
+	bool Validate() const;
+};
+
+#endif
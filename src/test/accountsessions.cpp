@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/server/accountsessions.h>
+#include <engine/shared/network.h>
+
+static NETADDR Addr(const char *pAddr)
+{
+	NETADDR Addr;
+	net_addr_from_str(&Addr, pAddr);
+	return Addr;
+}
+
+TEST(AccountSessions, DropTypes)
+{
+	// a timeout arrives as stressing, it must keep the account
+	EXPECT_TRUE(CAccountSessions::KeepsSession(CLIENTDROPTYPE_STRESSING));
+	EXPECT_TRUE(CAccountSessions::KeepsSession(CLIENTDROPTYPE_ERROR));
+	EXPECT_TRUE(CAccountSessions::KeepsSession(CLIENTDROPTYPE_LOGOUT));
+	EXPECT_FALSE(CAccountSessions::KeepsSession(CLIENTDROPTYPE_KICK));
+	EXPECT_FALSE(CAccountSessions::KeepsSession(CLIENTDROPTYPE_BAN));
+	EXPECT_FALSE(CAccountSessions::KeepsSession(CLIENTDROPTYPE_SHUTDOWN));
+}
+
+TEST(AccountSessions, Timeout)
+{
+	// the client times out and comes back on another slot, others took the old one meanwhile
+	CAccountSessions Sessions;
+	NETADDR ClientAddr = Addr("10.0.0.1:50000");
+	Sessions.Save(&ClientAddr, 42, "nameless tee", 100);
+	EXPECT_EQ(Sessions.Num(0), 1);
+
+	CAccountSessions::CSession Session;
+	NETADDR OtherAddr = Addr("10.0.0.2:50000");
+	EXPECT_FALSE(Sessions.Take(&OtherAddr, 10, &Session));
+	NETADDR OtherPort = Addr("10.0.0.1:50001");
+	EXPECT_FALSE(Sessions.Take(&OtherPort, 10, &Session));
+
+	ASSERT_TRUE(Sessions.Take(&ClientAddr, 10, &Session));
+	EXPECT_EQ(Session.m_UserID, 42);
+	EXPECT_STREQ(Session.m_aUsername, "nameless tee");
+
+	// given back once only
+	EXPECT_FALSE(Sessions.Take(&ClientAddr, 10, &Session));
+	EXPECT_EQ(Sessions.Num(0), 0);
+}
+
+TEST(AccountSessions, Expire)
+{
+	CAccountSessions Sessions;
+	NETADDR ClientAddr = Addr("10.0.0.1:50000");
+	Sessions.Save(&ClientAddr, 42, "nameless tee", 100);
+	CAccountSessions::CSession Session;
+	EXPECT_FALSE(Sessions.Take(&ClientAddr, 100, &Session));
+	EXPECT_FALSE(Sessions.Take(&ClientAddr, 10, &Session));
+}
+
+TEST(AccountSessions, Replace)
+{
+	CAccountSessions Sessions;
+	NETADDR ClientAddr = Addr("10.0.0.1:50000");
+	Sessions.Save(&ClientAddr, 42, "first", 100);
+	Sessions.Save(&ClientAddr, 43, "second", 200);
+	EXPECT_EQ(Sessions.Num(0), 1);
+
+	CAccountSessions::CSession Session;
+	ASSERT_TRUE(Sessions.Take(&ClientAddr, 150, &Session));
+	EXPECT_EQ(Session.m_UserID, 43);
+}
+
+TEST(AccountSessions, Full)
+{
+	// the session closest to expire makes room
+	CAccountSessions Sessions;
+	for(int i = 0; i < CAccountSessions::MAX_SESSIONS; i++)
+	{
+		char aAddr[NETADDR_MAXSTRSIZE];
+		str_format(aAddr, sizeof(aAddr), "10.0.%d.%d:8303", i / 256, i % 256);
+		NETADDR ClientAddr = Addr(aAddr);
+		Sessions.Save(&ClientAddr, i, "", 1000 + i);
+	}
+	NETADDR NewAddr = Addr("10.1.0.0:8303");
+	Sessions.Save(&NewAddr, 1000, "", 5000);
+	EXPECT_EQ(Sessions.Num(0), CAccountSessions::MAX_SESSIONS);
+
+	CAccountSessions::CSession Session;
+	NETADDR OldestAddr = Addr("10.0.0.0:8303");
+	EXPECT_FALSE(Sessions.Take(&OldestAddr, 0, &Session));
+	EXPECT_TRUE(Sessions.Take(&NewAddr, 0, &Session));
+	NETADDR SecondAddr = Addr("10.0.0.1:8303");
+	EXPECT_TRUE(Sessions.Take(&SecondAddr, 0, &Session));
+}
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/datafile.h>
+#include <engine/storage.h>
+
+#include <vector>
+
+static const char s_aFilename[] = "test_datafile.map";
+
+class DataFile : public ::testing::Test
+{
+protected:
+	IStorage *m_pStorage;
+	std::vector<std::vector<int> > m_lBlocks;
+
+	void SetUp()
+	{
+		m_pStorage = CreateTempStorage(".");
+
+		// a mix of highly compressible, random and tiny blocks
+		unsigned Seed = 1;
+		for(int b = 0; b < 12; b++)
+		{
+			std::vector<int> lBlock(b == 11 ? 1 : 1000 * (b + 1));
+			for(unsigned i = 0; i < lBlock.size(); i++)
+			{
+				Seed = Seed * 1103515245 + 12345;
+				lBlock[i] = b % 2 ? (int)(Seed >> 8) : (int)(i / 64);
+			}
+			m_lBlocks.push_back(lBlock);
+		}
+
+		Write(s_aFilename, 1);
+	}
+
+	void TearDown()
+	{
+		m_pStorage->RemoveFile(s_aFilename, IStorage::TYPE_SAVE);
+		delete m_pStorage;
+	}
+
+	void Write(const char *pFilename, int NumThreads)
+	{
+		CDataFileWriter Writer;
+		ASSERT_TRUE(Writer.Open(m_pStorage, pFilename));
+		Writer.SetCompressionThreads(NumThreads);
+		int Item[2] = {1, 2};
+		Writer.AddItem(1, 0, sizeof(Item), Item);
+		for(unsigned b = 0; b < m_lBlocks.size(); b++)
+			Writer.AddData(m_lBlocks[b].size() * sizeof(int), &m_lBlocks[b][0]);
+		Writer.Finish();
+	}
+
+	std::vector<char> ReadFile(const char *pFilename)
+	{
+		IOHANDLE File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, IStorage::TYPE_SAVE);
+		std::vector<char> lData(io_length(File));
+		io_read(File, &lData[0], lData.size());
+		io_close(File);
+		return lData;
+	}
+
+	void WriteFile(const char *pFilename, const std::vector<char> &lData)
+	{
+		IOHANDLE File = m_pStorage->OpenFile(pFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		io_write(File, &lData[0], lData.size());
+		io_close(File);
+	}
+
+	void ExpectBlocks(CDataFileReader *pReader)
+	{
+		ASSERT_EQ(pReader->NumData(), (int)m_lBlocks.size());
+		for(unsigned b = 0; b < m_lBlocks.size(); b++)
+		{
+			ASSERT_EQ(pReader->GetDataSize(b), (int)(m_lBlocks[b].size() * sizeof(int)));
+			EXPECT_EQ(mem_comp(pReader->GetData(b), &m_lBlocks[b][0], m_lBlocks[b].size() * sizeof(int)), 0);
+		}
+	}
+};
+
+TEST_F(DataFile, Mapped)
+{
+	CDataFileReader Read;
+	ASSERT_TRUE(Read.Open(m_pStorage, s_aFilename, IStorage::TYPE_ALL));
+	CDataFileReader Mapped;
+	ASSERT_TRUE(Mapped.Open(m_pStorage, s_aFilename, IStorage::TYPE_ALL, CDataFileReader::OPENFLAG_MAP));
+
+	EXPECT_EQ(Read.Crc(), Mapped.Crc());
+	EXPECT_TRUE(Read.Sha256() == Mapped.Sha256());
+	ExpectBlocks(&Read);
+	ExpectBlocks(&Mapped);
+
+	int *pItem = (int *)Mapped.FindItem(1, 0);
+	ASSERT_TRUE(pItem);
+	EXPECT_EQ(pItem[1], 2);
+}
+
+TEST_F(DataFile, LoadData)
+{
+	for(int Flags = 0; Flags <= CDataFileReader::OPENFLAG_MAP; Flags++)
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(m_pStorage, s_aFilename, IStorage::TYPE_ALL, Flags));
+
+		// duplicates and invalid indices are ignored
+		int aIndices[] = {3, 1, 3, -1, 100};
+		EXPECT_TRUE(Reader.LoadData(aIndices, sizeof(aIndices) / sizeof(aIndices[0]), 4));
+		EXPECT_TRUE(Reader.LoadData(0, 0, 4));
+		ExpectBlocks(&Reader);
+
+		// loaded data stays writable and can be loaded again
+		((int *)Reader.GetData(0))[0] = -1;
+		Reader.UnloadData(0);
+		EXPECT_TRUE(Reader.LoadData(0, 0, 4));
+		ExpectBlocks(&Reader);
+	}
+}
+
+TEST_F(DataFile, ParallelCompression)
+{
+	static const char s_aParallelFilename[] = "test_datafile_parallel.map";
+	Write(s_aParallelFilename, 4);
+
+	CDataFileReader Serial;
+	ASSERT_TRUE(Serial.Open(m_pStorage, s_aFilename, IStorage::TYPE_ALL));
+	CDataFileReader Parallel;
+	ASSERT_TRUE(Parallel.Open(m_pStorage, s_aParallelFilename, IStorage::TYPE_ALL));
+	EXPECT_TRUE(Serial.Sha256() == Parallel.Sha256());
+	ExpectBlocks(&Parallel);
+
+	Parallel.Close();
+	m_pStorage->RemoveFile(s_aParallelFilename, IStorage::TYPE_SAVE);
+}
+
+TEST_F(DataFile, Truncated)
+{
+	std::vector<char> lData = ReadFile(s_aFilename);
+	for(int Cut = 1; Cut < 8; Cut++)
+	{
+		// from the end of the data back into the header
+		std::vector<char> lTruncated(lData.begin(), lData.begin() + lData.size() * (8 - Cut) / 8 + 1);
+		WriteFile(s_aFilename, lTruncated);
+		for(int Flags = 0; Flags <= CDataFileReader::OPENFLAG_MAP; Flags++)
+		{
+			CDataFileReader Reader;
+			EXPECT_FALSE(Reader.Open(m_pStorage, s_aFilename, IStorage::TYPE_ALL, Flags));
+		}
+	}
+}
+
+TEST_F(DataFile, CorruptData)
+{
+	// the last bytes belong to the compressed stream of the last block
+	std::vector<char> lData = ReadFile(s_aFilename);
+	for(int i = 1; i <= 4; i++)
+		lData[lData.size() - i] ^= 0x5a;
+	WriteFile(s_aFilename, lData);
+
+	for(int Flags = 0; Flags <= CDataFileReader::OPENFLAG_MAP; Flags++)
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(m_pStorage, s_aFilename, IStorage::TYPE_ALL, Flags));
+		EXPECT_FALSE(Reader.GetData(m_lBlocks.size() - 1));
+		EXPECT_FALSE(Reader.LoadData(0, 0, 4));
+		EXPECT_TRUE(Reader.GetData(0));
+	}
+}
@@ -0,0 +1,464 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/huffman.h>
+#include <engine/shared/network.h>
+
+// the old single symbol codec, kept to check that the table driven one
+// produces exactly the same bytes
+class CReferenceHuffman
+{
+	enum
+	{
+		HUFFMAN_EOF_SYMBOL = 256,
+
+		HUFFMAN_MAX_SYMBOLS = HUFFMAN_EOF_SYMBOL + 1,
+		HUFFMAN_MAX_NODES = HUFFMAN_MAX_SYMBOLS * 2 - 1,
+
+		HUFFMAN_LUTBITS = 10,
+		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+	};
+
+	struct CNode
+	{
+		unsigned m_Bits;
+		unsigned m_NumBits;
+		unsigned short m_aLeafs[2];
+		unsigned char m_Symbol;
+	};
+
+	struct CConstructNode
+	{
+		unsigned short m_NodeId;
+		int m_Frequency;
+	};
+
+	CNode m_aNodes[HUFFMAN_MAX_NODES];
+	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CNode *m_pStartNode;
+	int m_NumNodes;
+
+	void Setbits_r(CNode *pNode, int Bits, unsigned Depth)
+	{
+		if(pNode->m_aLeafs[1] != 0xffff)
+			Setbits_r(&m_aNodes[pNode->m_aLeafs[1]], Bits | (1 << Depth), Depth + 1);
+		if(pNode->m_aLeafs[0] != 0xffff)
+			Setbits_r(&m_aNodes[pNode->m_aLeafs[0]], Bits, Depth + 1);
+
+		if(pNode->m_NumBits)
+		{
+			pNode->m_Bits = Bits;
+			pNode->m_NumBits = Depth;
+		}
+	}
+
+	static void BubbleSort(CConstructNode **ppList, int Size)
+	{
+		int Changed = 1;
+		while(Changed)
+		{
+			Changed = 0;
+			for(int i = 0; i < Size - 1; i++)
+			{
+				if(ppList[i]->m_Frequency < ppList[i + 1]->m_Frequency)
+				{
+					CConstructNode *pTemp = ppList[i];
+					ppList[i] = ppList[i + 1];
+					ppList[i + 1] = pTemp;
+					Changed = 1;
+				}
+			}
+			Size--;
+		}
+	}
+
+public:
+	void Init(const unsigned *pFrequencies)
+	{
+		mem_zero(this, sizeof(*this));
+
+		CConstructNode aNodesLeftStorage[HUFFMAN_MAX_SYMBOLS];
+		CConstructNode *apNodesLeft[HUFFMAN_MAX_SYMBOLS];
+		int NumNodesLeft = HUFFMAN_MAX_SYMBOLS;
+
+		for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+		{
+			m_aNodes[i].m_NumBits = 0xFFFFFFFF;
+			m_aNodes[i].m_Symbol = i;
+			m_aNodes[i].m_aLeafs[0] = 0xffff;
+			m_aNodes[i].m_aLeafs[1] = 0xffff;
+			aNodesLeftStorage[i].m_Frequency = i == HUFFMAN_EOF_SYMBOL ? 1 : pFrequencies[i];
+			aNodesLeftStorage[i].m_NodeId = i;
+			apNodesLeft[i] = &aNodesLeftStorage[i];
+		}
+
+		m_NumNodes = HUFFMAN_MAX_SYMBOLS;
+		while(NumNodesLeft > 1)
+		{
+			BubbleSort(apNodesLeft, NumNodesLeft);
+			m_aNodes[m_NumNodes].m_NumBits = 0;
+			m_aNodes[m_NumNodes].m_aLeafs[0] = apNodesLeft[NumNodesLeft - 1]->m_NodeId;
+			m_aNodes[m_NumNodes].m_aLeafs[1] = apNodesLeft[NumNodesLeft - 2]->m_NodeId;
+			apNodesLeft[NumNodesLeft - 2]->m_NodeId = m_NumNodes;
+			apNodesLeft[NumNodesLeft - 2]->m_Frequency = apNodesLeft[NumNodesLeft - 1]->m_Frequency + apNodesLeft[NumNodesLeft - 2]->m_Frequency;
+			m_NumNodes++;
+			NumNodesLeft--;
+		}
+
+		m_pStartNode = &m_aNodes[m_NumNodes - 1];
+		Setbits_r(m_pStartNode, 0, 0);
+
+		for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
+		{
+			unsigned Bits = i;
+			int k;
+			CNode *pNode = m_pStartNode;
+			for(k = 0; k < HUFFMAN_LUTBITS; k++)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+				Bits >>= 1;
+				if(pNode->m_NumBits)
+				{
+					m_apDecodeLut[i] = pNode;
+					break;
+				}
+			}
+			if(k == HUFFMAN_LUTBITS)
+				m_apDecodeLut[i] = pNode;
+		}
+	}
+
+	int MaxCodeLength() const
+	{
+		unsigned Max = 0;
+		for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+			Max = maximum(Max, m_aNodes[i].m_NumBits);
+		return Max;
+	}
+
+	int Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+	{
+		const unsigned char *pSrc = (const unsigned char *)pInput;
+		unsigned char *pDst = (unsigned char *)pOutput;
+		unsigned char *pDstEnd = pDst + OutputSize;
+		unsigned Bits = 0;
+		unsigned Bitcount = 0;
+
+		for(int i = 0; i <= InputSize; i++)
+		{
+			int Symbol = i == InputSize ? (int)HUFFMAN_EOF_SYMBOL : pSrc[i];
+			Bits |= m_aNodes[Symbol].m_Bits << Bitcount;
+			Bitcount += m_aNodes[Symbol].m_NumBits;
+			while(Bitcount >= 8)
+			{
+				*pDst++ = (unsigned char)(Bits & 0xff);
+				if(pDst == pDstEnd)
+					return -1;
+				Bits >>= 8;
+				Bitcount -= 8;
+			}
+		}
+
+		*pDst++ = Bits;
+		return (int)(pDst - (const unsigned char *)pOutput);
+	}
+
+	int Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+	{
+		unsigned char *pDst = (unsigned char *)pOutput;
+		const unsigned char *pSrc = (const unsigned char *)pInput;
+		unsigned char *pDstEnd = pDst + OutputSize;
+		const unsigned char *pSrcEnd = pSrc + InputSize;
+		unsigned Bits = 0;
+		unsigned Bitcount = 0;
+		CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+
+		while(1)
+		{
+			CNode *pNode = 0;
+			if(Bitcount >= HUFFMAN_LUTBITS)
+				pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+
+			while(Bitcount < 24 && pSrc != pSrcEnd)
+			{
+				Bits |= (*pSrc++) << Bitcount;
+				Bitcount += 8;
+			}
+
+			if(!pNode)
+				pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+
+			if(pNode->m_NumBits)
+			{
+				Bits >>= pNode->m_NumBits;
+				Bitcount -= pNode->m_NumBits;
+			}
+			else
+			{
+				Bits >>= HUFFMAN_LUTBITS;
+				Bitcount -= HUFFMAN_LUTBITS;
+				while(1)
+				{
+					pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+					Bitcount--;
+					Bits >>= 1;
+					if(pNode->m_NumBits)
+						break;
+					if(Bitcount == 0)
+						return -1;
+				}
+			}
+
+			if(pNode == pEof)
+				break;
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
+		}
+		return (int)(pDst - (const unsigned char *)pOutput);
+	}
+};
+
+// same frequencies as CNetBase uses
+static const unsigned gs_aNetworkFreq[256] = {
+	1 << 30, 4545, 2657, 431, 1950, 919, 444, 482, 2244, 617, 838, 542, 715, 1814, 304, 240, 754, 212, 647, 186,
+	283, 131, 146, 166, 543, 164, 167, 136, 179, 859, 363, 113, 157, 154, 204, 108, 137, 180, 202, 176,
+	872, 404, 168, 134, 151, 111, 113, 109, 120, 126, 129, 100, 41, 20, 16, 22, 18, 18, 17, 19,
+	16, 37, 13, 21, 362, 166, 99, 78, 95, 88, 81, 70, 83, 284, 91, 187, 77, 68, 52, 68,
+	59, 66, 61, 638, 71, 157, 50, 46, 69, 43, 11, 24, 13, 19, 10, 12, 12, 20, 14, 9,
+	20, 20, 10, 10, 15, 15, 12, 12, 7, 19, 15, 14, 13, 18, 35, 19, 17, 14, 8, 5,
+	15, 17, 9, 15, 14, 18, 8, 10, 2173, 134, 157, 68, 188, 60, 170, 60, 194, 62, 175, 71,
+	148, 67, 167, 78, 211, 67, 156, 69, 1674, 90, 174, 53, 147, 89, 181, 51, 174, 63, 163, 80,
+	167, 94, 128, 122, 223, 153, 218, 77, 200, 110, 190, 73, 174, 69, 145, 66, 277, 143, 141, 60,
+	136, 53, 180, 57, 142, 57, 158, 61, 166, 112, 152, 92, 26, 22, 21, 28, 20, 26, 30, 21,
+	32, 27, 20, 17, 23, 21, 30, 22, 22, 21, 27, 25, 17, 27, 23, 18, 39, 26, 15, 21,
+	12, 18, 18, 27, 20, 18, 15, 19, 11, 17, 33, 12, 18, 15, 19, 18, 16, 26, 17, 18,
+	9, 10, 25, 22, 22, 17, 20, 16, 6, 16, 15, 20, 14, 18, 24, 335};
+
+class Huffman : public ::testing::Test
+{
+protected:
+	CHuffman m_Huffman;
+	CReferenceHuffman m_Reference;
+	unsigned m_Seed;
+
+	Huffman() :
+		m_Seed(0x5eed)
+	{
+		Init(gs_aNetworkFreq);
+	}
+
+	void Init(const unsigned *pFreq)
+	{
+		m_Huffman.Init(pFreq);
+		m_Reference.Init(pFreq);
+	}
+
+	unsigned Random()
+	{
+		m_Seed = m_Seed * 1103515245 + 12345;
+		return (m_Seed >> 8) & 0xffffff;
+	}
+
+	// roughly what network chunks look like: mostly zeros and small values
+	void RandomPacket(unsigned char *pData, int Size)
+	{
+		for(int i = 0; i < Size; i++)
+		{
+			unsigned r = Random() % 16;
+			pData[i] = r < 8 ? 0 : r < 14 ? Random() % 16 : Random() % 256;
+		}
+	}
+
+	void ExpectSameCompression(const unsigned char *pData, int Size, int OutputSize)
+	{
+		unsigned char aOut[NET_MAX_PACKETSIZE * 4];
+		unsigned char aRefOut[NET_MAX_PACKETSIZE * 4];
+		int Result = m_Huffman.Compress(pData, Size, aOut, OutputSize);
+		int RefResult = m_Reference.Compress(pData, Size, aRefOut, OutputSize);
+		ASSERT_EQ(Result, RefResult);
+		if(Result > 0)
+			ASSERT_EQ(mem_comp(aOut, aRefOut, Result), 0);
+	}
+
+	void ExpectSameDecompression(const unsigned char *pData, int Size, int OutputSize)
+	{
+		unsigned char aOut[NET_MAX_PACKETSIZE * 4];
+		unsigned char aRefOut[NET_MAX_PACKETSIZE * 4];
+		int Result = m_Huffman.Decompress(pData, Size, aOut, OutputSize);
+		int RefResult = m_Reference.Decompress(pData, Size, aRefOut, OutputSize);
+		ASSERT_EQ(Result, RefResult);
+		if(Result > 0)
+			ASSERT_EQ(mem_comp(aOut, aRefOut, Result), 0);
+	}
+};
+
+TEST_F(Huffman, ShortCodes)
+{
+	// the reference decoder only handles codes that fit into its refill
+	EXPECT_LE(m_Reference.MaxCodeLength(), 24);
+}
+
+TEST_F(Huffman, Empty)
+{
+	unsigned char aCompressed[16];
+	unsigned char aDecompressed[16];
+	int Size = m_Huffman.Compress("", 0, aCompressed, sizeof(aCompressed));
+	ASSERT_GT(Size, 0);
+	EXPECT_EQ(m_Huffman.Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed)), 0);
+	ExpectSameCompression((const unsigned char *)"", 0, sizeof(aCompressed));
+}
+
+TEST_F(Huffman, Network)
+{
+	unsigned char aData[NET_MAX_PACKETSIZE];
+	unsigned char aCompressed[NET_MAX_PACKETSIZE];
+	unsigned char aRefCompressed[NET_MAX_PACKETSIZE];
+	CNetBase::Init();
+	for(int i = 0; i < 200; i++)
+	{
+		int Size = Random() % sizeof(aData);
+		RandomPacket(aData, Size);
+		int Result = CNetBase::Compress(aData, Size, aCompressed, sizeof(aCompressed));
+		ASSERT_EQ(Result, m_Reference.Compress(aData, Size, aRefCompressed, sizeof(aRefCompressed)));
+		if(Result > 0)
+			ASSERT_EQ(mem_comp(aCompressed, aRefCompressed, Result), 0);
+	}
+}
+
+TEST_F(Huffman, FuzzRoundtrip)
+{
+	unsigned char aData[NET_MAX_PACKETSIZE * 2];
+	unsigned char aCompressed[NET_MAX_PACKETSIZE * 4];
+	unsigned char aDecompressed[NET_MAX_PACKETSIZE * 2];
+	for(int i = 0; i < 2000; i++)
+	{
+		int Size = Random() % sizeof(aData);
+		RandomPacket(aData, Size);
+		ExpectSameCompression(aData, Size, sizeof(aCompressed));
+
+		int CompressedSize = m_Huffman.Compress(aData, Size, aCompressed, sizeof(aCompressed));
+		ASSERT_GT(CompressedSize, 0);
+		ASSERT_EQ(m_Huffman.Decompress(aCompressed, CompressedSize, aDecompressed, sizeof(aDecompressed)), Size);
+		ASSERT_EQ(mem_comp(aData, aDecompressed, Size), 0);
+		ExpectSameDecompression(aCompressed, CompressedSize, sizeof(aDecompressed));
+	}
+}
+
+TEST_F(Huffman, FuzzOutputLimits)
+{
+	unsigned char aData[256];
+	unsigned char aCompressed[NET_MAX_PACKETSIZE];
+	for(int i = 0; i < 500; i++)
+	{
+		int Size = Random() % sizeof(aData);
+		RandomPacket(aData, Size);
+		int CompressedSize = m_Huffman.Compress(aData, Size, aCompressed, sizeof(aCompressed));
+		ASSERT_GT(CompressedSize, 0);
+		for(int OutputSize = 1; OutputSize <= CompressedSize + 1; OutputSize++)
+			ExpectSameCompression(aData, Size, OutputSize);
+		for(int OutputSize = 0; OutputSize <= Size + 1; OutputSize++)
+			ExpectSameDecompression(aCompressed, CompressedSize, OutputSize);
+	}
+}
+
+TEST_F(Huffman, FuzzGarbage)
+{
+	unsigned char aGarbage[512];
+	for(int i = 0; i < 2000; i++)
+	{
+		int Size = Random() % sizeof(aGarbage);
+		for(int j = 0; j < Size; j++)
+			aGarbage[j] = Random() % 256;
+		ExpectSameDecompression(aGarbage, Size, Random() % (NET_MAX_PACKETSIZE * 2));
+	}
+
+	// truncated streams
+	unsigned char aData[NET_MAX_PACKETSIZE];
+	unsigned char aCompressed[NET_MAX_PACKETSIZE * 2];
+	for(int i = 0; i < 500; i++)
+	{
+		int Size = Random() % sizeof(aData);
+		RandomPacket(aData, Size);
+		int CompressedSize = m_Huffman.Compress(aData, Size, aCompressed, sizeof(aCompressed));
+		ASSERT_GT(CompressedSize, 0);
+		for(int Truncated = 0; Truncated < CompressedSize; Truncated++)
+			ExpectSameDecompression(aCompressed, Truncated, sizeof(aData));
+	}
+}
+
+TEST_F(Huffman, FuzzFrequencies)
+{
+	unsigned aFreq[256];
+	unsigned char aData[NET_MAX_PACKETSIZE];
+	unsigned char aCompressed[NET_MAX_PACKETSIZE * 4];
+	for(int i = 0; i < 50; i++)
+	{
+		for(int j = 0; j < 256; j++)
+			aFreq[j] = 1 + Random() % (j % 7 == 0 ? 100000 : 100);
+		Init(aFreq);
+		ASSERT_LE(m_Reference.MaxCodeLength(), 24);
+		for(int j = 0; j < 50; j++)
+		{
+			int Size = Random() % sizeof(aData);
+			for(int k = 0; k < Size; k++)
+				aData[k] = Random() % 256;
+			ExpectSameCompression(aData, Size, sizeof(aCompressed));
+			int CompressedSize = m_Huffman.Compress(aData, Size, aCompressed, sizeof(aCompressed));
+			ASSERT_GT(CompressedSize, 0);
+			ExpectSameDecompression(aCompressed, CompressedSize, sizeof(aData));
+			ExpectSameDecompression(aCompressed, Random() % CompressedSize, sizeof(aData));
+		}
+	}
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(Huffman, DISABLED_Benchmark)
+{
+	enum
+	{
+		NUM_PACKETS = 256,
+		NUM_ROUNDS = 200,
+	};
+	static unsigned char s_aaData[NUM_PACKETS][NET_MAX_PACKETSIZE];
+	static unsigned char s_aaCompressed[NUM_PACKETS][NET_MAX_PACKETSIZE * 2];
+	static int s_aSize[NUM_PACKETS];
+	static int s_aCompressedSize[NUM_PACKETS];
+	unsigned char aOut[NET_MAX_PACKETSIZE * 2];
+	int64 TotalBytes = 0;
+	for(int i = 0; i < NUM_PACKETS; i++)
+	{
+		s_aSize[i] = 100 + Random() % (NET_MAX_PACKETSIZE - 100);
+		RandomPacket(s_aaData[i], s_aSize[i]);
+		s_aCompressedSize[i] = m_Huffman.Compress(s_aaData[i], s_aSize[i], s_aaCompressed[i], sizeof(s_aaCompressed[i]));
+		TotalBytes += s_aSize[i];
+	}
+	TotalBytes *= NUM_ROUNDS;
+
+	int64 aTime[4];
+	int64 Start = time_get();
+	for(int r = 0; r < NUM_ROUNDS; r++)
+		for(int i = 0; i < NUM_PACKETS; i++)
+			m_Reference.Compress(s_aaData[i], s_aSize[i], aOut, sizeof(aOut));
+	aTime[0] = time_get() - Start;
+	Start = time_get();
+	for(int r = 0; r < NUM_ROUNDS; r++)
+		for(int i = 0; i < NUM_PACKETS; i++)
+			m_Huffman.Compress(s_aaData[i], s_aSize[i], aOut, sizeof(aOut));
+	aTime[1] = time_get() - Start;
+	Start = time_get();
+	for(int r = 0; r < NUM_ROUNDS; r++)
+		for(int i = 0; i < NUM_PACKETS; i++)
+			m_Reference.Decompress(s_aaCompressed[i], s_aCompressedSize[i], aOut, sizeof(aOut));
+	aTime[2] = time_get() - Start;
+	Start = time_get();
+	for(int r = 0; r < NUM_ROUNDS; r++)
+		for(int i = 0; i < NUM_PACKETS; i++)
+			m_Huffman.Decompress(s_aaCompressed[i], s_aCompressedSize[i], aOut, sizeof(aOut));
+	aTime[3] = time_get() - Start;
+
+	const char *apNames[] = {"compress (reference)", "compress", "decompress (reference)", "decompress"};
+	for(int i = 0; i < 4; i++)
+		printf("%s: %.2f MB/s\n", apNames[i], TotalBytes / 1024.0 / 1024.0 / ((double)aTime[i] / time_freq()));
+}
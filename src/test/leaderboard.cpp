@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/server/leaderboard.h>
+
+static const char s_aMap[] = "infc_skull";
+
+static CLeaderboardCache::CRoundScore Round(int UserID, int Score)
+{
+	CLeaderboardCache::CRoundScore Round;
+	Round.m_UserID = UserID;
+	Round.m_Score = Score;
+	str_format(Round.m_aUsername, sizeof(Round.m_aUsername), "user%d", UserID);
+	return Round;
+}
+
+static CLeaderboardCache::CRequest Request(int ClientID, int UserID)
+{
+	CLeaderboardCache::CRequest Request;
+	Request.m_Type = CLeaderboardCache::REQUEST_RANK;
+	Request.m_ClientID = ClientID;
+	Request.m_UserID = UserID;
+	Request.m_DailyScoreType = -1;
+	return Request;
+}
+
+static void Load(CLeaderboardCache *pCache, int ScoreType, const std::vector<CLeaderboardCache::CRoundScore> &lRounds, int64 Now)
+{
+	std::vector<CLeaderboardCache::CRequest> lRequests;
+	pCache->Request(s_aMap, ScoreType, Request(0, 0), Now);
+	pCache->FinishLoad(s_aMap, ScoreType, lRounds, Now, &lRequests);
+}
+
+TEST(Leaderboard, CoalesceRequests)
+{
+	CLeaderboardCache Cache(3);
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 0), CLeaderboardCache::RESULT_LOAD);
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(1, 2), 0), CLeaderboardCache::RESULT_QUEUED);
+	EXPECT_EQ(Cache.Request(s_aMap, 100, Request(2, 3), 0), CLeaderboardCache::RESULT_LOAD);
+
+	std::vector<CLeaderboardCache::CRequest> lRequests;
+	Cache.FinishLoad(s_aMap, 0, std::vector<CLeaderboardCache::CRoundScore>(), 0, &lRequests);
+	ASSERT_EQ(lRequests.size(), 2u);
+	EXPECT_EQ(lRequests[0].m_ClientID, 0);
+	EXPECT_EQ(lRequests[1].m_ClientID, 1);
+
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(3, 4), 0), CLeaderboardCache::RESULT_READY);
+	EXPECT_EQ(Cache.Request("infc_other", 0, Request(3, 4), 0), CLeaderboardCache::RESULT_LOAD);
+
+	CLeaderboardCache::CStats Stats;
+	Cache.GetStats(&Stats, 0);
+	EXPECT_EQ(Stats.m_Hits, 1);
+	EXPECT_EQ(Stats.m_Misses, 3);
+	EXPECT_EQ(Stats.m_Queued, 1);
+	EXPECT_EQ(Stats.m_NumBoards, 1);
+}
+
+TEST(Leaderboard, Expire)
+{
+	CLeaderboardCache Cache(3);
+	Cache.SetTimeToLive(10);
+	Load(&Cache, 0, std::vector<CLeaderboardCache::CRoundScore>(), 0);
+
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 9), CLeaderboardCache::RESULT_READY);
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 10), CLeaderboardCache::RESULT_LOAD);
+
+	// a score written while loading makes the loaded board outdated
+	Cache.AddRoundScore(s_aMap, 0, Round(1, 10));
+	Cache.FinishLoad(s_aMap, 0, std::vector<CLeaderboardCache::CRoundScore>(), 10, 0);
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 10), CLeaderboardCache::RESULT_LOAD);
+
+	std::vector<CLeaderboardCache::CRequest> lRequests;
+	EXPECT_TRUE(Cache.AbortLoad(s_aMap, 0, &lRequests));
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 10), CLeaderboardCache::RESULT_LOAD);
+}
+
+TEST(Leaderboard, AbortLoad)
+{
+	CLeaderboardCache Cache(3);
+	Cache.SetTimeToLive(1);
+	std::vector<CLeaderboardCache::CRoundScore> lRounds;
+	lRounds.push_back(Round(1, 10));
+	Load(&Cache, 0, lRounds, 0);
+
+	// a failed reload keeps the board and gives the waiting requests back
+	Cache.AddRoundScore(s_aMap, 0, Round(2, 20));
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 1), CLeaderboardCache::RESULT_LOAD);
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(1, 2), 1), CLeaderboardCache::RESULT_QUEUED);
+	std::vector<CLeaderboardCache::CRequest> lRequests;
+	EXPECT_TRUE(Cache.AbortLoad(s_aMap, 0, &lRequests));
+	ASSERT_EQ(lRequests.size(), 2u);
+	EXPECT_EQ(lRequests[1].m_ClientID, 1);
+
+	CLeaderboardCache::CEntry aEntries[10];
+	EXPECT_EQ(Cache.GetTop(s_aMap, 0, aEntries, 10), 2);
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 2), CLeaderboardCache::RESULT_LOAD);
+
+	// nothing to answer from when the first load fails
+	lRequests.clear();
+	EXPECT_EQ(Cache.Request(s_aMap, 100, Request(2, 3), 2), CLeaderboardCache::RESULT_LOAD);
+	EXPECT_FALSE(Cache.AbortLoad(s_aMap, 100, &lRequests));
+	ASSERT_EQ(lRequests.size(), 1u);
+	EXPECT_EQ(lRequests[0].m_ClientID, 2);
+	EXPECT_EQ(Cache.Request(s_aMap, 100, Request(2, 3), 2), CLeaderboardCache::RESULT_LOAD);
+}
+
+TEST(Leaderboard, Evict)
+{
+	CLeaderboardCache Cache(3);
+	Cache.SetTimeToLive(100);
+	for(int i = 0; i < CLeaderboardCache::MAX_BOARDS; i++)
+		Load(&Cache, i, std::vector<CLeaderboardCache::CRoundScore>(), i);
+
+	// board 0 is used again, board 1 is the least recently used one
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 70), CLeaderboardCache::RESULT_READY);
+	Load(&Cache, 1000, std::vector<CLeaderboardCache::CRoundScore>(), 70);
+	CLeaderboardCache::CStats Stats;
+	Cache.GetStats(&Stats, 70);
+	EXPECT_EQ(Stats.m_NumBoards, (int)CLeaderboardCache::MAX_BOARDS);
+	EXPECT_EQ(Stats.m_Evicted, 1);
+	EXPECT_EQ(Cache.Request(s_aMap, 0, Request(0, 1), 70), CLeaderboardCache::RESULT_READY);
+	EXPECT_EQ(Cache.Request(s_aMap, 2, Request(0, 1), 70), CLeaderboardCache::RESULT_READY);
+	EXPECT_EQ(Cache.Request(s_aMap, 1, Request(0, 1), 70), CLeaderboardCache::RESULT_LOAD);
+
+	// boards unused for longer than their time to live go first
+	Cache.Request(s_aMap, 2000, Request(0, 1), 200);
+	Cache.GetStats(&Stats, 200);
+	EXPECT_EQ(Stats.m_NumBoards, 0);
+}
+
+TEST(Leaderboard, Ranking)
+{
+	CLeaderboardCache Cache(3);
+	std::vector<CLeaderboardCache::CRoundScore> lRounds;
+	lRounds.push_back(Round(1, 10));
+	lRounds.push_back(Round(1, 50));
+	lRounds.push_back(Round(2, 20));
+	lRounds.push_back(Round(2, 20));
+	lRounds.push_back(Round(2, 20));
+	lRounds.push_back(Round(2, 5));
+	lRounds.push_back(Round(3, 60));
+	Load(&Cache, 0, lRounds, 0);
+
+	CLeaderboardCache::CEntry aEntries[10];
+	ASSERT_EQ(Cache.GetTop(s_aMap, 0, aEntries, 10), 3);
+	// same score, smaller user id first
+	EXPECT_EQ(aEntries[0].m_UserID, 1);
+	EXPECT_EQ(aEntries[0].m_Score, 60);
+	EXPECT_EQ(aEntries[1].m_UserID, 2);
+	EXPECT_EQ(aEntries[1].m_Score, 60);
+	EXPECT_EQ(aEntries[1].m_NumRounds, 3);
+	EXPECT_EQ(aEntries[2].m_UserID, 3);
+	EXPECT_STREQ(aEntries[2].m_aUsername, "user3");
+
+	int Rank;
+	CLeaderboardCache::CEntry Entry;
+	EXPECT_FALSE(Cache.GetPlayer(s_aMap, 0, 4, &Rank, &Entry));
+	ASSERT_TRUE(Cache.GetPlayer(s_aMap, 0, 2, &Rank, &Entry));
+	EXPECT_EQ(Rank, 2);
+	EXPECT_EQ(Entry.m_LowestScore, 20);
+
+	// too low to count, only the best rounds are kept
+	Cache.AddRoundScore(s_aMap, 0, Round(2, 15));
+	ASSERT_TRUE(Cache.GetPlayer(s_aMap, 0, 2, &Rank, &Entry));
+	EXPECT_EQ(Entry.m_Score, 60);
+
+	Cache.AddRoundScore(s_aMap, 0, Round(2, 30));
+	ASSERT_TRUE(Cache.GetPlayer(s_aMap, 0, 2, &Rank, &Entry));
+	EXPECT_EQ(Rank, 1);
+	EXPECT_EQ(Entry.m_Score, 70);
+	EXPECT_EQ(Entry.m_NumRounds, 3);
+
+	Cache.AddRoundScore(s_aMap, 0, Round(4, 100));
+	ASSERT_TRUE(Cache.GetPlayer(s_aMap, 0, 4, &Rank, &Entry));
+	EXPECT_EQ(Rank, 1);
+	ASSERT_TRUE(Cache.GetPlayer(s_aMap, 0, 3, &Rank, &Entry));
+	EXPECT_EQ(Rank, 4);
+
+	// boards that aren't loaded are not created by updates
+	Cache.AddRoundScore(s_aMap, 100, Round(4, 100));
+	EXPECT_EQ(Cache.GetTop(s_aMap, 100, aEntries, 10), 0);
+}
+
+TEST(Leaderboard, DailyBest)
+{
+	CLeaderboardCache Cache(3);
+	CLeaderboardCache::CRoundScore aRounds[CLeaderboardCache::MAX_DAILY_BEST];
+
+	Cache.AddDailyScore(100, Round(1, 10));
+	EXPECT_EQ(Cache.GetDailyBest(100, aRounds, CLeaderboardCache::MAX_DAILY_BEST), 0);
+
+	std::vector<CLeaderboardCache::CRoundScore> lRounds;
+	for(int i = 0; i < 6; i++)
+		lRounds.push_back(Round(i, 60 - i*10));
+	Cache.SetDailyBest(100, lRounds);
+	EXPECT_EQ(Cache.GetDailyBest(100, aRounds, CLeaderboardCache::MAX_DAILY_BEST), (int)CLeaderboardCache::MAX_DAILY_BEST);
+
+	Cache.AddDailyScore(100, Round(7, 45));
+	ASSERT_EQ(Cache.GetDailyBest(100, aRounds, CLeaderboardCache::MAX_DAILY_BEST), (int)CLeaderboardCache::MAX_DAILY_BEST);
+	EXPECT_EQ(aRounds[0].m_Score, 60);
+	EXPECT_EQ(aRounds[2].m_UserID, 7);
+	EXPECT_EQ(aRounds[4].m_Score, 30);
+}
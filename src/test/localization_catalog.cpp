@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <teeuniverses/components/localization_catalog.h>
+
+#include <string>
+#include <vector>
+
+static const char s_aFilename[] = "test_localization.catalog";
+
+class LocalizationCatalog : public ::testing::Test
+{
+protected:
+	std::vector<std::string> m_lStrings;
+	std::vector<CLocalizationCatalog::CEntry> m_lEntries;
+
+	void SetUp()
+	{
+		// the entries point into m_lStrings, which must not move afterwards
+		const int NumEntries = 500;
+		m_lStrings.reserve(NumEntries * 3);
+		for(int i = 0; i < NumEntries; i++)
+		{
+			char aBuf[64];
+			str_format(aBuf, sizeof(aBuf), "Key number %d", i);
+			m_lStrings.push_back(aBuf);
+			str_format(aBuf, sizeof(aBuf), "Translation %d", i);
+			m_lStrings.push_back(aBuf);
+			str_format(aBuf, sizeof(aBuf), "Translations %d", i);
+			m_lStrings.push_back(aBuf);
+
+			CLocalizationCatalog::CEntry Entry;
+			Entry.m_pKey = m_lStrings[i * 3].c_str();
+			for(int v = 0; v < CLocalizationCatalog::NUM_VERSIONS; v++)
+				Entry.m_apVersions[v] = 0;
+			if(i % 2)
+				Entry.m_apVersions[0] = m_lStrings[i * 3 + 1].c_str();
+			else
+			{
+				Entry.m_apVersions[2] = m_lStrings[i * 3 + 1].c_str();
+				Entry.m_apVersions[6] = m_lStrings[i * 3 + 2].c_str();
+			}
+			m_lEntries.push_back(Entry);
+		}
+	}
+
+	void TearDown()
+	{
+		fs_remove(s_aFilename);
+	}
+
+	void ExpectEntries(const CLocalizationCatalog *pCatalog)
+	{
+		ASSERT_EQ(pCatalog->NumEntries(), (int)m_lEntries.size());
+		for(unsigned i = 0; i < m_lEntries.size(); i++)
+		{
+			for(int v = 0; v < CLocalizationCatalog::NUM_VERSIONS; v++)
+			{
+				const char *pExpected = m_lEntries[i].m_apVersions[v];
+				const char *pResult = pCatalog->Find(m_lEntries[i].m_pKey, v);
+				if(pExpected)
+				{
+					ASSERT_TRUE(pResult);
+					EXPECT_STREQ(pResult, pExpected);
+				}
+				else
+					EXPECT_FALSE(pResult);
+			}
+		}
+	}
+};
+
+TEST_F(LocalizationCatalog, Find)
+{
+	CLocalizationCatalog Catalog;
+	EXPECT_FALSE(Catalog.Find("Key number 1", 0));
+	ASSERT_TRUE(Catalog.Build(&m_lEntries[0], m_lEntries.size(), 1234));
+	EXPECT_EQ(Catalog.SourceCrc(), 1234u);
+	ExpectEntries(&Catalog);
+
+	EXPECT_FALSE(Catalog.Find("Missing key", 0));
+	EXPECT_FALSE(Catalog.Find("", 0));
+	EXPECT_FALSE(Catalog.Find("Key number 500", 0));
+}
+
+TEST_F(LocalizationCatalog, Duplicate)
+{
+	CLocalizationCatalog::CEntry Entry = m_lEntries[1];
+	Entry.m_apVersions[0] = "Replaced";
+	m_lEntries.push_back(Entry);
+
+	CLocalizationCatalog Catalog;
+	ASSERT_TRUE(Catalog.Build(&m_lEntries[0], m_lEntries.size(), 0));
+	EXPECT_EQ(Catalog.NumEntries(), (int)m_lEntries.size() - 1);
+	EXPECT_STREQ(Catalog.Find(Entry.m_pKey, 0), "Replaced");
+}
+
+TEST_F(LocalizationCatalog, Empty)
+{
+	CLocalizationCatalog Catalog;
+	ASSERT_TRUE(Catalog.Build(0, 0, 0));
+	EXPECT_EQ(Catalog.NumEntries(), 0);
+	EXPECT_FALSE(Catalog.Find("Key number 1", 0));
+}
+
+TEST_F(LocalizationCatalog, SaveLoad)
+{
+	CLocalizationCatalog Built;
+	ASSERT_TRUE(Built.Build(&m_lEntries[0], m_lEntries.size(), 5678));
+	ASSERT_TRUE(Built.Save(s_aFilename));
+
+	CLocalizationCatalog Loaded;
+	ASSERT_TRUE(Loaded.Load(s_aFilename));
+	EXPECT_EQ(Loaded.SourceCrc(), 5678u);
+	ExpectEntries(&Loaded);
+}
+
+TEST_F(LocalizationCatalog, Invalid)
+{
+	CLocalizationCatalog Built;
+	ASSERT_TRUE(Built.Build(&m_lEntries[0], m_lEntries.size(), 0));
+	ASSERT_TRUE(Built.Save(s_aFilename));
+
+	// cut off the end of the strings, the data is copied out first because
+	// opening the file for writing truncates it under the mapping
+	unsigned Size;
+	void *pMapped = io_map_file(s_aFilename, &Size);
+	ASSERT_TRUE(pMapped);
+	std::vector<char> lData((char *)pMapped, (char *)pMapped + Size);
+	io_unmap_file(pMapped, Size);
+	IOHANDLE File = io_open(s_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	ASSERT_EQ(io_write(File, &lData[0], Size - 1), Size - 1);
+	io_close(File);
+
+	CLocalizationCatalog Loaded;
+	EXPECT_FALSE(Loaded.Load(s_aFilename));
+	EXPECT_FALSE(Loaded.IsLoaded());
+	EXPECT_FALSE(Loaded.Load("missing.catalog"));
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/lockfree.h>
+
+#include <vector>
+
+struct CQueueItem
+{
+	int m_Producer;
+	int m_Value;
+	CQueueItem *m_pQueueNext;
+};
+
+TEST(MpscQueue, Order)
+{
+	CMpscQueue<CQueueItem> Queue;
+	EXPECT_TRUE(Queue.Empty());
+	EXPECT_FALSE(Queue.PopAll());
+
+	CQueueItem aItems[3];
+	for(int i = 0; i < 3; i++)
+	{
+		aItems[i].m_Value = i;
+		Queue.Push(&aItems[i]);
+	}
+	EXPECT_FALSE(Queue.Empty());
+
+	CQueueItem *pItem = Queue.PopAll();
+	for(int i = 0; i < 3; i++)
+	{
+		ASSERT_TRUE(pItem);
+		EXPECT_EQ(pItem->m_Value, i);
+		pItem = pItem->m_pQueueNext;
+	}
+	EXPECT_FALSE(pItem);
+	EXPECT_TRUE(Queue.Empty());
+}
+
+static const int NUM_PRODUCERS = 4;
+static const int NUM_ITEMS = 20000;
+
+struct CProducer
+{
+	CMpscQueue<CQueueItem> *m_pQueue;
+	CBlockPool<sizeof(CQueueItem), 64> *m_pPool;
+	int m_ID;
+};
+
+static void ProducerThread(void *pUser)
+{
+	CProducer *pProducer = (CProducer *)pUser;
+	for(int i = 0; i < NUM_ITEMS; i++)
+	{
+		void *pBlock;
+		while(!(pBlock = pProducer->m_pPool->Alloc()))
+			thread_yield();
+		CQueueItem *pItem = (CQueueItem *)pBlock;
+		pItem->m_Producer = pProducer->m_ID;
+		pItem->m_Value = i;
+		pProducer->m_pQueue->Push(pItem);
+	}
+}
+
+TEST(MpscQueue, Threads)
+{
+	// the pool is smaller than what is produced, the blocks have to be given back to go on
+	CMpscQueue<CQueueItem> Queue;
+	CBlockPool<sizeof(CQueueItem), 64> *pPool = new CBlockPool<sizeof(CQueueItem), 64>();
+	CProducer aProducers[NUM_PRODUCERS];
+	void *apThreads[NUM_PRODUCERS];
+	for(int i = 0; i < NUM_PRODUCERS; i++)
+	{
+		aProducers[i].m_pQueue = &Queue;
+		aProducers[i].m_pPool = pPool;
+		aProducers[i].m_ID = i;
+		apThreads[i] = thread_init(ProducerThread, &aProducers[i], "producer");
+	}
+
+	std::vector<int> lNext(NUM_PRODUCERS, 0);
+	int Received = 0;
+	while(Received < NUM_PRODUCERS * NUM_ITEMS)
+	{
+		CQueueItem *pItem = Queue.PopAll();
+		if(!pItem)
+			thread_yield();
+		while(pItem)
+		{
+			CQueueItem *pNext = pItem->m_pQueueNext;
+			// the items of each producer arrive in the order they were pushed
+			ASSERT_TRUE(pPool->Owns(pItem));
+			ASSERT_EQ(pItem->m_Value, lNext[pItem->m_Producer]);
+			lNext[pItem->m_Producer]++;
+			pPool->Free(pItem);
+			pItem = pNext;
+			Received++;
+		}
+	}
+
+	for(int i = 0; i < NUM_PRODUCERS; i++)
+		thread_wait(apThreads[i]);
+	EXPECT_TRUE(Queue.Empty());
+
+	// every block is free again
+	std::vector<void *> lBlocks;
+	while(void *pBlock = pPool->Alloc())
+		lBlocks.push_back(pBlock);
+	EXPECT_EQ((int)lBlocks.size(), 64);
+	delete pPool;
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+TEST(Memory, Tagged)
+{
+	MEMTAGSTATS Before, After;
+	mem_tag_stats(MEMTAG_SQL, &Before);
+
+	void *pBlock = mem_alloc_tagged(MEMTAG_SQL, 1000);
+	ASSERT_TRUE(pBlock);
+	EXPECT_EQ((size_t)pBlock % 16, 0u);
+	mem_zero(pBlock, 1000);
+
+	mem_tag_stats(MEMTAG_SQL, &After);
+	EXPECT_EQ(After.live_bytes - Before.live_bytes, 1000);
+	EXPECT_EQ(After.live_allocs - Before.live_allocs, 1);
+	EXPECT_EQ(After.total_allocs - Before.total_allocs, 1);
+	EXPECT_GE(After.peak_bytes, After.live_bytes);
+
+	mem_free_tagged(pBlock);
+	mem_free_tagged(0);
+	mem_tag_stats(MEMTAG_SQL, &After);
+	EXPECT_EQ(After.live_bytes, Before.live_bytes);
+	EXPECT_EQ(After.live_allocs, Before.live_allocs);
+	EXPECT_EQ(After.total_allocs - Before.total_allocs, 1);
+}
+
+TEST(Memory, Account)
+{
+	MEMTAGSTATS Before, After;
+	mem_tag_stats(MEMTAG_MAP, &Before);
+
+	mem_account(MEMTAG_MAP, 1 << 20);
+	mem_tag_stats(MEMTAG_MAP, &After);
+	EXPECT_EQ(After.live_bytes - Before.live_bytes, 1 << 20);
+	EXPECT_GE(After.peak_bytes, Before.live_bytes + (1 << 20));
+	EXPECT_EQ(After.live_allocs, Before.live_allocs);
+
+	mem_account(MEMTAG_MAP, -(1 << 20));
+	mem_tag_stats(MEMTAG_MAP, &After);
+	EXPECT_EQ(After.live_bytes, Before.live_bytes);
+	EXPECT_GE(After.peak_bytes, Before.live_bytes + (1 << 20));
+	EXPECT_STREQ(mem_tag_name(MEMTAG_MAP), "map");
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/metrics.h>
+
+#include <string>
+
+TEST(Metrics, Format)
+{
+	CMetrics Metrics;
+	CMetricCounter *pCounter = Metrics.RegisterCounter("test_packets_total", "Packets", "direction=\"in\"");
+	Metrics.RegisterCounter("test_packets_total", "Packets", "direction=\"out\"")->Add(3);
+	CMetricGauge *pGauge = Metrics.RegisterGauge("test_clients", "Clients");
+	pCounter->Add();
+	pCounter->Add(4);
+	pGauge->Set(7);
+	pGauge->Add(-2);
+
+	std::string Out;
+	Metrics.Write(Out);
+	EXPECT_EQ(Out,
+		"# HELP test_clients Clients\n"
+		"# TYPE test_clients gauge\n"
+		"test_clients 5\n"
+		"# HELP test_packets_total Packets\n"
+		"# TYPE test_packets_total counter\n"
+		"test_packets_total{direction=\"in\"} 5\n"
+		"test_packets_total{direction=\"out\"} 3\n");
+}
+
+TEST(Metrics, Histogram)
+{
+	CMetrics Metrics;
+	static const int64 s_aBounds[] = {10, 100};
+	CMetricHistogram *pHistogram = Metrics.RegisterHistogram("test_duration_seconds", "Duration", s_aBounds, 2, 1e-3, "kind=\"a\"");
+	pHistogram->Observe(5);
+	pHistogram->Observe(10);
+	pHistogram->Observe(50);
+	pHistogram->Observe(1000);
+	EXPECT_EQ(pHistogram->Count(), 4);
+
+	std::string Out;
+	Metrics.Write(Out);
+	EXPECT_EQ(Out,
+		"# HELP test_duration_seconds Duration\n"
+		"# TYPE test_duration_seconds histogram\n"
+		"test_duration_seconds_bucket{kind=\"a\",le=\"0.01\"} 2\n"
+		"test_duration_seconds_bucket{kind=\"a\",le=\"0.1\"} 3\n"
+		"test_duration_seconds_bucket{kind=\"a\",le=\"+Inf\"} 4\n"
+		"test_duration_seconds_sum{kind=\"a\"} 1.065\n"
+		"test_duration_seconds_count{kind=\"a\"} 4\n");
+}
+
+TEST(Metrics, RegisterTwice)
+{
+	CMetrics Metrics;
+	CMetricGauge *pFirst = Metrics.RegisterGauge("test_entities", "Entities", "type=\"laser\"");
+	CMetricGauge *pSecond = Metrics.RegisterGauge("test_entities", "Entities", "type=\"laser\"");
+	CMetricGauge *pOther = Metrics.RegisterGauge("test_entities", "Entities", "type=\"character\"");
+	EXPECT_EQ(pFirst, pSecond);
+	EXPECT_NE(pFirst, pOther);
+}
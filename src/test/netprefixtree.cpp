@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/netprefixtree.h>
+
+#include <vector>
+
+struct CTestRange
+{
+	NETADDR m_LB;
+	NETADDR m_UB;
+};
+
+class NetPrefixTree : public ::testing::Test
+{
+protected:
+	unsigned m_Seed;
+
+	NetPrefixTree() : m_Seed(1234) {}
+
+	unsigned Random()
+	{
+		m_Seed = m_Seed*1103515245+12345;
+		return m_Seed>>16;
+	}
+
+	NETADDR Addr(const char *pStr)
+	{
+		NETADDR Addr;
+		EXPECT_EQ(net_addr_from_str(&Addr, pStr), 0);
+		Addr.port = 0;
+		return Addr;
+	}
+
+	// addresses close to each other so that ranges overlap
+	NETADDR RandomAddr(int Type)
+	{
+		NETADDR Addr;
+		mem_zero(&Addr, sizeof(Addr));
+		Addr.type = Type;
+		int Bytes = CNetPrefixTree::AddrBits(Type)/8;
+		for(int i = 0; i < Bytes; i++)
+			Addr.ip[i] = i < Bytes-2 ? 10 : Random()&0xff;
+		return Addr;
+	}
+
+	static bool Contains(const CTestRange *pRange, const NETADDR *pAddr)
+	{
+		int Bytes = CNetPrefixTree::AddrBits(pAddr->type)/8;
+		return pRange->m_LB.type == pAddr->type && mem_comp(pRange->m_LB.ip, pAddr->ip, Bytes) <= 0 && mem_comp(pRange->m_UB.ip, pAddr->ip, Bytes) >= 0;
+	}
+};
+
+TEST_F(NetPrefixTree, SplitRange)
+{
+	CNetPrefixTree::CPrefix aPrefixes[CNetPrefixTree::MAX_RANGE_PREFIXES];
+	NETADDR LB = Addr("10.0.0.0");
+	NETADDR UB = Addr("10.0.255.255");
+	ASSERT_EQ(CNetPrefixTree::SplitRange(&LB, &UB, aPrefixes, CNetPrefixTree::MAX_RANGE_PREFIXES), 1);
+	EXPECT_EQ(aPrefixes[0].m_Length, 16);
+
+	LB = Addr("10.0.0.1");
+	UB = Addr("10.0.0.6");
+	ASSERT_EQ(CNetPrefixTree::SplitRange(&LB, &UB, aPrefixes, CNetPrefixTree::MAX_RANGE_PREFIXES), 4);
+	EXPECT_EQ(aPrefixes[0].m_Length, 32);
+	EXPECT_EQ(aPrefixes[1].m_Length, 31);
+	EXPECT_EQ(aPrefixes[2].m_Length, 31);
+	EXPECT_EQ(aPrefixes[3].m_Length, 32);
+	EXPECT_EQ(aPrefixes[3].m_aKey[3], 6);
+
+	LB = Addr("0.0.0.0");
+	UB = Addr("255.255.255.255");
+	ASSERT_EQ(CNetPrefixTree::SplitRange(&LB, &UB, aPrefixes, CNetPrefixTree::MAX_RANGE_PREFIXES), 1);
+	EXPECT_EQ(aPrefixes[0].m_Length, 0);
+
+	LB = Addr("[::1]");
+	UB = Addr("[ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffe]");
+	EXPECT_EQ(CNetPrefixTree::SplitRange(&LB, &UB, aPrefixes, CNetPrefixTree::MAX_RANGE_PREFIXES), 2*127);
+}
+
+TEST_F(NetPrefixTree, Match)
+{
+	CNetPrefixTree Tree;
+	int aValues[3];
+	NETADDR LB = Addr("10.0.0.0");
+	NETADDR UB = Addr("10.255.255.255");
+	Tree.InsertRange(&LB, &UB, &aValues[0]);
+	NETADDR Single = Addr("10.1.2.3");
+	Tree.InsertRange(&Single, &Single, &aValues[1]);
+	NETADDR LB6 = Addr("[2001:db8::]");
+	NETADDR UB6 = Addr("[2001:db8::ffff]");
+	Tree.InsertRange(&LB6, &UB6, &aValues[2]);
+
+	NETADDR Test = Addr("10.1.2.3");
+	EXPECT_EQ(Tree.Match(&Test), &aValues[1]);
+	Test = Addr("10.1.2.4");
+	EXPECT_EQ(Tree.Match(&Test), &aValues[0]);
+	Test = Addr("11.0.0.0");
+	EXPECT_EQ(Tree.Match(&Test), (void *)0);
+	Test = Addr("[2001:db8::1234]");
+	EXPECT_EQ(Tree.Match(&Test), &aValues[2]);
+	Test = Addr("[2001:db8::1:0]");
+	EXPECT_EQ(Tree.Match(&Test), (void *)0);
+
+	// same bytes, other address type
+	Test = Addr("[a00:0::]");
+	EXPECT_EQ(Tree.Match(&Test), (void *)0);
+
+	Tree.RemoveRange(&Single, &Single, &aValues[1]);
+	Test = Addr("10.1.2.3");
+	EXPECT_EQ(Tree.Match(&Test), &aValues[0]);
+	Tree.RemoveRange(&LB, &UB, &aValues[0]);
+	EXPECT_EQ(Tree.Match(&Test), (void *)0);
+}
+
+TEST_F(NetPrefixTree, Fuzz)
+{
+	for(int Round = 0; Round < 20; Round++)
+	{
+		int Type = Round&1 ? NETTYPE_IPV6 : NETTYPE_IPV4;
+		CNetPrefixTree Tree;
+		std::vector<CTestRange> lRanges(200);
+		for(unsigned i = 0; i < lRanges.size(); i++)
+		{
+			lRanges[i].m_LB = RandomAddr(Type);
+			lRanges[i].m_UB = RandomAddr(Type);
+			int Bytes = CNetPrefixTree::AddrBits(Type)/8;
+			if(mem_comp(lRanges[i].m_LB.ip, lRanges[i].m_UB.ip, Bytes) > 0)
+				std::swap(lRanges[i].m_LB, lRanges[i].m_UB);
+			if(Random()%4 == 0)
+				lRanges[i].m_UB = lRanges[i].m_LB;
+			Tree.InsertRange(&lRanges[i].m_LB, &lRanges[i].m_UB, &lRanges[i]);
+		}
+
+		// remove half of them again
+		std::vector<bool> lRemoved(lRanges.size());
+		for(unsigned i = 0; i < lRanges.size(); i++)
+		{
+			if(Random()%2)
+			{
+				Tree.RemoveRange(&lRanges[i].m_LB, &lRanges[i].m_UB, &lRanges[i]);
+				lRemoved[i] = true;
+			}
+		}
+
+		for(int i = 0; i < 2000; i++)
+		{
+			NETADDR Test = RandomAddr(Type);
+			bool Expected = false;
+			for(unsigned j = 0; j < lRanges.size(); j++)
+				Expected |= !lRemoved[j] && Contains(&lRanges[j], &Test);
+
+			CTestRange *pMatch = static_cast<CTestRange *>(Tree.Match(&Test));
+			ASSERT_EQ(pMatch != 0, Expected);
+			if(pMatch)
+			{
+				EXPECT_FALSE(lRemoved[pMatch-&lRanges[0]]);
+				EXPECT_TRUE(Contains(pMatch, &Test));
+			}
+		}
+
+		for(unsigned i = 0; i < lRanges.size(); i++)
+		{
+			if(!lRemoved[i])
+				Tree.RemoveRange(&lRanges[i].m_LB, &lRanges[i].m_UB, &lRanges[i]);
+		}
+		EXPECT_EQ(Tree.NumNodes(), 3);
+	}
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <game/server/infclass/occupancygrid.h>
+
+#include <vector>
+
+TEST(OccupancyGrid, Empty)
+{
+	COccupancyGrid Grid(64.0f);
+	EXPECT_FALSE(Grid.IsOccupied(vec2(0.0f, 0.0f), 60.0f));
+	EXPECT_EQ(Grid.Num(), 0);
+}
+
+TEST(OccupancyGrid, Radius)
+{
+	COccupancyGrid Grid(64.0f);
+	Grid.Add(vec2(100.0f, 100.0f));
+	EXPECT_TRUE(Grid.IsOccupied(vec2(100.0f, 100.0f), 60.0f));
+	EXPECT_TRUE(Grid.IsOccupied(vec2(160.0f, 100.0f), 60.0f));
+	EXPECT_FALSE(Grid.IsOccupied(vec2(161.0f, 100.0f), 60.0f));
+	EXPECT_TRUE(Grid.IsOccupied(vec2(140.0f, 140.0f), 60.0f));
+	EXPECT_FALSE(Grid.IsOccupied(vec2(150.0f, 150.0f), 60.0f));
+
+	Grid.Clear();
+	EXPECT_FALSE(Grid.IsOccupied(vec2(100.0f, 100.0f), 60.0f));
+}
+
+TEST(OccupancyGrid, Negative)
+{
+	// positions outside of the map still work
+	COccupancyGrid Grid(64.0f);
+	Grid.Add(vec2(-10.0f, -10.0f));
+	EXPECT_TRUE(Grid.IsOccupied(vec2(10.0f, 10.0f), 60.0f));
+	EXPECT_TRUE(Grid.IsOccupied(vec2(-60.0f, -10.0f), 60.0f));
+	EXPECT_FALSE(Grid.IsOccupied(vec2(-80.0f, -10.0f), 60.0f));
+}
+
+TEST(OccupancyGrid, BruteForce)
+{
+	std::vector<vec2> lPositions;
+	COccupancyGrid Grid(64.0f);
+	for(int i = 0; i < 64; i++)
+	{
+		vec2 Pos(random_float() * 2000.0f - 200.0f, random_float() * 1000.0f - 200.0f);
+		lPositions.push_back(Pos);
+		Grid.Add(Pos);
+	}
+
+	for(int i = 0; i < 10000; i++)
+	{
+		vec2 Pos(random_float() * 2000.0f - 200.0f, random_float() * 1000.0f - 200.0f);
+		bool Expected = false;
+		for(unsigned j = 0; j < lPositions.size(); j++)
+			Expected = Expected || distance(lPositions[j], Pos) <= 60.0f;
+		ASSERT_EQ(Grid.IsOccupied(Pos, 60.0f), Expected);
+	}
+}
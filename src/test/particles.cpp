@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/infclass/particles.h>
+
+#include <vector>
+
+static void Fill(CParticleSet *pSet, int Num)
+{
+	pSet->Resize(Num);
+	for(int i = 0; i < Num; i++)
+	{
+		float Angle = 2.0f * pi * i / Num;
+		float Distance = 10.0f + (i * 37) % 420;
+		vec2 Dir = vec2(cosf(Angle), sinf(Angle));
+		// every fifth particle already flies away from the center
+		pSet->Set(i, vec2(1000.0f, 500.0f) + Dir * Distance, i % 5 ? -Dir : Dir);
+	}
+}
+
+static void ExpectSame(const CParticleSet &Set1, const CParticleSet &Set2)
+{
+	ASSERT_EQ(Set1.Num(), Set2.Num());
+	for(int i = 0; i < Set1.Num(); i++)
+	{
+		EXPECT_FLOAT_EQ(Set1.Pos(i).x, Set2.Pos(i).x);
+		EXPECT_FLOAT_EQ(Set1.Pos(i).y, Set2.Pos(i).y);
+		EXPECT_FLOAT_EQ(Set1.Vel(i).x, Set2.Vel(i).x);
+		EXPECT_FLOAT_EQ(Set1.Vel(i).y, Set2.Vel(i).y);
+	}
+}
+
+TEST(Particles, PullTowards)
+{
+	// not a multiple of the batch size
+	const int Num = 101;
+	CParticleSet Set1, Set2;
+	Fill(&Set1, Num);
+	Fill(&Set2, Num);
+
+	std::vector<int> lArrived1(Num), lArrived2(Num);
+	for(int Tick = 0; Tick < 50; Tick++)
+	{
+		int NumArrived1 = Set1.PullTowards(vec2(1000.0f, 500.0f), 430.0f, 1.1f, 1.01f, lArrived1.data());
+		int NumArrived2 = Set2.PullTowardsScalar(vec2(1000.0f, 500.0f), 430.0f, 1.1f, 1.01f, lArrived2.data());
+		ASSERT_EQ(NumArrived1, NumArrived2);
+		for(int i = 0; i < NumArrived1; i++)
+		{
+			EXPECT_EQ(lArrived1[i], lArrived2[i]);
+			EXPECT_LT(lArrived1[i], Num);
+		}
+		ExpectSame(Set1, Set2);
+	}
+}
+
+TEST(Particles, Visible)
+{
+	const int Num = 101;
+	CParticleSet Set;
+	Fill(&Set, Num);
+
+	std::vector<int> lVisible1(Num), lVisible2(Num);
+	const vec2 aViewPos[] = {vec2(1000.0f, 500.0f), vec2(0.0f, 0.0f), vec2(1900.0f, 500.0f), vec2(5000.0f, 5000.0f)};
+	for(unsigned v = 0; v < sizeof(aViewPos) / sizeof(aViewPos[0]); v++)
+	{
+		int NumVisible1 = Set.Visible(vec2(1000.0f, 500.0f), 200.0f, aViewPos[v], lVisible1.data());
+		int NumVisible2 = Set.VisibleScalar(vec2(1000.0f, 500.0f), 200.0f, aViewPos[v], lVisible2.data());
+		ASSERT_EQ(NumVisible1, NumVisible2);
+		for(int i = 0; i < NumVisible1; i++)
+			EXPECT_EQ(lVisible1[i], lVisible2[i]);
+	}
+
+	EXPECT_GT(Set.Visible(vec2(1000.0f, 500.0f), 200.0f, vec2(1000.0f, 500.0f), lVisible1.data()), 0);
+	EXPECT_EQ(Set.Visible(vec2(1000.0f, 500.0f), 1000.0f, vec2(5000.0f, 5000.0f), lVisible1.data()), 0);
+}
+
+TEST(Particles, CirclePoints)
+{
+	vec2 aPoints[12];
+	CirclePoints(vec2(100.0f, 50.0f), 32.0f, 0.3f, 12, aPoints);
+	for(int i = 0; i < 12; i++)
+	{
+		float Angle = 0.3f + 2.0f * pi * i / 12;
+		EXPECT_NEAR(aPoints[i].x, 100.0f + 32.0f * cosf(Angle), 0.01f);
+		EXPECT_NEAR(aPoints[i].y, 50.0f + 32.0f * sinf(Angle), 0.01f);
+	}
+}
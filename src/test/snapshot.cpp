@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/snapshot.h>
+
+static char s_aSnapData[CSnapshot::MAX_SIZE];
+
+TEST(SnapshotBuilder, WithinBudget)
+{
+	static CSnapshotBuilder s_Builder;
+	s_Builder.Init();
+	for(int i = 0; i < 10; i++)
+	{
+		s_Builder.SetPriority(10 - i);
+		int *pData = (int *)s_Builder.NewItem(1, i, sizeof(int));
+		ASSERT_TRUE(pData);
+		*pData = i;
+	}
+	s_Builder.Finish(s_aSnapData);
+	CSnapshot *pSnap = (CSnapshot *)s_aSnapData;
+	ASSERT_EQ(pSnap->NumItems(), 10);
+	EXPECT_EQ(s_Builder.NumDroppedItems(), 0);
+	for(int i = 0; i < 10; i++)
+		EXPECT_EQ(pSnap->GetItem(i)->Data()[0], i);
+}
+
+TEST(SnapshotBuilder, DropLeastImportant)
+{
+	static CSnapshotBuilder s_Builder;
+	s_Builder.Init();
+	// every other item is important, the others are added farther and farther away
+	const int NumItems = 1500;
+	for(int i = 0; i < NumItems; i++)
+	{
+		s_Builder.SetPriority(i%2 ? 1000 + i : 0);
+		int *pData = (int *)s_Builder.NewItem(1, i, sizeof(int));
+		ASSERT_TRUE(pData);
+		*pData = i;
+	}
+	int Size = s_Builder.Finish(s_aSnapData);
+	EXPECT_LE(Size, (int)CSnapshot::MAX_SIZE);
+
+	CSnapshot *pSnap = (CSnapshot *)s_aSnapData;
+	EXPECT_EQ(pSnap->NumItems(), 1023);
+	EXPECT_EQ(s_Builder.NumDroppedItems(), NumItems - 1023);
+
+	// all the important items are kept, then the closest others, in the original order
+	int NumImportant = 0;
+	int LastKey = -1;
+	for(int i = 0; i < pSnap->NumItems(); i++)
+	{
+		int Value = pSnap->GetItem(i)->Data()[0];
+		EXPECT_EQ(pSnap->GetItem(i)->ID(), Value);
+		EXPECT_GT(Value, LastKey);
+		LastKey = Value;
+		if(Value%2 == 0)
+			NumImportant++;
+		else
+			EXPECT_LT(Value, 2*(1023 - NumItems/2));
+	}
+	EXPECT_EQ(NumImportant, NumItems/2);
+}
+
+TEST(SnapshotBuilder, SizeBudget)
+{
+	static CSnapshotBuilder s_Builder;
+	s_Builder.Init();
+	const int ItemSize = 1024;
+	for(int i = 0; i < 100; i++)
+	{
+		s_Builder.SetPriority(i < 50 ? 1 : 0);
+		ASSERT_TRUE(s_Builder.NewItem(1, i, ItemSize));
+	}
+	int Size = s_Builder.Finish(s_aSnapData);
+	EXPECT_LE(Size, (int)CSnapshot::MAX_SIZE);
+
+	CSnapshot *pSnap = (CSnapshot *)s_aSnapData;
+	EXPECT_GT(pSnap->NumItems(), 50);
+	EXPECT_LT(pSnap->NumItems(), 64);
+	EXPECT_EQ(s_Builder.NumDroppedItems(), 100 - pSnap->NumItems());
+	// the later items were more important
+	EXPECT_EQ(pSnap->GetItem(pSnap->NumItems() - 1)->ID(), 99);
+	EXPECT_EQ(pSnap->GetItem(pSnap->NumItems() - 50)->ID(), 50);
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/packer.h>
+#include <game/server/tuningprofiles.h>
+
+static void ExpectPacked(const CTuningProfiles *pProfiles, int ID, const CTuningParams *pParams)
+{
+	CMsgPacker Expected(NETMSGTYPE_SV_TUNEPARAMS);
+	const int *pValues = (const int *)pParams;
+	for(int i = 0; i < CTuningParams::Num(); i++)
+		Expected.AddInt(pValues[i]);
+
+	CMsgPacker Msg(NETMSGTYPE_SV_TUNEPARAMS);
+	ASSERT_TRUE(pProfiles->Pack(ID, &Msg));
+	ASSERT_EQ(Msg.Size(), Expected.Size());
+	EXPECT_EQ(mem_comp(Msg.Data(), Expected.Data(), Msg.Size()), 0);
+}
+
+TEST(TuningProfiles, Intern)
+{
+	CTuningProfiles Profiles;
+	CTuningParams Default;
+	CTuningParams Water;
+	Water.m_Gravity = -0.05f;
+	Water.m_GroundFriction = 0.95f;
+
+	int DefaultID = Profiles.Intern(&Default);
+	int WaterID = Profiles.Intern(&Water);
+	EXPECT_NE(DefaultID, WaterID);
+	EXPECT_EQ(Profiles.Intern(&Default), DefaultID);
+	CTuningParams WaterAgain = Water;
+	EXPECT_EQ(Profiles.Intern(&WaterAgain), WaterID);
+	EXPECT_EQ(Profiles.Num(), 2);
+
+	ExpectPacked(&Profiles, DefaultID, &Default);
+	ExpectPacked(&Profiles, WaterID, &Water);
+}
+
+TEST(TuningProfiles, Clear)
+{
+	CTuningProfiles Profiles;
+	CTuningParams Default;
+	int OldID = Profiles.Intern(&Default);
+	Profiles.Clear();
+
+	CMsgPacker Msg(NETMSGTYPE_SV_TUNEPARAMS);
+	EXPECT_FALSE(Profiles.Pack(OldID, &Msg));
+	int NewID = Profiles.Intern(&Default);
+	EXPECT_NE(NewID, OldID);
+	ExpectPacked(&Profiles, NewID, &Default);
+}
+
+TEST(TuningProfiles, Full)
+{
+	CTuningProfiles Profiles;
+	CTuningParams Params;
+	int FirstID = Profiles.Intern(&Params);
+	for(int i = 1; i < CTuningProfiles::MAX_PROFILES; i++)
+	{
+		Params.m_HookLength = 380.0f + i;
+		Profiles.Intern(&Params);
+	}
+	EXPECT_EQ(Profiles.Num(), (int)CTuningProfiles::MAX_PROFILES);
+
+	// one more starts over
+	Params.m_HookLength = 0.0f;
+	int ID = Profiles.Intern(&Params);
+	EXPECT_EQ(Profiles.Num(), 1);
+	CMsgPacker Msg(NETMSGTYPE_SV_TUNEPARAMS);
+	EXPECT_FALSE(Profiles.Pack(FirstID, &Msg));
+	ExpectPacked(&Profiles, ID, &Params);
+}
@@ -0,0 +1,267 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/hash.h>
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/config.h>
+#include <engine/console.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/server/mapconverter.h>
+#include <engine/shared/config.h>
+#include <engine/shared/datafile.h>
+#include <engine/storage.h>
+#include <game/server/infclass/events-director.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Converts the client maps of every server map ahead of time, so that the
+// server finds them in clientmaps/ instead of converting on a map change.
+
+struct CConvertResult
+{
+	std::string m_MapName;
+	char m_aConverterId[32];
+	unsigned m_ServerMapCrc;
+	unsigned m_ClientMapCrc;
+	SHA256_DIGEST m_ClientMapSha256;
+	bool m_Generated;
+	bool m_Success;
+};
+
+struct CConvertJob
+{
+	IStorage *m_pStorage;
+	IConsole *m_pConsole;
+	const char *m_pConverterId;
+	bool m_Force;
+
+	std::vector<CConvertResult> m_lResults;
+	unsigned m_Next;
+	LOCK m_Lock;
+};
+
+struct CWorker
+{
+	CConvertJob *m_pJob;
+	IKernel *m_pKernel;
+	IEngineMap *m_pMap;
+};
+
+static bool ConvertMap(CConvertJob *pJob, IEngineMap *pMap, CConvertResult *pResult)
+{
+	char aMapFilename[MAX_PATH_LENGTH];
+	str_format(aMapFilename, sizeof(aMapFilename), "maps/%s.map", pResult->m_MapName.c_str());
+	if(!pMap->Load(aMapFilename))
+	{
+		dbg_msg("clientmap_generate", "failed to load map '%s'", aMapFilename);
+		return false;
+	}
+	pResult->m_ServerMapCrc = pMap->Crc();
+
+	// same converter id as CServer::GenerateClientMap picks for this map
+	EventsDirector::SetPreloadedMapName(pResult->m_MapName.c_str());
+	str_copy(pResult->m_aConverterId, EventsDirector::GetMapConverterId(pJob->m_pConverterId), sizeof(pResult->m_aConverterId));
+
+	char aClientMapName[MAX_PATH_LENGTH];
+	CMapConverter::GetClientMapName(aClientMapName, sizeof(aClientMapName), pResult->m_aConverterId, pResult->m_MapName.c_str(), pResult->m_ServerMapCrc);
+
+	CDataFileReader ClientMap;
+	if(pJob->m_Force || !ClientMap.Open(pJob->m_pStorage, aClientMapName, IStorage::TYPE_ALL))
+	{
+		char aFullPath[MAX_PATH_LENGTH];
+		pJob->m_pStorage->GetCompletePath(IStorage::TYPE_SAVE, aClientMapName, aFullPath, sizeof(aFullPath));
+		fs_makedir_rec_for(aFullPath);
+
+		CMapConverter MapConverter(pJob->m_pStorage, pMap, pJob->m_pConsole);
+		if(!MapConverter.Load() || !MapConverter.CreateMap(aClientMapName))
+		{
+			dbg_msg("clientmap_generate", "failed to convert '%s'", aMapFilename);
+			pMap->Unload();
+			return false;
+		}
+		pResult->m_Generated = true;
+
+		if(!ClientMap.Open(pJob->m_pStorage, aClientMapName, IStorage::TYPE_ALL))
+		{
+			pMap->Unload();
+			return false;
+		}
+	}
+	pMap->Unload();
+
+	pResult->m_ClientMapCrc = ClientMap.Crc();
+	pResult->m_ClientMapSha256 = ClientMap.Sha256();
+	return true;
+}
+
+static void ConvertThread(void *pUser)
+{
+	CWorker *pWorker = (CWorker *)pUser;
+	CConvertJob *pJob = pWorker->m_pJob;
+	while(1)
+	{
+		lock_wait(pJob->m_Lock);
+		unsigned Next = pJob->m_Next++;
+		lock_unlock(pJob->m_Lock);
+		if(Next >= pJob->m_lResults.size())
+			break;
+
+		CConvertResult *pResult = &pJob->m_lResults[Next];
+		pResult->m_Success = ConvertMap(pJob, pWorker->m_pMap, pResult);
+	}
+}
+
+static int ListMapsCallback(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	std::vector<std::string> *plMapNames = (std::vector<std::string> *)pUser;
+	int Length = str_length(pName);
+	if(IsDir || !str_endswith(pName, ".map"))
+		return 0;
+
+	std::string MapName(pName, Length - 4);
+	if(std::find(plMapNames->begin(), plMapNames->end(), MapName) == plMapNames->end())
+		plMapNames->push_back(MapName);
+	return 0;
+}
+
+static void WriteManifest(IStorage *pStorage, const std::vector<CConvertResult> &lResults)
+{
+	IOHANDLE File = pStorage->OpenFile("clientmaps/manifest.txt", IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		dbg_msg("clientmap_generate", "failed to write 'clientmaps/manifest.txt'");
+		return;
+	}
+
+	char aLine[512];
+	str_copy(aLine, "# map converter_id server_crc client_crc client_sha256", sizeof(aLine));
+	io_write(File, aLine, str_length(aLine));
+	io_write_newline(File);
+	for(unsigned i = 0; i < lResults.size(); i++)
+	{
+		if(!lResults[i].m_Success)
+			continue;
+
+		char aSha256[SHA256_MAXSTRSIZE];
+		sha256_str(lResults[i].m_ClientMapSha256, aSha256, sizeof(aSha256));
+		str_format(aLine, sizeof(aLine), "%s %s %08x %08x %s", lResults[i].m_MapName.c_str(), lResults[i].m_aConverterId,
+			lResults[i].m_ServerMapCrc, lResults[i].m_ClientMapCrc, aSha256);
+		io_write(File, aLine, str_length(aLine));
+		io_write_newline(File);
+	}
+	io_close(File);
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	IConfig *pConfig = CreateConfig();
+	pConfig->Reset();
+
+	int NumThreads = 4;
+	bool Force = false;
+	std::vector<std::string> lMapNames;
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		if(str_comp(argv[i], "-j") == 0 && i + 1 < argc) // ignore_convention
+			NumThreads = str_toint(argv[++i]); // ignore_convention
+		else if(str_comp(argv[i], "-c") == 0 && i + 1 < argc) // ignore_convention
+			str_copy(g_Config.m_InfConverterId, argv[++i], sizeof(g_Config.m_InfConverterId)); // ignore_convention
+		else if(str_comp(argv[i], "-f") == 0) // ignore_convention
+			Force = true;
+		else if(argv[i][0] == '-') // ignore_convention
+		{
+			dbg_msg("usage", "%s [-j threads] [-c converter_id] [-f] [map ...]", argv[0]); // ignore_convention
+			return -1;
+		}
+		else
+			lMapNames.push_back(argv[i]); // ignore_convention
+	}
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_SERVER, argc, argv); // ignore_convention
+	if(!pStorage)
+		return -1;
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+
+	// without a rotation list, convert everything in maps/
+	if(lMapNames.empty())
+		pStorage->ListDirectory(IStorage::TYPE_ALL, "maps", ListMapsCallback, &lMapNames);
+	std::sort(lMapNames.begin(), lMapNames.end());
+
+	CConvertJob Job;
+	Job.m_pStorage = pStorage;
+	Job.m_pConsole = pConsole;
+	Job.m_pConverterId = g_Config.m_InfConverterId;
+	Job.m_Force = Force;
+	Job.m_Next = 0;
+	Job.m_Lock = lock_create();
+	for(unsigned i = 0; i < lMapNames.size(); i++)
+	{
+		CConvertResult Result;
+		Result.m_MapName = lMapNames[i];
+		Result.m_aConverterId[0] = 0;
+		Result.m_ServerMapCrc = 0;
+		Result.m_ClientMapCrc = 0;
+		Result.m_Generated = false;
+		Result.m_Success = false;
+		Job.m_lResults.push_back(Result);
+	}
+
+	// the maps are converted side by side, each one compressed on a single thread
+	g_Config.m_InfConverterThreads = 1;
+	g_Config.m_SvMapLoadThreads = 1;
+	NumThreads = clamp(NumThreads, 1, maximum((int)lMapNames.size(), 1));
+
+	// every worker needs its own map, and so its own kernel to hand the storage to it
+	std::vector<CWorker> lWorkers(NumThreads);
+	for(int i = 0; i < NumThreads; i++)
+	{
+		lWorkers[i].m_pJob = &Job;
+		lWorkers[i].m_pKernel = IKernel::Create();
+		lWorkers[i].m_pMap = CreateEngineMap();
+		lWorkers[i].m_pKernel->RegisterInterface(pStorage);
+		lWorkers[i].m_pKernel->RegisterInterface(static_cast<IEngineMap *>(lWorkers[i].m_pMap));
+	}
+
+	int64 StartTime = time_get();
+	std::vector<void *> lThreads;
+	for(int i = 1; i < NumThreads; i++)
+	{
+		void *pThread = thread_init(ConvertThread, &lWorkers[i], "clientmap converter");
+		if(pThread)
+			lThreads.push_back(pThread);
+	}
+	ConvertThread(&lWorkers[0]);
+	for(unsigned i = 0; i < lThreads.size(); i++)
+		thread_wait(lThreads[i]);
+	lock_destroy(Job.m_Lock);
+
+	int NumGenerated = 0;
+	int NumFailed = 0;
+	for(unsigned i = 0; i < Job.m_lResults.size(); i++)
+	{
+		if(!Job.m_lResults[i].m_Success)
+			NumFailed++;
+		else if(Job.m_lResults[i].m_Generated)
+			NumGenerated++;
+	}
+	WriteManifest(pStorage, Job.m_lResults);
+
+	dbg_msg("clientmap_generate", "%d maps, %d generated, %d up to date, %d failed in %.2fs using %d threads",
+		(int)Job.m_lResults.size(), NumGenerated, (int)Job.m_lResults.size() - NumGenerated - NumFailed, NumFailed,
+		(time_get() - StartTime) / (float)time_freq(), (int)lThreads.size() + 1);
+
+	for(int i = 0; i < NumThreads; i++)
+	{
+		delete lWorkers[i].m_pMap;
+		delete lWorkers[i].m_pKernel;
+	}
+	delete pConsole;
+	delete pStorage;
+	delete pConfig;
+	return NumFailed ? -1 : 0;
+}
@@ -0,0 +1,46 @@
+#include <base/system.h>
+#include <engine/storage.h>
+#include <teeuniverses/components/localization.h>
+
+// Writes a compiled catalog next to the json file of every language, so the
+// server can map the translations instead of parsing json at startup.
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+
+	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_SERVER, argc, argv); // ignore_convention
+	if(!pStorage)
+		return -1;
+
+	CLocalization *pLocalization = new CLocalization(pStorage);
+	if(!pLocalization->Init())
+	{
+		dbg_msg("localization_compile", "failed to load the language index");
+		delete pLocalization;
+		delete pStorage;
+		return -1;
+	}
+
+	// languages without a json file, like english, have nothing to compile
+	int NumCompiled = 0;
+	int NumFailed = 0;
+	for(int i = 0; i < pLocalization->m_pLanguages.size(); i++)
+	{
+		const CLocalization::CLanguage *pLanguage = pLocalization->m_pLanguages[i];
+		if(!pLanguage->IsLoaded())
+			continue;
+		if(pLanguage->SaveCatalog())
+			NumCompiled++;
+		else
+		{
+			dbg_msg("localization_compile", "failed to compile '%s'", pLanguage->GetFilename());
+			NumFailed++;
+		}
+	}
+	dbg_msg("localization_compile", "%d languages compiled, %d failed", NumCompiled, NumFailed);
+
+	delete pLocalization;
+	delete pStorage;
+	return NumFailed ? -1 : 0;
+}